@@ -40,8 +40,12 @@
 #include "lvr2/io/hdf5/HDF5FeatureBase.hpp"
 #include "lvr2/io/hdf5/ChunkIO.hpp"
 
+#include <exception>
 #include <list>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace lvr2
 {
@@ -64,6 +68,14 @@ class ChunkGeomtryChannelVisitor : public boost::static_visitor<FloatChannelOpti
     }
 };
 
+/**
+ * @brief LRU cache of chunks that are stored in an HDF5 file
+ *
+ * Reading chunks (getChunk, isChunkLoaded and the cache statistics) is thread-safe, i.e., several
+ * threads may request chunks concurrently while chunks are loaded in the background. Cache hits
+ * do not wait for running HDF5 reads. Modifying the grid (setChunk, setGeometryChunk,
+ * setBoundingBox) must not run concurrently with other calls.
+ */
 class ChunkHashGrid
 {
   public:
@@ -75,6 +87,8 @@ class ChunkHashGrid
      * @brief class to load chunks from an HDF5 file
      *
      * @param hdf5Path path to the HDF5 file
+     * @param cacheSize maximum number of cached chunks. The most recently used chunk is always
+     *                  kept, so 0 behaves like 1 and does not disable the cache.
      */
     explicit ChunkHashGrid(std::string hdf5Path, size_t cacheSize, float chunkSize = 10.0f);
 
@@ -82,6 +96,8 @@ class ChunkHashGrid
      * @brief class to load chunks from an HDF5 file
      *
      * @param hdf5Path path to the HDF5 file
+     * @param cacheSize maximum number of cached chunks. The most recently used chunk is always
+     *                  kept, so 0 behaves like 1 and does not disable the cache.
      */
     ChunkHashGrid(std::string hdf5Path,
                   size_t cacheSize,
@@ -128,6 +144,8 @@ class ChunkHashGrid
      * Returns a the content of a chunk from the local cache.
      * If the requested chunk is not cached, the chunk will be loaded from the persistent storage
      * and returned after being added to the cache.
+     * If a prefetch failed with an unexpected exception since the last call, that exception is
+     * rethrown here.
      *
      * @tparam T type of requested chunk
      * @param layer layer of requested chunk
@@ -162,6 +180,111 @@ class ChunkHashGrid
      */
     bool isChunkLoaded(std::string layer, int x, int y, int z);
 
+    /**
+     * @brief sets the maximum number of bytes the cached chunks may occupy
+     *
+     * The size of a chunk is estimated from the data of its channels. Least recently used chunks
+     * are evicted until both the chunk count limit and the byte limit are satisfied.
+     * The most recently used chunk is never evicted, so at least one chunk stays cached.
+     *
+     * @param cacheBytes maximum number of cached bytes, 0 disables the limit (default)
+     */
+    void setCacheBytes(std::size_t cacheBytes);
+
+    /**
+     * @brief returns the maximum number of bytes the cached chunks may occupy (0 = unlimited)
+     */
+    std::size_t getCacheBytes() const
+    {
+        return m_cacheBytes;
+    }
+
+    /**
+     * @brief returns the estimated number of bytes of all currently cached chunks
+     */
+    std::size_t getCachedBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        return m_cachedBytes;
+    }
+
+    /**
+     * @brief returns the number of currently cached chunks
+     */
+    std::size_t getNumCachedChunks() const
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        return m_items.size();
+    }
+
+    /**
+     * @brief returns the number of chunk requests that were served from the cache
+     */
+    std::size_t getCacheHits() const
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        return m_cacheHits;
+    }
+
+    /**
+     * @brief returns the number of chunk requests that were not in the cache
+     */
+    std::size_t getCacheMisses() const
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        return m_cacheMisses;
+    }
+
+    /**
+     * @brief returns the number of chunks that were evicted from the cache
+     */
+    std::size_t getCacheEvictions() const
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        return m_cacheEvictions;
+    }
+
+    /**
+     * @brief returns the number of chunks that were loaded into the cache by a prefetch
+     */
+    std::size_t getPrefetchedChunks() const
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        return m_prefetchedChunks;
+    }
+
+    /**
+     * @brief returns the number of prefetched chunks that were requested before their eviction
+     */
+    std::size_t getPrefetchHits() const
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        return m_prefetchHits;
+    }
+
+    /**
+     * @brief returns the number of prefetched chunks that were evicted without being requested
+     */
+    std::size_t getPrefetchWasted() const
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        return m_prefetchWasted;
+    }
+
+    /**
+     * @brief resets the hit, miss, eviction and prefetch counters of the cache
+     */
+    void resetCacheStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        m_cacheHits        = 0;
+        m_cacheMisses      = 0;
+        m_cacheEvictions   = 0;
+        m_prefetchedChunks = 0;
+        m_prefetchHits     = 0;
+        m_prefetchWasted   = 0;
+    }
+
     /**
      * @brief Calculates the hash value for the given index triple
      *
@@ -223,6 +346,8 @@ class ChunkHashGrid
     /**
      * @brief regenerates cache hash grid
      *
+     * Has to be called with m_cacheMutex locked.
+     *
      * @param oldChunkAmount previous amount of chunks
      * @param oldChunkIndexOffset previous offset for chunk indices
      */
@@ -240,10 +365,12 @@ class ChunkHashGrid
      * @param y y coordinate of chunk in chunk coordinates
      * @param z z coordinate of chunk in chunk coordinates
      *
+     * @param prefetched true if the chunk is loaded in advance, i.e., not requested yet
+     *
      * @return true if chunk has been loaded; false if chunk does not exist in persistend storage
      */
     template <typename T>
-    bool loadChunk(std::string layer, int x, int y, int z);
+    bool loadChunk(std::string layer, int x, int y, int z, bool prefetched = false);
 
     /**
      * @brief loads given chunk data into cache
@@ -257,8 +384,46 @@ class ChunkHashGrid
      * @param y y coordinate of chunk in chunk coordinates
      * @param z z coordinate of chunk in chunk coordinates
      * @param data content of chunk to load
+     * @param prefetched true if the chunk is loaded in advance, i.e., not requested yet
      */
-    void loadChunk(std::string layer, int x, int y, int z, const val_type& data);
+    void loadChunk(std::string layer,
+                   int x,
+                   int y,
+                   int z,
+                   const val_type& data,
+                   bool prefetched = false);
+
+    /**
+     * @brief returns the cached chunk or nullptr and moves it to the front of the lru cache
+     *
+     * Has to be called with m_cacheMutex locked.
+     *
+     * @param layer layer of chunk
+     * @param hashValue hash of the chunk coordinate
+     * @param request true if the chunk is requested, false if it is only refreshed by a prefetch
+     *
+     * @return pointer to the cached chunk data if the chunk is loaded; else nullptr
+     */
+    val_type* touchChunk(const std::string& layer, std::size_t hashValue, bool request = true);
+
+    /**
+     * @brief returns a chunk from the cache or loads it from persistent storage into the cache
+     *
+     * HDF5 reads are serialized, the cache is locked only while it is accessed.
+     *
+     * @return content of the chunk; nullptr if it does not exist in persistent storage
+     */
+    template <typename T>
+    T readChunk(const std::string& layer, int x, int y, int z, bool prefetched);
+
+    // protects m_items, m_hashGrid, the interned layers and the cache statistics
+    mutable std::mutex m_cacheMutex;
+
+    // serializes the access to the HDF5 file, has to be locked before m_cacheMutex
+    std::mutex m_ioMutex;
+
+    // unexpected exception of a prefetch, rethrown by the next getChunk, protected by m_cacheMutex
+    std::exception_ptr m_prefetchError;
 
     /**
      * @brief sets chunk size in this container and in persistent storage
@@ -286,17 +451,75 @@ class ChunkHashGrid
                                  const BaseVector<std::size_t>& chunkIndexOffset);
 
   private:
+    // (layer id, chunk hash) pair stored in the lru list
+    using lru_key = std::pair<std::size_t, std::size_t>;
+
+    // cache entry of a chunk with its estimated size and position in the lru list
+    struct CacheEntry
+    {
+        val_type data;
+        std::size_t bytes;
+        std::list<lru_key>::iterator lruIt;
+        bool prefetched;
+    };
+
+    /**
+     * @brief returns the interned id of a layer, creates a new one if the layer is unknown
+     *
+     * Has to be called with m_cacheMutex locked.
+     */
+    std::size_t layerId(const std::string& layer);
+
+    /**
+     * @brief returns the cache entry of a chunk or nullptr if the chunk is not loaded
+     *
+     * Has to be called with m_cacheMutex locked.
+     */
+    CacheEntry* findEntry(const std::string& layer, std::size_t hashValue);
+
+    /**
+     * @brief evicts least recently used chunks until the cache limits are met
+     *
+     * Has to be called with m_cacheMutex locked.
+     */
+    void evictChunks();
+
+    /**
+     * @brief estimates the number of bytes of the channel data of a chunk
+     */
+    static std::size_t chunkBytes(const val_type& data);
+
     // chunkIO for the HDF5 file-IO
     io m_io;
 
-    // number of chunks that will be cached before deleting old chunks
+    // number of chunks that will be cached before deleting old chunks (at least one is kept)
     size_t m_cacheSize;
 
-    // ordered list to save recently used hashValues for the lru cache
-    std::list<std::pair<std::string, size_t>> m_items;
+    // number of bytes that may be cached before deleting old chunks (0 = unlimited)
+    size_t m_cacheBytes = 0;
+
+    // estimated number of bytes of all cached chunks
+    size_t m_cachedBytes = 0;
+
+    // cache statistics
+    size_t m_cacheHits      = 0;
+    size_t m_cacheMisses    = 0;
+    size_t m_cacheEvictions = 0;
+
+    // prefetch statistics
+    size_t m_prefetchedChunks = 0;
+    size_t m_prefetchHits     = 0;
+    size_t m_prefetchWasted   = 0;
+
+    // ordered list to save recently used (layer id, hashValue) pairs for the lru cache
+    std::list<lru_key> m_items;
+
+    // interned layer names, the index in m_layerNames is the layer id
+    std::unordered_map<std::string, std::size_t> m_layerIds;
+    std::vector<std::string> m_layerNames;
 
-    // hash map containing chunked meshes
-    std::unordered_map<std::string, std::unordered_map<size_t, val_type>> m_hashGrid;
+    // hash maps containing the cached chunks for each layer id
+    std::vector<std::unordered_map<size_t, CacheEntry>> m_hashGrid;
 
     // size of chunks
     float m_chunkSize;
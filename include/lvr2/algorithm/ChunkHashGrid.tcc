@@ -44,40 +44,58 @@ boost::optional<T> ChunkHashGrid::getChunk(std::string layer, int x, int y, int
     }
     std::size_t chunkHash = hashValue(x, y, z);
 
-    if (isChunkLoaded(layer, chunkHash))
     {
-        // move chunk to the front of the cache queue
-        m_items.remove({layer, chunkHash});
-        m_items.push_front({layer, chunkHash});
-
-        return boost::get<T>(m_hashGrid[layer][chunkHash]);
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        if (m_prefetchError)
+        {
+            std::exception_ptr error = m_prefetchError;
+            m_prefetchError          = nullptr;
+            std::rethrow_exception(error);
+        }
+        if (val_type* chunk = touchChunk(layer, chunkHash))
+        {
+            m_cacheHits++;
+            return boost::get<T>(*chunk);
+        }
+        m_cacheMisses++;
     }
 
-    if (loadChunk<T>(layer, x, y, z))
+    T data = readChunk<T>(layer, x, y, z, false);
+    if (data != nullptr)
     {
-        return boost::get<T>(m_hashGrid[layer][chunkHash]);
+        return data;
     }
 
     return boost::optional<T>{};
 }
 
 template <typename T>
-bool ChunkHashGrid::loadChunk(std::string layer, int x, int y, int z)
+bool ChunkHashGrid::loadChunk(std::string layer, int x, int y, int z, bool prefetched)
+{
+    return readChunk<T>(layer, x, y, z, prefetched) != nullptr;
+}
+
+template <typename T>
+T ChunkHashGrid::readChunk(const std::string& layer, int x, int y, int z, bool prefetched)
 {
-    if (isChunkLoaded(layer, x, y, z))
+    std::lock_guard<std::mutex> ioLock(m_ioMutex);
+
+    // the chunk may have been loaded by another thread while waiting for the file
     {
-        return true;
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        if (val_type* chunk = touchChunk(layer, hashValue(x, y, z), !prefetched))
+        {
+            return boost::get<T>(*chunk);
+        }
     }
 
     T data = m_io.loadChunk<T>(layer, x, y, z);
-    if (data == nullptr)
+    if (data != nullptr)
     {
-        return false;
+        loadChunk(layer, x, y, z, data, prefetched);
     }
 
-    loadChunk(layer, x, y, z, data);
-
-    return true;
+    return data;
 }
 
 } // namespace lvr2
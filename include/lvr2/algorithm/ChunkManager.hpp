@@ -44,6 +44,14 @@
 #include "lvr2/io/Model.hpp"
 #include "lvr2/types/Channel.hpp"
 
+#include <ctpl.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
+
 namespace lvr2
 {
 
@@ -93,6 +101,11 @@ class ChunkManager : public ChunkHashGrid
      */
     ChunkManager(std::string hdf5Path, size_t cacheSize = 200, float chunkSize = 10.0f);
 
+    /**
+     * @brief Stops the prefetching. Prefetches that are not started yet are discarded.
+     */
+    ~ChunkManager();
+
     /**
      * @brief getGlobalBoundingBox is a getter for the bounding box of the entire chunked model
      * 
@@ -156,6 +169,60 @@ class ChunkManager : public ChunkHashGrid
                               const std::map<std::string, FilterFunction> filter,
                               std::string layer = std::string("mesh"));
 
+    /**
+     * @brief Loads all chunks of the given area (expanded by a margin) into the cache in the
+     * background
+     *
+     * The chunks that are not cached yet are loaded by a pool of prefetch threads, so a later
+     * call of extractArea for this area is served from the cache. Chunks that are already being
+     * prefetched are not requested twice. The effectiveness of the prefetching is reported by
+     * getPrefetchedChunks, getPrefetchHits and getPrefetchWasted.
+     *
+     * @param area bounding box of the area that will be requested
+     * @param margin distance by which the area is expanded in every direction
+     * @param layer layer of the chunks
+     */
+    void prefetchArea(const BoundingBox<BaseVector<float>>& area,
+                      float margin      = 0.0f,
+                      std::string layer = std::string("mesh"));
+
+    /**
+     * @brief Prefetches the chunks around the positions of a trajectory
+     *
+     * Prefetches the chunks within the given radius around every position of the trajectory
+     * and around the position predicted by linear extrapolation of the last two positions.
+     * The chunks are requested in the order of the trajectory.
+     *
+     * @param trajectory (planned or recent) positions of the client, ordered by time
+     * @param radius radius around each position that will be requested
+     * @param lookAhead extrapolation factor, 1.0 predicts one more step of the same length
+     * @param layer layer of the chunks
+     */
+    void prefetchTrajectory(const std::vector<BaseVector<float>>& trajectory,
+                            float radius,
+                            float lookAhead   = 1.0f,
+                            std::string layer = std::string("mesh"));
+
+    /**
+     * @brief Blocks until all requested prefetches are finished
+     */
+    void waitForPrefetch();
+
+    /**
+     * @brief Returns the number of chunks that are queued or currently loaded by the prefetcher
+     */
+    size_t getNumPendingPrefetches();
+
+    /**
+     * @brief Sets the number of prefetch threads
+     *
+     * Reads from the HDF5 file are serialized, so additional threads only help if chunks are
+     * requested from several layers or the cache is busy. Default is one thread.
+     *
+     * @param numThreads number of prefetch threads
+     */
+    void setPrefetchThreads(int numThreads);
+
     /**
      * @brief Get all existing channels from mesh
      * 
@@ -225,6 +292,21 @@ class ChunkManager : public ChunkHashGrid
      * @return the grid coordinates as a BaseVector
      */
     BaseVector<int> getCellCoordinates(const BaseVector<float>& vec) const;
+
+    /**
+     * @brief returns the grid coordinates of all chunks that are needed for the given area
+     *
+     * @param area requested area, will be clipped to the bounding box of the model
+     * @return grid coordinates of the chunks in the order extractArea requests them
+     */
+    std::vector<BaseVector<int>> getAreaChunkCoordinates(
+        const BoundingBox<BaseVector<float>>& area) const;
+
+    /**
+     * @brief queues the loading of a chunk in the prefetch pool if it is neither cached nor
+     * already queued
+     */
+    void prefetchChunk(const std::string& layer, const BaseVector<int>& cellCoord);
     
     /**
      * @brief reads and combines a channel of multiple chunks
@@ -266,6 +348,21 @@ class ChunkManager : public ChunkHashGrid
                        const size_t numFaces,
                        const MeshBufferPtr meshBuffer,
                        const MultiChannelMap::val_type& originalChannel) const;
+
+    // number of prefetch threads
+    int m_prefetchThreads = 1;
+
+    // thread pool to load chunks in the background, created on the first prefetch
+    std::unique_ptr<ctpl::thread_pool> m_prefetchPool;
+
+    // chunks (layer, x, y, z) that are queued or currently loaded by the prefetch pool
+    std::set<std::tuple<std::string, int, int, int>> m_pendingPrefetches;
+
+    // protects m_pendingPrefetches and m_prefetchPool
+    std::mutex m_prefetchMutex;
+
+    // notified whenever a prefetch is finished
+    std::condition_variable m_prefetchFinished;
 };
 
 } /* namespace lvr2 */
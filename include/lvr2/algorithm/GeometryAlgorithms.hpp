@@ -36,6 +36,8 @@
 #include "lvr2/attrmaps/AttrMaps.hpp"
 #include "lvr2/geometry/Handles.hpp"
 #include <list>
+#include <set>
+#include <vector>
 
 namespace lvr2
 {
@@ -63,6 +65,42 @@ void calcLocalVertexNeighborhood(
 );
 
 
+/**
+ * @brief Buffers that `visitLocalVertexNeighborhood()` reuses between calls.
+ *
+ * Create one instance per thread and pass it to all calls of that thread, so
+ * that visiting the neighborhood of a vertex doesn't allocate memory once the
+ * buffers have grown to the size of the largest neighborhood.
+ */
+struct LocalNeighborhoodBuffers
+{
+    /// Vertices that still have to be expanded
+    vector<VertexHandle> stack;
+
+    /// The direct neighbors of the vertex that is currently expanded
+    vector<VertexHandle> directNeighbors;
+
+    /// Open addressing hash set of the indices of all visited vertices
+    vector<Index> visited;
+
+    /// Slots of `visited` that are in use, so clearing doesn't have to scan
+    /// the whole hash set
+    vector<size_t> visitedSlots;
+
+    /// Vertices whose neighbors couldn't be determined (non manifold)
+    vector<VertexHandle> invalid;
+
+    /**
+     * @brief Adds `vH` to the visited vertices.
+     *
+     * @return false, if `vH` was visited before.
+     */
+    bool markVisited(VertexHandle vH);
+
+    /// Clears the visited vertices, keeping the allocated memory
+    void clearVisited();
+};
+
 /**
  * @brief Visits every vertex in the local neighborhood of `vH`.
  *
@@ -81,6 +119,34 @@ void visitLocalVertexNeighborhood(
     VisitorF visitor
 );
 
+/**
+ * @brief Visits every vertex in the local neighborhood of `vH`, collecting
+ *        non manifold vertices in `invalid`.
+ */
+template <typename BaseVecT, typename VisitorF>
+void visitLocalVertexNeighborhood(
+    const BaseMesh<BaseVecT>& mesh,
+    std::set<VertexHandle>& invalid,
+    VertexHandle vH,
+    double radius,
+    VisitorF visitor
+);
+
+/**
+ * @brief Visits every vertex in the local neighborhood of `vH` using the
+ *        given per-thread `buffers`.
+ *
+ * Non manifold vertices are appended to `buffers.invalid`.
+ */
+template <typename BaseVecT, typename VisitorF>
+void visitLocalVertexNeighborhood(
+    const BaseMesh<BaseVecT>& mesh,
+    LocalNeighborhoodBuffers& buffers,
+    VertexHandle vH,
+    double radius,
+    VisitorF visitor
+);
+
 /**
  * @brief   Calculate the height difference value for each vertex of the given BaseMesh.
  *
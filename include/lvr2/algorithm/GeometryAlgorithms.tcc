@@ -52,6 +52,83 @@ void calcVertexLocalNeighborhood(
     });
 }
 
+namespace geometry_algorithms_detail
+{
+
+/// Removes the values of deleted vertices from a map that was filled for all
+/// vertex indices
+template <typename BaseVecT, typename ValueT>
+void eraseDeletedVertices(const BaseMesh<BaseVecT> &mesh, DenseVertexMap<ValueT> &map)
+{
+    if (mesh.numVertices() == mesh.nextVertexIndex())
+    {
+        return;
+    }
+    for (size_t i = 0; i < mesh.nextVertexIndex(); i++)
+    {
+        if (!mesh.containsVertex(VertexHandle(i)))
+        {
+            map.erase(VertexHandle(i));
+        }
+    }
+}
+
+} // namespace geometry_algorithms_detail
+
+inline bool LocalNeighborhoodBuffers::markVisited(VertexHandle vH)
+{
+    const Index empty = std::numeric_limits<Index>::max();
+
+    // Keep the load factor below one half, so that probe sequences are short
+    if (2 * (visitedSlots.size() + 1) > visited.size())
+    {
+        vector<Index> old(std::max<size_t>(64, 2 * visited.size()), empty);
+        old.swap(visited);
+        visitedSlots.clear();
+        for (Index idx : old)
+        {
+            if (idx != empty)
+            {
+                markVisited(VertexHandle(idx));
+            }
+        }
+    }
+
+    size_t mask = visited.size() - 1;
+    size_t slot = (vH.idx() * size_t(0x9E3779B1)) & mask;
+    while (visited[slot] != empty)
+    {
+        if (visited[slot] == vH.idx())
+        {
+            return false;
+        }
+        slot = (slot + 1) & mask;
+    }
+    visited[slot] = vH.idx();
+    visitedSlots.push_back(slot);
+    return true;
+}
+
+inline void LocalNeighborhoodBuffers::clearVisited()
+{
+    for (size_t slot : visitedSlots)
+    {
+        visited[slot] = std::numeric_limits<Index>::max();
+    }
+    visitedSlots.clear();
+}
+
+template <typename BaseVecT, typename VisitorF>
+void visitLocalVertexNeighborhood(
+    const BaseMesh<BaseVecT> &mesh,
+    VertexHandle vH,
+    double radius,
+    VisitorF visitor)
+{
+    LocalNeighborhoodBuffers buffers;
+    visitLocalVertexNeighborhood(mesh, buffers, vH, radius, visitor);
+}
+
 template <typename BaseVecT, typename VisitorF>
 void visitLocalVertexNeighborhood(
     const BaseMesh<BaseVecT> &mesh,
@@ -59,31 +136,39 @@ void visitLocalVertexNeighborhood(
     VertexHandle vH,
     double radius,
     VisitorF visitor)
+{
+    LocalNeighborhoodBuffers buffers;
+    visitLocalVertexNeighborhood(mesh, buffers, vH, radius, visitor);
+    invalid.insert(buffers.invalid.begin(), buffers.invalid.end());
+}
+
+template <typename BaseVecT, typename VisitorF>
+void visitLocalVertexNeighborhood(
+    const BaseMesh<BaseVecT> &mesh,
+    LocalNeighborhoodBuffers &buffers,
+    VertexHandle vH,
+    double radius,
+    VisitorF visitor)
 {
     // Prepare values for the radius test
     auto vPos = mesh.getVertexPosition(vH);
     const double radiusSquared = radius * radius;
 
-    // Store the vertices we want to expand. We reserve memory for 8 vertices
-    // already, since it's rather likely to have at least that many vertices
-    // in the stack. In the beginning, the stack only contains the original
-    // vertex we were given.
-    vector<VertexHandle> stack;
-    stack.reserve(8);
+    // Store the vertices we want to expand. In the beginning, the stack only
+    // contains the original vertex we were given.
+    auto& stack = buffers.stack;
+    stack.clear();
     stack.push_back(vH);
 
-    // In this map we store whether or not we have already visited a vertex,
+    // In this set we store whether or not we have already visited a vertex,
     // where visiting means: calling the visitor with it and pushing it on
     // the stack of vertices we still need to expand.
-    //
-    // It would be more appropriate to use a set instead of a map, but there
-    // are no attribute-sets...
-    SparseVertexMap<bool> visited(8, false);
-    visited.insert(vH, true);
+    buffers.clearVisited();
+    buffers.markVisited(vH);
 
     // This vector is later used to store the neighbors of a vertex. It's
-    // created here to reduce the amount of heap allocations.
-    vector<VertexHandle> directNeighbors;
+    // kept in the buffers to reduce the amount of heap allocations.
+    auto& directNeighbors = buffers.directNeighbors;
 
     // As long as there are vertices we want to expand...
     while (!stack.empty())
@@ -100,20 +185,18 @@ void visitLocalVertexNeighborhood(
         }
         catch (lvr2::PanicException exception)
         {
-            invalid.insert(curVH);
+            buffers.invalid.push_back(curVH);
         }
         for (auto newVH : directNeighbors)
         {
             // If this vertex is within the radius of the original vertex, we
             // want to visit it later, thus pushing it onto the stack. But we
-            // only do that if we haven't visited the vertex before. We use
-            // `containsKey` here because we only insert `true` anyway.
+            // only do that if we haven't visited the vertex before.
             auto distSquared = mesh.getVertexPosition(newVH).squaredDistanceFrom(vPos);
-            if (!visited.containsKey(newVH) && distSquared < radiusSquared)
+            if (distSquared < radiusSquared && buffers.markVisited(newVH))
             {
                 visitor(newVH);
                 stack.push_back(newVH);
-                visited.insert(newVH, true);
             }
         }
     }
@@ -122,14 +205,11 @@ void visitLocalVertexNeighborhood(
 template <typename BaseVecT>
 DenseVertexMap<float> calcVertexHeightDifferences(const BaseMesh<BaseVecT> &mesh, double radius)
 {
-    // We create a map to store a height-diff for each vertex. We preallocate
-    // memory for all vertices. This is not only an optimization, but more
-    // importantly to avoid multithreading crashes. The parallelized loop
-    // further down inserts into this data structure; if there is no free
-    // memory left, it will reallocate which will crash horribly when multiple
-    // threads are involved.
+    // We create a map to store a height-diff for each vertex. It already
+    // contains a value for every vertex index, so that the parallelized loop
+    // further down only overwrites values and never inserts into the map.
     DenseVertexMap<float> heightDiff;
-    heightDiff.reserve(mesh.nextVertexIndex());
+    heightDiff.fill(mesh.nextVertexIndex(), 0.0f);
 
     // Output
     string msg = timestamp.getElapsedTime() + "Computing height differences...";
@@ -138,39 +218,46 @@ DenseVertexMap<float> calcVertexHeightDifferences(const BaseMesh<BaseVecT> &mesh
 
     std::set<VertexHandle> invalid;
 
-// Calculate height difference for each vertex
-#pragma omp parallel for
-    for (size_t i = 0; i < mesh.nextVertexIndex(); i++)
+    // Calculate height difference for each vertex
+    #pragma omp parallel
     {
-        auto vH = VertexHandle(i);
-        if (!mesh.containsVertex(vH))
+        LocalNeighborhoodBuffers buffers;
+        ProgressBatch localProgress(progress);
+
+        #pragma omp for schedule(dynamic, 64)
+        for (size_t i = 0; i < mesh.nextVertexIndex(); i++)
         {
-            continue;
-        }
+            auto vH = VertexHandle(i);
+            if (!mesh.containsVertex(vH))
+            {
+                continue;
+            }
 
-        float minHeight = std::numeric_limits<float>::max();
-        float maxHeight = std::numeric_limits<float>::lowest();
+            float minHeight = std::numeric_limits<float>::max();
+            float maxHeight = std::numeric_limits<float>::lowest();
 
-        visitLocalVertexNeighborhood(mesh, invalid, vH, radius, [&](auto neighbor) {
-            auto curPos = mesh.getVertexPosition(neighbor);
+            visitLocalVertexNeighborhood(mesh, buffers, vH, radius, [&](auto neighbor) {
+                auto curPos = mesh.getVertexPosition(neighbor);
 
-            if (curPos.z < minHeight)
-            {
-                minHeight = curPos.z;
-            }
-            if (curPos.z > maxHeight)
-            {
-                maxHeight = curPos.z;
-            }
-        });
+                if (curPos.z < minHeight)
+                {
+                    minHeight = curPos.z;
+                }
+                if (curPos.z > maxHeight)
+                {
+                    maxHeight = curPos.z;
+                }
+            });
 
-// Calculate the final height difference
-#pragma omp critical
-        {
-            heightDiff.insert(vH, maxHeight - minHeight);
-            ++progress;
+            // Calculate the final height difference
+            heightDiff[vH] = maxHeight - minHeight;
+            ++localProgress;
         }
+
+        #pragma omp critical
+        invalid.insert(buffers.invalid.begin(), buffers.invalid.end());
     }
+    geometry_algorithms_detail::eraseDeletedVertices(mesh, heightDiff);
 
     if(!timestamp.isQuiet())
     cout << endl;
@@ -247,16 +334,13 @@ DenseVertexMap<float> calcVertexRoughness(
     double radius,
     const VertexMap<Normal<typename BaseVecT::CoordType>> &normals)
 {
-    // We create a map to store the roughness for each vertex. We preallocate
-    // memory for all vertices. This is not only an optimization, but more
-    // importantly to avoid multithreading crashes. The parallelized loop
-    // further down inserts into this data structure; if there is no free
-    // memory left, it will reallocate which will crash horribly when multiple
-    // threads are involved.
+    // We create a map to store the roughness for each vertex. It already
+    // contains a value for every vertex index, so that the parallelized loop
+    // further down only overwrites values and never inserts into the map.
     DenseVertexMap<float> roughness;
-    roughness.reserve(mesh.nextVertexIndex());
+    roughness.fill(mesh.nextVertexIndex(), 0.0f);
 
-    auto averageAngles = calcAverageVertexAngles(mesh, normals);
+    const auto averageAngles = calcAverageVertexAngles(mesh, normals);
 
     // Output
     string msg = timestamp.getElapsedTime() + "Computing roughness";
@@ -265,31 +349,39 @@ DenseVertexMap<float> calcVertexRoughness(
 
     std::set<VertexHandle> invalid;
 
-// Calculate roughness for each vertex
-#pragma omp parallel for
-    for (size_t i = 0; i < mesh.nextVertexIndex(); i++)
+    // Calculate roughness for each vertex
+    #pragma omp parallel
     {
-        auto vH = VertexHandle(i);
-        if (!mesh.containsVertex(vH))
+        LocalNeighborhoodBuffers buffers;
+        ProgressBatch localProgress(progress);
+
+        #pragma omp for schedule(dynamic, 64)
+        for (size_t i = 0; i < mesh.nextVertexIndex(); i++)
         {
-            continue;
-        }
+            auto vH = VertexHandle(i);
+            if (!mesh.containsVertex(vH))
+            {
+                continue;
+            }
 
-        float sum = 0.0;
-        size_t count = 0;
+            float sum = 0.0;
+            size_t count = 0;
 
-        visitLocalVertexNeighborhood(mesh, invalid, vH, radius, [&](auto neighbor) {
-            sum += averageAngles[neighbor];
-            count += 1;
-        });
+            visitLocalVertexNeighborhood(mesh, buffers, vH, radius, [&](auto neighbor) {
+                sum += averageAngles[neighbor];
+                count += 1;
+            });
 
-#pragma omp critical
-        {
             // Calculate the final roughness
-            roughness.insert(vH, count ? sum / count : 0);
-            ++progress;
+            roughness[vH] = count ? sum / count : 0;
+            ++localProgress;
         }
+
+        #pragma omp critical
+        invalid.insert(buffers.invalid.begin(), buffers.invalid.end());
     }
+    geometry_algorithms_detail::eraseDeletedVertices(mesh, roughness);
+
     if(!timestamp.isQuiet())
         cout << endl;
 
@@ -310,55 +402,61 @@ void calcVertexRoughnessAndHeightDifferences(
     DenseVertexMap<float> &roughness,
     DenseVertexMap<float> &heightDiff)
 {
-    // Reserving memory in those maps is important to avoid multi threading
-    // related crashes.
-    roughness.clear();
-    roughness.reserve(mesh.nextVertexIndex());
-    heightDiff.clear();
-    heightDiff.reserve(mesh.nextVertexIndex());
+    // Both maps contain a value for every vertex index, so that the
+    // parallelized loop only overwrites values and never inserts.
+    roughness.fill(mesh.nextVertexIndex(), 0.0f);
+    heightDiff.fill(mesh.nextVertexIndex(), 0.0f);
 
     std::set<VertexHandle> invalid;
-    auto averageAngles = calcAverageVertexAngles(mesh, normals);
+    const auto averageAngles = calcAverageVertexAngles(mesh, normals);
 
-// Calculate roughness and height difference for each vertex
-#pragma omp parallel for
-    for (size_t i = 0; i < mesh.nextVertexIndex(); i++)
+    // Calculate roughness and height difference for each vertex
+    #pragma omp parallel
     {
-        auto vH = VertexHandle(i);
-        if (!mesh.containsVertex(vH))
-        {
-            continue;
-        }
-
-        double sum = 0.0;
-        uint32_t count = 0;
-        float minHeight = std::numeric_limits<float>::max();
-        float maxHeight = std::numeric_limits<float>::lowest();
-
-        visitLocalVertexNeighborhood(mesh, invalid, vH, radius, [&](auto neighbor) {
-            sum += averageAngles[neighbor];
-            count += 1;
+        LocalNeighborhoodBuffers buffers;
 
-            auto curPos = mesh.getVertexPosition(neighbor);
-            if (curPos.z < minHeight)
-            {
-                minHeight = curPos.z;
-            }
-            if (curPos.z > maxHeight)
+        #pragma omp for schedule(dynamic, 64)
+        for (size_t i = 0; i < mesh.nextVertexIndex(); i++)
+        {
+            auto vH = VertexHandle(i);
+            if (!mesh.containsVertex(vH))
             {
-                maxHeight = curPos.z;
+                continue;
             }
-        });
 
-#pragma omp critical
-        {
+            double sum = 0.0;
+            uint32_t count = 0;
+            float minHeight = std::numeric_limits<float>::max();
+            float maxHeight = std::numeric_limits<float>::lowest();
+
+            visitLocalVertexNeighborhood(mesh, buffers, vH, radius, [&](auto neighbor) {
+                sum += averageAngles[neighbor];
+                count += 1;
+
+                auto curPos = mesh.getVertexPosition(neighbor);
+                if (curPos.z < minHeight)
+                {
+                    minHeight = curPos.z;
+                }
+                if (curPos.z > maxHeight)
+                {
+                    maxHeight = curPos.z;
+                }
+            });
+
             // Calculate the final roughness
-            roughness.insert(vH, count ? sum / count : 0);
+            roughness[vH] = count ? sum / count : 0;
 
             // Calculate the final height difference
-            heightDiff.insert(vH, maxHeight - minHeight);
+            heightDiff[vH] = maxHeight - minHeight;
         }
+
+        #pragma omp critical
+        invalid.insert(buffers.invalid.begin(), buffers.invalid.end());
     }
+    geometry_algorithms_detail::eraseDeletedVertices(mesh, roughness);
+    geometry_algorithms_detail::eraseDeletedVertices(mesh, heightDiff);
+
     if (!invalid.empty())
     {
         std::cerr << "Found " << invalid.size() << " invalid, non manifold "
@@ -78,6 +78,35 @@ size_t iterativeEdgeCollapse(
     CostF collapseCost
 );
 
+/**
+ * @brief Collapses up to `count` many edges of `mesh` in batches, evaluating
+ *        the collapse costs in parallel.
+ *
+ * Instead of collapsing one edge at a time, each round first recomputes the
+ * best outgoing edge of all vertices whose neighborhood changed, in parallel.
+ * The cheapest `batchRatio` of all candidate edges are then collapsed in order
+ * of their cost, skipping every edge with a vertex in the one-ring of an edge
+ * collapsed earlier in the same round. Thus, every collapse still uses the
+ * exact cost of the current mesh, but the order differs slightly from
+ * `iterativeEdgeCollapse`.
+ *
+ * The parameters are the same as for `iterativeEdgeCollapse`. Every thread
+ * works on its own copy of `collapseCost`, which is called concurrently and
+ * must not modify shared state.
+ *
+ * @param[in] batchRatio Fraction of the candidate edges considered per round
+ *
+ * @return The number of edges actually collapsed.
+ */
+template<typename BaseVecT, typename CostF>
+size_t parallelEdgeCollapse(
+    BaseMesh<BaseVecT>& mesh,
+    const size_t count,
+    FaceMap<Normal<typename BaseVecT::CoordType>>& faceNormals,
+    CostF collapseCost,
+    const float batchRatio = 0.1
+);
+
 /**
  * @brief Like `iterativeEdgeCollapse` but with a fixed cost function.
  */
@@ -88,6 +117,17 @@ size_t simpleMeshReduction(
     FaceMap<Normal<typename BaseVecT::CoordType>>& faceNormals
 );
 
+/**
+ * @brief Like `parallelEdgeCollapse` but with the cost function of
+ *        `simpleMeshReduction`.
+ */
+template<typename BaseVecT>
+size_t simpleParallelMeshReduction(
+    BaseMesh<BaseVecT>& mesh,
+    const size_t count,
+    FaceMap<Normal<typename BaseVecT::CoordType>>& faceNormals
+);
+
 } // namespace lvr2
 
 #include "lvr2/algorithm/ReductionAlgorithms.tcc"
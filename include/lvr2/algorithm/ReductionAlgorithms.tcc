@@ -29,6 +29,8 @@
  * ReductionAlgorithms.tcc
  */
 
+#include <algorithm>
+#include <limits>
 #include <unordered_set>
 #include <vector>
 
@@ -36,6 +38,7 @@
 #include "lvr2/algorithm/NormalAlgorithms.hpp"
 #include "lvr2/geometry/Handles.hpp"
 #include "lvr2/util/Meap.hpp"
+#include "lvr2/util/Panic.hpp"
 
 using std::unordered_set;
 using std::vector;
@@ -237,21 +240,246 @@ size_t iterativeEdgeCollapse(
     return collapsedEdgeCount;
 }
 
-template<typename BaseVecT>
-size_t simpleMeshReduction(
+template<typename BaseVecT, typename CostF>
+size_t parallelEdgeCollapse(
     BaseMesh<BaseVecT>& mesh,
     const size_t count,
-    FaceMap<Normal<typename BaseVecT::CoordType>>& faceNormals
+    FaceMap<Normal<typename BaseVecT::CoordType>>& faceNormals,
+    CostF collapseCost,
+    const float batchRatio
 )
 {
-    vector<EdgeHandle> edgesAroundFrom;
-    vector<FaceHandle> facesAroundFrom;
+    std::cout << timestamp << "Reduce mesh by collapsing " << count
+              << " edges in parallel batches" << std::endl;
+
+    const Index noVertex = std::numeric_limits<Index>::max();
+    const size_t numVertexIndices = mesh.nextVertexIndex();
+
+    // The target of the best outgoing edge of each vertex and its cost.
+    // `noVertex` means that no outgoing edge is collapsable.
+    vector<Index> bestTo(numVertexIndices, noVertex);
+    vector<float> bestCost(numVertexIndices, std::numeric_limits<float>::max());
+
+    // Vertices whose best edge has to be recomputed and vertices whose
+    // neighborhood was changed by a collapse in the current round.
+    vector<uint8_t> dirty(numVertexIndices, 0);
+    vector<uint8_t> locked(numVertexIndices, 0);
+    for (const auto vH: mesh.vertices())
+    {
+        dirty[vH.idx()] = 1;
+    }
+
+    const auto& constFaceNormals = faceNormals;
+
+    // These variables are only used in the loop, but are created here to
+    // avoid unnecessary heap allocations.
+    vector<Index> candidates;
+    vector<Index> lockedVertices;
+    vector<VertexHandle> lockNeighbors;
+    vector<FaceHandle> facesAroundMidpoint;
+    vector<VertexHandle> midpointNeighbors;
+
+    // Output
+    string msg = timestamp.getElapsedTime()
+        + "Collapsing up to "
+        + std::to_string(count)
+        + " of the edges ";
+    ProgressBar progress(count + 1, msg);
+    ++progress;
+
+    size_t collapsedEdgeCount = 0;
+
+    while (collapsedEdgeCount < count)
+    {
+        // Recompute the best outgoing edge of all dirty vertices. The mesh
+        // isn't changed during this step, so all threads can read it.
+        #pragma omp parallel
+        {
+            CostF localCost = collapseCost;
+            vector<VertexHandle> neighbors;
+
+            #pragma omp for schedule(dynamic, 64)
+            for (size_t i = 0; i < numVertexIndices; i++)
+            {
+                if (!dirty[i])
+                {
+                    continue;
+                }
+                dirty[i] = 0;
+                bestTo[i] = noVertex;
+                bestCost[i] = std::numeric_limits<float>::max();
+
+                const VertexHandle fromH(i);
+                if (!mesh.containsVertex(fromH))
+                {
+                    continue;
+                }
+
+                // Vertices with broken neighborhoods are never collapsed
+                try
+                {
+                    neighbors.clear();
+                    mesh.getNeighboursOfVertex(fromH, neighbors);
+                    for (const auto toH: neighbors)
+                    {
+                        auto maybeCost = localCost(fromH, toH, constFaceNormals);
+                        if (maybeCost && *maybeCost < bestCost[i])
+                        {
+                            bestCost[i] = *maybeCost;
+                            bestTo[i] = toH.idx();
+                        }
+                    }
+                }
+                catch (PanicException& exception)
+                {
+                    bestTo[i] = noVertex;
+                }
+                catch (VertexLoopException& exception)
+                {
+                    bestTo[i] = noVertex;
+                }
+            }
+        }
+
+        // Select the cheapest candidates of this round
+        candidates.clear();
+        for (size_t i = 0; i < numVertexIndices; i++)
+        {
+            if (bestTo[i] != noVertex)
+            {
+                candidates.push_back(i);
+            }
+        }
+        if (candidates.empty())
+        {
+            break;
+        }
+
+        auto byCost = [&](Index a, Index b)
+        {
+            return bestCost[a] < bestCost[b] || (bestCost[a] == bestCost[b] && a < b);
+        };
+        size_t batchSize = std::max<size_t>(1, candidates.size() * batchRatio);
+        batchSize = std::min(batchSize, count - collapsedEdgeCount);
+        if (batchSize < candidates.size())
+        {
+            std::nth_element(candidates.begin(), candidates.begin() + batchSize, candidates.end(), byCost);
+            candidates.resize(batchSize);
+        }
+        std::sort(candidates.begin(), candidates.end(), byCost);
+
+        // Collapse the candidates. The first candidate is never locked, so
+        // every round either collapses an edge or drops a candidate.
+        for (const auto fromIdx: candidates)
+        {
+            // The cost of this edge might have changed or one of its vertices
+            // was removed, it is recomputed in the next round.
+            const auto toIdx = bestTo[fromIdx];
+            if (toIdx == noVertex || locked[fromIdx] || locked[toIdx])
+            {
+                continue;
+            }
+
+            const VertexHandle fromH(fromIdx);
+            const VertexHandle toH(toIdx);
+
+            const auto edgeMin = mesh.getEdgeBetween(fromH, toH);
+            if (!edgeMin || !mesh.isCollapsable(edgeMin.unwrap()))
+            {
+                // If we can't collapse this edge, we will just ignore it until
+                // the neighborhood of `fromH` changes.
+                bestTo[fromIdx] = noVertex;
+                continue;
+            }
+
+            // Lock both vertices and their neighbors, since the cost of all
+            // their edges changes with this collapse.
+            for (const auto vH: {fromH, toH})
+            {
+                lockNeighbors.clear();
+                mesh.getNeighboursOfVertex(vH, lockNeighbors);
+                lockNeighbors.push_back(vH);
+                for (const auto neighborH: lockNeighbors)
+                {
+                    if (!locked[neighborH.idx()])
+                    {
+                        locked[neighborH.idx()] = 1;
+                        lockedVertices.push_back(neighborH.idx());
+                    }
+                }
+            }
+
+            auto toPos = mesh.getVertexPosition(toH);
+            auto result = mesh.collapseEdge(edgeMin.unwrap());
+            collapsedEdgeCount += 1;
+            ++progress;
+
+            // Set correct position of the new vertex
+            mesh.getVertexPosition(result.midPoint) = toPos;
+
+            // The removed vertex doesn't have a best edge anymore
+            const auto removedH = result.midPoint == toH ? fromH : toH;
+            bestTo[removedH.idx()] = noVertex;
+
+            // The best edges of the midpoint and all its neighbors are
+            // recomputed in the next round.
+            midpointNeighbors.clear();
+            mesh.getNeighboursOfVertex(result.midPoint, midpointNeighbors);
+            dirty[result.midPoint.idx()] = 1;
+            for (const auto vH: midpointNeighbors)
+            {
+                dirty[vH.idx()] = 1;
+            }
+
+            // We update the normal of all faces touching the midpoint.
+            facesAroundMidpoint.clear();
+            mesh.getFacesOfVertex(result.midPoint, facesAroundMidpoint);
+            for (auto fH: facesAroundMidpoint)
+            {
+                auto maybeNormal = getFaceNormal(mesh.getVertexPositionsOfFace(fH));
+                auto normal = maybeNormal
+                    ? *maybeNormal
+                    : Normal<typename BaseVecT::CoordType>(0, 0, 1);
+
+                faceNormals[fH] = normal;
+            }
+
+            // Remove all entries from that map that belong to now invalid
+            // handles.
+            for (auto neighbor: result.neighbors)
+            {
+                if (neighbor)
+                {
+                    faceNormals.erase(neighbor->removedFace);
+                }
+            }
+        }
+
+        for (const auto vIdx: lockedVertices)
+        {
+            locked[vIdx] = 0;
+        }
+        lockedVertices.clear();
+    }
+
+    cout << endl << timestamp << "Collapsed " << collapsedEdgeCount << " edges..." << endl;
+
+    return collapsedEdgeCount;
+}
+
+namespace reduction_detail
+{
 
-    return iterativeEdgeCollapse(mesh, count, faceNormals, [&](
+/// Returns the cost function of `simpleMeshReduction`. Copies of the returned
+/// function don't share any state and can be used by different threads.
+template<typename BaseVecT>
+auto simpleCollapseCost(const BaseMesh<BaseVecT>& mesh)
+{
+    return [&mesh, edgesAroundFrom = vector<EdgeHandle>(), facesAroundFrom = vector<FaceHandle>()](
         VertexHandle fromH,
         VertexHandle toH,
         const FaceMap<Normal<typename BaseVecT::CoordType>>& normals
-    ) -> boost::optional<float>
+    ) mutable -> boost::optional<float>
     {
         // The minimal value of the dot product between two normals that is allowed.
         const float MIN_NORMAL_DIFF = 0.5;
@@ -353,7 +581,29 @@ size_t simpleMeshReduction(
         auto length = mesh.getVertexPosition(fromH).distanceFrom(mesh.getVertexPosition(toH));
 
         return length * curvature;
-    });
+    };
+}
+
+} // namespace reduction_detail
+
+template<typename BaseVecT>
+size_t simpleMeshReduction(
+    BaseMesh<BaseVecT>& mesh,
+    const size_t count,
+    FaceMap<Normal<typename BaseVecT::CoordType>>& faceNormals
+)
+{
+    return iterativeEdgeCollapse(mesh, count, faceNormals, reduction_detail::simpleCollapseCost(mesh));
+}
+
+template<typename BaseVecT>
+size_t simpleParallelMeshReduction(
+    BaseMesh<BaseVecT>& mesh,
+    const size_t count,
+    FaceMap<Normal<typename BaseVecT::CoordType>>& faceNormals
+)
+{
+    return parallelEdgeCollapse(mesh, count, faceNormals, reduction_detail::simpleCollapseCost(mesh));
 }
 
 } // namespace lvr2
@@ -40,9 +40,16 @@
 #include "lvr2/io/MeshBuffer.hpp"
 #include "lvr2/types/MatrixTypes.hpp"
 #include "lvr2/geometry/BVH.hpp"
+#include "lvr2/geometry/WideBVH.hpp"
 #include "lvr2/algorithm/raycasting/RaycasterBase.hpp"
 #include "Intersection.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+
 #define EPSILON 0.0000001
 #define PI 3.14159265
 
@@ -60,6 +67,27 @@ public:
      */
     BVHRaycaster(const MeshBufferPtr mesh, unsigned int stack_size = 64);
 
+    /**
+     * @brief Constructor: Uses an already built BVH of the mesh instead of building it,
+     *        e.g. one loaded with the hdf5 BVHIO feature
+     *
+     * @param mesh Mesh the BVH was built for
+     * @param bvh BVH of the mesh
+     * @param stack_size Traversal stack size
+     */
+    BVHRaycaster(
+        const MeshBufferPtr mesh,
+        BVHTree<BaseVector<float> > bvh,
+        unsigned int stack_size = 64);
+
+    /**
+     * @brief Returns the BVH of the mesh, e.g. to store it for later runs
+     */
+    const BVHTree<BaseVector<float> >& getBVH() const
+    {
+        return m_bvh;
+    }
+
     /**
      * @brief Cast a single ray onto the mesh
      * 
@@ -74,6 +102,185 @@ public:
         const Vector3f& direction,
         IntT& intersection);
 
+    /**
+     * @brief Cast a single ray onto the mesh within the given ray range
+     *
+     * @param[in] origin Ray origin
+     * @param[in] direction Ray direction
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @param[out] intersection User defined intersection output
+     * @return true  Intersection found
+     * @return false  Not intersection found
+     */
+    bool castRay(
+        const Vector3f& origin,
+        const Vector3f& direction,
+        float tMin,
+        float tMax,
+        IntT& intersection);
+
+    /**
+     * @brief Checks whether the mesh is hit anywhere within the given ray range.
+     *        The traversal stops at the first found intersection.
+     *
+     * @param[in] origin Ray origin
+     * @param[in] direction Ray direction
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @return true  Any intersection found
+     * @return false  Not intersection found
+     */
+    bool isOccluded(
+        const Vector3f& origin,
+        const Vector3f& direction,
+        float tMin,
+        float tMax);
+
+    /**
+     * @brief Cast a ray from single origin
+     *        with multiple directions onto the mesh
+     *
+     * Consecutive rays are traversed as packets of PacketSize rays through a
+     * BVH4 that is collapsed from the binary BVH on the first call. The
+     * results are the same as calling castRay for every ray, except that
+     * rays through an edge may report either of the adjacent faces.
+     *
+     * @param[in] origin Origin of the ray
+     * @param[in] directions Directions of the ray
+     * @param[out] intersections User defined intersections output
+     * @param[out] hits Intersection found or not
+     */
+    void castRays(
+        const Vector3f& origin,
+        const std::vector<Vector3f>& directions,
+        std::vector<IntT>& intersections,
+        std::vector<uint8_t>& hits) override;
+
+    /**
+     * @brief Cast a ray from a single origin
+     *        with multiple directions (in matrix form) onto the mesh
+     *
+     * All rows are processed as packets by a single parallel loop.
+     *
+     * @param[in] origin Origin of the ray
+     * @param[in] directions Directions of the ray
+     * @param[out] intersections User defined intersections output
+     * @param[out] hits Intersection found or not
+     */
+    void castRays(
+        const Vector3f& origin,
+        const std::vector<std::vector<Vector3f> >& directions,
+        std::vector< std::vector<IntT> >& intersections,
+        std::vector< std::vector<uint8_t> >& hits) override;
+
+    /**
+     * @brief Cast from multiple ray origin/direction
+     *        pairs onto the mesh
+     *
+     * @param[in] origins Origins of the rays
+     * @param[in] directions Directions of the rays
+     * @param[out] intersections User defined intersections output
+     * @param[out] hits Intersection found or not
+     */
+    void castRays(
+        const std::vector<Vector3f>& origins,
+        const std::vector<Vector3f>& directions,
+        std::vector<IntT>& intersections,
+        std::vector<uint8_t>& hits) override;
+
+    /**
+     * @brief Cast rays with multiples origins.
+     *        Each origin has multiples directions.
+     *
+     * All rows are processed as packets by a single parallel loop.
+     *
+     * @param[in] origins Origins of the rays
+     * @param[in] directions Directions for each origin
+     * @param[out] intersections Resulting intersections output
+     * @param[out] hits Intersection found or not
+     */
+    void castRays(
+        const std::vector<Vector3f>& origins,
+        const std::vector<std::vector<Vector3f> >& directions,
+        std::vector<std::vector<IntT> >& intersections,
+        std::vector<std::vector<uint8_t> >& hits) override;
+
+    /**
+     * @brief Cast a ray from single origin with multiple directions onto the
+     *        mesh within the given ray range. Uses the packet traversal.
+     *
+     * @param[in] origin Origin of the ray
+     * @param[in] directions Directions of the ray
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @param[out] intersections User defined intersections output
+     * @param[out] hits Intersection found or not
+     */
+    void castRays(
+        const Vector3f& origin,
+        const std::vector<Vector3f>& directions,
+        float tMin,
+        float tMax,
+        std::vector<IntT>& intersections,
+        std::vector<uint8_t>& hits) override;
+
+    /**
+     * @brief Cast from multiple ray origin/direction pairs onto the mesh
+     *        within the given ray range. Uses the packet traversal.
+     *
+     * @param[in] origins Origins of the rays
+     * @param[in] directions Directions of the rays
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @param[out] intersections User defined intersections output
+     * @param[out] hits Intersection found or not
+     */
+    void castRays(
+        const std::vector<Vector3f>& origins,
+        const std::vector<Vector3f>& directions,
+        float tMin,
+        float tMax,
+        std::vector<IntT>& intersections,
+        std::vector<uint8_t>& hits) override;
+
+    /**
+     * @brief Occlusion test for rays from a single origin with multiple
+     *        directions. A packet is finished as soon as all of its rays hit.
+     *
+     * @param[in] origin Origin of the rays
+     * @param[in] directions Directions of the rays
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @param[out] occluded Any intersection found or not
+     */
+    void isOccluded(
+        const Vector3f& origin,
+        const std::vector<Vector3f>& directions,
+        float tMin,
+        float tMax,
+        std::vector<uint8_t>& occluded) override;
+
+    /**
+     * @brief Occlusion test for multiple ray origin/direction pairs.
+     *        A packet is finished as soon as all of its rays hit.
+     *
+     * @param[in] origins Origins of the rays
+     * @param[in] directions Directions of the rays
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @param[out] occluded Any intersection found or not
+     */
+    void isOccluded(
+        const std::vector<Vector3f>& origins,
+        const std::vector<Vector3f>& directions,
+        float tMin,
+        float tMax,
+        std::vector<uint8_t>& occluded) override;
+
+    /// Number of rays that are traversed together by castRays
+    static constexpr int PacketSize = 8;
+
     /**
      * @struct Ray
      * @brief Data type to store information about a ray
@@ -95,7 +302,33 @@ public:
         Vector3f pointHit;
         float hitDist;
     };
-    
+
+    /**
+     * @struct RayPacket
+     * @brief Rays of a packet in SoA layout. Unused lanes have a negative tMax.
+     */
+    struct RayPacket {
+        float org[3][PacketSize];
+        float dir[3][PacketSize];
+        float invDir[3][PacketSize];
+        /// Minimum ray parameter of an intersection
+        float tMin[PacketSize];
+        /// Ray parameter of the closest hit so far
+        float tMax[PacketSize];
+        /// Index of the closest triangle in the BVH4 triangle list
+        uint32_t tri[PacketSize];
+    };
+
+    /**
+     * @struct PacketStackEntry
+     * @brief Traversal stack entry: A BVH4 node or leaf and its entry distance
+     */
+    struct PacketStackEntry {
+        uint32_t child;
+        uint32_t count;
+        float tNear;
+    };
+
 protected:
 
     inline Vector3f barycentric(
@@ -132,8 +365,103 @@ protected:
     const unsigned int* m_TriIdxList;
     const unsigned int m_stack_size;
 
+    /**
+     * @brief Translates the result of a triangle intersection to IntT
+     */
+    void fillIntersection(
+        const Vector3f& direction,
+        const TriangleIntersectionResult& result,
+        IntT& intersection) const;
+
 private:
 
+    /**
+     * @brief A row of rays that castRays traverses as packets
+     */
+    struct RayRow {
+        /// Origins of the rays. Only the first one is used if originStride is 0
+        const Vector3f* origins;
+        size_t originStride;
+        const Vector3f* directions;
+        size_t size;
+        /// May be null for occlusion tests
+        IntT* intersections;
+        uint8_t* hits;
+    };
+
+    /**
+     * @brief Returns the BVH4 for packet traversal. Is built on the first call.
+     */
+    const BVH4& wideBVH();
+
+    /**
+     * @brief Casts all rays of the given rows in packets of PacketSize rays in parallel
+     *
+     * @param rows      The rays and their outputs
+     * @param tMin      Minimum ray parameter of an intersection
+     * @param tMax      Maximum ray parameter of an intersection
+     * @param anyHit    Only determine whether there is any intersection.
+     *                  The intersections of the rows are not written.
+     */
+    void castRows(const std::vector<RayRow>& rows, float tMin, float tMax, bool anyHit);
+
+    /**
+     * @brief Finds the closest intersection of all rays of the packet
+     *
+     * @param bvh       The BVH4 to traverse
+     * @param packet    The rays. tMax and tri contain the closest hits afterwards.
+     * @param stack     Traversal stack with at least bvh.getMaxStackSize() entries
+     * @param anyHit    Stop the traversal of a ray at its first intersection. tMax
+     *                  of the ray is negative afterwards and tri is set to the hit triangle.
+     */
+    void intersectPacket(
+        const BVH4& bvh,
+        RayPacket& packet,
+        PacketStackEntry* stack,
+        bool anyHit) const;
+
+    /**
+     * @brief Checks whether the first n rays of the packet have the same direction
+     *        signs and close origins, i.e., whether they visit mostly the same nodes
+     */
+    bool isCoherent(const RayPacket& packet, int n, float maxOriginSpread) const;
+
+    /**
+     * @brief Traverses the BVH4 with a single ray of the packet and tests it
+     *        against all children of a node at once
+     *
+     * @param bvh       The BVH4 to traverse
+     * @param packet    The rays. tMax and tri of lane l are updated like in intersectPacket.
+     * @param l         The lane of the ray
+     * @param stack     Traversal stack with at least bvh.getMaxStackSize() entries
+     * @param anyHit    Stop the traversal at the first intersection
+     */
+    void intersectRay(
+        const BVH4& bvh,
+        RayPacket& packet,
+        int l,
+        PacketStackEntry* stack,
+        bool anyHit) const;
+
+    std::unique_ptr<BVH4> m_wideBVH;
+    std::once_flag m_wideBVHFlag;
+
+    /**
+     * @brief Creates the Ray for castRay and isOccluded
+     */
+    inline Ray createRay(const Vector3f& direction) const
+    {
+        Ray ray;
+        ray.dir = direction;
+        // wtf /0 ???? 
+        ray.invDir = {1.0f / ray.dir.x(), 1.0f / ray.dir.y(), 1.0f / ray.dir.z() };
+
+        ray.rayDirSign.x() = ray.invDir.x() < 0;
+        ray.rayDirSign.y() = ray.invDir.y() < 0;
+        ray.rayDirSign.z() = ray.invDir.z() < 0;
+        return ray;
+    }
+
     /**
      * @brief Calculates the squared distance of two vectors
      * @param a First vector
@@ -151,9 +479,11 @@ private:
      * @param origin    The origin of the ray
      * @param ray       The ray
      * @param boxPtr    A pointer to the box data
+     * @param tMin      Minimum ray parameter of an intersection
+     * @param tMax      Maximum ray parameter of an intersection
      * @return          A boolean indicating whether the ray hits the box
      */
-    bool rayIntersectsBox(Vector3f origin, Ray ray, const float* boxPtr);
+    bool rayIntersectsBox(Vector3f origin, Ray ray, const float* boxPtr, float tMin, float tMax);
 
     /**
      * @brief Calculates the closest intersection of a raycast into a scene of triangles, given a bounding volume hierarchy
@@ -166,6 +496,9 @@ private:
      * @param clBVHlimits                   3d upper and lower limits for each bounding box in the BVH
      * @param clTriangleIntersectionData    Precomputed intersection data for each triangle
      * @param clTriIdxList                  List of triangle indices
+     * @param tMin                          Minimum ray parameter of an intersection
+     * @param tMax                          Maximum ray parameter of an intersection
+     * @param anyHit                        Return the first found instead of the closest intersection
      * @return The TriangleIntersectionResult, containing information about the triangle intersection
      */
     TriangleIntersectionResult intersectTrianglesBVH(
@@ -174,7 +507,10 @@ private:
         Ray ray,
         const float* clBVHlimits,
         const float* clTriangleIntersectionData,
-        const unsigned int* clTriIdxList
+        const unsigned int* clTriIdxList,
+        float tMin,
+        float tMax,
+        bool anyHit
     );
 
 };
@@ -3,8 +3,18 @@ namespace lvr2 {
 
 template<typename IntT>
 BVHRaycaster<IntT>::BVHRaycaster(const MeshBufferPtr mesh, unsigned int stack_size)
+:BVHRaycaster<IntT>(mesh, BVHTree<BaseVector<float> >(mesh), stack_size)
+{
+    
+}
+
+template<typename IntT>
+BVHRaycaster<IntT>::BVHRaycaster(
+    const MeshBufferPtr mesh,
+    BVHTree<BaseVector<float> > bvh,
+    unsigned int stack_size)
 :RaycasterBase<IntT>(mesh)
-,m_bvh(mesh)
+,m_bvh(std::move(bvh))
 ,m_faces(mesh->getFaceIndices())
 ,m_vertices(mesh->getVertices())
 ,m_BVHindicesOrTriLists(m_bvh.getIndexesOrTrilists().data())
@@ -22,26 +32,198 @@ bool BVHRaycaster<IntT>::castRay(
     const Vector3f& direction,
     IntT& intersection)
 {
-    Ray ray;
-    ray.dir = direction;
-    // wtf /0 ???? 
-    ray.invDir = {1.0f / ray.dir.x(), 1.0f / ray.dir.y(), 1.0f / ray.dir.z() };
-
-    ray.rayDirSign.x() = ray.invDir.x() < 0;
-    ray.rayDirSign.y() = ray.invDir.y() < 0;
-    ray.rayDirSign.z() = ray.invDir.z() < 0;
+    return castRay(origin, direction, 0.0f, std::numeric_limits<float>::infinity(), intersection);
+}
 
+template<typename IntT>
+bool BVHRaycaster<IntT>::castRay(
+    const Vector3f& origin,
+    const Vector3f& direction,
+    float tMin,
+    float tMax,
+    IntT& intersection)
+{
     TriangleIntersectionResult result 
         = intersectTrianglesBVH(
             m_BVHindicesOrTriLists,
             origin, 
-            ray, 
+            createRay(direction), 
             m_BVHlimits, 
             m_TriangleIntersectionData, 
-            m_TriIdxList);
+            m_TriIdxList,
+            tMin,
+            tMax,
+            false);
     
     // FINISHING
     // translate to IntT
+    fillIntersection(direction, result, intersection);
+
+    return result.hit;
+}
+
+template<typename IntT>
+bool BVHRaycaster<IntT>::isOccluded(
+    const Vector3f& origin,
+    const Vector3f& direction,
+    float tMin,
+    float tMax)
+{
+    TriangleIntersectionResult result
+        = intersectTrianglesBVH(
+            m_BVHindicesOrTriLists,
+            origin,
+            createRay(direction),
+            m_BVHlimits,
+            m_TriangleIntersectionData,
+            m_TriIdxList,
+            tMin,
+            tMax,
+            true);
+
+    return result.hit;
+}
+
+template<typename IntT>
+void BVHRaycaster<IntT>::castRays(
+    const Vector3f& origin,
+    const std::vector<Vector3f>& directions,
+    std::vector<IntT>& intersections,
+    std::vector<uint8_t>& hits)
+{
+    intersections.resize(directions.size());
+    hits.resize(directions.size(), false);
+
+    std::vector<RayRow> rows(1);
+    rows[0] = {&origin, 0, directions.data(), directions.size(), intersections.data(), hits.data()};
+    castRows(rows, 0.0f, std::numeric_limits<float>::infinity(), false);
+}
+
+template<typename IntT>
+void BVHRaycaster<IntT>::castRays(
+    const Vector3f& origin,
+    const std::vector<std::vector<Vector3f> >& directions,
+    std::vector< std::vector<IntT> >& intersections,
+    std::vector< std::vector<uint8_t> >& hits)
+{
+    intersections.resize(directions.size());
+    hits.resize(directions.size());
+
+    std::vector<RayRow> rows(directions.size());
+    for(size_t i = 0; i < directions.size(); i++)
+    {
+        intersections[i].resize(directions[i].size());
+        hits[i].resize(directions[i].size(), false);
+        rows[i] = {&origin, 0, directions[i].data(), directions[i].size(), intersections[i].data(), hits[i].data()};
+    }
+    castRows(rows, 0.0f, std::numeric_limits<float>::infinity(), false);
+}
+
+template<typename IntT>
+void BVHRaycaster<IntT>::castRays(
+    const std::vector<Vector3f>& origins,
+    const std::vector<Vector3f>& directions,
+    std::vector<IntT>& intersections,
+    std::vector<uint8_t>& hits)
+{
+    intersections.resize(directions.size());
+    hits.resize(directions.size(), false);
+
+    std::vector<RayRow> rows(1);
+    rows[0] = {origins.data(), 1, directions.data(), directions.size(), intersections.data(), hits.data()};
+    castRows(rows, 0.0f, std::numeric_limits<float>::infinity(), false);
+}
+
+template<typename IntT>
+void BVHRaycaster<IntT>::castRays(
+    const std::vector<Vector3f>& origins,
+    const std::vector<std::vector<Vector3f> >& directions,
+    std::vector<std::vector<IntT> >& intersections,
+    std::vector<std::vector<uint8_t> >& hits)
+{
+    intersections.resize(directions.size());
+    hits.resize(directions.size());
+
+    std::vector<RayRow> rows(directions.size());
+    for(size_t i = 0; i < directions.size(); i++)
+    {
+        intersections[i].resize(directions[i].size());
+        hits[i].resize(directions[i].size(), false);
+        rows[i] = {&origins[i], 0, directions[i].data(), directions[i].size(), intersections[i].data(), hits[i].data()};
+    }
+    castRows(rows, 0.0f, std::numeric_limits<float>::infinity(), false);
+}
+
+template<typename IntT>
+void BVHRaycaster<IntT>::castRays(
+    const Vector3f& origin,
+    const std::vector<Vector3f>& directions,
+    float tMin,
+    float tMax,
+    std::vector<IntT>& intersections,
+    std::vector<uint8_t>& hits)
+{
+    intersections.resize(directions.size());
+    hits.resize(directions.size(), false);
+
+    std::vector<RayRow> rows(1);
+    rows[0] = {&origin, 0, directions.data(), directions.size(), intersections.data(), hits.data()};
+    castRows(rows, tMin, tMax, false);
+}
+
+template<typename IntT>
+void BVHRaycaster<IntT>::castRays(
+    const std::vector<Vector3f>& origins,
+    const std::vector<Vector3f>& directions,
+    float tMin,
+    float tMax,
+    std::vector<IntT>& intersections,
+    std::vector<uint8_t>& hits)
+{
+    intersections.resize(directions.size());
+    hits.resize(directions.size(), false);
+
+    std::vector<RayRow> rows(1);
+    rows[0] = {origins.data(), 1, directions.data(), directions.size(), intersections.data(), hits.data()};
+    castRows(rows, tMin, tMax, false);
+}
+
+template<typename IntT>
+void BVHRaycaster<IntT>::isOccluded(
+    const Vector3f& origin,
+    const std::vector<Vector3f>& directions,
+    float tMin,
+    float tMax,
+    std::vector<uint8_t>& occluded)
+{
+    occluded.resize(directions.size(), false);
+
+    std::vector<RayRow> rows(1);
+    rows[0] = {&origin, 0, directions.data(), directions.size(), nullptr, occluded.data()};
+    castRows(rows, tMin, tMax, true);
+}
+
+template<typename IntT>
+void BVHRaycaster<IntT>::isOccluded(
+    const std::vector<Vector3f>& origins,
+    const std::vector<Vector3f>& directions,
+    float tMin,
+    float tMax,
+    std::vector<uint8_t>& occluded)
+{
+    occluded.resize(directions.size(), false);
+
+    std::vector<RayRow> rows(1);
+    rows[0] = {origins.data(), 1, directions.data(), directions.size(), nullptr, occluded.data()};
+    castRows(rows, tMin, tMax, true);
+}
+
+template<typename IntT>
+void BVHRaycaster<IntT>::fillIntersection(
+    const Vector3f& direction,
+    const TriangleIntersectionResult& result,
+    IntT& intersection) const
+{
     if constexpr(IntT::template has<intelem::Point>())
     {
         intersection.point = result.pointHit;
@@ -95,8 +277,6 @@ bool BVHRaycaster<IntT>::castRay(
         // TODO
         intersection.mesh_id = 0;
     }
-
-    return result.hit;
 }
 
 // PRIVATE
@@ -108,7 +288,10 @@ BVHRaycaster<IntT>::intersectTrianglesBVH(
     Ray ray,
     const float* clBVHlimits,
     const float* clTriangleIntersectionData,
-    const unsigned int* clTriIdxList)
+    const unsigned int* clTriIdxList,
+    float tMin,
+    float tMax,
+    bool anyHit)
 {
     int tid_scale = 4;
     int bvh_limits_scale = 2;
@@ -138,7 +321,7 @@ BVHRaycaster<IntT>::intersectTrianglesBVH(
         {
             
             // if ray intersects inner node, push indices of left and right child nodes on the stack
-            if (rayIntersectsBox(origin, ray, &clBVHlimits[bvh_limits_scale * 3 * boxId]))
+            if (rayIntersectsBox(origin, ray, &clBVHlimits[bvh_limits_scale * 3 * boxId], tMin, tMax))
             {
                 stack[stackId++] = clBVHindicesOrTriLists[4 * boxId + 1];
                 stack[stackId++] = clBVHindicesOrTriLists[4 * boxId + 2];
@@ -179,6 +362,10 @@ BVHRaycaster<IntT>::intersectTrianglesBVH(
                 {
                     continue; // epsilon
                 }
+                if (s < tMin || s > tMax)
+                {
+                    continue; // outside of the requested range
+                }
                 Vector3f hit = ray.dir * s;
                 hit += origin;
 
@@ -215,6 +402,13 @@ BVHRaycaster<IntT>::intersectTrianglesBVH(
                         result.hit = true;
                         hitpoint = hit;
                     }
+
+                    // any intersection is enough for occlusion queries
+                    if (anyHit)
+                    {
+                        stackId = 0;
+                        break;
+                    }
                 }
 
             }
@@ -232,7 +426,9 @@ template<typename IntT>
 bool BVHRaycaster<IntT>::rayIntersectsBox(
     Vector3f origin,
     Ray ray,
-    const float* boxPtr)
+    const float* boxPtr,
+    float tMin,
+    float tMax)
 {
     const float* limitsX2 = boxPtr;
     const float* limitsY2 = boxPtr+2;
@@ -274,7 +470,393 @@ bool BVHRaycaster<IntT>::rayIntersectsBox(
         tmax = tzmax;
     }
 
+    // the box is completely outside of the requested range
+    return tmin <= tMax && tmax >= tMin;
+}
+
+template<typename IntT>
+const BVH4& BVHRaycaster<IntT>::wideBVH()
+{
+    std::call_once(m_wideBVHFlag, [this]()
+    {
+        m_wideBVH.reset(new BVH4(m_bvh));
+    });
+    return *m_wideBVH;
+}
+
+template<typename IntT>
+void BVHRaycaster<IntT>::castRows(const std::vector<RayRow>& rows, float tMin, float tMax, bool anyHit)
+{
+    const BVH4& bvh = wideBVH();
+    const std::vector<uint32_t>& triIndexList = bvh.getTriIndexList();
+
+    // packets compare with "s < tMax" while the requested range includes tMax
+    float laneMin = std::max(tMin, 0.0f);
+    float laneMax = std::nextafter(tMax, std::numeric_limits<float>::infinity());
+
+    // rays of a packet are traversed separately if their origins are farther apart than this
+    float maxOriginSpread = 0.0f;
+    if(!bvh.getNodes().empty())
+    {
+        const typename BVH4::Node& root = bvh.getNodes()[0];
+        for(int a = 0; a < 3; a++)
+        {
+            float min = std::numeric_limits<float>::infinity();
+            float max = -std::numeric_limits<float>::infinity();
+            for(int i = 0; i < BVH4::NodeWidth; i++)
+            {
+                min = std::min(min, root.bounds[2 * a][i]);
+                max = std::max(max, root.bounds[2 * a + 1][i]);
+            }
+            maxOriginSpread = std::max(maxOriginSpread, 0.01f * (max - min));
+        }
+    }
+
+    // one job per packet, so that rows of different length are balanced
+    std::vector<std::pair<size_t, size_t> > jobs;
+    for(size_t i = 0; i < rows.size(); i++)
+    {
+        for(size_t start = 0; start < rows[i].size; start += PacketSize)
+        {
+            jobs.emplace_back(i, start);
+        }
+    }
+
+    #pragma omp parallel
+    {
+        std::vector<PacketStackEntry> stack(bvh.getMaxStackSize());
+        RayPacket packet;
+
+        #pragma omp for schedule(dynamic, 16)
+        for(size_t j = 0; j < jobs.size(); j++)
+        {
+            const RayRow& row = rows[jobs[j].first];
+            size_t start = jobs[j].second;
+            int n = static_cast<int>(std::min<size_t>(PacketSize, row.size - start));
+
+            for(int l = 0; l < PacketSize; l++)
+            {
+                // unused lanes repeat the last ray and are disabled by a negative tMax
+                size_t ray = start + std::min(l, n - 1);
+                const Vector3f& origin = row.origins[ray * row.originStride];
+                const Vector3f& direction = row.directions[ray];
+                for(int a = 0; a < 3; a++)
+                {
+                    packet.org[a][l] = origin[a];
+                    packet.dir[a][l] = direction[a];
+                    packet.invDir[a][l] = 1.0f / direction[a];
+                }
+                packet.tMin[l] = laneMin;
+                packet.tMax[l] = l < n ? laneMax : -1.0f;
+                packet.tri[l] = BVH4::InvalidChild;
+            }
+
+            if(bvh.getNodes().empty())
+            {
+                // nothing to hit
+            }
+            else if(isCoherent(packet, n, maxOriginSpread))
+            {
+                intersectPacket(bvh, packet, stack.data(), anyHit);
+            }
+            else
+            {
+                // incoherent rays would visit the union of their nodes in a packet
+                for(int l = 0; l < n; l++)
+                {
+                    intersectRay(bvh, packet, l, stack.data(), anyHit);
+                }
+            }
+
+            for(int l = 0; l < n; l++)
+            {
+                size_t ray = start + l;
+                row.hits[ray] = packet.tri[l] != BVH4::InvalidChild;
+                if(!row.hits[ray] || anyHit)
+                {
+                    continue;
+                }
+
+                const Vector3f& origin = row.origins[ray * row.originStride];
+                const Vector3f& direction = row.directions[ray];
+
+                TriangleIntersectionResult result;
+                result.hit = true;
+                result.pBestTriId = triIndexList[packet.tri[l]];
+                result.pointHit = direction * packet.tMax[l];
+                result.pointHit += origin;
+                result.hitDist = sqrt(distanceSquare(origin, result.pointHit));
+
+                fillIntersection(direction, result, row.intersections[ray]);
+            }
+        }
+    }
+}
+
+template<typename IntT>
+void BVHRaycaster<IntT>::intersectPacket(
+    const BVH4& bvh,
+    RayPacket& packet,
+    PacketStackEntry* stack,
+    bool anyHit) const
+{
+    constexpr int Width = BVH4::NodeWidth;
+    const float epsilon = static_cast<float>(EPSILON);
+    const float infinity = std::numeric_limits<float>::infinity();
+
+    const std::vector<typename BVH4::Node>& nodes = bvh.getNodes();
+    const float* triangleData = bvh.getTrianglesIntersectionData().data();
+
+    int stackId = 0;
+    stack[stackId++] = {0, 0, 0.0f};
+
+    while (stackId)
+    {
+        PacketStackEntry entry = stack[--stackId];
+
+        // skip entries that are behind the closest hit of every ray
+        float maxT = *std::max_element(packet.tMax, packet.tMax + PacketSize);
+        if (maxT < 0.0f)
+        {
+            break; // all rays are finished
+        }
+        if (entry.tNear > maxT)
+        {
+            continue;
+        }
+
+        if (entry.count) // leaf
+        {
+            // same intersection test as intersectTrianglesBVH for all rays at once
+            for (uint32_t i = entry.child; i < entry.child + entry.count; i++)
+            {
+                const float* tri = triangleData + 16 * i;
+
+                #pragma omp simd
+                for(int l = 0; l < PacketSize; l++)
+                {
+                    float k = tri[0] * packet.dir[0][l] + tri[1] * packet.dir[1][l] + tri[2] * packet.dir[2][l];
+                    float s = (tri[3] - (tri[0] * packet.org[0][l] + tri[1] * packet.org[1][l] + tri[2] * packet.org[2][l])) / k;
+
+                    float hitX = packet.dir[0][l] * s + packet.org[0][l];
+                    float hitY = packet.dir[1][l] * s + packet.org[1][l];
+                    float hitZ = packet.dir[2][l] * s + packet.org[2][l];
+
+                    float kt1 = tri[4] * hitX + tri[5] * hitY + tri[6] * hitZ - tri[7];
+                    float kt2 = tri[8] * hitX + tri[9] * hitY + tri[10] * hitZ - tri[11];
+                    float kt3 = tri[12] * hitX + tri[13] * hitY + tri[14] * hitZ - tri[15];
+
+                    // bitwise instead of logical and, so that the loop has no branches
+                    bool hit = (k != 0.0f) & (s > epsilon) & (s >= packet.tMin[l]) & (s < packet.tMax[l])
+                        & (kt1 >= 0.0f) & (kt2 >= 0.0f) & (kt3 >= 0.0f);
+
+                    // rays of occlusion queries are finished by their first hit
+                    packet.tMax[l] = hit ? (anyHit ? -1.0f : s) : packet.tMax[l];
+                    packet.tri[l] = hit ? i : packet.tri[l];
+                }
+            }
+        }
+        else // inner node
+        {
+            const typename BVH4::Node& node = nodes[entry.child];
+
+            PacketStackEntry children[Width];
+            int numChildren = 0;
+
+            for (int i = 0; i < Width; i++)
+            {
+                if (node.child[i] == BVH4::InvalidChild)
+                {
+                    continue;
+                }
+
+                // slab test of all rays, misses get an infinite entry distance
+                float laneNear[PacketSize];
+                #pragma omp simd
+                for(int l = 0; l < PacketSize; l++)
+                {
+                    float tx0 = (node.bounds[0][i] - packet.org[0][l]) * packet.invDir[0][l];
+                    float tx1 = (node.bounds[1][i] - packet.org[0][l]) * packet.invDir[0][l];
+                    float ty0 = (node.bounds[2][i] - packet.org[1][l]) * packet.invDir[1][l];
+                    float ty1 = (node.bounds[3][i] - packet.org[1][l]) * packet.invDir[1][l];
+                    float tz0 = (node.bounds[4][i] - packet.org[2][l]) * packet.invDir[2][l];
+                    float tz1 = (node.bounds[5][i] - packet.org[2][l]) * packet.invDir[2][l];
+
+                    // plain conditionals instead of std::min / std::max, which return references
+                    float tNear = packet.tMin[l];
+                    tNear = tx0 < tx1 ? (tx0 > tNear ? tx0 : tNear) : (tx1 > tNear ? tx1 : tNear);
+                    tNear = ty0 < ty1 ? (ty0 > tNear ? ty0 : tNear) : (ty1 > tNear ? ty1 : tNear);
+                    tNear = tz0 < tz1 ? (tz0 > tNear ? tz0 : tNear) : (tz1 > tNear ? tz1 : tNear);
+
+                    float tFar = packet.tMax[l];
+                    tFar = tx0 < tx1 ? (tx1 < tFar ? tx1 : tFar) : (tx0 < tFar ? tx0 : tFar);
+                    tFar = ty0 < ty1 ? (ty1 < tFar ? ty1 : tFar) : (ty0 < tFar ? ty0 : tFar);
+                    tFar = tz0 < tz1 ? (tz1 < tFar ? tz1 : tFar) : (tz0 < tFar ? tz0 : tFar);
+
+                    laneNear[l] = tNear <= tFar ? tNear : infinity;
+                }
+
+                float tNearMin = *std::min_element(laneNear, laneNear + PacketSize);
+
+                if (tNearMin != infinity)
+                {
+                    children[numChildren++] = {node.child[i], node.count[i], tNearMin};
+                }
+            }
+
+            // push the farthest child first, so that the nearest one is traversed next.
+            // Insertion sort, as there are at most Width children
+            for (int i = 0; i < numChildren; i++)
+            {
+                int j = stackId + i;
+                while (j > stackId && stack[j - 1].tNear < children[i].tNear)
+                {
+                    stack[j] = stack[j - 1];
+                    j--;
+                }
+                stack[j] = children[i];
+            }
+            stackId += numChildren;
+        }
+    }
+}
+
+template<typename IntT>
+bool BVHRaycaster<IntT>::isCoherent(
+    const RayPacket& packet,
+    int n,
+    float maxOriginSpread) const
+{
+    for(int a = 0; a < 3; a++)
+    {
+        bool negative = packet.dir[a][0] < 0.0f;
+        float min = packet.org[a][0];
+        float max = packet.org[a][0];
+        for(int l = 1; l < n; l++)
+        {
+            if((packet.dir[a][l] < 0.0f) != negative)
+            {
+                return false;
+            }
+            min = std::min(min, packet.org[a][l]);
+            max = std::max(max, packet.org[a][l]);
+        }
+        if(max - min > maxOriginSpread)
+        {
+            return false;
+        }
+    }
     return true;
 }
 
-} // namespace lvr2
\ No newline at end of file
+template<typename IntT>
+void BVHRaycaster<IntT>::intersectRay(
+    const BVH4& bvh,
+    RayPacket& packet,
+    int l,
+    PacketStackEntry* stack,
+    bool anyHit) const
+{
+    constexpr int Width = BVH4::NodeWidth;
+    const float epsilon = static_cast<float>(EPSILON);
+    const float infinity = std::numeric_limits<float>::infinity();
+
+    const std::vector<typename BVH4::Node>& nodes = bvh.getNodes();
+    const float* triangleData = bvh.getTrianglesIntersectionData().data();
+
+    const float org[3] = {packet.org[0][l], packet.org[1][l], packet.org[2][l]};
+    const float dir[3] = {packet.dir[0][l], packet.dir[1][l], packet.dir[2][l]};
+    const float invDir[3] = {packet.invDir[0][l], packet.invDir[1][l], packet.invDir[2][l]};
+    const float tMin = packet.tMin[l];
+    float& tMax = packet.tMax[l];
+
+    int stackId = 0;
+    stack[stackId++] = {0, 0, 0.0f};
+
+    while (stackId)
+    {
+        PacketStackEntry entry = stack[--stackId];
+        if (entry.tNear > tMax)
+        {
+            continue;
+        }
+
+        if (entry.count) // leaf
+        {
+            for (uint32_t i = entry.child; i < entry.child + entry.count; i++)
+            {
+                const float* tri = triangleData + 16 * i;
+
+                float k = tri[0] * dir[0] + tri[1] * dir[1] + tri[2] * dir[2];
+                float s = (tri[3] - (tri[0] * org[0] + tri[1] * org[1] + tri[2] * org[2])) / k;
+
+                float hitX = dir[0] * s + org[0];
+                float hitY = dir[1] * s + org[1];
+                float hitZ = dir[2] * s + org[2];
+
+                float kt1 = tri[4] * hitX + tri[5] * hitY + tri[6] * hitZ - tri[7];
+                float kt2 = tri[8] * hitX + tri[9] * hitY + tri[10] * hitZ - tri[11];
+                float kt3 = tri[12] * hitX + tri[13] * hitY + tri[14] * hitZ - tri[15];
+
+                if (k != 0.0f && s > epsilon && s >= tMin && s < tMax
+                    && kt1 >= 0.0f && kt2 >= 0.0f && kt3 >= 0.0f)
+                {
+                    packet.tri[l] = i;
+                    if (anyHit)
+                    {
+                        tMax = -1.0f;
+                        return;
+                    }
+                    tMax = s;
+                }
+            }
+        }
+        else // inner node: test the ray against all children at once
+        {
+            const typename BVH4::Node& node = nodes[entry.child];
+
+            float childNear[Width];
+            #pragma omp simd
+            for (int i = 0; i < Width; i++)
+            {
+                float tx0 = (node.bounds[0][i] - org[0]) * invDir[0];
+                float tx1 = (node.bounds[1][i] - org[0]) * invDir[0];
+                float ty0 = (node.bounds[2][i] - org[1]) * invDir[1];
+                float ty1 = (node.bounds[3][i] - org[1]) * invDir[1];
+                float tz0 = (node.bounds[4][i] - org[2]) * invDir[2];
+                float tz1 = (node.bounds[5][i] - org[2]) * invDir[2];
+
+                float tNear = tMin;
+                tNear = tx0 < tx1 ? (tx0 > tNear ? tx0 : tNear) : (tx1 > tNear ? tx1 : tNear);
+                tNear = ty0 < ty1 ? (ty0 > tNear ? ty0 : tNear) : (ty1 > tNear ? ty1 : tNear);
+                tNear = tz0 < tz1 ? (tz0 > tNear ? tz0 : tNear) : (tz1 > tNear ? tz1 : tNear);
+
+                float tFar = tMax;
+                tFar = tx0 < tx1 ? (tx1 < tFar ? tx1 : tFar) : (tx0 < tFar ? tx0 : tFar);
+                tFar = ty0 < ty1 ? (ty1 < tFar ? ty1 : tFar) : (ty0 < tFar ? ty0 : tFar);
+                tFar = tz0 < tz1 ? (tz1 < tFar ? tz1 : tFar) : (tz0 < tFar ? tz0 : tFar);
+
+                childNear[i] = (tNear <= tFar) & (node.child[i] != BVH4::InvalidChild) ? tNear : infinity;
+            }
+
+            // push the farthest child first, so that the nearest one is traversed next
+            int base = stackId;
+            for (int i = 0; i < Width; i++)
+            {
+                if (childNear[i] == infinity)
+                {
+                    continue;
+                }
+                int j = stackId++;
+                while (j > base && stack[j - 1].tNear < childNear[i])
+                {
+                    stack[j] = stack[j - 1];
+                    j--;
+                }
+                stack[j] = {node.child[i], node.count[i], childNear[i]};
+            }
+        }
+    }
+}
+
+} // namespace lvr2
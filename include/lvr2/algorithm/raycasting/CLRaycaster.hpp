@@ -76,6 +76,13 @@ public:
     CLRaycaster(const MeshBufferPtr mesh,
                 unsigned int stack_size = 32);
 
+    /**
+     * @brief Constructor: Uses an already built BVH of the mesh, loads CL kernels
+     */
+    CLRaycaster(const MeshBufferPtr mesh,
+                BVHTree<BaseVector<float> > bvh,
+                unsigned int stack_size = 32);
+
     /// Overload functions ///
     /**
      * @brief Cast a single ray onto the mesh. Hint: Better not use it on GPU.
@@ -91,6 +98,7 @@ public:
         const Vector3f& direction,
         IntT& intersection);
 
+    using BVHRaycaster<IntT>::castRay;
     using BVHRaycaster<IntT>::castRays;
 
     /**
@@ -123,6 +131,38 @@ public:
         std::vector<IntT>& intersections,
         std::vector<uint8_t>& hits) override;
 
+    /**
+     * @brief Cast a ray from a single origin
+     *        with multiple directions (in matrix form) onto the mesh.
+     *        Every row is cast on the GPU.
+     *
+     * @param[in] origin Origin of the ray
+     * @param[in] directions Directions of the ray
+     * @param[out] intersections User defined intersections output
+     * @param[out] hits Intersection found or not
+     */
+    void castRays(
+        const Vector3f& origin,
+        const std::vector<std::vector<Vector3f> >& directions,
+        std::vector< std::vector<IntT> >& intersections,
+        std::vector< std::vector<uint8_t> >& hits) override;
+
+    /**
+     * @brief Cast rays with multiples origins.
+     *        Each origin has multiples directions.
+     *        Every row is cast on the GPU.
+     *
+     * @param[in] origins Origins of the rays
+     * @param[in] directions Directions for each origin
+     * @param[out] intersections Resulting intersections output
+     * @param[out] hits Intersection found or not
+     */
+    void castRays(
+        const std::vector<Vector3f>& origins,
+        const std::vector<std::vector<Vector3f> >& directions,
+        std::vector<std::vector<IntT> >& intersections,
+        std::vector<std::vector<uint8_t> >& hits) override;
+
     struct ClTriangleIntersectionResult {
         cl_uchar hit = 0;
         cl_uint pBestTriId;
@@ -10,7 +10,16 @@ constexpr char CAST_RAYS_BVH_PROGRAM[] =
 template<typename IntT>
 CLRaycaster<IntT>::CLRaycaster(const MeshBufferPtr mesh, 
     unsigned int stack_size)
-:BVHRaycaster<IntT>(mesh, stack_size)
+:CLRaycaster<IntT>(mesh, BVHTree<BaseVector<float> >(mesh), stack_size)
+{
+
+}
+
+template<typename IntT>
+CLRaycaster<IntT>::CLRaycaster(const MeshBufferPtr mesh,
+    BVHTree<BaseVector<float> > bvh,
+    unsigned int stack_size)
+:BVHRaycaster<IntT>(mesh, std::move(bvh), stack_size)
 ,m_warp_size(32)
 {
     try {
@@ -504,6 +513,27 @@ void CLRaycaster<IntT>::castRays(
 //     }
 // }
 
+template<typename IntT>
+void CLRaycaster<IntT>::castRays(
+    const Vector3f& origin,
+    const std::vector<std::vector<Vector3f> >& directions,
+    std::vector< std::vector<IntT> >& intersections,
+    std::vector< std::vector<uint8_t> >& hits)
+{
+    // the CPU packet traversal of BVHRaycaster is skipped on purpose
+    RaycasterBase<IntT>::castRays(origin, directions, intersections, hits);
+}
+
+template<typename IntT>
+void CLRaycaster<IntT>::castRays(
+    const std::vector<Vector3f>& origins,
+    const std::vector<std::vector<Vector3f> >& directions,
+    std::vector<std::vector<IntT> >& intersections,
+    std::vector<std::vector<uint8_t> >& hits)
+{
+    RaycasterBase<IntT>::castRays(origins, directions, intersections, hits);
+}
+
 template<typename IntT>
 void CLRaycaster<IntT>::castRays(
     const std::vector<Vector3f>& origins,
@@ -67,6 +67,43 @@ public:
         const Vector3f& direction,
         IntT& intersection);
 
+    /**
+     * @brief Cast a single ray onto the mesh within the given ray range
+     *
+     * @param[in] origin Ray origin
+     * @param[in] direction Ray direction
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @param[out] intersection User defined intersection output
+     * @return true  Intersection found
+     * @return false  Not intersection found
+     */
+    bool castRay(
+        const Vector3f& origin,
+        const Vector3f& direction,
+        float tMin,
+        float tMax,
+        IntT& intersection);
+
+    using RaycasterBase<IntT>::isOccluded;
+
+    /**
+     * @brief Checks whether the mesh is hit anywhere within the given ray range
+     *        by an occlusion query of Embree
+     *
+     * @param[in] origin Ray origin
+     * @param[in] direction Ray direction
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @return true  Any intersection found
+     * @return false  Not intersection found
+     */
+    bool isOccluded(
+        const Vector3f& origin,
+        const Vector3f& direction,
+        float tMin,
+        float tMax);
+
 protected:
 
     RTCDevice initializeDevice();
@@ -74,7 +111,9 @@ protected:
 
     inline RTCRayHit lvr2embree(
         const Vector3f& origin, 
-        const Vector3f& direction) const
+        const Vector3f& direction,
+        float tMin = 0.0f,
+        float tMax = INFINITY) const
     {
         RTCRayHit rayhit;
         rayhit.ray.org_x = origin.x();
@@ -83,8 +122,8 @@ protected:
         rayhit.ray.dir_x = direction.x();
         rayhit.ray.dir_y = direction.y();
         rayhit.ray.dir_z = direction.z();
-        rayhit.ray.tnear = 0;
-        rayhit.ray.tfar = INFINITY;
+        rayhit.ray.tnear = tMin;
+        rayhit.ray.tfar = tMax;
         rayhit.ray.mask = 0;
         rayhit.ray.flags = 0;
         rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
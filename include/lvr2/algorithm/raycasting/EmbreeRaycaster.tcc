@@ -24,7 +24,18 @@ bool EmbreeRaycaster<IntT>::castRay(
     const Vector3f& direction,
     IntT& intersection)
 {
-    RTCRayHit rayhit = lvr2embree(origin, direction);
+    return castRay(origin, direction, 0.0f, INFINITY, intersection);
+}
+
+template<typename IntT>
+bool EmbreeRaycaster<IntT>::castRay(
+    const Vector3f& origin,
+    const Vector3f& direction,
+    float tMin,
+    float tMax,
+    IntT& intersection)
+{
+    RTCRayHit rayhit = lvr2embree(origin, direction, tMin, tMax);
     rtcIntersect1(m_scene, &m_context, &rayhit);
     
     if constexpr(IntT::template has<intelem::Point>())
@@ -71,6 +82,20 @@ bool EmbreeRaycaster<IntT>::castRay(
     return (rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID);
 }
 
+template<typename IntT>
+bool EmbreeRaycaster<IntT>::isOccluded(
+    const Vector3f& origin,
+    const Vector3f& direction,
+    float tMin,
+    float tMax)
+{
+    RTCRay ray = lvr2embree(origin, direction, tMin, tMax).ray;
+    rtcOccluded1(m_scene, &m_context, &ray);
+
+    // embree sets tfar to -inf if any hit was found
+    return ray.tfar < 0.0f;
+}
+
 // PRIVATE
 
 template<typename IntT>
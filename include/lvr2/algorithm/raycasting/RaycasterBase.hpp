@@ -72,7 +72,49 @@ public:
         const Vector3f& direction,
         IntT& intersection
     ) = 0;
-    
+
+    /**
+     * @brief Cast a single ray onto the mesh and only consider intersections
+     *        within the given range of the ray. The range is given as multiples
+     *        of the direction, i.e., in the unit of the distance for
+     *        normalized directions.
+     *
+     * @param[in] origin Ray origin
+     * @param[in] direction Ray direction
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @param[out] intersection User defined intersection output
+     * @return true  Intersection found
+     * @return false  Not intersection found
+     */
+    virtual bool castRay(
+        const Vector3f& origin,
+        const Vector3f& direction,
+        float tMin,
+        float tMax,
+        IntT& intersection
+    ) = 0;
+
+    /**
+     * @brief Checks whether the mesh is hit anywhere within the given range of
+     *        the ray. The search stops at the first hit, so this is cheaper than
+     *        castRay, e.g. for visibility checks. Use direction = target - origin
+     *        and tMax slightly below 1 to check whether target is visible from origin.
+     *
+     * @param[in] origin Ray origin
+     * @param[in] direction Ray direction
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @return true  Any intersection found
+     * @return false  Not intersection found
+     */
+    virtual bool isOccluded(
+        const Vector3f& origin,
+        const Vector3f& direction,
+        float tMin,
+        float tMax
+    ) = 0;
+
     // VIRTUALS WITH DEFAULTS. overridable
     
     /**
@@ -139,6 +181,80 @@ public:
         std::vector<std::vector<uint8_t> >& hits
     );
 
+    /**
+     * @brief Cast a ray from single origin with multiple directions
+     *        onto the mesh. Only intersections within [tMin, tMax] are considered.
+     *
+     * @param[in] origin Origin of the ray
+     * @param[in] directions Directions of the ray
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @param[out] intersections User defined intersections output
+     * @param[out] hits Intersection found or not
+     */
+    virtual void castRays(
+        const Vector3f& origin,
+        const std::vector<Vector3f>& directions,
+        float tMin,
+        float tMax,
+        std::vector<IntT>& intersections,
+        std::vector<uint8_t>& hits
+    );
+
+    /**
+     * @brief Cast from multiple ray origin/direction pairs onto the mesh.
+     *        Only intersections within [tMin, tMax] are considered.
+     *
+     * @param[in] origins Origins of the rays
+     * @param[in] directions Directions of the rays
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @param[out] intersections User defined intersections output
+     * @param[out] hits Intersection found or not
+     */
+    virtual void castRays(
+        const std::vector<Vector3f>& origins,
+        const std::vector<Vector3f>& directions,
+        float tMin,
+        float tMax,
+        std::vector<IntT>& intersections,
+        std::vector<uint8_t>& hits
+    );
+
+    /**
+     * @brief Occlusion test for rays from a single origin with multiple directions
+     *
+     * @param[in] origin Origin of the rays
+     * @param[in] directions Directions of the rays
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @param[out] occluded Any intersection found or not
+     */
+    virtual void isOccluded(
+        const Vector3f& origin,
+        const std::vector<Vector3f>& directions,
+        float tMin,
+        float tMax,
+        std::vector<uint8_t>& occluded
+    );
+
+    /**
+     * @brief Occlusion test for multiple ray origin/direction pairs
+     *
+     * @param[in] origins Origins of the rays
+     * @param[in] directions Directions of the rays
+     * @param[in] tMin Minimum ray parameter of an intersection
+     * @param[in] tMax Maximum ray parameter of an intersection
+     * @param[out] occluded Any intersection found or not
+     */
+    virtual void isOccluded(
+        const std::vector<Vector3f>& origins,
+        const std::vector<Vector3f>& directions,
+        float tMin,
+        float tMax,
+        std::vector<uint8_t>& occluded
+    );
+
 private:
     const MeshBufferPtr m_mesh;
 };
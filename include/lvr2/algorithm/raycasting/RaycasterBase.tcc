@@ -76,4 +76,76 @@ void RaycasterBase<IntT>::castRays(
     }
 }
 
-} // namespace lvr2
\ No newline at end of file
+template<typename IntT>
+void RaycasterBase<IntT>::castRays(
+    const Vector3f& origin,
+    const std::vector<Vector3f>& directions,
+    float tMin,
+    float tMax,
+    std::vector<IntT>& intersections,
+    std::vector<uint8_t>& hits)
+{
+    intersections.resize(directions.size());
+    hits.resize(directions.size(), false);
+
+    #pragma omp parallel for
+    for(size_t i=0; i<directions.size(); i++)
+    {
+        hits[i] = castRay(origin, directions[i], tMin, tMax, intersections[i]);
+    }
+}
+
+template<typename IntT>
+void RaycasterBase<IntT>::castRays(
+    const std::vector<Vector3f>& origins,
+    const std::vector<Vector3f>& directions,
+    float tMin,
+    float tMax,
+    std::vector<IntT>& intersections,
+    std::vector<uint8_t>& hits)
+{
+    intersections.resize(directions.size());
+    hits.resize(directions.size(), false);
+
+    #pragma omp parallel for
+    for(size_t i=0; i<directions.size(); i++)
+    {
+        hits[i] = castRay(origins[i], directions[i], tMin, tMax, intersections[i]);
+    }
+}
+
+template<typename IntT>
+void RaycasterBase<IntT>::isOccluded(
+    const Vector3f& origin,
+    const std::vector<Vector3f>& directions,
+    float tMin,
+    float tMax,
+    std::vector<uint8_t>& occluded)
+{
+    occluded.resize(directions.size(), false);
+
+    #pragma omp parallel for
+    for(size_t i=0; i<directions.size(); i++)
+    {
+        occluded[i] = isOccluded(origin, directions[i], tMin, tMax);
+    }
+}
+
+template<typename IntT>
+void RaycasterBase<IntT>::isOccluded(
+    const std::vector<Vector3f>& origins,
+    const std::vector<Vector3f>& directions,
+    float tMin,
+    float tMax,
+    std::vector<uint8_t>& occluded)
+{
+    occluded.resize(directions.size(), false);
+
+    #pragma omp parallel for
+    for(size_t i=0; i<directions.size(); i++)
+    {
+        occluded[i] = isOccluded(origins[i], directions[i], tMin, tMax);
+    }
+}
+
+} // namespace lvr2
@@ -35,6 +35,7 @@
 #ifndef LVR2_ATTRMAPS_STABLEVECTOR_H_
 #define LVR2_ATTRMAPS_STABLEVECTOR_H_
 
+#include <cstdint>
 #include <vector>
 #include <utility>
 #include <boost/optional.hpp>
@@ -51,6 +52,39 @@ using std::vector;
 namespace lvr2
 {
 
+namespace stable_vector_detail
+{
+
+/// Wrapper for bool elements, since `vector<bool>` can't return references
+struct BoolElement
+{
+    bool value;
+
+    BoolElement() = default;
+    BoolElement(bool v) : value(v) {}
+};
+
+/// Type an element of type `ElemT` is stored as in the element array
+template<typename ElemT>
+struct Storage
+{
+    using Type = ElemT;
+
+    static ElemT& ref(ElemT& elem) { return elem; }
+    static const ElemT& ref(const ElemT& elem) { return elem; }
+};
+
+template<>
+struct Storage<bool>
+{
+    using Type = BoolElement;
+
+    static bool& ref(BoolElement& elem) { return elem.value; }
+    static const bool& ref(const BoolElement& elem) { return elem.value; }
+};
+
+} // namespace stable_vector_detail
+
 /**
  * @brief Iterator over handles in this vector, which skips deleted elements
  *
@@ -61,13 +95,22 @@ template<typename HandleT, typename ElemT>
 class StableVectorIterator
 {
 private:
-    /// Reference to the deleted marker array this iterator belongs to
-    const vector<boost::optional<ElemT>>* m_elements;
+    using StoredType = typename stable_vector_detail::Storage<ElemT>::Type;
+
+    /// Reference to the element array this iterator belongs to
+    const vector<StoredType>* m_elements;
+
+    /// Reference to the bitset marking the used elements
+    const vector<uint64_t>* m_used;
 
     /// Current position in the vector
     size_t m_pos;
 public:
-    StableVectorIterator(const vector<boost::optional<ElemT>>* deleted, bool startAtEnd = false);
+    StableVectorIterator(
+        const vector<StoredType>* elements,
+        const vector<uint64_t>* used,
+        bool startAtEnd = false
+    );
 
     StableVectorIterator& operator=(const StableVectorIterator& other);
     bool operator==(const StableVectorIterator& other) const;
@@ -90,11 +133,23 @@ public:
  * remains true regardless of other insertions and deletions happening in
  * between.
  *
+ * The elements are stored contiguously without any per-element overhead.
+ * Whether an element is deleted is stored in a separate bitset, so iterating
+ * over the handles only reads one bit per element. Deleted elements stay in
+ * the element array as tombstones. Unlike in `vector<bool>`, `bool` elements
+ * occupy one byte each, so references to them can be handed out.
+ *
+ * Existing elements may be modified from several threads via `operator[]` as
+ * long as each thread accesses different elements. All other modifying
+ * methods, including `set()` and `erase()`, are not thread-safe, since
+ * neighbouring elements share a word of the bitset.
+ *
  * USE WITH CAUTION: This NEVER frees memory of deleted values (except on its
- * own destruction and can get very large if used incorrectly! If deletions in
- * your use-case are far more numerous than insertions, this data structure is
- * probably not fitting your needs. The memory requirement of this class is
- * O(n_p) where n_p is the number of `push()` calls.
+ * own destruction or when calling `compact()`) and can get very large if used
+ * incorrectly! If deletions in your use-case are far more numerous than
+ * insertions, this data structure is probably not fitting your needs. The
+ * memory requirement of this class is O(n_p) where n_p is the number of
+ * `push()` calls.
  *
  * @tparam HandleT This handle type contains the actual index. It has to be
  *                 derived from `BaseHandle`!
@@ -151,10 +206,21 @@ public:
      * by this method are marked as deleted and thus aren't initialized. They
      * can be set later with `set()`.
      *
+     * As the deleted elements still occupy storage, this requires `ElemT` to
+     * be default constructible. Use `increaseSizeDeleted()` otherwise.
+     *
      * If `upTo` is already a valid handle, this method will panic!
      */
     void increaseSize(HandleType upTo);
 
+    /**
+     * @brief Works like `increaseSize(upTo)`, but fills the storage of the
+     *        deleted elements with copies of `placeholder`.
+     *
+     * If `upTo` is already a valid handle, this method will panic!
+     */
+    void increaseSizeDeleted(HandleType upTo, const ElementType& placeholder);
+
     /**
      * @brief Increases the size of the vector to the length of `upTo` by
      *        inserting copies of `elem`.
@@ -273,12 +339,43 @@ public:
      */
     void reserve(size_t newCap);
 
+    /**
+     * @brief Frees the capacity that is not used by any (deleted or
+     *        non-deleted) element.
+     */
+    void shrinkToFit();
+
+    /**
+     * @brief Removes all deleted elements by moving the remaining elements to
+     *        the front, keeping their order, and frees the unused memory.
+     *
+     * This invalidates all handles into this vector!
+     *
+     * @return For each old index, the new index of its element, or the
+     *         maximum value of `Index` if the element was deleted.
+     */
+    vector<Index> compact();
+
 private:
     /// Count of used elements in elements vector
     size_t m_usedCount;
 
-    /// Vector for stored elements
-    vector<boost::optional<ElementType>> m_elements;
+    using Storage = stable_vector_detail::Storage<ElemT>;
+
+    /// Vector for stored elements, including deleted ones
+    vector<typename Storage::Type> m_elements;
+
+    /// One bit per element, set if the element is not deleted
+    vector<uint64_t> m_used;
+
+    /// Returns whether the element at `idx` is not deleted
+    bool isUsed(size_t idx) const;
+
+    /// Sets or clears the used bit of the element at `idx`
+    void setUsed(size_t idx, bool used);
+
+    /// Resizes the bitset to the current number of elements
+    void resizeUsed();
 
     /**
      * @brief Assert that the requested handle is not deleted or throw an
@@ -35,13 +35,36 @@
 #include "lvr2/util/Panic.hpp"
 #include <boost/shared_array.hpp>
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
 #include <string>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 
 namespace lvr2
 {
 
+namespace stable_vector_detail
+{
+
+/// Index of the lowest set bit, `bits` must not be zero
+inline unsigned countTrailingZeros(uint64_t bits)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return index;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+} // namespace stable_vector_detail
+
 template<typename HandleT, typename ElemT>
 void StableVector<HandleT, ElemT>::checkAccess(HandleType handle) const
 {
@@ -56,28 +79,62 @@ void StableVector<HandleT, ElemT>::checkAccess(HandleType handle) const
     }
 
     // You cannot access deleted or uninitialized elements!
-    if (!m_elements[handle.idx()])
+    if (!isUsed(handle.idx()))
     {
         panic("attempt to access a deleted value in StableVector");
     }
     //#endif
 }
 
+template<typename HandleT, typename ElemT>
+bool StableVector<HandleT, ElemT>::isUsed(size_t idx) const
+{
+    return (m_used[idx / 64] >> (idx % 64)) & 1;
+}
+
+template<typename HandleT, typename ElemT>
+void StableVector<HandleT, ElemT>::setUsed(size_t idx, bool used)
+{
+    uint64_t mask = uint64_t(1) << (idx % 64);
+    if (used)
+    {
+        m_used[idx / 64] |= mask;
+    }
+    else
+    {
+        m_used[idx / 64] &= ~mask;
+    }
+}
+
+template<typename HandleT, typename ElemT>
+void StableVector<HandleT, ElemT>::resizeUsed()
+{
+    m_used.resize((m_elements.size() + 63) / 64, 0);
+}
+
 template<typename HandleT, typename ElemT>
 StableVector<HandleT, ElemT>::StableVector(size_t countElements, const ElementType& defaultValue)
-    : m_elements(countElements, defaultValue),
-      m_usedCount(countElements)
-{}
+    : m_usedCount(countElements),
+      m_elements(countElements, defaultValue),
+      m_used((countElements + 63) / 64, ~uint64_t(0))
+{
+    // Clear the bits behind the last element, so that iterating never
+    // reaches them
+    if (countElements % 64 != 0)
+    {
+        m_used.back() = (uint64_t(1) << (countElements % 64)) - 1;
+    }
+}
 
 template<typename HandleT, typename ElemT>
 StableVector<HandleT, ElemT>::StableVector(size_t countElements, const boost::shared_array<ElementType>& sharedArray)
-    : m_usedCount(countElements)
+    : m_usedCount(countElements),
+      m_elements(sharedArray.get(), sharedArray.get() + countElements),
+      m_used((countElements + 63) / 64, ~uint64_t(0))
 {
-    m_elements.reserve(countElements);
-    #pragma omp parallel for
-    for(size_t i=0; i<countElements; i++)
+    if (countElements % 64 != 0)
     {
-        m_elements[i] = sharedArray[i];
+        m_used.back() = (uint64_t(1) << (countElements % 64)) - 1;
     }
 }
 
@@ -85,6 +142,8 @@ template<typename HandleT, typename ElemT>
 HandleT StableVector<HandleT, ElemT>::push(const ElementType& elem)
 {
     m_elements.emplace_back(elem);
+    resizeUsed();
+    m_used.back() |= uint64_t(1) << ((size() - 1) % 64);
     ++m_usedCount;
     return HandleT(size() - 1);
 }
@@ -93,6 +152,8 @@ template<typename HandleT, typename ElemT>
 HandleT StableVector<HandleT, ElemT>::push(ElementType&& elem)
 {
     m_elements.emplace_back(move(elem));
+    resizeUsed();
+    m_used.back() |= uint64_t(1) << ((size() - 1) % 64);
     ++m_usedCount;
     return HandleT(size() - 1);
 }
@@ -105,7 +166,20 @@ void StableVector<HandleT, ElemT>::increaseSize(HandleType upTo)
         panic("call to increaseSize() with a valid handle!");
     }
 
-    m_elements.resize(upTo.idx(), boost::none);
+    m_elements.resize(upTo.idx());
+    resizeUsed();
+}
+
+template<typename HandleT, typename ElemT>
+void StableVector<HandleT, ElemT>::increaseSizeDeleted(HandleType upTo, const ElementType& placeholder)
+{
+    if (upTo.idx() < size())
+    {
+        panic("call to increaseSizeDeleted() with a valid handle!");
+    }
+
+    m_elements.resize(upTo.idx(), placeholder);
+    resizeUsed();
 }
 
 template<typename HandleT, typename ElemT>
@@ -116,7 +190,14 @@ void StableVector<HandleT, ElemT>::increaseSize(HandleType upTo, const ElementTy
         panic("call to increaseSize() with a valid handle!");
     }
 
+    size_t oldSize = size();
     m_elements.resize(upTo.idx(), elem);
+    resizeUsed();
+    for (size_t i = oldSize; i < size(); i++)
+    {
+        m_used[i / 64] |= uint64_t(1) << (i % 64);
+    }
+    m_usedCount += size() - oldSize;
 }
 
 template <typename HandleT, typename ElemT>
@@ -130,7 +211,7 @@ void StableVector<HandleT, ElemT>::erase(HandleType handle)
 {
     checkAccess(handle);
 
-    m_elements[handle.idx()] = boost::none;
+    setUsed(handle.idx(), false);
     --m_usedCount;
 }
 
@@ -138,40 +219,42 @@ template<typename HandleT, typename ElemT>
 void StableVector<HandleT, ElemT>::clear()
 {
     m_elements.clear();
+    m_used.clear();
+    m_usedCount = 0;
 }
 
 template<typename HandleT, typename ElemT>
 boost::optional<ElemT&> StableVector<HandleT, ElemT>::get(HandleType handle)
 {
-    if (handle.idx() >= size() || !m_elements[handle.idx()])
+    if (handle.idx() >= size() || !isUsed(handle.idx()))
     {
         return boost::none;
     }
-    return *m_elements[handle.idx()];
+    return Storage::ref(m_elements[handle.idx()]);
 }
 
 template<typename HandleT, typename ElemT>
 boost::optional<const ElemT&> StableVector<HandleT, ElemT>::get(HandleType handle) const
 {
-    if (handle.idx() >= size() || !m_elements[handle.idx()])
+    if (handle.idx() >= size() || !isUsed(handle.idx()))
     {
         return boost::none;
     }
-    return *m_elements[handle.idx()];
+    return Storage::ref(m_elements[handle.idx()]);
 }
 
 template<typename HandleT, typename ElemT>
 ElemT& StableVector<HandleT, ElemT>::operator[](HandleType handle)
 {
     checkAccess(handle);
-    return *m_elements[handle.idx()];
+    return Storage::ref(m_elements[handle.idx()]);
 }
 
 template<typename HandleT, typename ElemT>
 const ElemT& StableVector<HandleT, ElemT>::operator[](HandleType handle) const
 {
     checkAccess(handle);
-    return *m_elements[handle.idx()];
+    return Storage::ref(m_elements[handle.idx()]);
 }
 
 template<typename HandleT, typename ElemT>
@@ -196,9 +279,10 @@ void StableVector<HandleT, ElemT>::set(HandleType handle, const ElementType& ele
     }
 
     // insert element
-    if (!m_elements[handle.idx()])
+    if (!isUsed(handle.idx()))
     {
         ++m_usedCount;
+        setUsed(handle.idx(), true);
     }
     m_elements[handle.idx()] = elem;
 };
@@ -213,39 +297,80 @@ void StableVector<HandleT, ElemT>::set(HandleType handle, ElementType&& elem)
     }
 
     // insert element
-    if (!m_elements[handle.idx()])
+    if (!isUsed(handle.idx()))
     {
         ++m_usedCount;
+        setUsed(handle.idx(), true);
     }
-    m_elements[handle.idx()] = elem;
+    m_elements[handle.idx()] = move(elem);
 };
 
 template<typename HandleT, typename ElemT>
 void StableVector<HandleT, ElemT>::reserve(size_t newCap)
 {
     m_elements.reserve(newCap);
+    m_used.reserve((newCap + 63) / 64);
 };
 
+template<typename HandleT, typename ElemT>
+void StableVector<HandleT, ElemT>::shrinkToFit()
+{
+    m_elements.shrink_to_fit();
+    m_used.shrink_to_fit();
+}
+
+template<typename HandleT, typename ElemT>
+vector<Index> StableVector<HandleT, ElemT>::compact()
+{
+    vector<Index> newIndices(size(), std::numeric_limits<Index>::max());
+
+    size_t next = 0;
+    for (size_t i = 0; i < size(); i++)
+    {
+        if (isUsed(i))
+        {
+            if (i != next)
+            {
+                m_elements[next] = move(m_elements[i]);
+            }
+            newIndices[i] = next;
+            next++;
+        }
+    }
+
+    // Elements can't be default constructed, so we erase instead of resize
+    m_elements.erase(m_elements.begin() + next, m_elements.end());
+    m_used.assign((next + 63) / 64, ~uint64_t(0));
+    if (next % 64 != 0)
+    {
+        m_used.back() = (uint64_t(1) << (next % 64)) - 1;
+    }
+    shrinkToFit();
+
+    return newIndices;
+}
+
 template<typename HandleT, typename ElemT>
 StableVectorIterator<HandleT, ElemT> StableVector<HandleT, ElemT>::begin() const
 {
-    return StableVectorIterator<HandleT, ElemT>(&this->m_elements);
+    return StableVectorIterator<HandleT, ElemT>(&this->m_elements, &this->m_used);
 }
 
 template<typename HandleT, typename ElemT>
 StableVectorIterator<HandleT, ElemT> StableVector<HandleT, ElemT>::end() const
 {
-    return StableVectorIterator<HandleT, ElemT>(&this->m_elements, true);
+    return StableVectorIterator<HandleT, ElemT>(&this->m_elements, &this->m_used, true);
 }
 
 template<typename HandleT, typename ElemT>
 StableVectorIterator<HandleT, ElemT>::StableVectorIterator(
-    const vector<boost::optional<ElemT>>* deleted,
+    const vector<StoredType>* elements,
+    const vector<uint64_t>* used,
     bool startAtEnd
 )
-    : m_elements(deleted), m_pos(startAtEnd ? deleted->size() : 0)
+    : m_elements(elements), m_used(used), m_pos(startAtEnd ? elements->size() : 0)
 {
-    if (m_pos == 0 && !m_elements->empty() && !(*m_elements)[0])
+    if (m_pos == 0 && !m_elements->empty() && !((*m_used)[0] & 1))
     {
         ++(*this);
     }
@@ -262,6 +387,7 @@ StableVectorIterator<HandleT, ElemT>& StableVectorIterator<HandleT, ElemT>::oper
     }
     m_pos = other.m_pos;
     m_elements = other.m_elements;
+    m_used = other.m_used;
 
     return *this;
 }
@@ -285,18 +411,36 @@ bool StableVectorIterator<HandleT, ElemT>::operator!=(
 template<typename HandleT, typename ElemT>
 StableVectorIterator<HandleT, ElemT>& StableVectorIterator<HandleT, ElemT>::operator++()
 {
+    size_t size = m_elements->size();
+
     // If not at the end, advance by one element
-    if (m_pos < m_elements->size())
+    if (m_pos < size)
     {
         m_pos++;
     }
 
-    // Advance until the next element, at most 1 element behind the vector, to
-    // indicate the end of iteration.
-    while (m_pos < m_elements->size() && !(*m_elements)[m_pos])
+    // Advance to the next set bit, skipping whole words of deleted elements.
+    // Bits behind the last element are never set, so reaching the end of the
+    // bitset means the end of iteration.
+    size_t word = m_pos / 64;
+    if (m_pos >= size || word >= m_used->size())
     {
-        m_pos++;
+        m_pos = size;
+        return *this;
+    }
+
+    uint64_t bits = (*m_used)[word] & (~uint64_t(0) << (m_pos % 64));
+    while (bits == 0)
+    {
+        word++;
+        if (word >= m_used->size())
+        {
+            m_pos = size;
+            return *this;
+        }
+        bits = (*m_used)[word];
     }
+    m_pos = std::min(word * 64 + stable_vector_detail::countTrailingZeros(bits), size);
 
     return *this;
 }
@@ -111,6 +111,16 @@ public:
      */
     void reserve(size_t newCap);
 
+    /**
+     * @brief Stores `value` for every key below `countElements`, replacing
+     *        all values stored before.
+     *
+     * As no key has to be inserted afterwards, several threads can then
+     * overwrite the values of different keys through `operator[]` without
+     * any locking.
+     */
+    void fill(size_t countElements, const ValueT& value);
+
 private:
     /// The underlying storage
     StableVector<HandleT, ValueT> m_vec;
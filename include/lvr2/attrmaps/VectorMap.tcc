@@ -68,7 +68,7 @@ boost::optional<ValueT> VectorMap<HandleT, ValueT>::insert(HandleT key, const Va
     // If the vector isn't large enough yet, we allocate additional space.
     if (key.idx() >= m_vec.size())
     {
-        m_vec.increaseSize(key);
+        m_vec.increaseSizeDeleted(key, value);
         m_vec.push(value);
         return boost::none;
     }
@@ -153,6 +153,12 @@ void VectorMap<HandleT, ValueT>::reserve(size_t newCap)
     m_vec.reserve(newCap);
 };
 
+template<typename HandleT, typename ValueT>
+void VectorMap<HandleT, ValueT>::fill(size_t countElements, const ValueT& value)
+{
+    m_vec = StableVector<HandleT, ValueT>(countElements, value);
+}
+
 
 template<typename HandleT, typename ValueT>
 VectorMapIterator<HandleT, ValueT>::VectorMapIterator(StableVectorIterator<HandleT, ValueT> iter)
@@ -51,6 +51,12 @@ public:
 
 	/// Enables the maximum number of parallel threads
 	static void setMaxNumThreads();
+
+	/// Returns the maximum number of nested active parallel regions (or 1 if OpenMP is not supported)
+	static int  getMaxActiveLevels();
+
+	/// Sets the maximum number of nested active parallel regions if OpenMP is used for parallelization
+	static void setMaxActiveLevels(int levels);
 };
 
 } // namespace lvr2
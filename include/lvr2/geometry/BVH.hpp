@@ -51,9 +51,11 @@ namespace lvr2
  * @brief Implementation of an Bounding Volume Hierarchy Tree used for ray casting
  *
  * This class generates a BVHTree from the given triangle mesh represented by vertices and faces. AABB are used as
- * bounding volumes. The Tree Contains inner nodes and leaf nodes. The leaf nodes are grouped into inner nodes using
- * the surface area heuristic. The tree is represented in two ways: the normal tree structure and the cache friendly
- * index representation.
+ * bounding volumes. The Tree Contains inner nodes and leaf nodes. The triangles are split into inner nodes using
+ * the binned surface area heuristic. The tree is built directly into its cache friendly index representation,
+ * the top levels of the tree are built in parallel.
+ *
+ * Triangle ids in the leaves are the face ids of the mesh. Malformed faces are not part of the tree.
  *
  * @tparam BaseVecT
  */
@@ -83,6 +85,22 @@ public:
      */
     BVHTree(const MeshBufferPtr mesh);
 
+    /**
+     * @brief Restores a tree from its cache friendly representation, e.g. after loading it from a file.
+     *        The arguments have the layout returned by the corresponding getters.
+     *
+     * @param limits Boundaries of the AABB of all nodes
+     * @param indexesOrTrilists Four values per node
+     * @param triIndexList Index list of triangles in the leaf nodes
+     * @param trianglesIntersectionData 16 values per triangle
+     */
+    BVHTree(
+        vector<float> limits,
+        vector<uint32_t> indexesOrTrilists,
+        vector<uint32_t> triIndexList,
+        vector<float> trianglesIntersectionData
+    );
+
     /**
      * @return Index list (for getTrianglesIntersectionData) of triangles in the leaf nodes
      */
@@ -108,7 +126,7 @@ public:
     /**
      * @brief Returns precalculated values for the triangle intersection tests
      *
-     * @return 16 values per triangle:
+     * @return 16 values per face of the mesh (zero for malformed faces):
      *      1-3: x, y, z of normal
      *      4: normal.dot(point1)
      *      5-7: x, y, z of edge plane vector 1
@@ -123,67 +141,36 @@ public:
 
 private:
 
-    // Internal triangle representation
-    struct Triangle {
-
-        Triangle();
-
-        // indices in vertex array
-        // todo: not used?
-        uint32_t idx1;
-        uint32_t idx2;
-        uint32_t idx3;
-
-        BaseVecT center;
-        Normal<float> normal;
-
-        // intersection pre-computed cache
-        float d, d1, d2, d3;
-        Normal<float> e1, e2, e3;
-
-        // todo: not used?
-        BoundingBox<BaseVecT> bb;
+    // Bounds and centroid of a triangle, only needed during construction
+    struct BuildPrimitive {
+        float min[3];
+        float max[3];
+        float center[3];
     };
 
-    // Internal AABB representation
-    struct AABB {
-        BoundingBox<BaseVecT> bb;
-
-        // Triangles corresponding to this AABB
-        vector<size_t> triangles;
+    // Node of the flat tree during construction. Holds one entry of m_limits and m_indexesOrTrilists.
+    struct BuildNode {
+        float limits[6];
+        uint32_t indexesOrTrilists[4];
     };
 
-    // Abstract tree node
-    struct BVHNode {
-        BoundingBox<BaseVecT> bb;
-        virtual bool isLeaf() = 0;
+    // Bin of the binned surface area heuristic
+    struct Bin {
+        float limits[6];
+        uint32_t count;
     };
-    using BVHNodePtr = unique_ptr<BVHNode>;
 
-    // Inner tree node
-    struct BVHInner: BVHNode {
+    // Number of bins per axis used to evaluate split candidates
+    static constexpr int NumBins = 32;
 
-        // Left sub tree
-        BVHNodePtr left;
+    // Nodes with less triangles always become leaves
+    static constexpr uint32_t MinLeafSize = 4;
 
-        // Right sub tree
-        BVHNodePtr right;
-        virtual bool isLeaf() { return false; }
-    };
-    using BVHInnerPtr = unique_ptr<BVHInner>;
+    // Nodes with more triangles are split at the median, if no SAH split is found
+    static constexpr uint32_t MaxLeafSize = 16;
 
-    // Leaf tree node
-    struct BVHLeaf: BVHNode {
-
-        // Triangles corresponding to this leaf node
-        vector<size_t> triangles;
-        virtual bool isLeaf() { return true; }
-    };
-    using BVHLeafPtr = unique_ptr<BVHLeaf>;
-
-    // working variables for tree construction
-    BVHNodePtr m_root;
-    vector<Triangle> m_triangles;
+    // Nodes with more triangles are built in parallel OpenMP tasks
+    static constexpr uint32_t ParallelBuildSize = 4096;
 
     // cache friendly data for the SIMD device
     vector<uint32_t> m_triIndexList;
@@ -192,56 +179,49 @@ private:
     vector<float> m_trianglesIntersectionData;
 
     /**
-     * @brief Builds the tree without it's cache friendly representation. Utilizes the buildTreeRecursive method.
+     * @brief Calculates the intersection data for all faces and the bounds of all well formed faces.
+     *        Fills m_trianglesIntersectionData and m_triIndexList.
      *
      * @param vertices Vertices of mesh to create tree for
+     * @param n_vertices Number of vertices, faces referencing other vertices are skipped
      * @param faces Faces of mesh to create tree for
-     *
-     * @return Root node of the tree
+     * @param n_faces Number of faces
+     * @param primitives Bounds of the faces, indexed by face id
      */
-    BVHNodePtr buildTree(const vector<float>& vertices, const vector<uint32_t>& faces);
-
-    /**
-     * @brief Builds the tree without it's cache friendly representation. Utilizes the buildTreeRecursive method.
-     *
-     * @param vertices Vertices of mesh to create tree for
-     * @param faces Faces of mesh to create tree for
-     *
-     * @return Root node of the tree
-     */
-    BVHNodePtr buildTree(
-        const floatArr vertices, size_t n_vertices,
-        const indexArray faces, size_t n_faces
+    void precomputeTriangles(
+        const float* vertices,
+        size_t n_vertices,
+        const uint32_t* faces,
+        size_t n_faces,
+        vector<BuildPrimitive>& primitives
     );
 
     /**
-     * @brief Recursive method to build the tree.
+     * @brief Builds the cache friendly tree from the triangles referenced by m_triIndexList.
+     *        Utilizes the buildTreeRecursive method.
      *
-     * @param work The current work queue to generate the tree from
-     * @param depth The current depth of the tree
-     *
-     * @return Root node of the current tree
-     */
-    BVHNodePtr buildTreeRecursive(vector<AABB>& work, uint32_t depth = 0);
-
-    /**
-     * @brief Creates the cache friendly representation of the tree. Needs the tree itself!
+     * @param primitives Bounds of the faces, indexed by face id
      */
-    void createCFTree();
+    void buildTree(const vector<BuildPrimitive>& primitives);
 
     /**
-     * @brief Recursive method for cache friendly tree creation.
+     * @brief Recursive method to build the tree. Partitions the range [begin, end) of m_triIndexList
+     *        in place and appends the nodes of the sub tree to nodes in depth first order.
+     *        Child indices are relative to the first node of the sub tree.
      *
-     * @param currentNode Current node to convert to it's cache friendly form
-     * @param idxBoxes Number of boxes created for the current tree. This has to be increased every time a box
-     *        is processed.
+     * @param primitives Bounds of the faces, indexed by face id
+     * @param begin First index of the sub tree in m_triIndexList
+     * @param end Last index + 1 of the sub tree in m_triIndexList
+     * @param bounds Bounding box of the triangles in the range
+     * @param nodes Output list of nodes
      */
-    void createCFTreeRecursive(BVHNodePtr currentNode, uint32_t& idxBoxes);
-
-    /**
-     * @brief Converts the precalculated triangle intersection data to a SIMD friendly structure
-     */
-    void convertTrianglesIntersectionData();
+    void buildTreeRecursive(
+        const vector<BuildPrimitive>& primitives,
+        uint32_t begin,
+        uint32_t end,
+        const float* bounds,
+        vector<BuildNode>& nodes
+    );
 };
 
 } /* namespace lvr2 */
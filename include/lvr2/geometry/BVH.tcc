@@ -32,6 +32,7 @@
  *  @author Johan M. von Behren <johan@vonbehren.eu>
  */
 
+#include <algorithm>
 #include <limits>
 
 using std::make_unique;
@@ -41,28 +42,54 @@ using std::move;
 namespace lvr2
 {
 
-template<typename BaseVecT>
-BVHTree<BaseVecT>::Triangle::Triangle()
-    : idx1(0)
-    , idx2(0)
-    , idx3(0)
-    , center(0, 0, 0)
-    , normal(0, 1, 0)
-    , d(0.0f)
-    , d1(0.0f)
-    , d2(0.0f)
-    , d3(0.0f)
-    , e1(0, 1, 0)
-    , e2(0, 1, 0)
-    , e3(0, 1, 0)
-    , bb()
-{}
+namespace bvh_detail
+{
+
+// Limits are stored as min x, max x, min y, max y, min z, max z
+
+inline void clearLimits(float* limits)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        limits[axis * 2] = std::numeric_limits<float>::max();
+        limits[axis * 2 + 1] = -std::numeric_limits<float>::max();
+    }
+}
+
+inline void expandLimits(float* limits, const float* min, const float* max)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        limits[axis * 2] = std::min(limits[axis * 2], min[axis]);
+        limits[axis * 2 + 1] = std::max(limits[axis * 2 + 1], max[axis]);
+    }
+}
+
+inline void expandLimits(float* limits, const float* other)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        limits[axis * 2] = std::min(limits[axis * 2], other[axis * 2]);
+        limits[axis * 2 + 1] = std::max(limits[axis * 2 + 1], other[axis * 2 + 1]);
+    }
+}
+
+inline float halfArea(const float* limits)
+{
+    float x = limits[1] - limits[0];
+    float y = limits[3] - limits[2];
+    float z = limits[5] - limits[4];
+    return x * y + y * z + z * x;
+}
+
+} // namespace bvh_detail
 
 template<typename BaseVecT>
 BVHTree<BaseVecT>::BVHTree(const vector<float>& vertices, const vector<uint32_t>& faces)
 {
-    m_root = buildTree(vertices, faces);
-    createCFTree();
+    vector<BuildPrimitive> primitives;
+    precomputeTriangles(vertices.data(), vertices.size() / 3, faces.data(), faces.size() / 3, primitives);
+    buildTree(primitives);
 }
 
 template<typename BaseVecT>
@@ -70,8 +97,9 @@ BVHTree<BaseVecT>::BVHTree(
     const floatArr vertices, size_t n_vertices,
     const indexArray faces, size_t n_faces)
 {
-    m_root = buildTree(vertices, n_vertices, faces, n_faces);
-    createCFTree();
+    vector<BuildPrimitive> primitives;
+    precomputeTriangles(vertices.get(), n_vertices, faces.get(), n_faces, primitives);
+    buildTree(primitives);
 }
 
 template<typename BaseVecT>
@@ -85,35 +113,48 @@ BVHTree<BaseVecT>::BVHTree(const MeshBufferPtr mesh)
 }
 
 template<typename BaseVecT>
-typename BVHTree<BaseVecT>::BVHNodePtr BVHTree<BaseVecT>::buildTree(
-    const vector<float>& vertices,
-    const vector<uint32_t>& faces
+BVHTree<BaseVecT>::BVHTree(
+    vector<float> limits,
+    vector<uint32_t> indexesOrTrilists,
+    vector<uint32_t> triIndexList,
+    vector<float> trianglesIntersectionData)
+:m_triIndexList(move(triIndexList))
+,m_limits(move(limits))
+,m_indexesOrTrilists(move(indexesOrTrilists))
+,m_trianglesIntersectionData(move(trianglesIntersectionData))
+{
+
+}
+
+template<typename BaseVecT>
+void BVHTree<BaseVecT>::precomputeTriangles(
+    const float* vertices,
+    size_t n_vertices,
+    const uint32_t* faces,
+    size_t n_faces,
+    vector<BuildPrimitive>& primitives
 )
 {
-    vector<AABB> work;
-    work.reserve(faces.size() / 3);
-    m_triangles.reserve(faces.size() / 3);
+    using CoordT = typename BaseVecT::CoordType;
 
-    BoundingBox<BaseVecT> outerBb;
+    const uint32_t sizePerTriangle = 4 + 4 + 4 + 4;
+    m_trianglesIntersectionData.assign(n_faces * sizePerTriangle, 0.0f);
+    primitives.resize(n_faces);
+    vector<uint8_t> wellFormed(n_faces, 0);
 
-    // Iterate over all faces and create an AABB for all of them
-    for (size_t i = 0; i < faces.size(); i += 3)
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n_faces; i++)
     {
-        // Convert raw float data into objects
-        BaseVecT point1;
-        point1.x = vertices[faces[i]*3];
-        point1.y = vertices[faces[i]*3+1];
-        point1.z = vertices[faces[i]*3+2];
-
-        BaseVecT point2;
-        point2.x = vertices[faces[i+1]*3];
-        point2.y = vertices[faces[i+1]*3+1];
-        point2.z = vertices[faces[i+1]*3+2];
+        const uint32_t* face = faces + i * 3;
+        if (face[0] >= n_vertices || face[1] >= n_vertices || face[2] >= n_vertices)
+        {
+            continue;
+        }
 
-        BaseVecT point3;
-        point3.x = vertices[faces[i+2]*3];
-        point3.y = vertices[faces[i+2]*3+1];
-        point3.z = vertices[faces[i+2]*3+2];
+        // Convert raw float data into objects
+        BaseVecT point1(vertices[face[0]*3], vertices[face[0]*3+1], vertices[face[0]*3+2]);
+        BaseVecT point2(vertices[face[1]*3], vertices[face[1]*3+1], vertices[face[1]*3+2]);
+        BaseVecT point3(vertices[face[2]*3], vertices[face[2]*3+1], vertices[face[2]*3+2]);
 
         // Precalculate intersection test data for faces
         auto vc1 = point2 - point1;
@@ -128,478 +169,305 @@ typename BVHTree<BaseVecT>::BVHNodePtr BVHTree<BaseVecT>::buildTree(
         {
             continue;
         }
-
-        BoundingBox<BaseVecT> faceBb;
-        faceBb.expand(point1);
-        faceBb.expand(point2);
-        faceBb.expand(point3);
-
-        // Create triangles from faces for internal usage
-        Triangle triangle;
-        triangle.bb = faceBb;
-        triangle.center = BaseVecT((point1.asVector() + point2.asVector() + point3.asVector()) / 3.0f);
-        triangle.idx1 = faces[i];
-        triangle.idx2 = faces[i+1];
-        triangle.idx3 = faces[i+2];
+        wellFormed[i] = 1;
 
         // pick best normal
-        Normal<typename BaseVecT::CoordType> normal1(cross1);
-        Normal<typename BaseVecT::CoordType> normal2(cross2);
-        Normal<typename BaseVecT::CoordType> normal3(cross3);
-        auto bestNormal = normal1;
-        if (normal2.length() > bestNormal.length())
+        Normal<CoordT> normal(cross1);
+        Normal<CoordT> normal2(cross2);
+        Normal<CoordT> normal3(cross3);
+        if (normal2.length() > normal.length())
         {
-            bestNormal = normal2;
+            normal = normal2;
         }
-        if (normal3.length() > bestNormal.length())
+        if (normal3.length() > normal.length())
         {
-            bestNormal = normal3;
+            normal = normal3;
         }
-        triangle.normal = Normal<typename BaseVecT::CoordType>(bestNormal);
-
-        triangle.d = triangle.normal.dot(point1);
 
         // calc edge planes for intersection tests
-        triangle.e1 = Normal<typename BaseVecT::CoordType>(triangle.normal.cross(vc1));
-        triangle.d1 = triangle.e1.dot(point1);
-
-        triangle.e2 = Normal<typename BaseVecT::CoordType>(triangle.normal.cross(vc2));
-        triangle.d2 = triangle.e2.dot(point2);
-
-        triangle.e3 = Normal<typename BaseVecT::CoordType>(triangle.normal.cross(vc3));
-        triangle.d3 = triangle.e3.dot(point3);
-
-        // Create AABB and add current triangle (face) to it
-        AABB aabb;
-        aabb.bb = faceBb;
-        aabb.triangles.push_back(m_triangles.size());
-        m_triangles.push_back(triangle);
-
-        outerBb.expand(faceBb);
-        work.push_back(aabb);
+        Normal<CoordT> e1(normal.cross(vc1));
+        Normal<CoordT> e2(normal.cross(vc2));
+        Normal<CoordT> e3(normal.cross(vc3));
+
+        float* data = m_trianglesIntersectionData.data() + i * sizePerTriangle;
+        data[0] = normal.getX();
+        data[1] = normal.getY();
+        data[2] = normal.getZ();
+        data[3] = normal.dot(point1);
+
+        data[4] = e1.getX();
+        data[5] = e1.getY();
+        data[6] = e1.getZ();
+        data[7] = e1.dot(point1);
+
+        data[8] = e2.getX();
+        data[9] = e2.getY();
+        data[10] = e2.getZ();
+        data[11] = e2.dot(point2);
+
+        data[12] = e3.getX();
+        data[13] = e3.getY();
+        data[14] = e3.getZ();
+        data[15] = e3.dot(point3);
+
+        // bounding box and its centroid for the tree construction
+        BuildPrimitive& primitive = primitives[i];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            primitive.min[axis] = std::min({point1[axis], point2[axis], point3[axis]});
+            primitive.max[axis] = std::max({point1[axis], point2[axis], point3[axis]});
+            primitive.center[axis] = (primitive.min[axis] + primitive.max[axis]) * 0.5f;
+        }
     }
 
-    // Create the tree recursively from the list of AABBs
-
-    BVHTree<BaseVecT>::BVHNodePtr out;
-
-    #pragma omp parallel
-    #pragma omp single nowait
-    out = buildTreeRecursive(work);
-    
-    std::cout << "end building." << std::endl;
-    out->bb = outerBb;
-
-    return out;
+    // Only well formed faces are inserted into the tree
+    m_triIndexList.clear();
+    m_triIndexList.reserve(n_faces);
+    for (size_t i = 0; i < n_faces; i++)
+    {
+        if (wellFormed[i])
+        {
+            m_triIndexList.push_back(static_cast<uint32_t>(i));
+        }
+    }
 }
 
-
 template<typename BaseVecT>
-typename BVHTree<BaseVecT>::BVHNodePtr BVHTree<BaseVecT>::buildTree(
-    const floatArr vertices, size_t n_vertices,
-    const indexArray faces, size_t n_faces
-)
+void BVHTree<BaseVecT>::buildTree(const vector<BuildPrimitive>& primitives)
 {
-    vector<AABB> work;
-    work.reserve(n_faces);
-    m_triangles.reserve(n_faces);
-
-    BoundingBox<BaseVecT> outerBb;
-    // Iterate over all faces and create an AABB for all of them
-    for (size_t i = 0; i < n_faces*3; i += 3)
+    float bounds[6];
+    bvh_detail::clearLimits(bounds);
+    for (uint32_t idx: m_triIndexList)
     {
-        // Convert raw float data into objects
-        BaseVecT point1;
-        point1.x = vertices[faces[i]*3];
-        point1.y = vertices[faces[i]*3+1];
-        point1.z = vertices[faces[i]*3+2];
-
-        BaseVecT point2;
-        point2.x = vertices[faces[i+1]*3];
-        point2.y = vertices[faces[i+1]*3+1];
-        point2.z = vertices[faces[i+1]*3+2];
-
-        BaseVecT point3;
-        point3.x = vertices[faces[i+2]*3];
-        point3.y = vertices[faces[i+2]*3+1];
-        point3.z = vertices[faces[i+2]*3+2];
-
-        // Precalculate intersection test data for faces
-        auto vc1 = point2 - point1;
-        auto vc2 = point3 - point2;
-        auto vc3 = point1 - point3;
-
-        // skip malformed faces
-        auto cross1 = vc1.cross(vc2);
-        auto cross2 = vc2.cross(vc3);
-        auto cross3 = vc3.cross(vc1);
-        if (cross1.length() == 0 || cross2.length() == 0 || cross3.length() == 0)
-        {
-            continue;
-        }
-
-        BoundingBox<BaseVecT> faceBb;
-        faceBb.expand(point1);
-        faceBb.expand(point2);
-        faceBb.expand(point3);
-
-        // Create triangles from faces for internal usage
-        Triangle triangle;
-        triangle.bb = faceBb;
-        triangle.center = (point1 + point2 + point3) / 3.0f;
-        triangle.idx1 = faces[i];
-        triangle.idx2 = faces[i+1];
-        triangle.idx3 = faces[i+2];
-
-        // pick best normal
-        typename BaseVecT::CoordType test = 2.0;
-        Normal<typename BaseVecT::CoordType> normal1(cross1);
-        Normal<typename BaseVecT::CoordType> normal2(cross2);
-        Normal<typename BaseVecT::CoordType> normal3(cross3);
-        auto bestNormal = normal1;
-        if (normal2.length() > bestNormal.length())
-        {
-            bestNormal = normal2;
-        }
-        if (normal3.length() > bestNormal.length())
-        {
-            bestNormal = normal3;
-        }
-        triangle.normal = Normal<typename BaseVecT::CoordType>(bestNormal);
-
-        triangle.d = triangle.normal.dot(point1);
-
-        // calc edge planes for intersection tests
-        triangle.e1 = Normal<typename BaseVecT::CoordType>(triangle.normal.cross(vc1));
-        triangle.d1 = triangle.e1.dot(point1);
-
-        triangle.e2 = Normal<typename BaseVecT::CoordType>(triangle.normal.cross(vc2));
-        triangle.d2 = triangle.e2.dot(point2);
-
-        triangle.e3 = Normal<typename BaseVecT::CoordType>(triangle.normal.cross(vc3));
-        triangle.d3 = triangle.e3.dot(point3);
-
-        // Create AABB and add current triangle (face) to it
-        AABB aabb;
-        aabb.bb = faceBb;
-        aabb.triangles.push_back(m_triangles.size());
-        m_triangles.push_back(triangle);
-
-        outerBb.expand(faceBb);
-        work.push_back(aabb);
+        bvh_detail::expandLimits(bounds, primitives[idx].min, primitives[idx].max);
     }
 
+    vector<BuildNode> nodes;
+    nodes.reserve(2 * (m_triIndexList.size() / MinLeafSize) + 1);
 
-    // Create the tree recursively from the list of AABBs
-    BVHTree<BaseVecT>::BVHNodePtr out;
     #pragma omp parallel
     #pragma omp single nowait
-    out = buildTreeRecursive(work);
+    buildTreeRecursive(primitives, 0, static_cast<uint32_t>(m_triIndexList.size()), bounds, nodes);
 
-    out->bb = outerBb;
+    // Convert nodes to the SIMD friendly format
+    m_limits.resize(nodes.size() * 6);
+    m_indexesOrTrilists.resize(nodes.size() * 4);
 
-    return out;
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        std::copy(nodes[i].limits, nodes[i].limits + 6, m_limits.begin() + i * 6);
+        std::copy(nodes[i].indexesOrTrilists, nodes[i].indexesOrTrilists + 4, m_indexesOrTrilists.begin() + i * 4);
+    }
 }
 
 template<typename BaseVecT>
-typename BVHTree<BaseVecT>::BVHNodePtr BVHTree<BaseVecT>::buildTreeRecursive(vector<AABB>& work, uint32_t depth)
+void BVHTree<BaseVecT>::buildTreeRecursive(
+    const vector<BuildPrimitive>& primitives,
+    uint32_t begin,
+    uint32_t end,
+    const float* bounds,
+    vector<BuildNode>& nodes
+)
 {
+    const uint32_t count = end - begin;
+    uint32_t* tris = m_triIndexList.data();
+
+    // Nodes are referenced by index, the vector may grow during recursion
+    const size_t nodeIdx = nodes.size();
+    nodes.emplace_back();
+    std::copy(bounds, bounds + 6, nodes[nodeIdx].limits);
+
+    auto makeLeaf = [&]()
+    {
+        uint32_t* leaf = nodes[nodeIdx].indexesOrTrilists;
+        leaf[0] = 0x80000000 | count;
+        leaf[1] = 0;
+        leaf[2] = 0;
+        leaf[3] = begin;
+    };
+
     // terminate recursion, if work size is small enough
-    if (work.size() < 4)
+    if (count < MinLeafSize)
+    {
+        makeLeaf();
+        return;
+    }
+
+    // Bins are distributed over the bounding box of the centroids
+    float centerMin[3], centerMax[3];
+    for (int axis = 0; axis < 3; axis++)
     {
-        // Create a leaf node and add all remaining triangles into it
-        auto leaf = make_unique<BVHLeaf>();
-        for (auto aabb: work)
+        centerMin[axis] = std::numeric_limits<float>::max();
+        centerMax[axis] = -std::numeric_limits<float>::max();
+    }
+    for (uint32_t i = begin; i < end; i++)
+    {
+        const float* center = primitives[tris[i]].center;
+        for (int axis = 0; axis < 3; axis++)
         {
-            leaf->triangles.reserve(aabb.triangles.size());
-            for (auto triangle: aabb.triangles)
-            {
-                leaf->triangles.push_back(triangle);
-            }
+            centerMin[axis] = std::min(centerMin[axis], center[axis]);
+            centerMax[axis] = std::max(centerMax[axis], center[axis]);
         }
-        return move(leaf);
     }
 
-    // divide node into smaller nodes
-    BoundingBox<BaseVecT> bb;
-    for (auto aabb: work)
+    float binScale[3];
+    for (int axis = 0; axis < 3; axis++)
     {
-        bb.expand(aabb.bb);
+        float extent = centerMax[axis] - centerMin[axis];
+        binScale[axis] = extent > 0 ? NumBins / extent : 0.0f;
     }
 
-    // SAH, surface area heuristic calculation
-    float minCost =
-        work.size() * (bb.getXSize() * bb.getYSize() + bb.getYSize() * bb.getZSize() + bb.getZSize() * bb.getXSize());
+    auto binIndex = [&](uint32_t tri, int axis)
+    {
+        int bin = static_cast<int>((primitives[tri].center[axis] - centerMin[axis]) * binScale[axis]);
+        return std::min(bin, NumBins - 1);
+    };
 
-    auto bestSplit = numeric_limits<typename BaseVecT::CoordType>::max();
+    // SAH, surface area heuristic calculation. Keeping all triangles in one leaf is the cost to beat.
+    float minCost = count * bvh_detail::halfArea(bounds);
     int bestAxis = -1;
+    int bestBin = 0;
 
     // try all 3 axises X = 0, Y = 1, Z = 2
-    for (uint8_t j = 0; j < 3; j++)
+    for (int axis = 0; axis < 3; axis++)
     {
-        auto axis = j;
-        float start, stop, step;
-
-        if (axis == 0)
+        if (binScale[axis] == 0.0f)
         {
-            start = bb.getMin().x;
-            stop = bb.getMax().x;
+            // all centroids are in one plane, we must move to a different axis
+            continue;
         }
-        else if(axis == 1)
+
+        Bin bins[NumBins];
+        for (Bin& bin: bins)
         {
-            start = bb.getMin().y;
-            stop = bb.getMax().y;
+            bvh_detail::clearLimits(bin.limits);
+            bin.count = 0;
         }
-        else
+
+        for (uint32_t i = begin; i < end; i++)
         {
-            start = bb.getMin().z;
-            stop = bb.getMax().z;
+            const BuildPrimitive& primitive = primitives[tris[i]];
+            Bin& bin = bins[binIndex(tris[i], axis)];
+            bvh_detail::expandLimits(bin.limits, primitive.min, primitive.max);
+            bin.count++;
         }
 
-        if (fabs(stop - start) < 1e-4)
+        // Sweep from the right to get the cost of all right sides
+        float rightArea[NumBins];
+        uint32_t rightCount[NumBins];
+        Bin accum;
+        bvh_detail::clearLimits(accum.limits);
+        accum.count = 0;
+        for (int b = NumBins - 1; b > 0; b--)
         {
-            // bb side along this axis too short, we must move to a different axis
-            continue;
+            bvh_detail::expandLimits(accum.limits, bins[b].limits);
+            accum.count += bins[b].count;
+            rightArea[b] = bvh_detail::halfArea(accum.limits);
+            rightCount[b] = accum.count;
         }
 
-        step = (stop - start) / (1024.0f / (depth + 1.0f));
-
-        for (float testSplit = start + step; testSplit < stop - step; testSplit += step)
+        // Sweep from the left, splitting before bin b
+        bvh_detail::clearLimits(accum.limits);
+        accum.count = 0;
+        for (int b = 1; b < NumBins; b++)
         {
-            // create left and right bb
-            BoundingBox<BaseVecT> lBb;
-            BoundingBox<BaseVecT> rBb;
-
-            int countLeft = 0, countRight = 0;
-
-            for (size_t i = 0; i < work.size(); i++)
-            {
-                auto& v = work[i];
-
-                float value;
-                if (axis == 0)
-                {
-                    value = v.bb.getCentroid().x;
-                }
-                else if (axis == 1)
-                {
-                    value = v.bb.getCentroid().y;
-                }
-                else
-                {
-                    value = v.bb.getCentroid().z;
-                }
-
-                if (value < testSplit)
-                {
-                    lBb.expand(v.bb);
-                    countLeft++;
-                }
-                else
-                {
-                    rBb.expand(v.bb);
-                    countRight++;
-                }
-            }
-
-            // Skipt to small values
-            if (countLeft <= 1 || countRight <= 1)
+            bvh_detail::expandLimits(accum.limits, bins[b - 1].limits);
+            accum.count += bins[b - 1].count;
+            if (accum.count == 0 || rightCount[b] == 0)
             {
                 continue;
             }
 
-            // Calc surface for left and right box
-            float surfaceLeft =
-                lBb.getXSize() * lBb.getYSize() + lBb.getYSize() * lBb.getZSize() + lBb.getZSize() * lBb.getXSize();
-            float surfaceRight =
-                lBb.getXSize() * rBb.getYSize() + rBb.getYSize() * rBb.getZSize() + rBb.getZSize() * rBb.getXSize();
-
-            // Check if new best split was found
-            float totalCost = surfaceLeft * countLeft + surfaceRight * countRight;
+            float totalCost = bvh_detail::halfArea(accum.limits) * accum.count + rightArea[b] * rightCount[b];
             if (totalCost < minCost)
             {
                 minCost = totalCost;
-                bestSplit = testSplit;
                 bestAxis = axis;
+                bestBin = b;
             }
         }
     }
 
-    // If no good split was found, create a leaf node and copy all remaining triangles into it
-    if (bestAxis == -1)
+    uint32_t mid;
+    if (bestAxis != -1)
     {
-        auto leaf = make_unique<BVHLeaf>();
-        for (auto aabb: work)
+        mid = static_cast<uint32_t>(std::partition(tris + begin, tris + end, [&](uint32_t tri)
         {
-            leaf->triangles.reserve(aabb.triangles.size());
-            for (auto triangle: aabb.triangles)
-            {
-                leaf->triangles.push_back(triangle);
-            }
-        }
-        return move(leaf);
+            return binIndex(tri, bestAxis) < bestBin;
+        }) - tris);
     }
-
-    vector<AABB> leftWork;
-    vector<AABB> rightWork;
-    BoundingBox<BaseVecT> lBb;
-    BoundingBox<BaseVecT> rBb;
-
-    // Use the found split to split the current node into two new inner nodes
-    for (size_t i = 0; i < work.size(); i++)
+    else if (count <= MaxLeafSize)
     {
-        auto& v = work[i];
-
-        // Get the best axis centroid value
-        float value;
-        if (bestAxis == 0)
-        {
-            value = v.bb.getCentroid().x;
-        }
-        else if (bestAxis == 1)
-        {
-            value = v.bb.getCentroid().y;
-        }
-        else
-        {
-            value = v.bb.getCentroid().z;
-        }
-
-        // Create queues for left and right sub trees
-        if (value < bestSplit)
+        // No split is better than a single leaf
+        makeLeaf();
+        return;
+    }
+    else
+    {
+        // Large node without a good split (e.g. many overlapping triangles): split at the median
+        int axis = 0;
+        for (int a = 1; a < 3; a++)
         {
-            leftWork.push_back(v);
-            lBb.expand(v.bb);
+            if (centerMax[a] - centerMin[a] > centerMax[axis] - centerMin[axis])
+            {
+                axis = a;
+            }
         }
-        else
+        mid = begin + count / 2;
+        std::nth_element(tris + begin, tris + mid, tris + end, [&](uint32_t a, uint32_t b)
         {
-            rightWork.push_back(v);
-            rBb.expand(v.bb);
-        }
+            return primitives[a].center[axis] < primitives[b].center[axis];
+        });
     }
 
-    // Recursively split new sub trees into further inner or leaf nodes
-    
-    auto inner = make_unique<BVHInner>();
-
-    // #pragma omp parallel
-    // #pragma omp single nowait
-    // {
-    #pragma omp task shared(inner)
+    float lBounds[6];
+    float rBounds[6];
+    bvh_detail::clearLimits(lBounds);
+    bvh_detail::clearLimits(rBounds);
+    for (uint32_t i = begin; i < end; i++)
     {
-        inner->left = buildTreeRecursive(leftWork, depth + 1);
-        inner->left->bb = lBb;
+        const BuildPrimitive& primitive = primitives[tris[i]];
+        bvh_detail::expandLimits(i < mid ? lBounds : rBounds, primitive.min, primitive.max);
     }
-    #pragma omp task shared(inner)
-    {
-        inner->right = buildTreeRecursive(rightWork, depth + 1);
-        inner->right->bb = rBb;
-    }
-    #pragma omp taskwait
-    // }
-    
-    return move(inner);
-}
-
-template<typename BaseVecT>
-void BVHTree<BaseVecT>::createCFTree()
-{
-    m_triIndexList.reserve(m_triangles.size());
-    uint32_t idxBoxes = 0;
-    createCFTreeRecursive(move(m_root), idxBoxes);
-    convertTrianglesIntersectionData();
-}
-
-template<typename BaseVecT>
-void BVHTree<BaseVecT>::createCFTreeRecursive(BVHNodePtr currentNode, uint32_t& idxBoxes)
-{
-    // Convert bounding box limits to SIMD friendly format
-    m_limits.push_back(currentNode->bb.getMin().x);
-    m_limits.push_back(currentNode->bb.getMax().x);
-
-    m_limits.push_back(currentNode->bb.getMin().y);
-    m_limits.push_back(currentNode->bb.getMax().y);
-
-    m_limits.push_back(currentNode->bb.getMin().z);
-    m_limits.push_back(currentNode->bb.getMax().z);
-
-    // If we have an inner node
-    if (!currentNode->isLeaf())
-    {
-        BVHInnerPtr inner(dynamic_cast<BVHInner*>(currentNode.release()));
-
-        // push dummy count (0 -> inner node!)
-        m_indexesOrTrilists.push_back(0);
-
-        // push dummy box indices (they will be fixed later)
-        size_t indexesOrTrilistsPos = m_indexesOrTrilists.size();
-        m_indexesOrTrilists.push_back(0);
-        m_indexesOrTrilists.push_back(0);
-
-        // push dummy start index
-        m_indexesOrTrilists.push_back(0);
-
-        // now recurse
-        uint32_t idxLeft = ++idxBoxes;
-        createCFTreeRecursive(move(inner->left), idxBoxes);
-        uint32_t idxRight = ++idxBoxes;
-        createCFTreeRecursive(move(inner->right), idxBoxes);
 
-        // fix box indices
-        m_indexesOrTrilists[indexesOrTrilistsPos] = idxLeft;
-        m_indexesOrTrilists[indexesOrTrilistsPos + 1] = idxRight;
-    }
-    else
+    // Recursively split new sub trees into further inner or leaf nodes. The left sub tree follows its parent.
+    uint32_t idxRight;
+    if (count >= ParallelBuildSize)
     {
-        // If we have a leaf node
-        BVHLeafPtr leaf(dynamic_cast<BVHLeaf*>(currentNode.release()));
-        uint32_t count = static_cast<uint32_t>(leaf->triangles.size());
+        // Build the right sub tree into its own list in parallel and append it afterwards
+        vector<BuildNode> rightNodes;
 
-        // push real count
-        m_indexesOrTrilists.push_back(0x80000000 | count);
+        #pragma omp task shared(primitives, rightNodes)
+        buildTreeRecursive(primitives, mid, end, rBounds, rightNodes);
 
-        // push dummy box indices
-        m_indexesOrTrilists.push_back(0);
-        m_indexesOrTrilists.push_back(0);
+        buildTreeRecursive(primitives, begin, mid, lBounds, nodes);
 
-        // push start index
-        m_indexesOrTrilists.push_back(static_cast<uint32_t>(m_triIndexList.size()));
+        #pragma omp taskwait
 
-        // copy triangle indices
-        for (auto idx: leaf->triangles)
+        idxRight = static_cast<uint32_t>(nodes.size());
+        for (BuildNode& node: rightNodes)
         {
-            m_triIndexList.push_back(static_cast<uint32_t>(idx));
+            if (!(node.indexesOrTrilists[0] & 0x80000000))
+            {
+                node.indexesOrTrilists[1] += idxRight;
+                node.indexesOrTrilists[2] += idxRight;
+            }
         }
+        nodes.insert(nodes.end(), rightNodes.begin(), rightNodes.end());
     }
-}
-
-template<typename BaseVecT>
-void BVHTree<BaseVecT>::convertTrianglesIntersectionData()
-{
-    uint32_t sizePerTriangle = 4 + 4 + 4 + 4;
-    m_trianglesIntersectionData.reserve(m_triangles.size() * sizePerTriangle);
-    for (auto const& triangle: m_triangles)
+    else
     {
-        m_trianglesIntersectionData.push_back(triangle.normal.getX());
-        m_trianglesIntersectionData.push_back(triangle.normal.getY());
-        m_trianglesIntersectionData.push_back(triangle.normal.getZ());
-        m_trianglesIntersectionData.push_back(triangle.d);
-
-        m_trianglesIntersectionData.push_back(triangle.e1.getX());
-        m_trianglesIntersectionData.push_back(triangle.e1.getY());
-        m_trianglesIntersectionData.push_back(triangle.e1.getZ());
-        m_trianglesIntersectionData.push_back(triangle.d1);
-
-        m_trianglesIntersectionData.push_back(triangle.e2.getX());
-        m_trianglesIntersectionData.push_back(triangle.e2.getY());
-        m_trianglesIntersectionData.push_back(triangle.e2.getZ());
-        m_trianglesIntersectionData.push_back(triangle.d2);
-
-        m_trianglesIntersectionData.push_back(triangle.e3.getX());
-        m_trianglesIntersectionData.push_back(triangle.e3.getY());
-        m_trianglesIntersectionData.push_back(triangle.e3.getZ());
-        m_trianglesIntersectionData.push_back(triangle.d3);
+        buildTreeRecursive(primitives, begin, mid, lBounds, nodes);
+        idxRight = static_cast<uint32_t>(nodes.size());
+        buildTreeRecursive(primitives, mid, end, rBounds, nodes);
     }
+
+    uint32_t* inner = nodes[nodeIdx].indexesOrTrilists;
+    inner[0] = 0;
+    inner[1] = static_cast<uint32_t>(nodeIdx + 1);
+    inner[2] = idxRight;
+    inner[3] = 0;
 }
 
 template<typename BaseVecT>
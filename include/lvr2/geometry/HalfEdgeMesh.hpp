@@ -145,6 +145,17 @@ public:
 
     bool debugCheckMeshIntegrity() const;
 
+    /**
+     * @brief Removes the storage of all deleted vertices, faces and edges.
+     *
+     * Operations like `collapseEdge()` only mark elements as deleted. This
+     * moves the remaining elements to the front of their arrays and frees
+     * the memory of the deleted ones. Handles keep their relative order.
+     *
+     * This invalidates all handles and all attribute maps of this mesh!
+     */
+    void compact();
+
 private:
     StableVector<HalfEdgeHandle, Edge> m_edges;
     StableVector<FaceHandle, Face> m_faces;
@@ -207,6 +218,30 @@ private:
      */
     pair<HalfEdgeHandle, HalfEdgeHandle> addEdgePair(VertexHandle v1H, VertexHandle v2H);
 
+    /**
+     * @brief Adds all given triangles to a mesh that has vertices but no
+     *        faces yet.
+     *
+     * Instead of searching around the vertices for every face like
+     * `addFace()` does, the directed edges of all triangles are bucketed by
+     * their source vertex and sorted by their target, so that twins can be
+     * looked up directly. Triangles that cannot be represented are skipped
+     * without throwing: degenerate triangles, triangles reusing a directed
+     * edge of an earlier triangle and triangles whose fan around a vertex is
+     * separated from a closed fan around the same vertex.
+     *
+     * If every vertex lies in at most one fan of triangles, the resulting mesh
+     * (including all handles) is the same as the one built by calling
+     * `addFace()` for each triangle in order. Otherwise, only the order in
+     * which the boundary edges of several fans around a vertex are linked may
+     * differ.
+     *
+     * @param indices  Three vertex indices per triangle.
+     * @param numFaces Number of triangles in `indices`.
+     * @return The number of skipped triangles.
+     */
+    size_t addFacesBulk(const Index* indices, size_t numFaces);
+
 
     /**
      * @brief Circulates around the vertex `vH`, calling the `visitor` for each
@@ -36,6 +36,7 @@
 #include <array>
 #include <utility>
 #include <iostream>
+#include <limits>
 
 #include "lvr2/attrmaps/AttrMaps.hpp"
 #include "lvr2/util/Panic.hpp"
@@ -59,29 +60,26 @@ HalfEdgeMesh<BaseVecT>::HalfEdgeMesh(MeshBufferPtr ptr)
     floatArr vertices = ptr->getVertices();
     indexArray indices = ptr->getFaceIndices();
 
+    Vertex defaultVertex;
+    m_vertices = StableVector<VertexHandle, Vertex>(numVertices, defaultVertex);
+
+    #pragma omp parallel for schedule(static)
     for(size_t i = 0; i < numVertices; i++)
     {
         size_t pos = 3 * i;
-        this->addVertex(BaseVecT(
+        m_vertices[VertexHandle(i)].pos = BaseVecT(
                             vertices[pos],
                             vertices[pos + 1],
-                            vertices[pos + 2]));
+                            vertices[pos + 2]);
     }
 
-    for(size_t i = 0; i < numFaces; i++)
+    if (numFaces > 0)
     {
-        size_t pos = 3 * i;
-        VertexHandle v1(indices[pos]);
-        VertexHandle v2(indices[pos + 1]);
-        VertexHandle v3(indices[pos + 2]);
-        try
+        size_t skipped = addFacesBulk(indices.get(), numFaces);
+        if (skipped > 0)
         {
-            this->addFace(v1, v2, v3);
-        }
-        catch(PanicException exception)
-        {
-            std::cerr << timestamp << "Warning loop detected. Omitting face "
-                      << v1.idx() << " " << v2.idx() << " " << v3.idx() << std::endl;
+            std::cerr << timestamp << "Warning: Omitted " << skipped
+                      << " degenerate or non-manifold faces" << std::endl;
         }
     }
 }
@@ -1856,6 +1854,44 @@ bool HalfEdgeMesh<BaseVecT>::debugCheckMeshIntegrity() const
     return error;
 }
 
+template <typename BaseVecT>
+void HalfEdgeMesh<BaseVecT>::compact()
+{
+    vector<Index> edgeIndices = m_edges.compact();
+    vector<Index> faceIndices = m_faces.compact();
+    vector<Index> vertexIndices = m_vertices.compact();
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < m_edges.size(); i++)
+    {
+        auto& e = m_edges[HalfEdgeHandle(i)];
+        if (e.face)
+        {
+            e.face = FaceHandle(faceIndices[e.face.unwrap().idx()]);
+        }
+        e.target = VertexHandle(vertexIndices[e.target.idx()]);
+        e.next = HalfEdgeHandle(edgeIndices[e.next.idx()]);
+        e.twin = HalfEdgeHandle(edgeIndices[e.twin.idx()]);
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < m_faces.size(); i++)
+    {
+        auto& f = m_faces[FaceHandle(i)];
+        f.edge = HalfEdgeHandle(edgeIndices[f.edge.idx()]);
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < m_vertices.size(); i++)
+    {
+        auto& v = m_vertices[VertexHandle(i)];
+        if (v.outgoing)
+        {
+            v.outgoing = HalfEdgeHandle(edgeIndices[v.outgoing.unwrap().idx()]);
+        }
+    }
+}
+
 // ========================================================================
 // = Private helper methods
 // ========================================================================
@@ -2107,6 +2143,306 @@ pair<HalfEdgeHandle, HalfEdgeHandle> HalfEdgeMesh<BaseVecT>::addEdgePair(VertexH
     return std::make_pair(aH, bH);
 }
 
+template <typename BaseVecT>
+size_t HalfEdgeMesh<BaseVecT>::addFacesBulk(const Index* indices, size_t numFaces)
+{
+    // Corner `c` of the triangle list stands for the directed edge from
+    // `tris[c]` to the next vertex of the same triangle `c / 3`.
+    const Index noCorner = std::numeric_limits<Index>::max();
+    auto nextCorner = [](Index c) { return c - c % 3 + (c + 1) % 3; };
+    auto prevCorner = [](Index c) { return c - c % 3 + (c + 2) % 3; };
+
+    size_t numVertices = m_vertices.size();
+
+    // Degenerate triangles and invalid indices are dropped upfront
+    vector<Index> tris;
+    tris.reserve(3 * numFaces);
+    for (size_t i = 0; i < numFaces; i++)
+    {
+        const Index* t = indices + 3 * i;
+        if (t[0] < numVertices && t[1] < numVertices && t[2] < numVertices
+            && t[0] != t[1] && t[1] != t[2] && t[2] != t[0])
+        {
+            tris.insert(tris.end(), t, t + 3);
+        }
+    }
+
+    vector<Index> offsets(numVertices + 1);
+    vector<Index> corners;
+    vector<Index> twins;
+    vector<Index> halfEdges;
+    vector<uint8_t> visited;
+    vector<uint8_t> rejected;
+
+    // Skipping triangles never creates new conflicts, so this runs at most
+    // three times: after dropping triangles that reuse a directed edge and
+    // after dropping triangles around non-manifold vertices.
+    while (true)
+    {
+        size_t numCorners = tris.size();
+        size_t numTris = numCorners / 3;
+        rejected.assign(numTris, 0);
+        bool anyRejected = false;
+
+        auto dropRejected = [&]()
+        {
+            size_t kept = 0;
+            for (size_t f = 0; f < numTris; f++)
+            {
+                if (!rejected[f])
+                {
+                    std::copy_n(tris.begin() + 3 * f, 3, tris.begin() + 3 * kept);
+                    kept++;
+                }
+            }
+            tris.resize(3 * kept);
+        };
+
+        // ===================================================================
+        // = Bucket corners by source vertex and sort each bucket by target
+        // ===================================================================
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (size_t c = 0; c < numCorners; c++)
+        {
+            offsets[tris[c] + 1]++;
+        }
+        for (size_t v = 0; v < numVertices; v++)
+        {
+            offsets[v + 1] += offsets[v];
+        }
+
+        corners.resize(numCorners);
+        {
+            vector<Index> insertPos(offsets.begin(), offsets.end() - 1);
+            for (size_t c = 0; c < numCorners; c++)
+            {
+                corners[insertPos[tris[c]]++] = c;
+            }
+        }
+
+        #pragma omp parallel for schedule(dynamic, 4096) reduction(||:anyRejected)
+        for (size_t v = 0; v < numVertices; v++)
+        {
+            std::sort(corners.begin() + offsets[v], corners.begin() + offsets[v + 1],
+                [&](Index a, Index b)
+                {
+                    Index targetA = tris[nextCorner(a)];
+                    Index targetB = tris[nextCorner(b)];
+                    return targetA < targetB || (targetA == targetB && a < b);
+                });
+
+            // A directed edge can only belong to one face. The earlier
+            // triangle keeps it.
+            for (Index i = offsets[v] + 1; i < offsets[v + 1]; i++)
+            {
+                if (tris[nextCorner(corners[i - 1])] == tris[nextCorner(corners[i])])
+                {
+                    #pragma omp atomic write
+                    rejected[corners[i] / 3] = 1;
+                    anyRejected = true;
+                }
+            }
+        }
+
+        if (anyRejected)
+        {
+            dropRejected();
+            continue;
+        }
+
+        // ===================================================================
+        // = Pair twins and assign handles
+        // ===================================================================
+        twins.resize(numCorners);
+        #pragma omp parallel for schedule(static)
+        for (size_t c = 0; c < numCorners; c++)
+        {
+            Index source = tris[c];
+            Index target = tris[nextCorner(c)];
+            auto begin = corners.begin() + offsets[target];
+            auto end = corners.begin() + offsets[target + 1];
+            auto it = std::lower_bound(begin, end, source, [&](Index corner, Index value)
+            {
+                return tris[nextCorner(corner)] < value;
+            });
+            twins[c] = (it != end && tris[nextCorner(*it)] == source) ? *it : noCorner;
+        }
+
+        // Like `findOrCreateEdgeBetween()`, the first triangle using either
+        // direction of an edge creates the pair, its own half edge first.
+        halfEdges.resize(numCorners);
+        Index numPairs = 0;
+        for (size_t c = 0; c < numCorners; c++)
+        {
+            if (twins[c] == noCorner || c < twins[c])
+            {
+                halfEdges[c] = 2 * numPairs++;
+            }
+        }
+
+        #pragma omp parallel for schedule(static)
+        for (size_t c = 0; c < numCorners; c++)
+        {
+            if (twins[c] != noCorner && twins[c] < c)
+            {
+                halfEdges[c] = halfEdges[twins[c]] + 1;
+            }
+        }
+
+        Edge defaultEdge;
+        m_edges = StableVector<HalfEdgeHandle, Edge>(2 * numPairs, defaultEdge);
+        m_faces = StableVector<FaceHandle, Face>(numTris, Face(HalfEdgeHandle(0)));
+
+        #pragma omp parallel for schedule(static)
+        for (size_t c = 0; c < numCorners; c++)
+        {
+            HalfEdgeHandle eH(halfEdges[c]);
+            HalfEdgeHandle twinH(halfEdges[c] ^ 1);
+
+            auto& e = m_edges[eH];
+            e.face = FaceHandle(c / 3);
+            e.target = VertexHandle(tris[nextCorner(c)]);
+            e.next = HalfEdgeHandle(halfEdges[nextCorner(c)]);
+            e.twin = twinH;
+
+            if (twins[c] == noCorner)
+            {
+                // The `next` handle of boundary edges is set below
+                auto& boundary = m_edges[twinH];
+                boundary.target = VertexHandle(tris[c]);
+                boundary.twin = eH;
+            }
+
+            if (c % 3 == 0)
+            {
+                m_faces[FaceHandle(c / 3)].edge = eH;
+            }
+        }
+
+        // ===================================================================
+        // = Walk the fans around each vertex
+        // ===================================================================
+        // The corner following `c` around its source vertex is
+        // `nextCorner(twins[c])`. A fan is open if it starts at a corner whose
+        // previous corner has no twin; all corners not reached from such a
+        // start form closed fans. Several open fans are connected by linking
+        // their boundary edges into one circle, but a closed fan can't share
+        // its vertex with any other fan.
+        visited.assign(numCorners, 0);
+
+        #pragma omp parallel for schedule(dynamic, 4096) reduction(||:anyRejected)
+        for (size_t v = 0; v < numVertices; v++)
+        {
+            Index begin = offsets[v];
+            Index end = offsets[v + 1];
+            auto& vertex = m_vertices[VertexHandle(v)];
+            if (begin == end)
+            {
+                vertex.outgoing = OptionalHalfEdgeHandle();
+                continue;
+            }
+
+            // `addFace()` sets the outgoing edge of the first face at `v`
+            Index firstCorner = *std::min_element(corners.begin() + begin, corners.begin() + end);
+            vertex.outgoing = HalfEdgeHandle(halfEdges[firstCorner]);
+
+            size_t numFans = 0;
+            size_t numClosedFans = 0;
+            OptionalHalfEdgeHandle firstOutH;
+            OptionalHalfEdgeHandle lastInH;
+
+            for (Index i = begin; i < end; i++)
+            {
+                Index start = corners[i];
+                if (twins[prevCorner(start)] != noCorner)
+                {
+                    continue;
+                }
+
+                Index last = start;
+                visited[last] = 1;
+                while (twins[last] != noCorner)
+                {
+                    last = nextCorner(twins[last]);
+                    visited[last] = 1;
+                }
+
+                HalfEdgeHandle outH(halfEdges[prevCorner(start)] ^ 1);
+                HalfEdgeHandle inH(halfEdges[last] ^ 1);
+                if (lastInH)
+                {
+                    m_edges[lastInH.unwrap()].next = outH;
+                }
+                else
+                {
+                    firstOutH = outH;
+                }
+                lastInH = inH;
+                numFans++;
+            }
+            if (lastInH)
+            {
+                m_edges[lastInH.unwrap()].next = firstOutH.unwrap();
+            }
+
+            for (Index i = begin; i < end; i++)
+            {
+                Index start = corners[i];
+                if (visited[start])
+                {
+                    continue;
+                }
+
+                Index c = start;
+                do
+                {
+                    visited[c] = 1;
+                    c = nextCorner(twins[c]);
+                } while (c != start);
+                numClosedFans++;
+            }
+
+            if (numClosedFans == 0 || numFans + numClosedFans == 1)
+            {
+                continue;
+            }
+
+            // Non-manifold vertex: keep the fan of the first face only
+            Index c = firstCorner;
+            do
+            {
+                visited[c] = 2;
+                c = twins[c] == noCorner ? noCorner : nextCorner(twins[c]);
+            } while (c != noCorner && c != firstCorner);
+
+            c = firstCorner;
+            while (twins[prevCorner(c)] != noCorner && twins[prevCorner(c)] != firstCorner)
+            {
+                c = twins[prevCorner(c)];
+                visited[c] = 2;
+            }
+
+            for (Index i = begin; i < end; i++)
+            {
+                if (visited[corners[i]] != 2)
+                {
+                    #pragma omp atomic write
+                    rejected[corners[i] / 3] = 1;
+                }
+            }
+            anyRejected = true;
+        }
+
+        if (anyRejected)
+        {
+            dropRejected();
+            continue;
+        }
+
+        return numFaces - numTris;
+    }
+}
+
 
 // ========================================================================
 // = Iterator stuff
@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2018, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * WideBVH.hpp
+ */
+
+#pragma once
+#ifndef LVR2_GEOMETRY_WIDEBVH_HPP
+#define LVR2_GEOMETRY_WIDEBVH_HPP
+
+#include "lvr2/geometry/BVH.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace lvr2
+{
+
+/**
+ * @brief Bounding Volume Hierarchy with up to Width children per node
+ *
+ * The hierarchy is created by collapsing the binary tree of a BVHTree: Every node takes the
+ * children of its largest inner children until it has Width children. The bounding boxes of all
+ * children of a node are stored in SoA layout, so rays can be tested against all of them with
+ * SIMD instructions. The triangle intersection data is copied in the order of the leaves, so the
+ * triangles of a leaf are stored contiguously.
+ *
+ * @tparam Width Maximum number of children per node, usually 4 or 8
+ */
+template<int Width>
+class WideBVH
+{
+public:
+
+    /// Maximum number of children per node
+    static constexpr int NodeWidth = Width;
+
+    /// Marks unused child slots of a node
+    static constexpr uint32_t InvalidChild = 0xFFFFFFFF;
+
+    /// A node of the hierarchy. Unused child slots have an empty bounding box.
+    struct Node
+    {
+        /// Bounding boxes of the children: min x, max x, min y, max y, min z, max z
+        float bounds[6][Width];
+
+        /// Node index of inner children, index of the first triangle of leaf children
+        uint32_t child[Width];
+
+        /// Number of triangles of leaf children, 0 for inner children
+        uint32_t count[Width];
+    };
+
+    /**
+     * @brief Collapses the given binary tree
+     *
+     * @param tree The binary tree. Is not referenced after construction.
+     */
+    template<typename BaseVecT>
+    WideBVH(const BVHTree<BaseVecT>& tree);
+
+    /// @return The nodes. The root is the first node.
+    const std::vector<Node>& getNodes() const;
+
+    /**
+     * @return 16 values per triangle in the order of the leaves, see
+     *         BVHTree::getTrianglesIntersectionData()
+     */
+    const std::vector<float>& getTrianglesIntersectionData() const;
+
+    /// @return The index of every triangle in BVHTree::getTrianglesIntersectionData()
+    const std::vector<uint32_t>& getTriIndexList() const;
+
+    /// @return The number of levels of inner nodes
+    int getDepth() const;
+
+    /// @return The maximum number of entries of a depth first traversal stack
+    size_t getMaxStackSize() const;
+
+private:
+
+    /**
+     * @brief Recursively creates the wide node for a node of the binary tree
+     *
+     * @return The index of the created node
+     */
+    uint32_t collapse(
+        const std::vector<uint32_t>& indexesOrTrilists,
+        const std::vector<float>& limits,
+        const std::vector<uint32_t>& triIndexList,
+        const std::vector<float>& trianglesIntersectionData,
+        uint32_t binaryNode,
+        int depth);
+
+    std::vector<Node> m_nodes;
+    std::vector<float> m_trianglesIntersectionData;
+    std::vector<uint32_t> m_triIndexList;
+    int m_depth;
+};
+
+using BVH4 = WideBVH<4>;
+using BVH8 = WideBVH<8>;
+
+} // namespace lvr2
+
+#include "lvr2/geometry/WideBVH.tcc"
+
+#endif // LVR2_GEOMETRY_WIDEBVH_HPP
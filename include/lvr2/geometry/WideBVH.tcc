@@ -0,0 +1,221 @@
+/**
+ * Copyright (c) 2018, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * WideBVH.tcc
+ */
+
+#include <algorithm>
+#include <limits>
+
+namespace lvr2
+{
+
+namespace wide_bvh_detail
+{
+
+/// Returns true if the node of a binary BVHTree is a leaf
+inline bool isLeaf(const std::vector<uint32_t>& indexesOrTrilists, uint32_t node)
+{
+    return indexesOrTrilists[4 * node] & 0x80000000;
+}
+
+/// Returns half the surface area of the bounding box of a node of a binary BVHTree
+inline float halfArea(const std::vector<float>& limits, uint32_t node)
+{
+    const float* box = &limits[6 * node];
+    float x = box[1] - box[0];
+    float y = box[3] - box[2];
+    float z = box[5] - box[4];
+    return x * y + y * z + z * x;
+}
+
+} // namespace wide_bvh_detail
+
+template<int Width>
+template<typename BaseVecT>
+WideBVH<Width>::WideBVH(const BVHTree<BaseVecT>& tree)
+    : m_depth(0)
+{
+    static_assert(Width >= 2, "A WideBVH needs at least two children per node");
+
+    const std::vector<uint32_t>& triIndexList = tree.getTriIndexList();
+    m_triIndexList.reserve(triIndexList.size());
+    m_trianglesIntersectionData.reserve(triIndexList.size() * 16);
+
+    if (!tree.getIndexesOrTrilists().empty())
+    {
+        collapse(
+            tree.getIndexesOrTrilists(),
+            tree.getLimits(),
+            triIndexList,
+            tree.getTrianglesIntersectionData(),
+            0, 1);
+    }
+}
+
+template<int Width>
+uint32_t WideBVH<Width>::collapse(
+    const std::vector<uint32_t>& indexesOrTrilists,
+    const std::vector<float>& limits,
+    const std::vector<uint32_t>& triIndexList,
+    const std::vector<float>& trianglesIntersectionData,
+    uint32_t binaryNode,
+    int depth)
+{
+    using namespace wide_bvh_detail;
+
+    m_depth = std::max(m_depth, depth);
+
+    // Gather the children: Replace the inner child with the largest surface area
+    // by its own children until the node is full
+    uint32_t children[Width];
+    int numChildren = 0;
+    if (isLeaf(indexesOrTrilists, binaryNode))
+    {
+        children[numChildren++] = binaryNode;
+    }
+    else
+    {
+        children[numChildren++] = indexesOrTrilists[4 * binaryNode + 1];
+        children[numChildren++] = indexesOrTrilists[4 * binaryNode + 2];
+    }
+
+    while (numChildren < Width)
+    {
+        int best = -1;
+        float bestArea = -1.0f;
+        for (int i = 0; i < numChildren; i++)
+        {
+            if (!isLeaf(indexesOrTrilists, children[i]) && halfArea(limits, children[i]) > bestArea)
+            {
+                best = i;
+                bestArea = halfArea(limits, children[i]);
+            }
+        }
+        if (best < 0)
+        {
+            break;
+        }
+        uint32_t expanded = children[best];
+        children[best] = indexesOrTrilists[4 * expanded + 1];
+        children[numChildren++] = indexesOrTrilists[4 * expanded + 2];
+    }
+
+    uint32_t index = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.emplace_back();
+
+    // Unused slots get an inverted box that is never hit
+    for (int i = 0; i < Width; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            m_nodes[index].bounds[2 * axis][i] = std::numeric_limits<float>::infinity();
+            m_nodes[index].bounds[2 * axis + 1][i] = -std::numeric_limits<float>::infinity();
+        }
+        m_nodes[index].child[i] = InvalidChild;
+        m_nodes[index].count[i] = 0;
+    }
+
+    for (int i = 0; i < numChildren; i++)
+    {
+        uint32_t child = children[i];
+        uint32_t target;
+        uint32_t count = 0;
+
+        if (isLeaf(indexesOrTrilists, child))
+        {
+            count = indexesOrTrilists[4 * child] & 0x7fffffff;
+            if (count == 0)
+            {
+                continue;
+            }
+
+            // copy the triangles of the leaf
+            target = static_cast<uint32_t>(m_triIndexList.size());
+            uint32_t first = indexesOrTrilists[4 * child + 3];
+            for (uint32_t j = first; j < first + count; j++)
+            {
+                uint32_t triangle = triIndexList[j];
+                m_triIndexList.push_back(triangle);
+                m_trianglesIntersectionData.insert(
+                    m_trianglesIntersectionData.end(),
+                    trianglesIntersectionData.begin() + 16 * triangle,
+                    trianglesIntersectionData.begin() + 16 * (triangle + 1));
+            }
+        }
+        else
+        {
+            // m_nodes may be reallocated, so it is only accessed by index afterwards
+            target = collapse(indexesOrTrilists, limits, triIndexList, trianglesIntersectionData, child, depth + 1);
+        }
+
+        Node& node = m_nodes[index];
+        for (int j = 0; j < 6; j++)
+        {
+            node.bounds[j][i] = limits[6 * child + j];
+        }
+        node.child[i] = target;
+        node.count[i] = count;
+    }
+
+    return index;
+}
+
+template<int Width>
+const std::vector<typename WideBVH<Width>::Node>& WideBVH<Width>::getNodes() const
+{
+    return m_nodes;
+}
+
+template<int Width>
+const std::vector<float>& WideBVH<Width>::getTrianglesIntersectionData() const
+{
+    return m_trianglesIntersectionData;
+}
+
+template<int Width>
+const std::vector<uint32_t>& WideBVH<Width>::getTriIndexList() const
+{
+    return m_triIndexList;
+}
+
+template<int Width>
+int WideBVH<Width>::getDepth() const
+{
+    return m_depth;
+}
+
+template<int Width>
+size_t WideBVH<Width>::getMaxStackSize() const
+{
+    // every processed inner node replaces its stack entry by at most Width entries
+    return static_cast<size_t>(m_depth) * (Width - 1) + 1;
+}
+
+} // namespace lvr2
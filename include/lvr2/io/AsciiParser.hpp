@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2018, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * AsciiParser.hpp
+ */
+
+#ifndef LVR2_IO_ASCIIPARSER_HPP_
+#define LVR2_IO_ASCIIPARSER_HPP_
+
+#include <cstddef>
+#include <vector>
+
+namespace lvr2
+{
+
+/**
+ * @brief   Parallel parser for line based ASCII point cloud data
+ *          (.xyz, .pts, .txt, ...) that is already present in memory,
+ *          usually as a memory mapped file.
+ *
+ * The given range is split into line aligned blocks. The constructor
+ * counts the non blank lines of all blocks in parallel, so that callers
+ * can allocate their output buffers with the exact size. \ref parse then
+ * parses all blocks in parallel and passes the values of each line together
+ * with its index to a functor, which can write them directly to their final
+ * position. Numbers are converted with std::from_chars instead of stream or
+ * scanf based conversions. Values may be separated by blanks, tabs or commas.
+ */
+class AsciiParser
+{
+public:
+
+    /**
+     * @brief   Splits [first, last) into line aligned blocks and counts
+     *          the non blank lines in each block.
+     *
+     * @param first     Pointer to the first character of the data
+     * @param last      Pointer behind the last character of the data
+     * @param maxLines  If given, only the first maxLines non blank lines
+     *                  are considered
+     */
+    AsciiParser(const char* first, const char* last, size_t maxLines = 0);
+
+    /**
+     * @brief   Returns the number of non blank lines that will be parsed
+     */
+    size_t numLines() const { return m_lineOffsets.back(); }
+
+    /**
+     * @brief   Returns a pointer behind the last considered line. Differs
+     *          from the end of the data if maxLines was set.
+     */
+    const char* end() const { return m_blocks.back(); }
+
+    /**
+     * @brief   Parses all non blank lines in parallel.
+     *
+     * @param maxValues Number of values that are parsed per line. Additional
+     *                  values are ignored, missing values are set to zero.
+     * @param func      Functor that is called as func(index, values, numValues)
+     *                  for every line, where index is the running index of the
+     *                  line in [0, numLines()) and numValues the number of values
+     *                  actually found in the line. Is called concurrently.
+     *
+     * @return  The number of lines containing less than maxValues values
+     */
+    template<typename LineFunc>
+    size_t parse(size_t maxValues, LineFunc func) const;
+
+    /**
+     * @brief   Parses the number at the beginning of [first, last). Leading
+     *          separators are skipped.
+     *
+     * @return  Pointer behind the parsed number or nullptr if there is no
+     *          valid number
+     */
+    static const char* parseFloat(const char* first, const char* last, float& value);
+
+    /**
+     * @brief   Parses up to maxValues numbers from the line [first, last).
+     *          Parsing stops at the first token that is not a number, the
+     *          remaining entries of values are set to zero.
+     *
+     * @return  The number of parsed values
+     */
+    static size_t parseLine(const char* first, const char* last, float* values, size_t maxValues);
+
+    /**
+     * @brief   Returns a pointer behind the next line break in [first, last)
+     *          or last if there is none.
+     */
+    static const char* nextLine(const char* first, const char* last);
+
+    /**
+     * @brief   True if [first, last) contains separators only.
+     */
+    static bool isBlank(const char* first, const char* last);
+
+private:
+
+    /// Block boundaries, block i is [m_blocks[i], m_blocks[i + 1])
+    std::vector<const char*>    m_blocks;
+
+    /// Index of the first line of each block, last entry is the total count
+    std::vector<size_t>         m_lineOffsets;
+};
+
+} // namespace lvr2
+
+#include "AsciiParser.tcc"
+
+#endif /* LVR2_IO_ASCIIPARSER_HPP_ */
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2018, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * AsciiParser.tcc
+ */
+
+#include <algorithm>
+#include <atomic>
+
+namespace lvr2
+{
+
+template<typename LineFunc>
+size_t AsciiParser::parse(size_t maxValues, LineFunc func) const
+{
+    const long numBlocks = static_cast<long>(m_blocks.size()) - 1;
+    std::atomic<size_t> incomplete(0);
+
+    #pragma omp parallel
+    {
+        std::vector<float> values(std::max<size_t>(maxValues, 1));
+        size_t localIncomplete = 0;
+
+        #pragma omp for schedule(dynamic, 1)
+        for (long b = 0; b < numBlocks; b++)
+        {
+            size_t index = m_lineOffsets[b];
+            const size_t lastIndex = m_lineOffsets[b + 1];
+            const char* pos = m_blocks[b];
+            const char* blockEnd = m_blocks[b + 1];
+
+            while (pos < blockEnd && index < lastIndex)
+            {
+                const char* lineEnd = nextLine(pos, blockEnd);
+                if (!isBlank(pos, lineEnd))
+                {
+                    size_t n = parseLine(pos, lineEnd, values.data(), maxValues);
+                    if (n < maxValues)
+                    {
+                        localIncomplete++;
+                    }
+                    func(index++, values.data(), n);
+                }
+                pos = lineEnd;
+            }
+        }
+
+        incomplete += localIncomplete;
+    }
+
+    return incomplete;
+}
+
+} // namespace lvr2
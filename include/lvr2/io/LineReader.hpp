@@ -117,6 +117,12 @@ public:
   };
 
 private:
+  /**
+   * @brief Reads the next points of the current ASCII file using a parallel
+   *        parser on the memory mapped file.
+   */
+  boost::shared_ptr<void> getNextAsciiPoints(size_t &return_amount, size_t amount);
+
   std::vector<std::string> m_filePaths;
   std::vector<size_t> m_filePos;
   size_t m_elementAmount;
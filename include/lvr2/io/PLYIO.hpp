@@ -59,7 +59,10 @@ namespace lvr2
  *
  * The PLYIO class provides functionalities for reading and writing the Polygon
  * File Format, also known as Stanford Triangle Format. Both binary and ascii
- * modes are supported. For the actual file handling the RPly library is used.
+ * modes are supported. Binary little endian files are memory mapped and read
+ * with bulk copies of the interleaved properties. Files are saved as binary
+ * little endian with a bulk writer. All other files are handled by the RPly
+ * library.
  * \n \n
  * The following list is a short description of all handled elements and
  * properties of ply files. In short the elements \c vertex and \c face
@@ -164,6 +167,21 @@ class PLYIO : public BaseIO
 
     private:
 
+        /**
+         * \brief Reads a binary little endian PLY file through a memory
+         *        mapping.
+         *
+         * The properties of the vertex, point and face elements are copied
+         * to the buffers of the model in bulk. If the layout of an element
+         * already matches a buffer, the buffer points into the mapped file.
+         * Returns an empty pointer if the file is not supported, e.g. because
+         * it is stored as ascii, contains polygons or panorama coordinates.
+         * The file should then be read with RPly.
+         **/
+        ModelPtr readBinary( string filename, bool readColor, bool readConfidence,
+                bool readIntensity, bool readNormals, bool readFaces,
+                bool readPanoramaCoords );
+
 
         /**
          * \brief Callback for read vertices.
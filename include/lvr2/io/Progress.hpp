@@ -47,8 +47,13 @@ using std::string;
 using std::wstring;
 using std::wcout;
 
+#include <atomic>
+#include <limits>
+
 #include <boost/thread/mutex.hpp>
 
+#include "lvr2/io/Timestamp.hpp"
+
 namespace lvr2
 {
 
@@ -60,6 +65,11 @@ namespace lvr2
  * 	After each iteration the ++-operator should be called. The
  * 	progress information in '%' is automatically printed to stdout
  * 	together with the given prefix string.
+ *
+ * 	The counter is incremented atomically. A lock is only taken when
+ * 	the printed percentage changes, i.e., at most 100 times. In quiet
+ * 	mode without a progress callback the increment operators return
+ * 	immediately.
  */
 
 typedef void(*ProgressCallbackPtr)(int);
@@ -75,20 +85,36 @@ public:
      *
      * @param max_val	The number of performed iterations
      * @param prefix	The prefix string for progress output
+     * @param quiet     If true, no output is generated. Defaults to the
+     *                  quiet state of the global timestamp in the calling
+     *                  translation unit. A registered progress callback is
+     *                  called regardless.
      */
-    ProgressBar(size_t max_val, string prefix = "");
+    ProgressBar(size_t max_val, string prefix = "", bool quiet = timestamp.isQuiet());
 
     virtual ~ProgressBar();
 
     /**
      * @brief Increases the counter of performed iterations
      */
-    void operator++();
+    inline void operator++() { *this += 1; }
 
     /**
      * @brief Increases the counter of performed by \ref n
      */
-    void operator+=(size_t n);
+    inline void operator+=(size_t n)
+    {
+        if(m_quiet && !m_progressCallback)
+        {
+            return;
+        }
+
+        size_t val = m_currentVal.fetch_add(n, std::memory_order_relaxed) + n;
+        if(val >= m_nextVal.load(std::memory_order_relaxed))
+        {
+            update();
+        }
+    }
 
 
     /**
@@ -108,6 +134,9 @@ public:
 
 protected:
 
+    /// Prints the output for all percentages reached so far
+    void update();
+
     /// Prints the output
     void print_bar();
 
@@ -117,10 +146,16 @@ protected:
     /// The number of iterations
     size_t			m_maxVal;
 
-        /// The current counter
-    size_t	 		m_currentVal;
+    /// The current counter
+    std::atomic<size_t> m_currentVal;
+
+    /// The counter value at which the next percentage is reached
+    std::atomic<size_t> m_nextVal;
 
-    /// A mutex object for counter increment (for parallel executions)
+    /// If true, the counter is not updated
+    bool            m_quiet;
+
+    /// A mutex object for output generation (for parallel executions)
     boost::mutex 	m_mutex;
 
     /// The current progress in percent
@@ -137,6 +172,65 @@ protected:
 };
 
 
+/**
+ * @brief   Collects the increments of a \ref ProgressBar within a single
+ *          thread and forwards them in batches to avoid contention on the
+ *          shared counter in parallel loops. Create one instance per thread
+ *          inside of the parallel region. Remaining increments are forwarded
+ *          on destruction.
+ */
+class ProgressBatch
+{
+public:
+
+    /**
+     * @brief Ctor.
+     *
+     * @param progress  The progress bar that is updated
+     * @param batchSize The number of increments that are collected before
+     *                  the progress bar is updated
+     */
+    ProgressBatch(ProgressBar& progress, size_t batchSize = 256)
+        : m_progress(progress), m_batchSize(batchSize), m_count(0) {}
+
+    ~ProgressBatch() { flush(); }
+
+    /**
+     * @brief Increases the local counter
+     */
+    inline void operator++()
+    {
+        if(++m_count >= m_batchSize)
+        {
+            flush();
+        }
+    }
+
+    /**
+     * @brief Forwards the collected increments to the progress bar
+     */
+    inline void flush()
+    {
+        if(m_count)
+        {
+            m_progress += m_count;
+            m_count = 0;
+        }
+    }
+
+private:
+
+    /// The updated progress bar
+    ProgressBar&    m_progress;
+
+    /// The number of increments per update
+    size_t          m_batchSize;
+
+    /// The number of collected increments
+    size_t          m_count;
+};
+
+
 /**
  * @brief	A progress counter class
  *
@@ -173,9 +267,9 @@ protected:
     size_t			m_stepVal;
 
     /// The current counter value
-    size_t			m_currentVal;
+    std::atomic<size_t> m_currentVal;
 
-    /// A mutex object for counter increment (for parallel executions)
+    /// A mutex object for output generation (for parallel executions)
     boost::mutex 	m_mutex;
 
     /// A string stream for output generation
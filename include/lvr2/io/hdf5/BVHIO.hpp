@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef LVR2_IO_HDF5_BVHIO_HPP
+#define LVR2_IO_HDF5_BVHIO_HPP
+
+#include <boost/optional.hpp>
+
+#include "lvr2/geometry/BaseVector.hpp"
+#include "lvr2/geometry/BVH.hpp"
+
+// Dependencies
+#include "ArrayIO.hpp"
+
+namespace lvr2 {
+namespace hdf5features {
+
+/**
+ * @class BVHIO
+ * @brief Hdf5IO Feature for storing a built BVHTree next to its mesh
+ *
+ * Building the BVH of a large mesh takes considerably longer than loading it.
+ * This Feature stores the cache friendly representation of a BVHTree in the
+ * subgroup "bvh" of a mesh group, so that repeated ray casting jobs on the same
+ * mesh can skip the construction.
+ *
+ * Example:
+ * @code
+ * MyHdf5IO io;
+ * MeshBufferPtr mesh = io.loadMesh("amesh");
+ *
+ * // writing
+ * BVHTree<BaseVector<float>> bvh(mesh);
+ * io.save("amesh", bvh);
+ *
+ * // reading
+ * auto bvh_in = io.loadBVH("amesh");
+ * if(bvh_in)
+ * {
+ *     BVHRaycaster<MyIntType> rc(mesh, std::move(*bvh_in));
+ * }
+ * @endcode
+ *
+ * Generates attributes at hdf5 group <mesh>/bvh:
+ * - IO: BVHIO
+ * - CLASS: BVHTree
+ *
+ * Dependencies:
+ * - ArrayIO
+ *
+ */
+template<typename Derived>
+class BVHIO {
+public:
+    void save(std::string meshName, const BVHTree<BaseVector<float> >& bvh);
+    void save(HighFive::Group& meshGroup, const BVHTree<BaseVector<float> >& bvh);
+
+    /**
+     * @brief Loads the BVH stored in the given mesh group. Returns an empty optional,
+     *        if no BVH is stored or it was built for other vertices or faces than the
+     *        ones stored in the mesh group.
+     */
+    boost::optional<BVHTree<BaseVector<float> > > loadBVH(std::string meshName);
+    boost::optional<BVHTree<BaseVector<float> > > loadBVH(HighFive::Group& meshGroup);
+
+protected:
+
+    bool isBVH(HighFive::Group& group);
+
+    /**
+     * @brief Identifies the geometry of a mesh by its number of vertices and a hash of its
+     *        vertices and face indices. Returns an empty optional, if the mesh group has no
+     *        vertices or face indices.
+     */
+    boost::optional<std::pair<uint64_t, uint64_t> > meshFingerprint(HighFive::Group& meshGroup);
+
+    Derived* m_file_access = static_cast<Derived*>(this);
+
+    // dependencies
+    ArrayIO<Derived>* m_array_io = static_cast<ArrayIO<Derived>*>(m_file_access);
+
+    static constexpr const char* ID = "BVHIO";
+    static constexpr const char* OBJID = "BVHTree";
+    static constexpr const char* GROUP = "bvh";
+};
+
+} // hdf5features
+
+/**
+ *
+ * @brief Hdf5Construct Specialization for hdf5features::BVHIO
+ * - Constructs dependencies (ArrayIO)
+ * - Sets type variable
+ *
+ */
+template<typename Derived>
+struct Hdf5Construct<hdf5features::BVHIO, Derived> {
+
+    // DEPS
+    using deps = typename Hdf5Construct<hdf5features::ArrayIO, Derived>::type;
+
+    // ADD THE FEATURE ITSELF
+    using type = typename deps::template add_features<hdf5features::BVHIO>::type;
+
+};
+
+} // namespace lvr2
+
+#include "BVHIO.tcc"
+
+#endif // LVR2_IO_HDF5_BVHIO_HPP
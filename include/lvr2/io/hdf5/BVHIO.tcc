@@ -0,0 +1,246 @@
+namespace lvr2
+{
+
+namespace hdf5features
+{
+
+template <typename Derived>
+void BVHIO<Derived>::save(std::string meshName, const BVHTree<BaseVector<float> >& bvh)
+{
+    HighFive::Group g = hdf5util::getGroup(m_file_access->m_hdf5_file, meshName, true);
+
+    save(g, bvh);
+}
+
+template <typename Derived>
+void BVHIO<Derived>::save(HighFive::Group& meshGroup, const BVHTree<BaseVector<float> >& bvh)
+{
+    const vector<float>& limits = bvh.getLimits();
+    const vector<uint32_t>& indexesOrTrilists = bvh.getIndexesOrTrilists();
+    const vector<uint32_t>& triIndexList = bvh.getTriIndexList();
+    const vector<float>& intersectionData = bvh.getTrianglesIntersectionData();
+
+    if (triIndexList.empty())
+    {
+        std::cout << "[Hdf5IO - BVHIO] WARNING: BVH contains no triangles. Nothing will be saved." << std::endl;
+        return;
+    }
+
+    HighFive::Group group = hdf5util::getGroup(meshGroup, GROUP, true);
+
+    std::string id(BVHIO<Derived>::ID);
+    std::string obj(BVHIO<Derived>::OBJID);
+    hdf5util::setAttribute(group, "IO", id);
+    hdf5util::setAttribute(group, "CLASS", obj);
+
+    // Stores which geometry the BVH was built for, so loadBVH can detect stale BVHs
+    if (auto fingerprint = meshFingerprint(meshGroup))
+    {
+        hdf5util::setAttribute(group, "mesh_num_vertices", fingerprint->first);
+        hdf5util::setAttribute(group, "mesh_hash", fingerprint->second);
+    }
+    else
+    {
+        std::cout << "[Hdf5IO - BVHIO] WARNING: Mesh geometry has to be saved before the BVH. "
+                  << "The BVH can't be validated when it is loaded." << std::endl;
+    }
+
+    size_t numNodes = limits.size() / 6;
+    size_t numFaces = intersectionData.size() / 16;
+
+    boost::shared_array<float> limitsData(new float[limits.size()]);
+    std::copy(limits.begin(), limits.end(), limitsData.get());
+    std::vector<size_t> dimLimits{numNodes, 6};
+    std::vector<hsize_t> chunkLimits{numNodes, 6};
+    m_array_io->save(group, "limits", dimLimits, chunkLimits, limitsData);
+
+    boost::shared_array<uint32_t> nodesData(new uint32_t[indexesOrTrilists.size()]);
+    std::copy(indexesOrTrilists.begin(), indexesOrTrilists.end(), nodesData.get());
+    std::vector<size_t> dimNodes{numNodes, 4};
+    std::vector<hsize_t> chunkNodes{numNodes, 4};
+    m_array_io->save(group, "indexes_or_trilists", dimNodes, chunkNodes, nodesData);
+
+    boost::shared_array<uint32_t> triIndexData(new uint32_t[triIndexList.size()]);
+    std::copy(triIndexList.begin(), triIndexList.end(), triIndexData.get());
+    std::vector<size_t> dimTriIndex{triIndexList.size()};
+    std::vector<hsize_t> chunkTriIndex{triIndexList.size()};
+    m_array_io->save(group, "tri_index_list", dimTriIndex, chunkTriIndex, triIndexData);
+
+    boost::shared_array<float> trianglesData(new float[intersectionData.size()]);
+    std::copy(intersectionData.begin(), intersectionData.end(), trianglesData.get());
+    std::vector<size_t> dimTriangles{numFaces, 16};
+    std::vector<hsize_t> chunkTriangles{numFaces, 16};
+    m_array_io->save(group, "triangle_intersection_data", dimTriangles, chunkTriangles, trianglesData);
+}
+
+template <typename Derived>
+boost::optional<BVHTree<BaseVector<float> > > BVHIO<Derived>::loadBVH(std::string meshName)
+{
+    boost::optional<BVHTree<BaseVector<float> > > ret;
+
+    if (hdf5util::exist(m_file_access->m_hdf5_file, meshName))
+    {
+        HighFive::Group g = hdf5util::getGroup(m_file_access->m_hdf5_file, meshName, false);
+        ret = loadBVH(g);
+    }
+
+    return ret;
+}
+
+template <typename Derived>
+boost::optional<BVHTree<BaseVector<float> > > BVHIO<Derived>::loadBVH(HighFive::Group& meshGroup)
+{
+    if (!meshGroup.exist(GROUP))
+    {
+        return boost::none;
+    }
+
+    HighFive::Group group = meshGroup.getGroup(GROUP);
+    if (!isBVH(group))
+    {
+        std::cout << "[Hdf5IO - BVHIO] WARNING: flags of " << group.getId() << " are not correct."
+                  << std::endl;
+        return boost::none;
+    }
+
+    std::vector<size_t> dimLimits, dimNodes, dimTriIndex, dimTriangles;
+    boost::shared_array<float> limits
+        = m_array_io->template load<float>(group, "limits", dimLimits);
+    boost::shared_array<uint32_t> indexesOrTrilists
+        = m_array_io->template load<uint32_t>(group, "indexes_or_trilists", dimNodes);
+    boost::shared_array<uint32_t> triIndexList
+        = m_array_io->template load<uint32_t>(group, "tri_index_list", dimTriIndex);
+    boost::shared_array<float> intersectionData
+        = m_array_io->template load<float>(group, "triangle_intersection_data", dimTriangles);
+
+    if (!limits || !indexesOrTrilists || !triIndexList || !intersectionData
+        || dimLimits.size() != 2 || dimLimits[1] != 6
+        || dimNodes.size() != 2 || dimNodes[1] != 4 || dimNodes[0] != dimLimits[0]
+        || dimTriangles.size() != 2 || dimTriangles[1] != 16
+        || dimTriIndex.size() != 1 || dimTriIndex[0] > dimTriangles[0])
+    {
+        std::cout << "[Hdf5IO - BVHIO] WARNING: Wrong BVH dimensions. BVH will not be loaded." << std::endl;
+        return boost::none;
+    }
+
+    size_t numNodes = dimLimits[0];
+    size_t numTriIndices = dimTriIndex[0];
+    size_t numFaces = dimTriangles[0];
+
+    // Only well formed faces are stored in the tri index list, each of them once
+    for (size_t i = 0; i < numTriIndices; i++)
+    {
+        if (triIndexList[i] >= numFaces)
+        {
+            std::cout << "[Hdf5IO - BVHIO] WARNING: Triangle index out of range. "
+                      << "BVH will not be loaded." << std::endl;
+            return boost::none;
+        }
+    }
+
+    // Children are stored after their parent, so a valid tree can't contain cycles.
+    // Leaves reference a range of the tri index list.
+    bool validNodes = numNodes > 0;
+    for (size_t i = 0; i < numNodes && validNodes; i++)
+    {
+        const uint32_t* node = indexesOrTrilists.get() + i * 4;
+        if (node[0] & 0x80000000)
+        {
+            uint64_t count = node[0] & 0x7fffffff;
+            validNodes = node[3] + count <= numTriIndices;
+        }
+        else
+        {
+            validNodes = node[1] > i && node[1] < numNodes && node[2] > i && node[2] < numNodes;
+        }
+    }
+    if (!validNodes)
+    {
+        std::cout << "[Hdf5IO - BVHIO] WARNING: Invalid BVH nodes. BVH will not be loaded."
+                  << std::endl;
+        return boost::none;
+    }
+
+    // A BVH that was built for a different version of the mesh is useless
+    if (auto fingerprint = meshFingerprint(meshGroup))
+    {
+        uint64_t numVertices = fingerprint->first;
+        uint64_t hash = fingerprint->second;
+        if (!hdf5util::checkAttribute(group, "mesh_num_vertices", numVertices)
+            || !hdf5util::checkAttribute(group, "mesh_hash", hash))
+        {
+            std::cout << "[Hdf5IO - BVHIO] WARNING: BVH does not match the geometry of the mesh. "
+                      << "BVH will not be loaded." << std::endl;
+            return boost::none;
+        }
+    }
+
+    return BVHTree<BaseVector<float> >(
+        vector<float>(limits.get(), limits.get() + numNodes * 6),
+        vector<uint32_t>(indexesOrTrilists.get(), indexesOrTrilists.get() + numNodes * 4),
+        vector<uint32_t>(triIndexList.get(), triIndexList.get() + numTriIndices),
+        vector<float>(intersectionData.get(), intersectionData.get() + numFaces * 16)
+    );
+}
+
+template <typename Derived>
+bool BVHIO<Derived>::isBVH(HighFive::Group& group)
+{
+    std::string id(BVHIO<Derived>::ID);
+    std::string obj(BVHIO<Derived>::OBJID);
+    return hdf5util::checkAttribute(group, "IO", id)
+        && hdf5util::checkAttribute(group, "CLASS", obj);
+}
+
+template <typename Derived>
+boost::optional<std::pair<uint64_t, uint64_t> > BVHIO<Derived>::meshFingerprint(
+    HighFive::Group& meshGroup)
+{
+    if (!meshGroup.exist("channels"))
+    {
+        return boost::none;
+    }
+
+    HighFive::Group channels = meshGroup.getGroup("channels");
+    std::vector<size_t> dimVertices, dimFaces;
+    boost::shared_array<float> vertices
+        = m_array_io->template load<float>(channels, "vertices", dimVertices);
+    boost::shared_array<uint32_t> faces
+        = m_array_io->template load<uint32_t>(channels, "face_indices", dimFaces);
+    if (!vertices || !faces || dimVertices.empty() || dimFaces.empty())
+    {
+        return boost::none;
+    }
+
+    size_t numVertexValues = 1;
+    for (auto d : dimVertices)
+    {
+        numVertexValues *= d;
+    }
+    size_t numFaceValues = 1;
+    for (auto d : dimFaces)
+    {
+        numFaceValues *= d;
+    }
+
+    // 64 bit FNV-1a over the face indices and the vertex coordinates
+    uint64_t hash = 14695981039346656037ull;
+    auto hashBytes = [&hash](const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    uint64_t numFaces = dimFaces[0];
+    hashBytes(&numFaces, sizeof(numFaces));
+    hashBytes(faces.get(), numFaceValues * sizeof(uint32_t));
+    hashBytes(vertices.get(), numVertexValues * sizeof(float));
+
+    return std::make_pair(static_cast<uint64_t>(dimVertices[0]), hash);
+}
+
+} // namespace hdf5features
+
+} // namespace lvr2
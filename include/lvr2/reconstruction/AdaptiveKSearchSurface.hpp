@@ -54,6 +54,7 @@
 
 
 #include "PointsetSurface.hpp"
+#include "CovariancePCA.hpp"
 
 // #ifdef LVR2_USE_STANN
 // // SearchTreeStann
@@ -109,7 +110,8 @@ public:
      * @param kn         The number of neighbor points used for normal estimation
      * @param ki         The number of neighbor points used for normal interpolation
      * @param kd         The number of neighbor points used for distance value calculation
-     * @param calcMethod Normal calculation method. 0: PCA(default), 1: RANSAC, 2: Iterative
+     * @param calcMethod Normal calculation method. 0: PCA(default), 1: RANSAC, 2: Iterative,
+     *                   3: Covariance based PCA (fastest)
      */
     AdaptiveKSearchSurface(
         PointBufferPtr loader,
@@ -144,6 +146,14 @@ public:
     virtual pair<typename BaseVecT::CoordType, typename BaseVecT::CoordType>
         distance(BaseVecT v) const;
 
+    /// See interface documentation. Uses a batched k-nearest-neighbor search.
+    virtual void distances(
+        const BaseVecT* positions,
+        size_t n,
+        typename BaseVecT::CoordType* projected,
+        typename BaseVecT::CoordType* euclidean
+    ) const;
+
     /**
      * @brief Calculates initial point normals using a least squares fit to
      *        the \ref m_kn nearest points
@@ -296,6 +306,24 @@ private:
         const vector<size_t> &id
     );
 
+    /**
+     * @brief Calculates a tangent plane for the query point from the
+     *        covariance matrix of the k-neighborhood. The normal is the
+     *        eigenvector of the smallest eigenvalue, which is computed
+     *        in closed form (see CovariancePCA.hpp).
+     *
+     * @param points        Interleaved coordinates of the point cloud
+     * @param queryPoint    The point for which the tangent plane is created
+     * @param k             The size of the used k-neighborhood
+     * @param id            The positions of the neighborhood points in \ref points
+     */
+    Plane<BaseVecT> calcPlanePCA(
+        const float* points,
+        const BaseVecT &queryPoint,
+        int k,
+        const size_t* id
+    );
+
 
 
 
@@ -305,6 +333,7 @@ private:
     // 0: PCA
     // 1: RANSAC
     // 2: Iterative
+    // 3: Covariance based PCA
     int m_calcMethod;
 
     // /// The currently stored points
@@ -44,6 +44,7 @@
 #include <set>
 #include <random>
 #include <algorithm>
+#include <numeric>
 
 #include "lvr2/util/Factories.hpp"
 #include "lvr2/io/Progress.hpp"
@@ -176,138 +177,175 @@ void AdaptiveKSearchSurface<BaseVecT>::calculateSurfaceNormals()
     string comment = timestamp.getElapsedTime() + "Estimating normals ";
     lvr2::ProgressBar progress(numPoints, comment);
 
-    #pragma omp parallel for schedule(dynamic, 12)
-    for(size_t i = 0; i < numPoints; i++) {
-        // We have to fit these vector to have the
-        // correct return values when performing the
-        // search on the stann kd tree. So we don't use
-        // the template parameter T for di
-        vector<size_t> id;
-        vector<float> di;
+    const float* points = pts.dataPtr().get();
 
-        int n = 0;
-        size_t k = k_0;
+    // The neighborhoods are searched for blocks of points at once. Points
+    // with a degenerated neighborhood are searched again with twice as many
+    // neighbors (at most five searches per point).
+    const size_t blockSize = 4096;
+    vector<size_t> pending;
+    vector<size_t> remaining;
+    vector<char> done;
+    vector<BaseVecT> queries;
+    vector<size_t> indices;
+    vector<float> distances;
+
+    for(size_t blockStart = 0; blockStart < numPoints; blockStart += blockSize)
+    {
+        size_t blockEnd = std::min(numPoints, blockStart + blockSize);
+        pending.resize(blockEnd - blockStart);
+        std::iota(pending.begin(), pending.end(), blockStart);
 
-        while(n < 5)
+        size_t k = k_0;
+        for(int n = 1; n <= 5 && !pending.empty(); n++)
         {
-            n++;
             /**
              *  @todo Maybe this should be done at the end of the loop
              *        after the bounding box check
              */
-            k = k * 2;
-
-            //T* point = this->m_points[i];
-
-            id.clear();
-            di.clear();
-
-            this->m_searchTree->kSearch(pts[i], k, id, di);
-
-            float min_x = 1e15f;
-            float min_y = 1e15f;
-            float min_z = 1e15f;
-            float max_x = - min_x;
-            float max_y = - min_y;
-            float max_z = - min_z;
-
-            float dx, dy, dz;
-            dx = dy = dz = 0;
-
-            // Calculate the bounding box of found point set
-            /**
-             * @todo Use the bounding box object from the old model3d
-             *       library for bounding box calculation...
-             */
-            for(size_t j = 0; j < k; j++) {
-                min_x = std::min(min_x, pts[id[j]][0]);
-                min_y = std::min(min_y, pts[id[j]][1]);
-                min_z = std::min(min_z, pts[id[j]][2]);
-
-                max_x = std::max(max_x, pts[id[j]][0]);
-                max_y = std::max(max_y, pts[id[j]][1]);
-                max_z = std::max(max_z, pts[id[j]][2]);
-
-                dx = max_x - min_x;
-                dy = max_y - min_y;
-                dz = max_z - min_z;
-            }
+            k = std::min(k * 2, numPoints);
 
-            if(boundingBoxOK(dx, dy, dz))
+            queries.resize(pending.size());
+            for(size_t j = 0; j < pending.size(); j++)
             {
-                break;
+                queries[j] = pts[pending[j]];
             }
-        }
 
-        // Create a query point for the current point
-        auto queryPoint = pts[i];
+            indices.resize(pending.size() * k);
+            distances.resize(pending.size() * k);
+            this->m_searchTree->kSearchMany(queries.data(), pending.size(), k, indices.data(), distances.data());
 
-        // Interpolate a plane based on the k-neighborhood
-        Plane<BaseVecT> p;
-        bool ransac_ok;
+            done.assign(pending.size(), 0);
 
-        if(m_calcMethod == 1)
-        {
-            p = calcPlaneRANSAC(queryPoint, k, id, ransac_ok);
-            // Fallback if RANSAC failed
-            if(!ransac_ok)
+            #pragma omp parallel
             {
-                // compare speed
-                p = calcPlane(queryPoint, k, id);
-            }
-        }
-        else if(m_calcMethod == 2)
-        {
-            p = calcPlaneIterative(queryPoint, k, id);
-        }
-        else
-        {
-            p = calcPlane(queryPoint, k, id);
-        }
-        // Get the mean distance to the tangent plane
-        //mean_distance = meanDistance(p, id, k);
-        Normal<typename BaseVecT::CoordType> normal(0, 0, 1);
-        normal = p.normal;
+                // Reused for all points of a thread
+                vector<size_t> id;
+                vector<size_t> nearestPoseIds;
+                vector<float> nearestPoseDistances;
 
-        // Flip normals towards the center of the scene or nearest scan pose
-        if(m_poseTree)
-        {
-            vector<size_t> nearestPoseIds;
-            m_poseTree->kSearch(queryPoint, 1, nearestPoseIds);
-            if(nearestPoseIds.size() == 1)
-            {
-                BaseVecT nearest = pts[nearestPoseIds[0]];
-                Normal<typename BaseVecT::CoordType> dir(queryPoint - nearest);
-                if(normal.dot(dir) < 0)
+                #pragma omp for schedule(dynamic, 12)
+                for(long j = 0; j < (long)pending.size(); j++)
                 {
-                    normal = -normal;
+                    const size_t* neighbors = indices.data() + j * k;
+
+                    if(n < 5)
+                    {
+                        float min_x = 1e15f;
+                        float min_y = 1e15f;
+                        float min_z = 1e15f;
+                        float max_x = - min_x;
+                        float max_y = - min_y;
+                        float max_z = - min_z;
+
+                        // Calculate the bounding box of found point set
+                        for(size_t l = 0; l < k; l++) {
+                            min_x = std::min(min_x, pts[neighbors[l]][0]);
+                            min_y = std::min(min_y, pts[neighbors[l]][1]);
+                            min_z = std::min(min_z, pts[neighbors[l]][2]);
+
+                            max_x = std::max(max_x, pts[neighbors[l]][0]);
+                            max_y = std::max(max_y, pts[neighbors[l]][1]);
+                            max_z = std::max(max_z, pts[neighbors[l]][2]);
+                        }
+
+                        // Search again with a larger neighborhood
+                        if(!boundingBoxOK(max_x - min_x, max_y - min_y, max_z - min_z))
+                        {
+                            continue;
+                        }
+                    }
+                    done[j] = 1;
+                    id.assign(neighbors, neighbors + k);
+
+                    // Create a query point for the current point
+                    size_t i = pending[j];
+                    auto queryPoint = pts[i];
+
+                    // Interpolate a plane based on the k-neighborhood
+                    Plane<BaseVecT> p;
+                    bool ransac_ok;
+
+                    if(m_calcMethod == 1)
+                    {
+                        p = calcPlaneRANSAC(queryPoint, k, id, ransac_ok);
+                        // Fallback if RANSAC failed
+                        if(!ransac_ok)
+                        {
+                            // compare speed
+                            p = calcPlane(queryPoint, k, id);
+                        }
+                    }
+                    else if(m_calcMethod == 2)
+                    {
+                        p = calcPlaneIterative(queryPoint, k, id);
+                    }
+                    else if(m_calcMethod == 3)
+                    {
+                        p = calcPlanePCA(points, queryPoint, k, neighbors);
+                    }
+                    else
+                    {
+                        p = calcPlane(queryPoint, k, id);
+                    }
+                    // Get the mean distance to the tangent plane
+                    //mean_distance = meanDistance(p, id, k);
+                    Normal<typename BaseVecT::CoordType> normal(0, 0, 1);
+                    normal = p.normal;
+
+                    // Flip normals towards the center of the scene or nearest scan pose
+                    if(m_poseTree)
+                    {
+                        nearestPoseIds.clear();
+                        nearestPoseDistances.clear();
+                        m_poseTree->kSearch(queryPoint, 1, nearestPoseIds, nearestPoseDistances);
+                        if(nearestPoseIds.size() == 1)
+                        {
+                            BaseVecT nearest = pts[nearestPoseIds[0]];
+                            Normal<typename BaseVecT::CoordType> dir(queryPoint - nearest);
+                            if(normal.dot(dir) < 0)
+                            {
+                                normal = -normal;
+                            }
+                        }
+                        else
+                        {
+                            cout << timestamp.getElapsedTime() << "Could not get nearest scan pose. Defaulting to centroid." << endl;
+                            Normal<typename BaseVecT::CoordType> dir(queryPoint - m_centroid);
+                            if(normal.dot(dir) < 0)
+                            {
+                                normal = -normal;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        Normal<typename BaseVecT::CoordType> dir(queryPoint - m_centroid);
+                        if(normal.dot(dir) < 0)
+                        {
+                            normal = -normal;
+                        }
+                    }
+
+                    // Save result in normal array
+                    normals[i*3 + 0] = normal.x;
+                    normals[i*3 + 1] = normal.y;
+                    normals[i*3 + 2] = normal.z;
                 }
             }
-            else
+
+            // Keep the points with degenerated neighborhoods for the next search
+            remaining.clear();
+            for(size_t j = 0; j < pending.size(); j++)
             {
-                cout << timestamp.getElapsedTime() << "Could not get nearest scan pose. Defaulting to centroid." << endl;
-                Normal<typename BaseVecT::CoordType> dir(queryPoint - m_centroid);
-                if(normal.dot(dir) < 0)
+                if(!done[j])
                 {
-                    normal = -normal;
+                    remaining.push_back(pending[j]);
                 }
             }
+            progress += pending.size() - remaining.size();
+            pending.swap(remaining);
         }
-        else
-        {
-            Normal<typename BaseVecT::CoordType> dir(queryPoint - m_centroid);
-            if(normal.dot(dir) < 0)
-            {
-                normal = -normal;
-            }
-        }
-
-        // Save result in normal array
-        normals[i*3 + 0] = normal.x;
-        normals[i*3 + 1] = normal.y;
-        normals[i*3 + 2] = normal.z;
-
-        ++progress;
     }
     cout << endl;
 
@@ -334,38 +372,59 @@ void AdaptiveKSearchSurface<BaseVecT>::interpolateSurfaceNormals()
     string comment = timestamp.getElapsedTime() + "Interpolating normals ";
     lvr2::ProgressBar progress(numPoints, comment);
 
-    // Interpolate normals
-    #pragma omp parallel for schedule(dynamic, 12)
-    for( int i = 0; i < (int)numPoints; i++)
-    {
-        vector<size_t> id;
-        vector<float> di;
+    // Interpolate normals. The neighborhoods are searched for
+    // blocks of points at once.
+    const size_t blockSize = 4096;
+    const size_t k = std::min((size_t)this->m_ki, numPoints);
+    vector<BaseVecT> queries;
+    vector<size_t> indices;
+    vector<float> distances;
 
-        this->m_searchTree->kSearch(pts[i], this->m_ki, id, di);
+    for(size_t blockStart = 0; blockStart < numPoints; blockStart += blockSize)
+    {
+        size_t blockEnd = std::min(numPoints, blockStart + blockSize);
+        size_t count = blockEnd - blockStart;
 
-        BaseVecT mean = normals[i];
-        for(int j = 0; j < this->m_ki; j++)
+        queries.resize(count);
+        for(size_t j = 0; j < count; j++)
         {
-            mean += normals[id[j]];
+            queries[j] = pts[blockStart + j];
         }
-        auto mean_normal = mean.normalized();
-        tmp[i] = mean_normal;
 
-        ///todo Try to remove this code. Should improve the results at all.
-        for(int j = 0; j < this->m_ki; j++)
+        indices.resize(count * k);
+        distances.resize(count * k);
+        this->m_searchTree->kSearchMany(queries.data(), count, k, indices.data(), distances.data());
+
+        #pragma omp parallel for schedule(dynamic, 12)
+        for(long j = 0; j < (long)count; j++)
         {
-            Normal<typename BaseVecT::CoordType> n = normals[id[j]];
+            size_t i = blockStart + j;
+            const size_t* id = indices.data() + j * k;
 
-            // Only override existing normals if the interpolated
-            // normals is significantly different from the initial
-            // estimation. This helps to avoid a too smooth normal
-            // field
-            if(fabs(n.dot(mean_normal)) > 0.2 )
+            BaseVecT mean = normals[i];
+            for(size_t l = 0; l < k; l++)
             {
-                normals[id[j]] = mean_normal;
+                mean += normals[id[l]];
+            }
+            auto mean_normal = mean.normalized();
+            tmp[i] = mean_normal;
+
+            ///todo Try to remove this code. Should improve the results at all.
+            for(size_t l = 0; l < k; l++)
+            {
+                Normal<typename BaseVecT::CoordType> n = normals[id[l]];
+
+                // Only override existing normals if the interpolated
+                // normals is significantly different from the initial
+                // estimation. This helps to avoid a too smooth normal
+                // field
+                if(fabs(n.dot(mean_normal)) > 0.2 )
+                {
+                    normals[id[l]] = mean_normal;
+                }
             }
         }
-        ++progress;
+        progress += count;
     }
     cout << endl;
     cout << timestamp.getElapsedTime() << "Copying normals..." << endl;
@@ -499,6 +558,47 @@ pair<typename BaseVecT::CoordType, typename BaseVecT::CoordType>
     // return make_pair(euklideanDistance, projectedDistance);
 }
 
+template<typename BaseVecT>
+void AdaptiveKSearchSurface<BaseVecT>::distances(
+    const BaseVecT* positions,
+    size_t n,
+    typename BaseVecT::CoordType* projected,
+    typename BaseVecT::CoordType* euclidean
+) const
+{
+    FloatChannel pts     = *(this->m_pointBuffer->getFloatChannel("points"));
+    FloatChannel normals = *(this->m_pointBuffer->getFloatChannel("normals"));
+    int k = this->m_kd;
+
+    // Find the nearest tangent planes of all positions
+    vector<size_t> id(n * k);
+    vector<float> di(n * k);
+    this->m_searchTree->kSearchMany(positions, n, k, id.data(), di.data());
+
+    #pragma omp parallel for schedule(static)
+    for(long j = 0; j < (long)n; j++)
+    {
+        const size_t* neighbors = id.data() + j * k;
+
+        BaseVecT nearest;
+        BaseVecT avg_normal;
+
+        for ( int i = 0; i < k; i++ )
+        {
+            nearest += pts[neighbors[i]];
+            avg_normal += normals[neighbors[i]];
+        }
+
+        avg_normal /= k;
+        nearest /= k;
+        auto normal = avg_normal.normalized();
+
+        //Calculate distance
+        projected[j] = (positions[j] - nearest).dot(normal);
+        euclidean[j] = (positions[j] - nearest).length();
+    }
+}
+
 // template<typename BaseVecT>
 // VertexT AdaptiveKSearchSurface<BaseVecT>::fromID(int i){
 //     return VertexT(
@@ -563,6 +663,28 @@ Plane<BaseVecT> AdaptiveKSearchSurface<BaseVecT>::calcPlane(
     return p;
 }
 
+template<typename BaseVecT>
+Plane<BaseVecT> AdaptiveKSearchSurface<BaseVecT>::calcPlanePCA(
+    const float* points,
+    const BaseVecT &queryPoint,
+    int k,
+    const size_t* id
+)
+{
+    float centroid[3];
+    float covariance[6];
+    float normal[3];
+
+    calcCovariance(points, id, k, centroid, covariance);
+    smallestEigenvector(covariance, normal);
+
+    Plane<BaseVecT> p;
+    p.normal = Normal<typename BaseVecT::CoordType>(normal[0], normal[1], normal[2]);
+    p.pos = queryPoint;
+
+    return p;
+}
+
 template<typename BaseVecT>
 Plane<BaseVecT> AdaptiveKSearchSurface<BaseVecT>::calcPlaneIterative(
     const BaseVecT &queryPoint,
@@ -41,9 +41,12 @@
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
+#include <array>
+#include <map>
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #ifndef __APPLE__
 #include <omp.h>
@@ -73,20 +76,41 @@ class BigGrid
   public:
     /**
      * Constructor:
-     * @param cloudPath path to PointCloud in ASCII xyz Format // Todo: Add other file formats
+     *
+     * Every input file is parsed only once. The files are read in parallel and every thread
+     * spills its points into its own binary file in the scratch directory, grouped in blocks
+     * per coarse spill cell. The grid is then built from the blocks of the spill files, one
+     * spill cell per thread.
+     *
+     * @throw std::runtime_error if a spill file can't be written or read
+     *
+     * @param cloudPath paths to PointClouds in ASCII xyz or PLY Format
      * @param voxelsize
+     * @param scale scale factor applied to the point coordinates
+     * @param bufferSize number of points that are read from a file at once
+     * @param scratchDir directory for the spill files and the memory mapped point files
      */
-    BigGrid(std::vector<std::string> cloudPath, float voxelsize, float scale = 0, size_t bufferSize = 1024);
+    BigGrid(std::vector<std::string> cloudPath,
+            float voxelsize,
+            float scale = 0,
+            size_t bufferSize = 65536,
+            std::string scratchDir = ".");
 
     /**
      * Constructor: specific case for incremental reconstruction/chunking. also compatible with simple reconstruction
      * @param voxelsize specified voxelsize
      * @param project ScanProject, which contain one or more Scans
      * @param scale scale value of for current scans
+     * @param scratchDir directory for the memory mapped point files
      */
-    BigGrid(float voxelsize,ScanProjectEditMarkPtr project, float scale = 0);
+    BigGrid(float voxelsize, ScanProjectEditMarkPtr project, float scale = 0, std::string scratchDir = ".");
 
-    BigGrid(std::string path);
+    /**
+     * Constructor: loads a serialized grid
+     * @param path path of the file written by serialize()
+     * @param scratchDir directory of the memory mapped point files of the grid
+     */
+    BigGrid(std::string path, std::string scratchDir = ".");
 
     /**
      * @return Number of voxels
@@ -188,9 +212,84 @@ class BigGrid
     inline bool hasColors() { return m_has_color; }
     inline bool hasNormals() { return m_has_normal; }
 
+    /**
+     * @return directory of the memory mapped point, normal, color and distance files
+     */
+    const std::string& getScratchDirectory() const { return m_scratchDir; }
+
   private:
+    /// Edge length of a spill cell in voxels
+    static constexpr size_t SpillCellVoxels = 64;
+
+    /// Number of points a thread buffers before they are written to its spill file
+    static constexpr size_t SpillBufferPoints = 1 << 20;
+
+    /// Header of a block of points within a spill file
+    struct SpillBlock
+    {
+        size_t cell;
+        size_t file;
+        size_t seq;
+        size_t count;
+    };
+
+    /// Location of a block within the spill files
+    struct SpillBlockRef
+    {
+        SpillBlock block;
+        size_t spillFile;
+        long offset;
+    };
+
+    /// Points, normals and colors of one spill cell buffered by a thread
+    struct SpillBuffer
+    {
+        std::vector<float> points;
+        std::vector<float> normals;
+        std::vector<unsigned char> colors;
+    };
+
     inline int calcIndex(float f) { return f < 0 ? f - .5 : f + .5; }
 
+    /**
+     * Makes the bounding box side lengths divisible by the voxel size and
+     * calculates the maximum indices of the grid.
+     */
+    void calcGridIndices();
+
+    /**
+     * @return path of the given file within the scratch directory
+     */
+    std::string scratchFile(const std::string& name) const;
+
+    /**
+     * @return path of the spill file with the given index
+     */
+    std::string spillFile(size_t index) const;
+
+    /**
+     * Reads the block headers of the spill files.
+     *
+     * @return the blocks of every spill cell, ordered by input file and read position
+     * @throw std::runtime_error if a spill file can't be read
+     */
+    std::vector<std::vector<SpillBlockRef>> indexSpillFiles(size_t numSpillFiles,
+                                                           size_t numCells);
+
+    /**
+     * Calls func(points, normals, colors, count) for every given block. Normals and
+     * colors are nullptr if the grid has none.
+     *
+     * @return a description of the error if a block can't be read, an empty string otherwise
+     */
+    template <typename F>
+    std::string forEachSpillBlock(const std::vector<SpillBlockRef>& blocks, F func);
+
+    /**
+     * Removes the spill files with the indices 0 to numSpillFiles - 1
+     */
+    void removeSpillFiles(size_t numSpillFiles);
+
     bool exists(int i, int j, int k);
     void insert(float x, float y, float z);
 
@@ -223,6 +322,9 @@ class BigGrid
 
     std::unordered_map<size_t, CellInfo> m_gridNumPoints;
     float m_scale;
+
+    /// Directory of the memory mapped files
+    std::string m_scratchDir;
 };
 
 } // namespace lvr2
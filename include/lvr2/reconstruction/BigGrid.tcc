@@ -43,11 +43,16 @@
 #include "lvr2/io/hdf5/VariantChannelIO.hpp"
 #include "lvr2/reconstruction/FastReconstructionTables.hpp"
 
-#include <boost/filesystem/path.hpp>
+#include <boost/filesystem.hpp>
 #include <boost/optional/optional_io.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 
 using namespace std;
 
@@ -58,292 +63,302 @@ template <typename BaseVecT>
 BigGrid<BaseVecT>::BigGrid(std::vector<std::string> cloudPath,
                            float voxelsize,
                            float scale,
-                           size_t bufferSize)
+                           size_t bufferSize,
+                           std::string scratchDir)
     : m_maxIndex(0), m_maxIndexSquare(0), m_maxIndexX(0), m_maxIndexY(0), m_maxIndexZ(0),
       m_numPoints(0), m_extrude(true), m_scale(scale), m_has_normal(false), m_has_color(false),
-      m_pointBufferSize(1024)
+      m_pointBufferSize(bufferSize), m_scratchDir(scratchDir)
 {
-
-    boost::filesystem::path selectedFile(cloudPath[0]);
-    string extension = selectedFile.extension().string();
 #ifndef __APPLE__
     omp_init_lock(&m_lock);
 #endif
     m_voxelSize = voxelsize;
+    boost::filesystem::create_directories(m_scratchDir);
 
-    // First, parse whole file to get BoundingBox and amount of points
-    float ix, iy, iz;
-    std::cout << lvr2::timestamp << "Computing Bounding Box..." << std::endl;
-    m_numPoints = 0;
-    size_t rsize = 0;
-    LineReader lineReader(cloudPath);
-    size_t lasti = 0;
-    while (lineReader.ok())
+    // Check the attributes of all input files. Attributes that are missing
+    // in some of the files are set to zero for their points.
+    std::vector<fileType> fileTypes(cloudPath.size());
+    for (size_t i = 0; i < cloudPath.size(); i++)
     {
-        if (lineReader.getFileType() == XYZNRGB)
-        {
-            boost::shared_ptr<xyznc> a = boost::static_pointer_cast<xyznc>(
-                lineReader.getNextPoints(rsize, m_pointBufferSize));
-            if (rsize <= 0 && !lineReader.ok())
+        LineReader reader(cloudPath[i]);
+        fileTypes[i] = reader.getFileType();
+        m_has_normal |= fileTypes[i] == XYZN || fileTypes[i] == XYZNRGB;
+        m_has_color |= fileTypes[i] == XYZRGB || fileTypes[i] == XYZNRGB;
+    }
+
+    // Single pass over the input: Each file is parsed by one thread and its points are
+    // binned into coarse spill cells. Every thread appends its bins to its own spill file,
+    // so no thread waits for another one. The spill cells do not depend on the final
+    // bounding box, so the box is computed in the same pass.
+    std::cout << lvr2::timestamp << "Reading and binning point clouds..." << std::endl;
+    const float spillCellSize = voxelsize * SpillCellVoxels;
+    std::map<std::array<long, 3>, size_t> spillCells;
+    size_t numPoints = 0;
+    size_t numSpillFiles = 0;
+    std::string spillError;
+
+    string comment = lvr2::timestamp.getElapsedTime() + "Reading point clouds ";
+    lvr2::ProgressBar readProgress(cloudPath.size(), comment);
+
+    #pragma omp parallel reduction(+ : numPoints)
+    {
+        BoundingBox<BaseVecT> localBB;
+        std::map<std::array<long, 3>, size_t> localCells;
+        std::unordered_map<size_t, SpillBuffer> buffers;
+        size_t buffered = 0;
+        size_t fileIndex = 0;
+        size_t seq = 0;
+
+        size_t spillIndex;
+        #pragma omp critical(bigGridSpillCells)
+        spillIndex = numSpillFiles++;
+
+        // truncates spill files of previous runs
+        const std::string spillPath = spillFile(spillIndex);
+        FILE* out = fopen(spillPath.c_str(), "wb");
+        std::string error = out ? "" : spillPath + " failed: " + std::strerror(errno);
+
+        auto write = [&](const void* data, size_t size, size_t count) {
+            if (error.empty() && fwrite(data, size, count, out) != count)
             {
-                break;
+                error = spillPath + " failed: " + std::strerror(errno);
             }
-            for (int i = 0; i < rsize; i++)
+        };
+
+        // Appends the buffered points of every spill cell as one block to the spill file
+        auto flush = [&]() {
+            for (auto& buffer : buffers)
             {
-                m_bb.expand(BaseVecT(a.get()[i].point.x * m_scale,
-                                        a.get()[i].point.y * m_scale,
-                                        a.get()[i].point.z * m_scale));
-                m_numPoints++;
+                SpillBlock block{buffer.first, fileIndex, seq, buffer.second.points.size() / 3};
+                write(&block, sizeof(SpillBlock), 1);
+                write(buffer.second.points.data(), sizeof(float), block.count * 3);
+                if (m_has_normal)
+                {
+                    write(buffer.second.normals.data(), sizeof(float), block.count * 3);
+                }
+                if (m_has_color)
+                {
+                    write(buffer.second.colors.data(), 1, block.count * 3);
+                }
             }
-        }
-        else if (lineReader.getFileType() == XYZN)
+            buffers.clear();
+            buffered = 0;
+            seq++;
+        };
+
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t f = 0; f < cloudPath.size(); f++)
         {
-            boost::shared_ptr<xyzn> a = boost::static_pointer_cast<xyzn>(
-                lineReader.getNextPoints(rsize, m_pointBufferSize));
-            if (rsize <= 0 && !lineReader.ok())
+            fileIndex = f;
+            seq = 0;
+
+            const fileType type = fileTypes[f];
+            const bool fileNormals = type == XYZN || type == XYZNRGB;
+            const bool fileColors = type == XYZRGB || type == XYZNRGB;
+            size_t stride = sizeof(xyz);
+            switch (type)
             {
-                break;
+                case XYZN: stride = sizeof(xyzn); break;
+                case XYZRGB: stride = sizeof(xyzc); break;
+                case XYZNRGB: stride = sizeof(xyznc); break;
+                default: break;
             }
-            for (int i = 0; i < rsize; i++)
+
+            LineReader reader(cloudPath[f]);
+            std::array<long, 3> lastKey{0, 0, 0};
+            SpillBuffer* buffer = nullptr;
+            size_t rsize = 0;
+            while (reader.ok())
             {
-                m_bb.expand(BaseVecT(a.get()[i].point.x * m_scale,
-                                        a.get()[i].point.y * m_scale,
-                                        a.get()[i].point.z * m_scale));
-                m_numPoints++;
+                boost::shared_ptr<void> data = reader.getNextPoints(rsize, m_pointBufferSize);
+                if (rsize <= 0 && !reader.ok())
+                {
+                    break;
+                }
+
+                const char* raw = static_cast<const char*>(data.get());
+                for (size_t i = 0; i < rsize; i++)
+                {
+                    const char* p = raw + i * stride;
+                    const lvr2::coord<float>& point = reinterpret_cast<const xyz*>(p)->point;
+                    float x = point.x * m_scale;
+                    float y = point.y * m_scale;
+                    float z = point.z * m_scale;
+                    localBB.expand(BaseVecT(x, y, z));
+
+                    std::array<long, 3> key{static_cast<long>(std::floor(x / spillCellSize)),
+                                            static_cast<long>(std::floor(y / spillCellSize)),
+                                            static_cast<long>(std::floor(z / spillCellSize))};
+                    if (buffer == nullptr || key != lastKey)
+                    {
+                        auto it = localCells.find(key);
+                        if (it == localCells.end())
+                        {
+                            size_t id;
+                            #pragma omp critical(bigGridSpillCells)
+                            id = spillCells.emplace(key, spillCells.size()).first->second;
+                            it = localCells.emplace(key, id).first;
+                        }
+                        buffer = &buffers[it->second];
+                        lastKey = key;
+                    }
+
+                    buffer->points.insert(buffer->points.end(), {x, y, z});
+                    if (m_has_normal)
+                    {
+                        if (fileNormals)
+                        {
+                            const lvr2::coord<float>& n = reinterpret_cast<const xyzn*>(p)->normal;
+                            buffer->normals.insert(buffer->normals.end(), {n.x, n.y, n.z});
+                        }
+                        else
+                        {
+                            buffer->normals.insert(buffer->normals.end(), {0.0f, 0.0f, 0.0f});
+                        }
+                    }
+                    if (m_has_color)
+                    {
+                        if (fileColors)
+                        {
+                            const lvr2::color<unsigned char>& c = type == XYZNRGB
+                                ? reinterpret_cast<const xyznc*>(p)->color
+                                : reinterpret_cast<const xyzc*>(p)->color;
+                            buffer->colors.insert(buffer->colors.end(), {c.r, c.g, c.b});
+                        }
+                        else
+                        {
+                            buffer->colors.insert(buffer->colors.end(), {0, 0, 0});
+                        }
+                    }
+                    numPoints++;
+                    buffered++;
+                }
+
+                if (buffered >= SpillBufferPoints)
+                {
+                    flush();
+                    buffer = nullptr;
+                }
             }
+
+            // blocks never contain points of several files
+            flush();
+            ++readProgress;
         }
-        else if (lineReader.getFileType() == XYZ)
+
+        // numPoints is the thread's private counter here
+        if (numPoints > 0)
         {
-            boost::shared_ptr<xyz> a = boost::static_pointer_cast<xyz>(
-                lineReader.getNextPoints(rsize, m_pointBufferSize));
-            if (rsize <= 0 && !lineReader.ok())
-            {
-                break;
-            }
-            for (size_t i = 0; i < rsize; i++)
-            {
-                m_bb.expand(BaseVecT(a.get()[i].point.x * m_scale,
-                                        a.get()[i].point.y * m_scale,
-                                        a.get()[i].point.z * m_scale));
-                m_numPoints++;
-                lasti = i;
-            }
+            #pragma omp critical(bigGridBoundingBox)
+            m_bb.expand(localBB);
         }
-        else if (lineReader.getFileType() == XYZRGB)
+
+        if (out != nullptr && fclose(out) != 0 && error.empty())
         {
-            boost::shared_ptr<xyzc> a = boost::static_pointer_cast<xyzc>(
-                lineReader.getNextPoints(rsize, m_pointBufferSize));
-            if (rsize <= 0 && !lineReader.ok())
-            {
-                break;
-            }
-            for (size_t i = 0; i < rsize; i++)
-            {
-                m_bb.expand(BaseVecT(a.get()[i].point.x * m_scale,
-                                        a.get()[i].point.y * m_scale,
-                                        a.get()[i].point.z * m_scale));
-                m_numPoints++;
-                lasti = i;
-            }
+            error = spillPath + " failed: " + std::strerror(errno);
         }
-        else
+        if (!error.empty())
         {
-            exit(-1);
+            #pragma omp critical(bigGridSpillCells)
+            spillError = error;
         }
     }
+    std::cout << std::endl;
 
-    // Make box side lenghts be divisible by voxel size
-    float longestSide = m_bb.getLongestSide();
-
-    BaseVecT center = m_bb.getCentroid();
-    size_t xsize2 = calcIndex(m_bb.getXSize() / m_voxelSize);
-    float xsize = ceil(m_bb.getXSize() / voxelsize) * voxelsize;
-    float ysize = ceil(m_bb.getYSize() / voxelsize) * voxelsize;
-    float zsize = ceil(m_bb.getZSize() / voxelsize) * voxelsize;
-    m_bb.expand(BaseVecT(center.x + xsize / 2, center.y + ysize / 2, center.z + zsize / 2));
-    m_bb.expand(BaseVecT(center.x - xsize / 2, center.y - ysize / 2, center.z - zsize / 2));
-    longestSide = ceil(longestSide / voxelsize) * voxelsize;
-
-    // calc max indices
+    if (!spillError.empty())
+    {
+        removeSpillFiles(numSpillFiles);
+        throw std::runtime_error("BigGrid: Writing spill file " + spillError);
+    }
+    m_numPoints = numPoints;
 
-    // m_maxIndex = (size_t)(longestSide/voxelsize);
-    m_maxIndexX = (size_t)(xsize / voxelsize);
-    m_maxIndexY = (size_t)(ysize / voxelsize);
-    m_maxIndexZ = (size_t)(zsize / voxelsize);
-    m_maxIndex = std::max(m_maxIndexX, std::max(m_maxIndexY, m_maxIndexZ)) + 5 * voxelsize;
-    m_maxIndexX += 1;
-    m_maxIndexY += 2;
-    m_maxIndexZ += 3;
-    m_maxIndexSquare = m_maxIndex * m_maxIndex;
+    calcGridIndices();
     std::cout << "BG: " << m_maxIndexSquare << "|" << m_maxIndexX << "|" << m_maxIndexY << "|"
                 << m_maxIndexZ << std::endl;
 
-    string comment = lvr2::timestamp.getElapsedTime() + "Building grid... ";
-    lvr2::ProgressBar progress(this->m_numPoints, comment);
+    // Spill cells in a fixed order to make the layout of the grid deterministic
+    std::vector<std::vector<SpillBlockRef>> spillBlocks;
+    try
+    {
+        spillBlocks = indexSpillFiles(numSpillFiles, spillCells.size());
+    }
+    catch (...)
+    {
+        removeSpillFiles(numSpillFiles);
+        throw;
+    }
+    std::vector<size_t> cells;
+    cells.reserve(spillCells.size());
+    for (auto it = spillCells.begin(); it != spillCells.end(); ++it)
+    {
+        cells.push_back(it->second);
+    }
 
-    lineReader.rewind();
+    // Count the points of the grid cells of each spill cell
+    comment = lvr2::timestamp.getElapsedTime() + "Building grid... ";
+    lvr2::ProgressBar progress(cells.size() * 2, comment);
 
-    size_t idx, idy, idz;
-    while (lineReader.ok())
+    std::vector<std::unordered_map<size_t, CellInfo>> cellInfos(cells.size());
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t c = 0; c < cells.size(); c++)
     {
-        if (lineReader.getFileType() == XYZNRGB)
-        {
-            boost::shared_ptr<xyznc> a = boost::static_pointer_cast<xyznc>(
-                lineReader.getNextPoints(rsize, m_pointBufferSize));
-            if (rsize <= 0 && !lineReader.ok())
-            {
-                break;
-            }
-            int dx, dy, dz;
-            for (int i = 0; i < rsize; i++)
+        std::unordered_map<size_t, CellInfo>& infos = cellInfos[c];
+        auto countPoints = [&](const float* points,
+                               const float* normals,
+                               const unsigned char* colors,
+                               size_t count) {
+            for (size_t i = 0; i < count; i++)
             {
-                ix = a.get()[i].point.x * m_scale;
-                iy = a.get()[i].point.y * m_scale;
-                iz = a.get()[i].point.z * m_scale;
-                idx = calcIndex((ix - m_bb.getMin()[0]) / voxelsize);
-                idy = calcIndex((iy - m_bb.getMin()[1]) / voxelsize);
-                idz = calcIndex((iz - m_bb.getMin()[2]) / voxelsize);
-                int e;
-                this->m_extrude ? e = 8 : e = 1;
+                size_t idx = calcIndex((points[i * 3] - m_bb.getMin()[0]) / voxelsize);
+                size_t idy = calcIndex((points[i * 3 + 1] - m_bb.getMin()[1]) / voxelsize);
+                size_t idz = calcIndex((points[i * 3 + 2] - m_bb.getMin()[2]) / voxelsize);
+                int e = m_extrude ? 8 : 1;
                 for (int j = 0; j < e; j++)
                 {
-                    dx = HGCreateTable[j][0];
-                    dy = HGCreateTable[j][1];
-                    dz = HGCreateTable[j][2];
-                    size_t h = hashValue(idx + dx, idy + dy, idz + dz);
-                    if (j == 0)
-                        m_gridNumPoints[h].size++;
-                    else
+                    size_t ix = idx + HGCreateTable[j][0];
+                    size_t iy = idy + HGCreateTable[j][1];
+                    size_t iz = idz + HGCreateTable[j][2];
+                    auto inserted = infos.emplace(hashValue(ix, iy, iz), CellInfo());
+                    if (inserted.second)
                     {
-                        auto it = m_gridNumPoints.find(h);
-                        if (it == m_gridNumPoints.end())
-                        {
-                            m_gridNumPoints[h].size = 0;
-                        }
+                        inserted.first->second.ix = ix;
+                        inserted.first->second.iy = iy;
+                        inserted.first->second.iz = iz;
                     }
-                }
-            }
-        }
-        else if (lineReader.getFileType() == XYZN)
-        {
-            boost::shared_ptr<xyzn> a = boost::static_pointer_cast<xyzn>(
-                lineReader.getNextPoints(rsize, m_pointBufferSize));
-            if (rsize <= 0 && !lineReader.ok())
-            {
-                break;
-            }
-            int dx, dy, dz;
-            for (int i = 0; i < rsize; i++)
-            {
-                ix = a.get()[i].point.x * m_scale;
-                iy = a.get()[i].point.y * m_scale;
-                iz = a.get()[i].point.z * m_scale;
-                idx = calcIndex((ix - m_bb.getMin()[0]) / voxelsize);
-                idy = calcIndex((iy - m_bb.getMin()[1]) / voxelsize);
-                idz = calcIndex((iz - m_bb.getMin()[2]) / voxelsize);
-
-                int e;
-                this->m_extrude ? e = 8 : e = 1;
-                for (int j = 0; j < e; j++)
-                {
-                    dx = HGCreateTable[j][0];
-                    dy = HGCreateTable[j][1];
-                    dz = HGCreateTable[j][2];
-                    size_t h = hashValue(idx + dx, idy + dy, idz + dz);
                     if (j == 0)
-                        m_gridNumPoints[h].size++;
-                    else
                     {
-                        auto it = m_gridNumPoints.find(h);
-                        if (it == m_gridNumPoints.end())
-                        {
-                            m_gridNumPoints[h].size = 0;
-                        }
+                        inserted.first->second.size++;
                     }
                 }
             }
-        }
-        else if (lineReader.getFileType() == XYZ)
+        };
+        std::string error = forEachSpillBlock(spillBlocks[cells[c]], countPoints);
+        if (!error.empty())
         {
-            boost::shared_ptr<xyz> a = boost::static_pointer_cast<xyz>(
-                lineReader.getNextPoints(rsize, m_pointBufferSize));
-            if (rsize <= 0 && !lineReader.ok())
-            {
-                break;
-            }
-            int dx, dy, dz;
-            for (int i = 0; i < rsize; i++)
-            {
-                ix = a.get()[i].point.x * m_scale;
-                iy = a.get()[i].point.y * m_scale;
-                iz = a.get()[i].point.z * m_scale;
-                idx = calcIndex((ix - m_bb.getMin()[0]) / voxelsize);
-                idy = calcIndex((iy - m_bb.getMin()[1]) / voxelsize);
-                idz = calcIndex((iz - m_bb.getMin()[2]) / voxelsize);
-                int e;
-                this->m_extrude ? e = 8 : e = 1;
-                for (int j = 0; j < e; j++)
-                {
-                    dx = HGCreateTable[j][0];
-                    dy = HGCreateTable[j][1];
-                    dz = HGCreateTable[j][2];
-                    size_t h = hashValue(idx + dx, idy + dy, idz + dz);
-                    if (j == 0)
-                        m_gridNumPoints[h].size++;
-                    else
-                    {
-                        auto it = m_gridNumPoints.find(h);
-                        if (it == m_gridNumPoints.end())
-                        {
-                            m_gridNumPoints[h].size = 0;
-                        }
-                    }
-                }
-            }
+            #pragma omp critical(bigGridSpillCells)
+            spillError = error;
         }
-        else if (lineReader.getFileType() == XYZRGB)
+        ++progress;
+    }
+
+    // Missing points would silently stay zero in the point files
+    if (!spillError.empty())
+    {
+        removeSpillFiles(numSpillFiles);
+        throw std::runtime_error("BigGrid: Reading spill file " + spillError);
+    }
+
+    // Merge the counts and compute the offsets of the cells in the point files
+    for (size_t c = 0; c < cells.size(); c++)
+    {
+        for (auto it = cellInfos[c].begin(); it != cellInfos[c].end(); ++it)
         {
-            boost::shared_ptr<xyzc> a = boost::static_pointer_cast<xyzc>(
-                lineReader.getNextPoints(rsize, m_pointBufferSize));
-            if (rsize <= 0 && !lineReader.ok())
+            auto inserted = m_gridNumPoints.emplace(it->first, it->second);
+            if (!inserted.second)
             {
-                break;
+                inserted.first->second.size += it->second.size;
             }
-            int dx, dy, dz;
-            for (int i = 0; i < rsize; i++)
-            {
-                ix = a.get()[i].point.x * m_scale;
-                iy = a.get()[i].point.y * m_scale;
-                iz = a.get()[i].point.z * m_scale;
-                idx = calcIndex((ix - m_bb.getMin()[0]) / voxelsize);
-                idy = calcIndex((iy - m_bb.getMin()[1]) / voxelsize);
-                idz = calcIndex((iz - m_bb.getMin()[2]) / voxelsize);
-                int e;
-                this->m_extrude ? e = 8 : e = 1;
-                for (int j = 0; j < e; j++)
-                {
-                    dx = HGCreateTable[j][0];
-                    dy = HGCreateTable[j][1];
-                    dz = HGCreateTable[j][2];
-                    size_t h = hashValue(idx + dx, idy + dy, idz + dz);
-                    if (j == 0)
-                        m_gridNumPoints[h].size++;
-                    else
-                    {
-                        auto it = m_gridNumPoints.find(h);
-                        if (it == m_gridNumPoints.end())
-                        {
-                            m_gridNumPoints[h].size = 0;
-                        }
-                    }
-                }
-            }
-        }
-        else
-        {
-            exit(-1);
         }
-        progress += rsize;
     }
 
     size_t num_cells = 0;
@@ -355,187 +370,108 @@ BigGrid<BaseVecT>::BigGrid(std::vector<std::string> cloudPath,
         it->second.dist_offset = num_cells++;
     }
 
-    lineReader.rewind();
+    // Each spill cell gets its own range within every grid cell it contributes to
+    for (size_t c = 0; c < cells.size(); c++)
+    {
+        for (auto it = cellInfos[c].begin(); it != cellInfos[c].end(); ++it)
+        {
+            CellInfo& cell = m_gridNumPoints[it->first];
+            it->second.offset = cell.offset + cell.inserted;
+            cell.inserted += it->second.size;
+        }
+    }
 
     boost::iostreams::mapped_file_params mmfparam;
-    mmfparam.path = "points.mmf";
+    mmfparam.path = scratchFile("points.mmf");
     mmfparam.mode = std::ios_base::in | std::ios_base::out | std::ios_base::trunc;
     mmfparam.new_file_size = sizeof(float) * m_numPoints * 3;
 
     boost::iostreams::mapped_file_params mmfparam_normal;
-    mmfparam_normal.path = "normals.mmf";
+    mmfparam_normal.path = scratchFile("normals.mmf");
     mmfparam_normal.mode = std::ios_base::in | std::ios_base::out | std::ios_base::trunc;
     mmfparam_normal.new_file_size = sizeof(float) * m_numPoints * 3;
 
     boost::iostreams::mapped_file_params mmfparam_color;
-    mmfparam_color.path = "colors.mmf";
+    mmfparam_color.path = scratchFile("colors.mmf");
     mmfparam_color.mode = std::ios_base::in | std::ios_base::out | std::ios_base::trunc;
     mmfparam_color.new_file_size = sizeof(unsigned char) * m_numPoints * 3;
 
     m_PointFile.open(mmfparam);
-    float* mmfdata_normal;
-    unsigned char* mmfdata_color;
-    if (lineReader.getFileType() == XYZNRGB || lineReader.getFileType() == XYZN)
+    float* mmfdata = (float*)m_PointFile.data();
+    float* mmfdata_normal = nullptr;
+    unsigned char* mmfdata_color = nullptr;
+    if (m_has_normal)
     {
         m_NomralFile.open(mmfparam_normal);
         mmfdata_normal = (float*)m_NomralFile.data();
-        m_has_normal = true;
     }
-    if (lineReader.getFileType() == XYZNRGB || lineReader.getFileType() == XYZRGB)
+    if (m_has_color)
     {
         m_ColorFile.open(mmfparam_color);
         mmfdata_color = (unsigned char*)m_ColorFile.data();
-        m_has_color = true;
     }
-    float* mmfdata = (float*)m_PointFile.data();
 
-    while (lineReader.ok())
+    // Copy the points into their cells. The spill cells write to disjoint ranges.
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t c = 0; c < cells.size(); c++)
     {
-        if (lineReader.getFileType() == XYZNRGB)
-        {
-            boost::shared_ptr<xyznc> a = boost::static_pointer_cast<xyznc>(
-                lineReader.getNextPoints(rsize, m_pointBufferSize));
-            if (rsize <= 0 && !lineReader.ok())
-            {
-                break;
-            }
-            for (int i = 0; i < rsize; i++)
-            {
-                ix = a.get()[i].point.x * m_scale;
-                iy = a.get()[i].point.y * m_scale;
-                iz = a.get()[i].point.z * m_scale;
-                size_t idx = calcIndex((ix - m_bb.getMin()[0]) / voxelsize);
-                size_t idy = calcIndex((iy - m_bb.getMin()[1]) / voxelsize);
-                size_t idz = calcIndex((iz - m_bb.getMin()[2]) / voxelsize);
-                size_t h = hashValue(idx, idy, idz);
-                size_t ins = (m_gridNumPoints[h].inserted);
-                m_gridNumPoints[h].ix = idx;
-                m_gridNumPoints[h].iy = idy;
-                m_gridNumPoints[h].iz = idz;
-                m_gridNumPoints[h].inserted++;
-                size_t index = m_gridNumPoints[h].offset + ins;
-                mmfdata[index * 3] = ix;
-                mmfdata[index * 3 + 1] = iy;
-                mmfdata[index * 3 + 2] = iz;
-                mmfdata_normal[index * 3] = a.get()[i].normal.x;
-                mmfdata_normal[index * 3 + 1] = a.get()[i].normal.y;
-                mmfdata_normal[index * 3 + 2] = a.get()[i].normal.z;
-
-                mmfdata_color[index * 3] = a.get()[i].color.r;
-                mmfdata_color[index * 3 + 1] = a.get()[i].color.g;
-                mmfdata_color[index * 3 + 2] = a.get()[i].color.b;
-            }
-        }
-        else if (lineReader.getFileType() == XYZN)
-        {
-            boost::shared_ptr<xyzn> a = boost::static_pointer_cast<xyzn>(
-                lineReader.getNextPoints(rsize, m_pointBufferSize));
-            if (rsize <= 0 && !lineReader.ok())
-            {
-                break;
-            }
-            for (int i = 0; i < rsize; i++)
-            {
-                ix = a.get()[i].point.x * m_scale;
-                iy = a.get()[i].point.y * m_scale;
-                iz = a.get()[i].point.z * m_scale;
-                size_t idx = calcIndex((ix - m_bb.getMin()[0]) / voxelsize);
-                size_t idy = calcIndex((iy - m_bb.getMin()[1]) / voxelsize);
-                size_t idz = calcIndex((iz - m_bb.getMin()[2]) / voxelsize);
-                size_t h = hashValue(idx, idy, idz);
-                size_t ins = (m_gridNumPoints[h].inserted);
-                m_gridNumPoints[h].ix = idx;
-                m_gridNumPoints[h].iy = idy;
-                m_gridNumPoints[h].iz = idz;
-                m_gridNumPoints[h].inserted++;
-                size_t index = m_gridNumPoints[h].offset + ins;
-                mmfdata[index * 3] = ix;
-                mmfdata[index * 3 + 1] = iy;
-                mmfdata[index * 3 + 2] = iz;
-                mmfdata_normal[index * 3] = a.get()[i].normal.x;
-                mmfdata_normal[index * 3 + 1] = a.get()[i].normal.y;
-                mmfdata_normal[index * 3 + 2] = a.get()[i].normal.z;
-            }
-        }
-        else if (lineReader.getFileType() == XYZ)
-        {
-            boost::shared_ptr<xyz> a = boost::static_pointer_cast<xyz>(
-                lineReader.getNextPoints(rsize, m_pointBufferSize));
-            if (rsize <= 0 && !lineReader.ok())
-            {
-                break;
-            }
-            for (int i = 0; i < rsize; i++)
+        std::unordered_map<size_t, CellInfo>& infos = cellInfos[c];
+        auto copyPoints = [&](const float* points,
+                              const float* normals,
+                              const unsigned char* colors,
+                              size_t count) {
+            for (size_t i = 0; i < count; i++)
             {
-                ix = a.get()[i].point.x * m_scale;
-                iy = a.get()[i].point.y * m_scale;
-                iz = a.get()[i].point.z * m_scale;
-                size_t idx = calcIndex((ix - m_bb.getMin()[0]) / voxelsize);
-                size_t idy = calcIndex((iy - m_bb.getMin()[1]) / voxelsize);
-                size_t idz = calcIndex((iz - m_bb.getMin()[2]) / voxelsize);
-                size_t h = hashValue(idx, idy, idz);
-                size_t ins = (m_gridNumPoints[h].inserted);
-                m_gridNumPoints[h].ix = idx;
-                m_gridNumPoints[h].iy = idy;
-                m_gridNumPoints[h].iz = idz;
-                m_gridNumPoints[h].inserted++;
-                size_t index = m_gridNumPoints[h].offset + ins;
-                mmfdata[index * 3] = ix;
-                mmfdata[index * 3 + 1] = iy;
-                mmfdata[index * 3 + 2] = iz;
+                size_t idx = calcIndex((points[i * 3] - m_bb.getMin()[0]) / voxelsize);
+                size_t idy = calcIndex((points[i * 3 + 1] - m_bb.getMin()[1]) / voxelsize);
+                size_t idz = calcIndex((points[i * 3 + 2] - m_bb.getMin()[2]) / voxelsize);
+                size_t index = infos[hashValue(idx, idy, idz)].offset++;
+                std::copy(points + i * 3, points + i * 3 + 3, mmfdata + index * 3);
+                if (m_has_normal)
+                {
+                    std::copy(normals + i * 3, normals + i * 3 + 3, mmfdata_normal + index * 3);
+                }
+                if (m_has_color)
+                {
+                    std::copy(colors + i * 3, colors + i * 3 + 3, mmfdata_color + index * 3);
+                }
             }
-        }
-        else if (lineReader.getFileType() == XYZRGB)
+        };
+        std::string error = forEachSpillBlock(spillBlocks[cells[c]], copyPoints);
+        if (!error.empty())
         {
-            boost::shared_ptr<xyzc> a = boost::static_pointer_cast<xyzc>(
-                lineReader.getNextPoints(rsize, m_pointBufferSize));
-            if (rsize <= 0 && !lineReader.ok())
-            {
-                break;
-            }
-            for (int i = 0; i < rsize; i++)
-            {
-                ix = a.get()[i].point.x * m_scale;
-                iy = a.get()[i].point.y * m_scale;
-                iz = a.get()[i].point.z * m_scale;
-                size_t idx = calcIndex((ix - m_bb.getMin()[0]) / voxelsize);
-                size_t idy = calcIndex((iy - m_bb.getMin()[1]) / voxelsize);
-                size_t idz = calcIndex((iz - m_bb.getMin()[2]) / voxelsize);
-                size_t h = hashValue(idx, idy, idz);
-                size_t ins = (m_gridNumPoints[h].inserted);
-                m_gridNumPoints[h].ix = idx;
-                m_gridNumPoints[h].iy = idy;
-                m_gridNumPoints[h].iz = idz;
-                m_gridNumPoints[h].inserted++;
-                size_t index = m_gridNumPoints[h].offset + ins;
-                mmfdata[index * 3] = ix;
-                mmfdata[index * 3 + 1] = iy;
-                mmfdata[index * 3 + 2] = iz;
-                mmfdata_color[index * 3] = a.get()[i].color.r;
-                mmfdata_color[index * 3 + 1] = a.get()[i].color.g;
-                mmfdata_color[index * 3 + 2] = a.get()[i].color.b;
-            }
+            #pragma omp critical(bigGridSpillCells)
+            spillError = error;
         }
+        std::unordered_map<size_t, CellInfo>().swap(infos);
+        ++progress;
+    }
+    std::cout << std::endl;
+
+    removeSpillFiles(numSpillFiles);
+    if (!spillError.empty())
+    {
+        throw std::runtime_error("BigGrid: Reading spill file " + spillError);
     }
 
-    //    for(auto it = m_gridNumPoints.begin(); it!= m_gridNumPoints.end() ; it++)
-    //    {
-    //        std::cout << "h : " << it->first << std::endl;
-    //    }
     m_PointFile.close();
     m_NomralFile.close();
-    mmfparam.path = "distances.mmf";
+    m_ColorFile.close();
+    mmfparam.path = scratchFile("distances.mmf");
     mmfparam.new_file_size = sizeof(float) * size() * 8;
 
     m_PointFile.open(mmfparam);
     m_PointFile.close();
 }
 
-
 template <typename BaseVecT>
-BigGrid<BaseVecT>::BigGrid(float voxelsize, ScanProjectEditMarkPtr project, float scale)
+BigGrid<BaseVecT>::BigGrid(float voxelsize,
+                           ScanProjectEditMarkPtr project,
+                           float scale,
+                           std::string scratchDir)
         : m_maxIndex(0), m_maxIndexSquare(0), m_maxIndexX(0), m_maxIndexY(0), m_maxIndexZ(0),
-          m_numPoints(0), m_extrude(true), m_scale(scale), m_has_normal(false), m_has_color(false)
+          m_numPoints(0), m_extrude(true), m_scale(scale), m_has_normal(false), m_has_color(false),
+          m_scratchDir(scratchDir)
 {
     /// 
 #ifdef LVR2_USE_OPEN_MP
@@ -685,17 +621,17 @@ BigGrid<BaseVecT>::BigGrid(float voxelsize, ScanProjectEditMarkPtr project, floa
 
         boost::iostreams::mapped_file_params mmfparam;
 
-        mmfparam.path = "points.mmf";
+        mmfparam.path = scratchFile("points.mmf");
         mmfparam.mode = std::ios_base::in | std::ios_base::out | std::ios_base::trunc;
         mmfparam.new_file_size = sizeof(float) * m_numPoints * 3;
 
         boost::iostreams::mapped_file_params mmfparam_normal;
-        mmfparam_normal.path = "normals.mmf";
+        mmfparam_normal.path = scratchFile("normals.mmf");
         mmfparam_normal.mode = std::ios_base::in | std::ios_base::out | std::ios_base::trunc;
         mmfparam_normal.new_file_size = sizeof(float) * m_numPoints * 3;
 
         boost::iostreams::mapped_file_params mmfparam_color;
-        mmfparam_color.path = "colors.mmf";
+        mmfparam_color.path = scratchFile("colors.mmf");
         mmfparam_color.mode = std::ios_base::in | std::ios_base::out | std::ios_base::trunc;
         mmfparam_color.new_file_size = sizeof(unsigned char) * m_numPoints * 3;
 
@@ -751,7 +687,7 @@ BigGrid<BaseVecT>::BigGrid(float voxelsize, ScanProjectEditMarkPtr project, floa
         
         m_PointFile.close();
         m_NomralFile.close();
-        mmfparam.path = "distances.mmf";
+        mmfparam.path = scratchFile("distances.mmf");
         mmfparam.new_file_size = sizeof(float) * size() * 8;
 
         m_PointFile.open(mmfparam);
@@ -769,7 +705,7 @@ BigGrid<BaseVecT>::~BigGrid()
 }
 
 template <typename BaseVecT>
-BigGrid<BaseVecT>::BigGrid(std::string path)
+BigGrid<BaseVecT>::BigGrid(std::string path, std::string scratchDir) : m_scratchDir(scratchDir)
 {
     ifstream ifs(path, ios::binary);
 
@@ -876,6 +812,160 @@ void BigGrid<BaseVecT>::serialize(std::string path)
     ofs.close();
 }
 
+template <typename BaseVecT>
+void BigGrid<BaseVecT>::calcGridIndices()
+{
+    // Make box side lenghts be divisible by voxel size
+    BaseVecT center = m_bb.getCentroid();
+    float xsize = ceil(m_bb.getXSize() / m_voxelSize) * m_voxelSize;
+    float ysize = ceil(m_bb.getYSize() / m_voxelSize) * m_voxelSize;
+    float zsize = ceil(m_bb.getZSize() / m_voxelSize) * m_voxelSize;
+    m_bb.expand(BaseVecT(center.x + xsize / 2, center.y + ysize / 2, center.z + zsize / 2));
+    m_bb.expand(BaseVecT(center.x - xsize / 2, center.y - ysize / 2, center.z - zsize / 2));
+
+    // calc max indices
+    m_maxIndexX = (size_t)(xsize / m_voxelSize);
+    m_maxIndexY = (size_t)(ysize / m_voxelSize);
+    m_maxIndexZ = (size_t)(zsize / m_voxelSize);
+    m_maxIndex = std::max(m_maxIndexX, std::max(m_maxIndexY, m_maxIndexZ)) + 5 * m_voxelSize;
+    m_maxIndexX += 1;
+    m_maxIndexY += 2;
+    m_maxIndexZ += 3;
+    m_maxIndexSquare = m_maxIndex * m_maxIndex;
+}
+
+template <typename BaseVecT>
+std::string BigGrid<BaseVecT>::scratchFile(const std::string& name) const
+{
+    return (boost::filesystem::path(m_scratchDir) / name).string();
+}
+
+template <typename BaseVecT>
+std::string BigGrid<BaseVecT>::spillFile(size_t index) const
+{
+    return scratchFile("spill_" + std::to_string(index) + ".bin");
+}
+
+template <typename BaseVecT>
+std::vector<std::vector<typename BigGrid<BaseVecT>::SpillBlockRef>>
+BigGrid<BaseVecT>::indexSpillFiles(size_t numSpillFiles, size_t numCells)
+{
+    const size_t pointBytes = sizeof(float) * 3 * (m_has_normal ? 2 : 1) + (m_has_color ? 3 : 0);
+
+    std::vector<std::vector<SpillBlockRef>> blocks(numCells);
+    for (size_t i = 0; i < numSpillFiles; i++)
+    {
+        FILE* in = fopen(spillFile(i).c_str(), "rb");
+        if (in == nullptr)
+        {
+            throw std::runtime_error("BigGrid: Reading spill file " + spillFile(i)
+                                     + " failed: " + std::strerror(errno));
+        }
+
+        // a block that ends past the end of the file would leave points missing
+        const size_t fileSize = boost::filesystem::file_size(spillFile(i));
+        size_t offset = 0;
+        while (offset < fileSize)
+        {
+            SpillBlock block;
+            if (fseek(in, offset, SEEK_SET) != 0 || fread(&block, sizeof(SpillBlock), 1, in) != 1
+                || block.cell >= numCells
+                || block.count > (fileSize - offset - sizeof(SpillBlock)) / pointBytes)
+            {
+                fclose(in);
+                throw std::runtime_error("BigGrid: Spill file " + spillFile(i) + " is corrupt");
+            }
+            offset += sizeof(SpillBlock);
+            blocks[block.cell].push_back(SpillBlockRef{block, i, static_cast<long>(offset)});
+            offset += block.count * pointBytes;
+        }
+        fclose(in);
+    }
+
+    for (auto& cellBlocks : blocks)
+    {
+        std::sort(cellBlocks.begin(),
+                  cellBlocks.end(),
+                  [](const SpillBlockRef& a, const SpillBlockRef& b) {
+                      return a.block.file < b.block.file
+                             || (a.block.file == b.block.file && a.block.seq < b.block.seq);
+                  });
+    }
+    return blocks;
+}
+
+template <typename BaseVecT>
+void BigGrid<BaseVecT>::removeSpillFiles(size_t numSpillFiles)
+{
+    for (size_t i = 0; i < numSpillFiles; i++)
+    {
+        boost::filesystem::remove(spillFile(i));
+    }
+}
+
+template <typename BaseVecT>
+template <typename F>
+std::string BigGrid<BaseVecT>::forEachSpillBlock(const std::vector<SpillBlockRef>& blocks,
+                                                 F func)
+{
+    // every call uses its own handles, so the spill cells can be read in parallel
+    std::map<size_t, FILE*> files;
+
+    std::string error;
+    std::vector<float> points;
+    std::vector<float> normals;
+    std::vector<unsigned char> colors;
+    for (const auto& b : blocks)
+    {
+        FILE*& in = files[b.spillFile];
+        if (in == nullptr)
+        {
+            in = fopen(spillFile(b.spillFile).c_str(), "rb");
+            if (in == nullptr)
+            {
+                error = spillFile(b.spillFile) + " failed: " + std::strerror(errno);
+                break;
+            }
+        }
+
+        size_t count = b.block.count;
+        size_t read = 0;
+        if (fseek(in, b.offset, SEEK_SET) == 0)
+        {
+            points.resize(count * 3);
+            read += fread(points.data(), sizeof(float), count * 3, in);
+            if (m_has_normal)
+            {
+                normals.resize(count * 3);
+                read += fread(normals.data(), sizeof(float), count * 3, in);
+            }
+            if (m_has_color)
+            {
+                colors.resize(count * 3);
+                read += fread(colors.data(), 1, count * 3, in);
+            }
+        }
+        if (read != count * 3 * (1 + m_has_normal + m_has_color))
+        {
+            error = spillFile(b.spillFile) + " failed: File is truncated";
+            break;
+        }
+        func(points.data(),
+             m_has_normal ? normals.data() : nullptr,
+             m_has_color ? colors.data() : nullptr,
+             count);
+    }
+
+    for (auto& file : files)
+    {
+        if (file.second != nullptr)
+        {
+            fclose(file.second);
+        }
+    }
+    return error;
+}
+
 template <typename BaseVecT>
 size_t BigGrid<BaseVecT>::size()
 {
@@ -915,7 +1005,7 @@ lvr2::floatArr BigGrid<BaseVecT>::points(int i, int j, int k, size_t& numPoints)
 
         points = lvr2::floatArr(new float[3 * cellSize]);
         boost::iostreams::mapped_file_params mmfparam;
-        mmfparam.path = "points.mmf";
+        mmfparam.path = scratchFile("points.mmf");
         mmfparam.mode = std::ios_base::in | std::ios_base::out | std::ios_base::trunc;
 
         m_PointFile.open(mmfparam);
@@ -952,7 +1042,7 @@ lvr2::floatArr BigGrid<BaseVecT>::points(
     lvr2::floatArr points(new float[numPoints * 3]);
     size_t p_index = 0;
 
-    boost::iostreams::mapped_file_source mmfs("points.mmf");
+    boost::iostreams::mapped_file_source mmfs(scratchFile("points.mmf"));
     float* mmfdata = (float*)mmfs.data();
 
     for (auto it = m_gridNumPoints.begin(); it != m_gridNumPoints.end(); it++)
@@ -977,7 +1067,7 @@ template <typename BaseVecT>
 lvr2::floatArr BigGrid<BaseVecT>::normals(
     float minx, float miny, float minz, float maxx, float maxy, float maxz, size_t& numPoints)
 {
-    std::ifstream ifs("normals.mmf");
+    std::ifstream ifs(scratchFile("normals.mmf"));
     if (!ifs.good())
     {
         numPoints = 0;
@@ -1003,7 +1093,7 @@ lvr2::floatArr BigGrid<BaseVecT>::normals(
     lvr2::floatArr points(new float[numPoints * 3]);
     size_t p_index = 0;
 
-    boost::iostreams::mapped_file_source mmfs("normals.mmf");
+    boost::iostreams::mapped_file_source mmfs(scratchFile("normals.mmf"));
     float* mmfdata = (float*)mmfs.data();
 
     for (auto it = m_gridNumPoints.begin(); it != m_gridNumPoints.end(); it++)
@@ -1029,7 +1119,7 @@ template <typename BaseVecT>
 lvr2::ucharArr BigGrid<BaseVecT>::colors(
     float minx, float miny, float minz, float maxx, float maxy, float maxz, size_t& numPoints)
 {
-    std::ifstream ifs("colors.mmf");
+    std::ifstream ifs(scratchFile("colors.mmf"));
     if (!ifs.good())
     {
         numPoints = 0;
@@ -1055,7 +1145,7 @@ lvr2::ucharArr BigGrid<BaseVecT>::colors(
     lvr2::ucharArr points(new unsigned char[numPoints * 3]);
     size_t p_index = 0;
 
-    boost::iostreams::mapped_file_source mmfs("colors.mmf");
+    boost::iostreams::mapped_file_source mmfs(scratchFile("colors.mmf"));
     unsigned char* mmfdata = (unsigned char*)mmfs.data();
 
     for (auto it = m_gridNumPoints.begin(); it != m_gridNumPoints.end(); it++)
@@ -1095,7 +1185,7 @@ lvr2::floatArr BigGrid<BaseVecT>::getPointCloud(size_t& numPoints)
 {
     lvr2::floatArr points(new float[3 * pointSize()]);
     boost::iostreams::mapped_file_params mmfparam;
-    mmfparam.path = "points.mmf";
+    mmfparam.path = scratchFile("points.mmf");
     mmfparam.mode = std::ios_base::in | std::ios_base::out | std::ios_base::trunc;
 
     m_PointFile.open(mmfparam);
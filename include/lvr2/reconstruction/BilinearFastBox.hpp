@@ -73,6 +73,20 @@ public:
         float comparePrecision
     );
 
+    /**
+     * @brief Same as FastBox::getLocalSurface, but extruded boxes are
+     *        triangulated, too (as in \ref getSurface).
+     */
+    virtual int getLocalSurface(
+        vector<QueryPoint<BaseVecT>>& query_points,
+        BaseVecT* positions
+    );
+
+    /**
+     * @brief Stores the given face for \ref optimizePlanarFaces
+     */
+    virtual void addLocalFace(FaceHandle face) { m_faces.push_back(face); }
+
     void optimizePlanarFaces(BaseMesh<BaseVecT>& mesh, size_t kc);
 
     // the point set surface
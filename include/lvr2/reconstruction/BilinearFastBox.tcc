@@ -124,6 +124,12 @@ void BilinearFastBox<BaseVecT>::getSurface(
      }
 }
 
+template<typename BaseVecT>
+int BilinearFastBox<BaseVecT>::getLocalSurface(vector<QueryPoint<BaseVecT>>& qp, BaseVecT* positions)
+{
+    return this->calcLocalSurface(qp, positions);
+}
+
  template<typename BaseVecT>
  void BilinearFastBox<BaseVecT>::optimizePlanarFaces(BaseMesh<BaseVecT>& mesh, size_t kc)
  {
@@ -0,0 +1,212 @@
+/**
+ * Copyright (c) 2018, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * CellMaps.hpp
+ */
+
+#ifndef _LVR2_RECONSTRUCTION_CELLMAPS_H_
+#define _LVR2_RECONSTRUCTION_CELLMAPS_H_
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lvr2
+{
+
+/**
+ * @brief Cell storage of a HashGrid that allocates every box on the heap
+ *        and keeps the pointers in a std::unordered_map.
+ *
+ * The map owns the boxes, i.e., all boxes that were created via createBox()
+ * or createBoxes() are deleted together with the map.
+ */
+template<typename BoxT>
+class PointerCellMap : public std::unordered_map<size_t, BoxT*>
+{
+public:
+    PointerCellMap() = default;
+
+    PointerCellMap(const PointerCellMap&) = delete;
+    PointerCellMap& operator=(const PointerCellMap&) = delete;
+
+    ~PointerCellMap();
+
+    /**
+     * @brief Creates a new box with the given constructor arguments. The box
+     *        is not inserted into the map.
+     */
+    template<typename... Args>
+    BoxT* createBox(Args&&... args);
+
+    /**
+     * @brief Creates n boxes concurrently. The constructor argument of the
+     *        i-th box is given by init(i).
+     *
+     * @return A vector with pointers to the new boxes
+     */
+    template<typename InitFunc>
+    std::vector<BoxT*> createBoxes(size_t n, InitFunc init);
+
+private:
+    std::vector<BoxT*> m_boxes;
+};
+
+/**
+ * @brief Cell storage of a HashGrid based on a flat open addressing table.
+ *
+ * All boxes are stored contiguously in large blocks instead of being
+ * allocated one by one. The cell entries (hash value, box pointer) are kept
+ * in insertion order, so iterating over all cells walks linearly through
+ * memory. Lookups use a linear probing table that only stores the hash value
+ * and the position of the entry.
+ *
+ * The interface mirrors the subset of std::unordered_map that is used by
+ * HashGrid: begin(), end(), find(), operator[], size(), reserve() and clear().
+ * Cells can not be removed. The hash value std::numeric_limits<size_t>::max()
+ * is reserved to mark empty slots.
+ */
+template<typename BoxT>
+class FlatCellMap
+{
+public:
+    using key_type = size_t;
+    using mapped_type = BoxT*;
+    using value_type = std::pair<size_t, BoxT*>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    FlatCellMap();
+
+    FlatCellMap(const FlatCellMap&) = delete;
+    FlatCellMap& operator=(const FlatCellMap&) = delete;
+
+    ~FlatCellMap();
+
+    iterator begin() { return m_entries.begin(); }
+    iterator end() { return m_entries.end(); }
+    const_iterator begin() const { return m_entries.begin(); }
+    const_iterator end() const { return m_entries.end(); }
+
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+
+    /**
+     * @brief Returns an iterator to the cell with the given hash value or
+     *        end() if no such cell exists. Safe to call concurrently as long
+     *        as the map is not modified.
+     */
+    iterator find(size_t key);
+    const_iterator find(size_t key) const;
+
+    /**
+     * @brief Returns a reference to the box pointer of the given cell.
+     *        Inserts a nullptr if the cell does not exist yet.
+     */
+    BoxT*& operator[](size_t key);
+
+    /**
+     * @brief Prepares the map for n cells without further rehashing
+     */
+    void reserve(size_t n);
+
+    /**
+     * @brief Removes all cells and destroys all boxes
+     */
+    void clear();
+
+    /**
+     * @brief Creates a new box with the given constructor arguments within
+     *        the box storage. The box is not inserted into the map.
+     */
+    template<typename... Args>
+    BoxT* createBox(Args&&... args);
+
+    /**
+     * @brief Creates n boxes concurrently in one contiguous block. The
+     *        constructor argument of the i-th box is given by init(i).
+     *
+     * @return A vector with pointers to the new boxes
+     */
+    template<typename InitFunc>
+    std::vector<BoxT*> createBoxes(size_t n, InitFunc init);
+
+private:
+
+    /// A contiguous block of boxes
+    struct Block
+    {
+        BoxT* data;
+        size_t size;
+        size_t capacity;
+    };
+
+    /// An entry of the probing table
+    struct Slot
+    {
+        size_t key;
+        size_t index;
+    };
+
+    static constexpr size_t EMPTY = std::numeric_limits<size_t>::max();
+
+    /// Number of boxes in a block created by createBox()
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+    /// Returns the slot of the given key or the empty slot where it belongs
+    size_t findSlot(size_t key) const;
+
+    /// Resizes the probing table to the given number of slots (power of two)
+    void rehash(size_t numSlots);
+
+    /// Allocates a new block of boxes
+    Block& newBlock(size_t capacity);
+
+    /// Cells in insertion order
+    std::vector<value_type> m_entries;
+
+    /// Open addressing table with linear probing
+    std::vector<Slot> m_slots;
+
+    /// Number of slots - 1
+    size_t m_mask;
+
+    /// Box storage
+    std::vector<Block> m_blocks;
+
+    std::allocator<BoxT> m_allocator;
+};
+
+} // namespace lvr2
+
+#include "CellMaps.tcc"
+
+#endif /* _LVR2_RECONSTRUCTION_CELLMAPS_H_ */
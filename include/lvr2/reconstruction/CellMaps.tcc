@@ -0,0 +1,224 @@
+/**
+ * Copyright (c) 2018, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * CellMaps.tcc
+ */
+
+#include <algorithm>
+#include <new>
+
+namespace lvr2
+{
+
+template<typename BoxT>
+PointerCellMap<BoxT>::~PointerCellMap()
+{
+    for (BoxT* box : m_boxes)
+    {
+        delete box;
+    }
+}
+
+template<typename BoxT>
+template<typename... Args>
+BoxT* PointerCellMap<BoxT>::createBox(Args&&... args)
+{
+    BoxT* box = new BoxT(std::forward<Args>(args)...);
+    m_boxes.push_back(box);
+    return box;
+}
+
+template<typename BoxT>
+template<typename InitFunc>
+std::vector<BoxT*> PointerCellMap<BoxT>::createBoxes(size_t n, InitFunc init)
+{
+    std::vector<BoxT*> boxes(n);
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++)
+    {
+        boxes[i] = new BoxT(init(i));
+    }
+
+    m_boxes.insert(m_boxes.end(), boxes.begin(), boxes.end());
+    return boxes;
+}
+
+template<typename BoxT>
+FlatCellMap<BoxT>::FlatCellMap()
+{
+    rehash(16);
+}
+
+template<typename BoxT>
+FlatCellMap<BoxT>::~FlatCellMap()
+{
+    clear();
+}
+
+template<typename BoxT>
+size_t FlatCellMap<BoxT>::findSlot(size_t key) const
+{
+    // Hash values of neighboring cells are consecutive numbers, so they are
+    // scattered over the table to avoid long probing sequences
+    size_t h = key * 0x9E3779B97F4A7C15ull;
+    size_t slot = (h ^ (h >> 32)) & m_mask;
+
+    while (m_slots[slot].key != key && m_slots[slot].key != EMPTY)
+    {
+        slot = (slot + 1) & m_mask;
+    }
+    return slot;
+}
+
+template<typename BoxT>
+typename FlatCellMap<BoxT>::iterator FlatCellMap<BoxT>::find(size_t key)
+{
+    const Slot& slot = m_slots[findSlot(key)];
+    return slot.key == EMPTY ? m_entries.end() : m_entries.begin() + slot.index;
+}
+
+template<typename BoxT>
+typename FlatCellMap<BoxT>::const_iterator FlatCellMap<BoxT>::find(size_t key) const
+{
+    const Slot& slot = m_slots[findSlot(key)];
+    return slot.key == EMPTY ? m_entries.end() : m_entries.begin() + slot.index;
+}
+
+template<typename BoxT>
+BoxT*& FlatCellMap<BoxT>::operator[](size_t key)
+{
+    // Keep the load factor below 0.7
+    if ((m_entries.size() + 1) * 10 > m_slots.size() * 7)
+    {
+        rehash(m_slots.size() * 2);
+    }
+
+    Slot& slot = m_slots[findSlot(key)];
+    if (slot.key == EMPTY)
+    {
+        slot.key = key;
+        slot.index = m_entries.size();
+        m_entries.emplace_back(key, nullptr);
+    }
+    return m_entries[slot.index].second;
+}
+
+template<typename BoxT>
+void FlatCellMap<BoxT>::reserve(size_t n)
+{
+    size_t numSlots = m_slots.size();
+    while (n * 10 > numSlots * 7)
+    {
+        numSlots *= 2;
+    }
+
+    if (numSlots > m_slots.size())
+    {
+        rehash(numSlots);
+    }
+    m_entries.reserve(n);
+}
+
+template<typename BoxT>
+void FlatCellMap<BoxT>::rehash(size_t numSlots)
+{
+    m_slots.assign(numSlots, Slot{EMPTY, 0});
+    m_mask = numSlots - 1;
+
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+        Slot& slot = m_slots[findSlot(m_entries[i].first)];
+        slot.key = m_entries[i].first;
+        slot.index = i;
+    }
+}
+
+template<typename BoxT>
+void FlatCellMap<BoxT>::clear()
+{
+    for (Block& block : m_blocks)
+    {
+        for (size_t i = 0; i < block.size; i++)
+        {
+            std::allocator_traits<std::allocator<BoxT>>::destroy(m_allocator, block.data + i);
+        }
+        m_allocator.deallocate(block.data, block.capacity);
+    }
+    m_blocks.clear();
+
+    m_entries.clear();
+    rehash(16);
+}
+
+template<typename BoxT>
+typename FlatCellMap<BoxT>::Block& FlatCellMap<BoxT>::newBlock(size_t capacity)
+{
+    m_blocks.push_back(Block{m_allocator.allocate(capacity), 0, capacity});
+    return m_blocks.back();
+}
+
+template<typename BoxT>
+template<typename... Args>
+BoxT* FlatCellMap<BoxT>::createBox(Args&&... args)
+{
+    if (m_blocks.empty() || m_blocks.back().size == m_blocks.back().capacity)
+    {
+        newBlock(BLOCK_SIZE);
+    }
+
+    Block& block = m_blocks.back();
+    BoxT* box = block.data + block.size;
+    new (box) BoxT(std::forward<Args>(args)...);
+    block.size++;
+    return box;
+}
+
+template<typename BoxT>
+template<typename InitFunc>
+std::vector<BoxT*> FlatCellMap<BoxT>::createBoxes(size_t n, InitFunc init)
+{
+    std::vector<BoxT*> boxes(n);
+    if (n == 0)
+    {
+        return boxes;
+    }
+
+    Block& block = newBlock(n);
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++)
+    {
+        boxes[i] = new (block.data + i) BoxT(init(i));
+    }
+    block.size = n;
+
+    return boxes;
+}
+
+} // namespace lvr2
@@ -0,0 +1,338 @@
+/**
+ * Copyright (c) 2018, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ *  CovariancePCA.hpp
+ *
+ *  Vectorized covariance accumulation and a closed-form eigen solver
+ *  for symmetric 3x3 matrices used for fast normal estimation.
+ */
+
+#ifndef LVR2_RECONSTRUCTION_COVARIANCEPCA_H_
+#define LVR2_RECONSTRUCTION_COVARIANCEPCA_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define LVR2_PCA_AVX2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LVR2_PCA_NEON
+#endif
+
+namespace lvr2
+{
+
+namespace pca_detail
+{
+
+/**
+ * @brief   Adds the sums of the coordinates and of their pairwise products
+ *          of n points given in SoA layout to \ref sums
+ *          (x, y, z, xx, xy, xz, yy, yz, zz).
+ */
+inline void accumulate(const float* x, const float* y, const float* z, size_t n, float sums[9])
+{
+    size_t i = 0;
+
+#if defined(LVR2_PCA_AVX2)
+    __m256 acc[9];
+    for(int j = 0; j < 9; j++)
+    {
+        acc[j] = _mm256_setzero_ps();
+    }
+
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256 vx = _mm256_loadu_ps(x + i);
+        __m256 vy = _mm256_loadu_ps(y + i);
+        __m256 vz = _mm256_loadu_ps(z + i);
+
+        acc[0] = _mm256_add_ps(acc[0], vx);
+        acc[1] = _mm256_add_ps(acc[1], vy);
+        acc[2] = _mm256_add_ps(acc[2], vz);
+        acc[3] = _mm256_fmadd_ps(vx, vx, acc[3]);
+        acc[4] = _mm256_fmadd_ps(vx, vy, acc[4]);
+        acc[5] = _mm256_fmadd_ps(vx, vz, acc[5]);
+        acc[6] = _mm256_fmadd_ps(vy, vy, acc[6]);
+        acc[7] = _mm256_fmadd_ps(vy, vz, acc[7]);
+        acc[8] = _mm256_fmadd_ps(vz, vz, acc[8]);
+    }
+
+    alignas(32) float lanes[8];
+    for(int j = 0; j < 9; j++)
+    {
+        _mm256_store_ps(lanes, acc[j]);
+        for(int l = 0; l < 8; l++)
+        {
+            sums[j] += lanes[l];
+        }
+    }
+#elif defined(LVR2_PCA_NEON)
+    float32x4_t acc[9];
+    for(int j = 0; j < 9; j++)
+    {
+        acc[j] = vdupq_n_f32(0.0f);
+    }
+
+    for(; i + 4 <= n; i += 4)
+    {
+        float32x4_t vx = vld1q_f32(x + i);
+        float32x4_t vy = vld1q_f32(y + i);
+        float32x4_t vz = vld1q_f32(z + i);
+
+        acc[0] = vaddq_f32(acc[0], vx);
+        acc[1] = vaddq_f32(acc[1], vy);
+        acc[2] = vaddq_f32(acc[2], vz);
+        acc[3] = vmlaq_f32(acc[3], vx, vx);
+        acc[4] = vmlaq_f32(acc[4], vx, vy);
+        acc[5] = vmlaq_f32(acc[5], vx, vz);
+        acc[6] = vmlaq_f32(acc[6], vy, vy);
+        acc[7] = vmlaq_f32(acc[7], vy, vz);
+        acc[8] = vmlaq_f32(acc[8], vz, vz);
+    }
+
+    float lanes[4];
+    for(int j = 0; j < 9; j++)
+    {
+        vst1q_f32(lanes, acc[j]);
+        sums[j] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+#endif
+
+    // Scalar fallback and remainder
+    for(; i < n; i++)
+    {
+        sums[0] += x[i];
+        sums[1] += y[i];
+        sums[2] += z[i];
+        sums[3] += x[i] * x[i];
+        sums[4] += x[i] * y[i];
+        sums[5] += x[i] * z[i];
+        sums[6] += y[i] * y[i];
+        sums[7] += y[i] * z[i];
+        sums[8] += z[i] * z[i];
+    }
+}
+
+/**
+ * @brief   Calculates an eigenvector of the symmetric 3x3 matrix \ref a
+ *          (xx, xy, xz, yy, yz, zz) for the eigenvalue \ref e from the
+ *          cross products of the rows of (a - e * I).
+ *
+ * @return  False, if the eigenvalue is not simple, i.e., no unique
+ *          eigenvector exists.
+ */
+inline bool eigenvector(const double a[6], double e, double v[3])
+{
+    const double r0[3] = {a[0] - e, a[1], a[2]};
+    const double r1[3] = {a[1], a[3] - e, a[4]};
+    const double r2[3] = {a[2], a[4], a[5] - e};
+
+    double c[3][3] = {
+        {r0[1] * r1[2] - r0[2] * r1[1], r0[2] * r1[0] - r0[0] * r1[2], r0[0] * r1[1] - r0[1] * r1[0]},
+        {r0[1] * r2[2] - r0[2] * r2[1], r0[2] * r2[0] - r0[0] * r2[2], r0[0] * r2[1] - r0[1] * r2[0]},
+        {r1[1] * r2[2] - r1[2] * r2[1], r1[2] * r2[0] - r1[0] * r2[2], r1[0] * r2[1] - r1[1] * r2[0]}
+    };
+
+    // Use the numerically most stable cross product
+    int best = 0;
+    double bestNorm = 0;
+    for(int j = 0; j < 3; j++)
+    {
+        double norm = c[j][0] * c[j][0] + c[j][1] * c[j][1] + c[j][2] * c[j][2];
+        if(norm > bestNorm)
+        {
+            bestNorm = norm;
+            best = j;
+        }
+    }
+
+    if(bestNorm < 1e-20)
+    {
+        return false;
+    }
+
+    double inv = 1.0 / std::sqrt(bestNorm);
+    v[0] = c[best][0] * inv;
+    v[1] = c[best][1] * inv;
+    v[2] = c[best][2] * inv;
+    return true;
+}
+
+} // namespace pca_detail
+
+/**
+ * @brief   Calculates the centroid and the covariance matrix of k points
+ *          of an interleaved xyz coordinate array. The coordinates are
+ *          gathered in small blocks and accumulated with AVX2 or NEON
+ *          instructions if available.
+ *
+ * @param points    Interleaved xyz coordinates of the point cloud
+ * @param ids       The indices of the k points in \ref points
+ * @param k         The number of points. Has to be larger than 0.
+ * @param centroid  The centroid of the points
+ * @param cov       The upper triangle of the covariance matrix
+ *                  (xx, xy, xz, yy, yz, zz)
+ */
+inline void calcCovariance(const float* points, const size_t* ids, size_t k, float centroid[3], float cov[6])
+{
+    // Shift the coordinates to the first point to avoid cancellation
+    const float* origin = points + 3 * ids[0];
+
+    const size_t blockSize = 64;
+    alignas(32) float x[blockSize];
+    alignas(32) float y[blockSize];
+    alignas(32) float z[blockSize];
+    float sums[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+    for(size_t start = 0; start < k; start += blockSize)
+    {
+        size_t n = std::min(blockSize, k - start);
+        for(size_t j = 0; j < n; j++)
+        {
+            const float* p = points + 3 * ids[start + j];
+            x[j] = p[0] - origin[0];
+            y[j] = p[1] - origin[1];
+            z[j] = p[2] - origin[2];
+        }
+        pca_detail::accumulate(x, y, z, n, sums);
+    }
+
+    const double inv = 1.0 / k;
+    const double mx = sums[0] * inv;
+    const double my = sums[1] * inv;
+    const double mz = sums[2] * inv;
+
+    cov[0] = sums[3] * inv - mx * mx;
+    cov[1] = sums[4] * inv - mx * my;
+    cov[2] = sums[5] * inv - mx * mz;
+    cov[3] = sums[6] * inv - my * my;
+    cov[4] = sums[7] * inv - my * mz;
+    cov[5] = sums[8] * inv - mz * mz;
+
+    centroid[0] = origin[0] + mx;
+    centroid[1] = origin[1] + my;
+    centroid[2] = origin[2] + mz;
+}
+
+/**
+ * @brief   Calculates the eigenvector of the smallest eigenvalue of a
+ *          symmetric 3x3 matrix in closed form (trigonometric solution of
+ *          the characteristic polynomial). For a covariance matrix this is
+ *          the normal of the least squares plane.
+ *
+ * @param cov       The upper triangle of the matrix (xx, xy, xz, yy, yz, zz)
+ * @param normal    The normalized eigenvector. (0, 0, 1) if the matrix
+ *                  is a multiple of the identity.
+ * @return          The smallest eigenvalue
+ */
+inline float smallestEigenvector(const float cov[6], float normal[3])
+{
+    normal[0] = 0.0f;
+    normal[1] = 0.0f;
+    normal[2] = 1.0f;
+
+    // Scale the matrix to avoid over- and underflows
+    double scale = 0;
+    for(int j = 0; j < 6; j++)
+    {
+        scale = std::max(scale, (double)std::fabs(cov[j]));
+    }
+    if(scale == 0)
+    {
+        return 0.0f;
+    }
+
+    double a[6];
+    for(int j = 0; j < 6; j++)
+    {
+        a[j] = cov[j] / scale;
+    }
+
+    // Eigenvalues of a = m * I + p * b
+    const double m = (a[0] + a[3] + a[5]) / 3.0;
+    const double b00 = a[0] - m;
+    const double b11 = a[3] - m;
+    const double b22 = a[5] - m;
+    const double p2 = (b00 * b00 + b11 * b11 + b22 * b22
+                    + 2.0 * (a[1] * a[1] + a[2] * a[2] + a[4] * a[4])) / 6.0;
+    if(p2 < 1e-30)
+    {
+        return m * scale;
+    }
+
+    const double p = std::sqrt(p2);
+    const double det = b00 * (b11 * b22 - a[4] * a[4])
+                     - a[1] * (a[1] * b22 - a[4] * a[2])
+                     + a[2] * (a[1] * a[4] - b11 * a[2]);
+    const double r = std::min(1.0, std::max(-1.0, det / (2.0 * p2 * p)));
+    const double phi = std::acos(r) / 3.0;
+
+    const double eMax = m + 2.0 * p * std::cos(phi);
+    const double eMin = m + 2.0 * p * std::cos(phi + 2.0 * M_PI / 3.0);
+
+    double v[3];
+    if(!pca_detail::eigenvector(a, eMin, v))
+    {
+        // The smallest eigenvalue is a double root. Every vector orthogonal
+        // to the eigenvector of the largest eigenvalue is a solution.
+        double u[3];
+        if(!pca_detail::eigenvector(a, eMax, u))
+        {
+            return eMin * scale;
+        }
+
+        // Cross product with the coordinate axis that is least parallel to u
+        int axis = 0;
+        if(std::fabs(u[1]) < std::fabs(u[axis])) axis = 1;
+        if(std::fabs(u[2]) < std::fabs(u[axis])) axis = 2;
+        double e[3] = {0, 0, 0};
+        e[axis] = 1.0;
+
+        v[0] = u[1] * e[2] - u[2] * e[1];
+        v[1] = u[2] * e[0] - u[0] * e[2];
+        v[2] = u[0] * e[1] - u[1] * e[0];
+        double inv = 1.0 / std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        v[0] *= inv;
+        v[1] *= inv;
+        v[2] *= inv;
+    }
+
+    normal[0] = v[0];
+    normal[1] = v[1];
+    normal[2] = v[2];
+    return eMin * scale;
+}
+
+} // namespace lvr2
+
+#endif /* LVR2_RECONSTRUCTION_COVARIANCEPCA_H_ */
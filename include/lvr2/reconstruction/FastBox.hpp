@@ -137,6 +137,28 @@ public:
         float comparePrecision
     );
 
+    /**
+     * @brief Calculates the local Marching Cubes configuration of the box
+     *        without touching the mesh or the neighbor boxes. Used by
+     *        the parallel surface extraction.
+     *
+     * @param query_points  A vector containing the query points of the
+     *                      reconstruction grid
+     * @param positions     The twelve interpolated edge intersections
+     * @return              The index into the MC table or -1 if the box
+     *                      does not contribute to the surface.
+     */
+    virtual int getLocalSurface(
+        vector<QueryPoint<BaseVecT>>& query_points,
+        BaseVecT* positions
+    );
+
+    /**
+     * @brief Is called for every face that was created from the local
+     *        surface of this box during parallel surface extraction.
+     */
+    virtual void addLocalFace(FaceHandle face) {}
+
     /// The voxelsize of the reconstruction grid
     static float             m_voxelsize;
 
@@ -209,6 +231,15 @@ protected:
 
     float distanceToBB(const BaseVecT& v, const BoundingBox<BaseVecT>& bb) const;
 
+    /**
+     * @brief Calculates the MC index and the edge intersections
+     *        regardless of the extrusion flag.
+     *
+     * @return The index into the MC table or -1 if one of the corners
+     *         is invalid.
+     */
+    int calcLocalSurface(vector<QueryPoint<BaseVecT>>& query_points, BaseVecT* positions);
+
 
     /// The eight box corners
     uint                        m_vertices[8];
@@ -194,6 +194,38 @@ void FastBox<BaseVecT>::getIntersections(BaseVecT* corners,
 }
 
 
+template<typename BaseVecT>
+int FastBox<BaseVecT>::calcLocalSurface(vector<QueryPoint<BaseVecT>>& qp, BaseVecT* positions)
+{
+    // Do not create triangles for invalid boxes
+    for (int i = 0; i < 8; i++)
+    {
+        if (qp[m_vertices[i]].m_invalid)
+        {
+            return -1;
+        }
+    }
+
+    BaseVecT corners[8];
+    float distances[8];
+
+    getCorners(corners, qp);
+    getDistances(distances, qp);
+    getIntersections(corners, distances, positions);
+
+    return getIndex(qp);
+}
+
+template<typename BaseVecT>
+int FastBox<BaseVecT>::getLocalSurface(vector<QueryPoint<BaseVecT>>& qp, BaseVecT* positions)
+{
+    if (this->m_extruded)
+    {
+        return -1;
+    }
+    return calcLocalSurface(qp, positions);
+}
+
 template<typename BaseVecT>
 void FastBox<BaseVecT>::getSurface(
     BaseMesh<BaseVecT>& mesh,
@@ -37,6 +37,7 @@
 
 #include "lvr2/geometry/BaseMesh.hpp"
 #include "lvr2/geometry/BoundingBox.hpp"
+#include "lvr2/io/Progress.hpp"
 
 //#include "PointsetMeshGenerator.hpp"
 #include "LocalApproximation.hpp"
@@ -117,6 +118,22 @@ public:
 
 private:
 
+    /**
+     * @brief Extracts the local surfaces of all cells in parallel.
+     *
+     * Each thread processes a contiguous range of cells and stores the
+     * created triangles in a local buffer. Vertices are identified by the
+     * grid edge they are located on, i.e., by the indices of the two query
+     * points of that edge. The buffers are merged into the mesh in cell
+     * order afterwards, so that the result is identical to the serial
+     * extraction. Only used for box types without special surface
+     * generation (FastBox and BilinearFastBox).
+     *
+     * @param mesh      The reconstructed mesh
+     * @param progress  Progress bar that is increased per processed cell
+     */
+    void getSurfaceParallel(BaseMesh<BaseVecT>& mesh, ProgressBar& progress);
+
     shared_ptr<HashGrid<BaseVecT, BoxT>> m_grid;
 };
 
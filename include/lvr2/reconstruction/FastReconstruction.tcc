@@ -34,6 +34,9 @@
 #include "lvr2/geometry/BaseMesh.hpp"
 #include "lvr2/reconstruction/FastReconstructionTables.hpp"
 #include "lvr2/io/Progress.hpp"
+#include "lvr2/config/lvropenmp.hpp"
+
+#include <cstdint>
 
 namespace lvr2
 {
@@ -55,21 +58,29 @@ void FastReconstruction<BaseVecT, BoxT>::getMesh(BaseMesh<BaseVecT> &mesh)
     BoxT* b;
     unsigned int global_index = mesh.numVertices();
 
+    BoxTraits<BoxT> traits;
+
     // Iterate through cells and calculate local approximations
     typename HashGrid<BaseVecT, BoxT>::box_map_it it;
-    for(it = m_grid->firstCell(); it != m_grid->lastCell(); it++)
+    if(OpenMPConfig::getNumThreads() > 1
+        && (traits.type == "FastBox" || traits.type == "BilinearFastBox"))
     {
-        b = it->second;
-        b->getSurface(mesh, m_grid->getQueryPoints(), global_index);
-        if(!timestamp.isQuiet())
-            ++progress;
+        getSurfaceParallel(mesh, progress);
+    }
+    else
+    {
+        for(it = m_grid->firstCell(); it != m_grid->lastCell(); it++)
+        {
+            b = it->second;
+            b->getSurface(mesh, m_grid->getQueryPoints(), global_index);
+            if(!timestamp.isQuiet())
+                ++progress;
+        }
     }
 
     if(!timestamp.isQuiet())
         cout << endl;
 
-    BoxTraits<BoxT> traits;
-
     if(traits.type == "SharpBox")  // Perform edge flipping for extended marching cubes
     {
         string SFComment = timestamp.getElapsedTime() + "Flipping edges  ";
@@ -177,6 +188,125 @@ void FastReconstruction<BaseVecT, BoxT>::getMesh(BaseMesh<BaseVecT> &mesh)
 
 }
 
+template<typename BaseVecT, typename BoxT>
+void FastReconstruction<BaseVecT, BoxT>::getSurfaceParallel(BaseMesh<BaseVecT>& mesh, ProgressBar& progress)
+{
+    vector<QueryPoint<BaseVecT>>& qp = m_grid->getQueryPoints();
+
+    // Keep the iteration order of the grid to create the same mesh
+    // as the serial extraction
+    vector<BoxT*> boxes;
+    boxes.reserve(m_grid->getNumberOfCells());
+    for(auto it = m_grid->firstCell(); it != m_grid->lastCell(); it++)
+    {
+        boxes.push_back(it->second);
+    }
+
+    // A vertex on a cell edge is identified by the two query points
+    // of the edge, which are shared by all adjacent cells
+    auto edgeKey = [](BoxT* b, int edge) -> uint64_t
+    {
+        uint64_t v1 = b->getVertex(vertex_edge_table[edge][0]);
+        uint64_t v2 = b->getVertex(vertex_edge_table[edge][1]);
+        return v1 < v2 ? (v1 << 32) | v2 : (v2 << 32) | v1;
+    };
+
+    // Thread local surfaces. Triangles reference the local vertices.
+    struct LocalSurface
+    {
+        vector<uint64_t>    keys;
+        vector<BaseVecT>    positions;
+        vector<uint32_t>    triangles;
+        vector<size_t>      triangleBoxes;
+    };
+
+    const int numThreads = OpenMPConfig::getNumThreads();
+    vector<LocalSurface> surfaces(numThreads);
+
+    #pragma omp parallel for schedule(static, 1) num_threads(numThreads)
+    for(int t = 0; t < numThreads; t++)
+    {
+        LocalSurface& surface = surfaces[t];
+        unordered_map<uint64_t, uint32_t> localIndices;
+
+        size_t begin = boxes.size() * t / numThreads;
+        size_t end = boxes.size() * (t + 1) / numThreads;
+        ProgressBatch localProgress(progress);
+
+        BaseVecT positions[12];
+        for(size_t i = begin; i < end; i++)
+        {
+            BoxT* b = boxes[i];
+            int index = b->getLocalSurface(qp, positions);
+            if(index >= 0)
+            {
+                for(int a = 0; MCTable[index][a] != -1; a++)
+                {
+                    int edge = MCTable[index][a];
+                    auto inserted = localIndices.emplace(edgeKey(b, edge), surface.keys.size());
+                    if(inserted.second)
+                    {
+                        surface.keys.push_back(inserted.first->first);
+                        surface.positions.push_back(positions[edge]);
+                    }
+                    surface.triangles.push_back(inserted.first->second);
+
+                    if(a % 3 == 2)
+                    {
+                        surface.triangleBoxes.push_back(i);
+                    }
+                }
+            }
+            ++localProgress;
+        }
+    }
+
+    // Merge the local surfaces in cell order. Vertices that were already
+    // created by a preceding thread are reused.
+    unordered_map<uint64_t, VertexHandle> vertices;
+    for(LocalSurface& surface : surfaces)
+    {
+        vector<VertexHandle> handles;
+        handles.reserve(surface.keys.size());
+        for(size_t i = 0; i < surface.keys.size(); i++)
+        {
+            auto it = vertices.find(surface.keys[i]);
+            if(it == vertices.end())
+            {
+                it = vertices.emplace(surface.keys[i], mesh.addVertex(surface.positions[i])).first;
+            }
+            handles.push_back(it->second);
+        }
+
+        for(size_t i = 0; i < surface.triangleBoxes.size(); i++)
+        {
+            FaceHandle f = mesh.addFace(
+                handles[surface.triangles[3 * i]],
+                handles[surface.triangles[3 * i + 1]],
+                handles[surface.triangles[3 * i + 2]]
+            );
+            boxes[surface.triangleBoxes[i]]->addLocalFace(f);
+        }
+
+        // Free memory early
+        surface = LocalSurface();
+    }
+
+    // Store the created vertices in the boxes like the serial version does
+    #pragma omp parallel for schedule(static)
+    for(long i = 0; i < (long)boxes.size(); i++)
+    {
+        for(int edge = 0; edge < 12; edge++)
+        {
+            auto it = vertices.find(edgeKey(boxes[i], edge));
+            if(it != vertices.end())
+            {
+                boxes[i]->m_intersections[edge] = it->second;
+            }
+        }
+    }
+}
+
 template<typename BaseVecT, typename BoxT>
 void FastReconstruction<BaseVecT, BoxT>::getMesh(
     BaseMesh<BaseVecT>& mesh,
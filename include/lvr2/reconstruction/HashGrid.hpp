@@ -35,6 +35,7 @@
 #ifndef _LVR2_RECONSTRUCTION_HASHGRID_H_
 #define _LVR2_RECONSTRUCTION_HASHGRID_H_
 
+#include <array>
 #include <unordered_map>
 #include <vector>
 #include <string>
@@ -42,6 +43,7 @@
 #include "QueryPoint.hpp"
 
 #include "lvr2/geometry/BoundingBox.hpp"
+#include "lvr2/reconstruction/CellMaps.hpp"
 #include "lvr2/reconstruction/QueryPoint.hpp"
 
 using std::string;
@@ -97,13 +99,17 @@ public:
 
     BoundingBox<BaseVecT> qp_bb;
 
-    /// Typedef to alias box map
-    typedef unordered_map<size_t, BoxT*> box_map;
+    /// Typedef to alias box map. The map owns the boxes of the grid.
+#ifdef LVR2_USE_FLAT_HASHGRID
+    typedef FlatCellMap<BoxT> box_map;
+#else
+    typedef PointerCellMap<BoxT> box_map;
+#endif
 
     typedef unordered_map<size_t, size_t> qp_map;
 
     /// Typedef to alias iterators for box maps
-    typedef typename unordered_map<size_t, BoxT*>::iterator  box_map_it;
+    typedef typename box_map::iterator  box_map_it;
 
     /// Typedef to alias iterators to query points
     typedef typename vector<QueryPoint<BaseVecT>>::iterator query_point_it;
@@ -178,6 +184,27 @@ public:
      */
     virtual void addLatticePoint(int i, int j, int k, float distance = 0.0);
 
+    /**
+     * @brief   Adds the lattice points for a whole set of positions using
+     *          all available OpenMP threads.
+     *
+     * The resulting grid is identical to the one created by calling
+     * \ref addLatticePoint for the positions 0 to numPoints - 1 in this
+     * order, i.e., cells, query point indices, neighbor links and the
+     * iteration order of getCells() are the same. Instead of inserting the
+     * cells one by one, all cells are collected and sorted by creation order
+     * first and boxes, query points and neighbors are then set up in
+     * parallel. If the grid already contains cells, the serial version is
+     * used.
+     *
+     * @param numPoints Number of positions
+     * @param getIndex  Functor that returns the discrete grid position of the
+     *                  i-th point as std::array<int, 3>. Is called concurrently.
+     * @param distance  Initial distance value of the created query points
+     */
+    template<typename IndexFunc>
+    void addLatticePoints(size_t numPoints, IndexFunc getIndex, float distance = 0.0);
+
     /**
      * @brief   Saves a representation of the grid to the given file
      *
@@ -221,7 +248,7 @@ public:
 
     vector<QueryPoint<BaseVecT>>& getQueryPoints() { return m_queryPoints; }
 
-    box_map getCells() { return m_cells; }
+    box_map& getCells() { return m_cells; }
 
     /***
      * @brief   Destructor
@@ -32,15 +32,21 @@
  *      Author: Thomas Wiemann
  */
 
+#include "lvr2/config/lvropenmp.hpp"
 #include "lvr2/geometry/BaseMesh.hpp"
 #include "lvr2/io/ChunkIO.hpp"
 #include "lvr2/io/Progress.hpp"
 #include "lvr2/io/Timestamp.hpp"
 #include "lvr2/reconstruction/FastReconstructionTables.hpp"
 #include "lvr2/reconstruction/HashGrid.hpp"
+#include "lvr2/util/ParallelSort.hpp"
 
+#include <algorithm>
+#include <bitset>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <unordered_set>
 
 namespace lvr2
 {
@@ -142,7 +148,7 @@ HashGrid<BaseVecT, BoxT>::HashGrid(string file)
         // cout << "i: " << k << endl;
         ifs >> h >> cell[0] >> cell[1] >> cell[2] >> cell[3] >> cell[4] >> cell[5] >> cell[6] >>
             cell[7] >> cell_center.x >> cell_center.y >> cell_center.z >> fusion;
-        BoxT* box = new BoxT(cell_center);
+        BoxT* box = m_cells.createBox(cell_center);
         box->m_extruded = fusion;
         for (int j = 0; j < 8; j++)
         {
@@ -237,7 +243,7 @@ HashGrid<BaseVecT, BoxT>::HashGrid(std::vector<string>& files,
             auto cell_it = this->m_cells.find(hash);
             if (cell_it == this->m_cells.end() && !extruded)
             {
-                BoxT* box = new BoxT(box_center);
+                BoxT* box = m_cells.createBox(box_center);
                 for (int i = 0; i < 8; i++)
                 {
                     current_index = this->findQueryPoint(i, idx, idy, idz);
@@ -340,7 +346,7 @@ HashGrid<BaseVecT, BoxT>::HashGrid(std::vector<string>& files,
             auto cell_it = this->m_cells.find(hash);
             if (cell_it == this->m_cells.end() && !extruded)
             {
-                BoxT* box = new BoxT(box_center);
+                BoxT* box = m_cells.createBox(box_center);
                 for (int i = 0; i < 8; i++)
                 {
                     current_index = this->findQueryPoint(i, idx, idy, idz);
@@ -447,7 +453,7 @@ HashGrid<BaseVecT, BoxT>::HashGrid(std::vector<PointBufferPtr> chunks,
                 auto cell_it = this->m_cells.find(hash);
                 if (cell_it == this->m_cells.end() && !extruded.get()[cellCount])
                 {
-                    BoxT* box = new BoxT(BaseVecT(centers[cellCount * 3 + 0], centers[cellCount * 3 + 1], centers[cellCount * 3 + 2]));
+                    BoxT* box = m_cells.createBox(BaseVecT(centers[cellCount * 3 + 0], centers[cellCount * 3 + 1], centers[cellCount * 3 + 2]));
                     for (int i = 0; i < 8; i++)
                     {
                         current_index = this->findQueryPoint(i, idx, idy, idz);
@@ -564,7 +570,7 @@ void HashGrid<BaseVecT, BoxT>::addLatticePoint(int index_x,
                     // }
 
                     // Create new box
-                    BoxT* box = new BoxT(box_center);
+                    BoxT* box = m_cells.createBox(box_center);
 
                     if (box_center[0] <= m_boundingBox.getMin().x + m_voxelsize * 5 ||
                         box_center[1] <= m_boundingBox.getMin().y + m_voxelsize * 5 ||
@@ -642,6 +648,285 @@ void HashGrid<BaseVecT, BoxT>::addLatticePoint(int index_x,
     }
 }
 
+template <typename BaseVecT, typename BoxT>
+template <typename IndexFunc>
+void HashGrid<BaseVecT, BoxT>::addLatticePoints(size_t numPoints,
+                                                IndexFunc getIndex,
+                                                float distance)
+{
+    // The bulk construction assumes an empty grid
+    if (!m_cells.empty())
+    {
+        for (size_t i = 0; i < numPoints; i++)
+        {
+            std::array<int, 3> index = getIndex(i);
+            addLatticePoint(index[0], index[1], index[2], distance);
+        }
+        return;
+    }
+
+    // A cell that will be created. The order corresponds to the point and
+    // offset that would create the cell in addLatticePoint().
+    struct CellEntry
+    {
+        size_t hash;
+        size_t order;
+        int index[3];
+    };
+
+    const size_t npos = std::numeric_limits<size_t>::max();
+    const int limit = this->m_extrude ? 1 : 0;
+    const size_t numOffsets = (2 * limit + 1) * (2 * limit + 1) * (2 * limit + 1);
+    const float vsh = 0.5 * this->m_voxelsize;
+    const auto v_min = this->m_boundingBox.getMin();
+
+    // Collect all cells touched by the points. Each thread handles a
+    // contiguous block of points, so the first occurrence of a cell within
+    // a block is the one with the smallest order.
+    const int numBlocks = OpenMPConfig::getNumThreads();
+    vector<vector<CellEntry>> blockCells(numBlocks);
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < numBlocks; t++)
+    {
+        size_t begin = numPoints * t / numBlocks;
+        size_t end = numPoints * (t + 1) / numBlocks;
+
+        std::unordered_set<size_t> visited;
+        std::unordered_set<size_t> created;
+        for (size_t i = begin; i < end; i++)
+        {
+            std::array<int, 3> index = getIndex(i);
+
+            // All neighbors of an already visited cell were created earlier
+            if (!visited.insert(hashValue(index[0], index[1], index[2])).second)
+            {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (int dx = -limit; dx <= limit; dx++)
+            {
+                for (int dy = -limit; dy <= limit; dy++)
+                {
+                    for (int dz = -limit; dz <= limit; dz++)
+                    {
+                        int x = index[0] + dx;
+                        int y = index[1] + dy;
+                        int z = index[2] + dz;
+                        size_t hash = hashValue(x, y, z);
+                        if (created.insert(hash).second)
+                        {
+                            blockCells[t].push_back({hash, i * numOffsets + offset, {x, y, z}});
+                        }
+                        offset++;
+                    }
+                }
+            }
+        }
+    }
+
+    vector<CellEntry> cells;
+    for (auto& block : blockCells)
+    {
+        cells.insert(cells.end(), block.begin(), block.end());
+        vector<CellEntry>().swap(block);
+    }
+
+    // Remove cells that were created in several blocks, keep the earliest
+    parallelSort(cells.begin(), cells.end(), [](const CellEntry& a, const CellEntry& b) {
+        return a.hash < b.hash || (a.hash == b.hash && a.order < b.order);
+    });
+    cells.erase(std::unique(cells.begin(), cells.end(), [](const CellEntry& a, const CellEntry& b) {
+        return a.hash == b.hash;
+    }), cells.end());
+
+    // Sort by creation order. The position within this vector is the rank
+    // of a cell.
+    parallelSort(cells.begin(), cells.end(), [](const CellEntry& a, const CellEntry& b) {
+        return a.order < b.order;
+    });
+
+    const size_t numCells = cells.size();
+
+    // Rank lookup. Concurrent reads from the map are safe.
+    unordered_map<size_t, size_t> ranks;
+    ranks.reserve(numCells);
+    for (size_t c = 0; c < numCells; c++)
+    {
+        ranks[cells[c].hash] = c;
+    }
+
+    // Ranks of the 27 cells around the given cell (in the neighbor order
+    // used by setNeighbor()), npos if a neighbor does not exist
+    auto findNeighbors = [&](const int* index, size_t* neighbors) {
+        int neighbor_index = 0;
+        for (int a = -1; a < 2; a++)
+        {
+            for (int b = -1; b < 2; b++)
+            {
+                for (int c = -1; c < 2; c++)
+                {
+                    auto it = ranks.find(hashValue(index[0] + a, index[1] + b, index[2] + c));
+                    neighbors[neighbor_index++] = (it != ranks.end()) ? it->second : npos;
+                }
+            }
+        }
+    };
+
+    // Neighbor index of the i-th cell that shares corner k
+    auto sharedNeighbor = [](int k, int i) {
+        const int* entry = shared_vertex_table[k] + 4 * i;
+        return (entry[0] + 1) * 9 + (entry[1] + 1) * 3 + (entry[2] + 1);
+    };
+
+    // Create the boxes in creation order
+    vector<BoxT*> boxes = m_cells.createBoxes(numCells, [&](size_t c) {
+        const int* index = cells[c].index;
+        return BaseVecT(index[0] * this->m_voxelsize + v_min.x,
+                        index[1] * this->m_voxelsize + v_min.y,
+                        index[2] * this->m_voxelsize + v_min.z);
+    });
+
+    // Determine which corners are owned by a box, i.e., which corners are
+    // not shared with a box created earlier
+    vector<unsigned char> owned(numCells);
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t c = 0; c < numCells; c++)
+    {
+        const int* index = cells[c].index;
+        BoxT* box = boxes[c];
+        BaseVecT box_center = box->getCenter();
+
+        if (box_center[0] <= m_boundingBox.getMin().x + m_voxelsize * 5 ||
+            box_center[1] <= m_boundingBox.getMin().y + m_voxelsize * 5 ||
+            box_center[2] <= m_boundingBox.getMin().z + m_voxelsize * 5)
+        {
+            box->m_duplicate = true;
+        }
+        else if (box_center[0] >= m_boundingBox.getMax().x - m_voxelsize * 5 ||
+                 box_center[1] >= m_boundingBox.getMax().y - m_voxelsize * 5 ||
+                 box_center[2] >= m_boundingBox.getMax().z - m_voxelsize * 5)
+        {
+            box->m_duplicate = true;
+        }
+
+        size_t neighbors[27];
+        findNeighbors(index, neighbors);
+
+        unsigned char mask = 0;
+        for (int k = 0; k < 8; k++)
+        {
+            bool isOwner = true;
+            for (int i = 0; i < 7 && isOwner; i++)
+            {
+                size_t r = neighbors[sharedNeighbor(k, i)];
+                isOwner = (r == npos || r > c);
+            }
+            if (isOwner)
+            {
+                mask |= (1 << k);
+            }
+        }
+        owned[c] = mask;
+    }
+
+    // Query point offsets of all boxes in creation order
+    vector<size_t> firstQueryPoint(numCells + 1);
+    firstQueryPoint[0] = 0;
+    for (size_t c = 0; c < numCells; c++)
+    {
+        firstQueryPoint[c + 1] = firstQueryPoint[c] + std::bitset<8>(owned[c]).count();
+    }
+
+    auto queryPointIndex = [&](size_t c, int k) {
+        return firstQueryPoint[c] + std::bitset<8>(owned[c] & ((1 << k) - 1)).count();
+    };
+
+    const size_t qpOffset = this->m_queryPoints.size();
+    this->m_queryPoints.resize(qpOffset + firstQueryPoint[numCells]);
+
+    // Assign query points and neighbors. Every thread only modifies its own boxes.
+    const int numThreads = OpenMPConfig::getNumThreads();
+    vector<BoundingBox<BaseVecT>> threadBoxes(numThreads);
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < numThreads; t++)
+    {
+        size_t begin = numCells * t / numThreads;
+        size_t end = numCells * (t + 1) / numThreads;
+
+        for (size_t c = begin; c < end; c++)
+        {
+            BoxT* box = boxes[c];
+            BaseVecT box_center = box->getCenter();
+
+            size_t neighbors[27];
+            findNeighbors(cells[c].index, neighbors);
+
+            for (int k = 0; k < 8; k++)
+            {
+                if (owned[c] & (1 << k))
+                {
+                    BaseVecT position(box_center.x + box_creation_table[k][0] * vsh,
+                                      box_center.y + box_creation_table[k][1] * vsh,
+                                      box_center.z + box_creation_table[k][2] * vsh);
+
+                    threadBoxes[t].expand(position);
+
+                    size_t qp = queryPointIndex(c, k);
+                    this->m_queryPoints[qpOffset + qp] = QueryPoint<BaseVecT>(position, distance);
+                    box->setVertex(k, this->m_globalIndex + qp);
+                }
+                else
+                {
+                    // Use the query point of the earliest box sharing this corner
+                    size_t owner = c;
+                    int ownerCorner = k;
+                    for (int i = 0; i < 7; i++)
+                    {
+                        size_t r = neighbors[sharedNeighbor(k, i)];
+                        if (r < owner)
+                        {
+                            owner = r;
+                            ownerCorner = shared_vertex_table[k][4 * i + 3];
+                        }
+                    }
+                    box->setVertex(k, this->m_globalIndex + queryPointIndex(owner, ownerCorner));
+                }
+            }
+
+            // A box is never linked to itself
+            for (int neighbor_index = 0; neighbor_index < 27; neighbor_index++)
+            {
+                if (neighbor_index != 13 && neighbors[neighbor_index] != npos)
+                {
+                    box->setNeighbor(neighbor_index, boxes[neighbors[neighbor_index]]);
+                }
+            }
+        }
+    }
+
+    for (auto& bb : threadBoxes)
+    {
+        if (bb.isValid())
+        {
+            qp_bb.expand(bb);
+        }
+    }
+
+    this->m_globalIndex += firstQueryPoint[numCells];
+
+    // Insert the cells in creation order without reserving, so the map grows
+    // exactly like with repeated addLatticePoint() calls and is iterated in
+    // the same order.
+    for (size_t c = 0; c < numCells; c++)
+    {
+        this->m_cells[cells[c].hash] = boxes[c];
+    }
+}
+
 template <typename BaseVecT, typename BoxT>
 void HashGrid<BaseVecT, BoxT>::setCoordinateScaling(float x, float y, float z)
 {
@@ -653,17 +938,7 @@ void HashGrid<BaseVecT, BoxT>::setCoordinateScaling(float x, float y, float z)
 template <typename BaseVecT, typename BoxT>
 HashGrid<BaseVecT, BoxT>::~HashGrid()
 {
-    box_map_it iter;
-    for (iter = m_cells.begin(); iter != m_cells.end(); iter++)
-    {
-        if (iter->second != NULL)
-        {
-            delete (iter->second);
-            iter->second = NULL;
-        }
-    }
-
-    m_cells.clear();
+    // The boxes are owned and freed by the cell map
 }
 
 template <typename BaseVecT, typename BoxT>
@@ -741,7 +1016,7 @@ void HashGrid<BaseVecT, BoxT>::saveGrid(string filename)
         }
 
         // Write box definitions
-        typename unordered_map<size_t, BoxT*>::iterator it;
+        box_map_it it;
         BoxT* box;
         for (it = m_cells.begin(); it != m_cells.end(); it++)
         {
@@ -847,7 +1122,7 @@ void HashGrid<BaseVecT, BoxT>::serialize(string file)
         }
 
         // Write box definitions
-        typename unordered_map<size_t, BoxT*>::iterator it;
+        box_map_it it;
         BoxT* box;
         for (it = m_cells.begin(); it != m_cells.end(); it++)
         {
@@ -47,12 +47,27 @@ template<typename BaseVecT, typename BoxT>
 class PointsetGrid: public HashGrid<BaseVecT, BoxT>
 {
 public:
+
+    /**
+     * @brief Creates a grid that contains a cell for each point of the
+     *        given surface (and its neighbors if extrusion is enabled).
+     *
+     * @param cellSize      Voxel size or number of intersections
+     * @param surface       Point set surface used to create the grid
+     * @param bb            Bounding box of the grid
+     * @param isVoxelsize   Whether to interpret cellSize as voxel size
+     * @param extrude       Whether to create additional cells around the points
+     * @param parallelBuild If true, the cells are created with all available
+     *                      threads via HashGrid::addLatticePoints. The resulting
+     *                      grid is identical to the serial construction.
+     */
     PointsetGrid(
         float cellSize,
         PointsetSurfacePtr<BaseVecT> surface,
         BoundingBox<BaseVecT> bb,
         bool isVoxelsize = true,
-        bool extrude = true
+        bool extrude = true,
+        bool parallelBuild = false
     );
 
     virtual ~PointsetGrid() {}
@@ -41,7 +41,8 @@ PointsetGrid<BaseVecT, BoxT>::PointsetGrid(
     PointsetSurfacePtr<BaseVecT> surface,
     BoundingBox<BaseVecT> bb,
     bool isVoxelsize,
-    bool extrude
+    bool extrude,
+    bool parallelBuild
 ) :
     HashGrid<BaseVecT, BoxT>(cellSize, bb, isVoxelsize, extrude),
     m_surface(surface)
@@ -56,6 +57,16 @@ PointsetGrid<BaseVecT, BoxT>::PointsetGrid(
 
     FloatChannel pts = *(m_surface->pointBuffer()->getFloatChannel("points"));
 
+    if(parallelBuild)
+    {
+        this->addLatticePoints(numPoint, [&](size_t i) {
+            BaseVecT pt = pts[i];
+            auto index = (pt - v_min) / this->m_voxelsize;
+            return std::array<int, 3>{calcIndex(index.x), calcIndex(index.y), calcIndex(index.z)};
+        });
+        return;
+    }
+
     // Iterator over all points, calc lattice indices and add lattice points to the grid
     for(size_t i = 0; i < numPoint; i++)
     {
@@ -75,22 +86,37 @@ void PointsetGrid<BaseVecT, BoxT>::calcDistanceValues()
 
     Timestamp ts;
 
-    // Calculate a distance value for each query point
-    #pragma omp parallel for schedule(dynamic, 4)
-    for( int i = 0; i < (int)this->m_queryPoints.size(); i++){
-        float projectedDistance;
-        float euklideanDistance;
+    // Calculate the distance values for blocks of query points at once
+    const size_t blockSize = 16384;
+    const size_t numQueryPoints = this->m_queryPoints.size();
+    vector<BaseVecT> positions;
+    vector<typename BaseVecT::CoordType> projectedDistances;
+    vector<typename BaseVecT::CoordType> euklideanDistances;
+
+    for(size_t blockStart = 0; blockStart < numQueryPoints; blockStart += blockSize)
+    {
+        size_t count = std::min(blockSize, numQueryPoints - blockStart);
+
+        positions.resize(count);
+        projectedDistances.resize(count);
+        euklideanDistances.resize(count);
+        for(size_t j = 0; j < count; j++)
+        {
+            positions[j] = this->m_queryPoints[blockStart + j].m_position;
+        }
 
-        //cout << euklideanDistance << " " << projectedDistance << endl;
+        this->m_surface->distances(positions.data(), count, projectedDistances.data(), euklideanDistances.data());
 
-        std::tie(projectedDistance, euklideanDistance) =
-            this->m_surface->distance(this->m_queryPoints[i].m_position);
-        if (euklideanDistance > 1.7320 * this->m_voxelsize)
+        for(size_t j = 0; j < count; j++)
         {
-            this->m_queryPoints[i].m_invalid = true;
+            QueryPoint<BaseVecT>& qp = this->m_queryPoints[blockStart + j];
+            if (euklideanDistances[j] > 1.7320 * this->m_voxelsize)
+            {
+                qp.m_invalid = true;
+            }
+            qp.m_distance = projectedDistances[j];
         }
-        this->m_queryPoints[i].m_distance = projectedDistance;
-        ++progress;
+        progress += count;
     }
     cout << endl;
     cout << timestamp << "Elapsed time: " << ts.getElapsedTimeInS() << endl;
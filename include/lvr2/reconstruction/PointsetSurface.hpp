@@ -36,6 +36,7 @@
 #define LVR2_RECONSTRUCTION_POINTSETSURFACE_HPP_
 
 #include <memory>
+#include <tuple>
 #include <utility>
 
 #include "lvr2/geometry/Normal.hpp"
@@ -73,6 +74,26 @@ public:
      */
     virtual pair<typename BaseVecT::CoordType, typename BaseVecT::CoordType>
         distance(BaseVecT v) const = 0;
+
+    /**
+     * @brief Calculates the distance values for a whole set of grid points.
+     *        The default implementation calls \ref distance in parallel.
+     *        Implementations may override it to search the neighborhoods
+     *        of all points at once.
+     *
+     * @param positions     Array of n grid points
+     * @param n             The number of grid points
+     * @param projected     Array of n elements that receives the projected
+     *                      distances to the isosurface
+     * @param euclidean     Array of n elements that receives the euclidian
+     *                      distances to the nearest data points
+     */
+    virtual void distances(
+        const BaseVecT* positions,
+        size_t n,
+        typename BaseVecT::CoordType* projected,
+        typename BaseVecT::CoordType* euclidean
+    ) const;
     /**
      * @brief   Calculates surface normals for each data point in the given
      *          PointBuffeer. If the buffer alreay contains normal information
@@ -50,6 +50,21 @@ PointsetSurface<BaseVecT>::PointsetSurface(PointBufferPtr pointBuffer)
     }
 }
 
+template<typename BaseVecT>
+void PointsetSurface<BaseVecT>::distances(
+    const BaseVecT* positions,
+    size_t n,
+    typename BaseVecT::CoordType* projected,
+    typename BaseVecT::CoordType* euclidean
+) const
+{
+    #pragma omp parallel for schedule(dynamic, 64)
+    for(long i = 0; i < (long)n; i++)
+    {
+        std::tie(projected[i], euclidean[i]) = this->distance(positions[i]);
+    }
+}
+
 template<typename BaseVecT>
 Normal<float> PointsetSurface<BaseVecT>::getInterpolatedNormal(const BaseVecT& position) const
 {
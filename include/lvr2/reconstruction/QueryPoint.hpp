@@ -78,9 +78,10 @@ public:
     QueryPoint(const QueryPoint &o);
 
     /**
-     * @brief Destructor.
+     * @brief Destructor. Intentionally not virtual to keep query points
+     *        free of a vtable pointer, grids store millions of them.
      */
-    virtual ~QueryPoint() {};
+    ~QueryPoint() {};
 
     /// The position of the query Vector
     BaseVecT m_position;
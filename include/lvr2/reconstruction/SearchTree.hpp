@@ -96,6 +96,31 @@ public:
         std::vector<size_t>& indices
     ) const;
 
+    /**
+     * @brief Performs a k-next-neighbor search for a whole set of query
+     *        points at once. The results are stored in flat row major
+     *        matrices with k entries per query point, so no memory is
+     *        allocated per query. The default implementation calls
+     *        \ref kSearch in parallel, implementations may override it
+     *        with a native batched search.
+     *
+     * @param query       Array of n query points.
+     * @param n           The number of query points.
+     * @param k           The number of neighbours for each query point. Must
+     *                    not exceed the number of points in the tree.
+     * @param indices     Array of n * k elements. Row i contains the indices
+     *                    of the neighbours of the i-th query point.
+     * @param distances   Array of n * k elements. Row i contains the
+     *                    distances of the neighbours of the i-th query point.
+     */
+    virtual void kSearchMany(
+        const BaseVecT* query,
+        size_t n,
+        int k,
+        size_t* indices,
+        CoordT* distances
+    ) const;
+
     // /**
     //  * @brief Set the number of neighbours used to estimate and interpolate normals.
     //  */
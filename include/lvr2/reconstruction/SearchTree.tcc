@@ -35,7 +35,9 @@
 
 #include "lvr2/io/Timestamp.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 using std::cout;
 using std::endl;
 
@@ -53,6 +55,42 @@ int SearchTree<BaseVecT>::kSearch(
     return this->kSearch(qp, neighbours, indices, distances);
 }
 
+template<typename BaseVecT>
+void SearchTree<BaseVecT>::kSearchMany(
+    const BaseVecT* query,
+    size_t n,
+    int k,
+    size_t* indices,
+    CoordT* distances
+) const
+{
+    #pragma omp parallel
+    {
+        // Reuse the result vectors for all queries of a thread
+        std::vector<size_t> id;
+        std::vector<CoordT> di;
+
+        #pragma omp for schedule(dynamic, 64)
+        for(long i = 0; i < (long)n; i++)
+        {
+            id.clear();
+            di.clear();
+            this->kSearch(query[i], k, id, di);
+
+            size_t* rowIndices = indices + i * k;
+            CoordT* rowDistances = distances + i * k;
+            size_t found = std::min(id.size(), (size_t)k);
+            std::copy(id.begin(), id.begin() + found, rowIndices);
+            std::copy(di.begin(), di.begin() + std::min(di.size(), found), rowDistances);
+            for(size_t j = found; j < (size_t)k; j++)
+            {
+                rowIndices[j] = std::numeric_limits<size_t>::max();
+                rowDistances[j] = std::numeric_limits<CoordT>::max();
+            }
+        }
+    }
+}
+
 // template<typename BaseVecT>
 // void SearchTree<BaseVecT>::setKi(int ki)
 // {
@@ -105,7 +105,7 @@ void SearchTreeFlann<BaseVecT>::radiusSearch(
 template<typename BaseVecT>
 void SearchTreeFlann<BaseVecT>::kSearchMany(
     const BaseVecT* query,
-    int n,
+    size_t n,
     int k,
     size_t* indices,
     CoordT* distances
@@ -113,11 +113,11 @@ void SearchTreeFlann<BaseVecT>::kSearchMany(
 {
     CoordT* queries = new CoordT[n * 3];
     flann::Matrix<CoordT> queries_mat(queries, n, 3);
-    flann::Matrix<size_t> indices_mat(indices, n, 1);
-    flann::Matrix<CoordT> distances_mat(distances, n, 1);
+    flann::Matrix<size_t> indices_mat(indices, n, k);
+    flann::Matrix<CoordT> distances_mat(distances, n, k);
 
     #pragma omp parallel for
-    for (size_t i = 0; i < n; i++)
+    for (long i = 0; i < (long)n; i++)
     {
         queries_mat[i][0] = query[i].x;
         queries_mat[i][1] = query[i].y;
@@ -130,7 +130,7 @@ void SearchTreeFlann<BaseVecT>::kSearchMany(
     #else
     params.cores = 4;
     #endif
-    m_tree->knnSearch(queries_mat, indices_mat, distances_mat, 1, params);
+    m_tree->knnSearch(queries_mat, indices_mat, distances_mat, k, params);
 
     delete[] queries;
 }
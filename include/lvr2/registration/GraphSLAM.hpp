@@ -40,6 +40,9 @@
 
 #include <Eigen/SparseCore>
 
+#include <map>
+#include <vector>
+
 namespace lvr2
 {
 
@@ -50,10 +53,57 @@ namespace lvr2
  * @param scan    The index of the scan
  * @param options The options on how to search
  * @param output  Will be filled with the indices of all close Scans
+ * @param tree    A KDTree of the scan in local coordinates (see KDTree::create).
+ *                Only used if options.closeLoopPairs is set. Created if nullptr.
  *
  * @return true if any Scans were found, false otherwise
  */
-bool findCloseScans(const std::vector<SLAMScanPtr>& scans, size_t scan, const SLAMOptions& options, std::vector<size_t>& output);
+bool findCloseScans(const std::vector<SLAMScanPtr>& scans, size_t scan, const SLAMOptions& options, std::vector<size_t>& output, KDTreePtr tree = nullptr);
+
+/**
+ * @brief A cache for the KDTrees of Scans in local coordinates.
+ *
+ * Since the trees are in local coordinates, they stay valid when the Scans are transformed and
+ * can be reused for all iterations of GraphSLAM. The cache holds trees until their total number
+ * of points reaches a limit. Trees that do not fit anymore are not cached, but built again
+ * whenever they are requested.
+ */
+class KDTreeCache
+{
+public:
+    /**
+     * @brief Creates an empty cache
+     *
+     * @param maxLeafSize   The maximum number of points in a leaf of the created trees
+     * @param maxPoints     The maximum total number of points of the cached trees
+     */
+    KDTreeCache(int maxLeafSize, size_t maxPoints);
+
+    /**
+     * @brief Returns the trees of the requested Scans. Missing trees are built in parallel.
+     *
+     * @param scans     A vector with all Scans. The cache is indexed by the position in this vector,
+     *                  so the same vector has to be used for all calls.
+     * @param indices   The indices of the requested Scans. May contain duplicates.
+     * @param output    Will be filled with the trees of the requested Scans, by Scan index
+     */
+    void getTrees(const std::vector<SLAMScanPtr>& scans, const std::vector<size_t>& indices, std::map<size_t, KDTreePtr>& output);
+
+    /// Returns the number of trees that were built so far
+    size_t numBuilt() const { return m_built; }
+
+private:
+    int m_maxLeafSize;
+
+    size_t m_maxPoints;
+
+    /// The total number of points in m_trees
+    size_t m_numPoints = 0;
+
+    size_t m_built = 0;
+
+    std::map<size_t, KDTreePtr> m_trees;
+};
 
 /**
  * @brief Wrapper class for running GraphSLAM on Scans
@@ -85,8 +135,9 @@ protected:
      * @param scans reference to a vector containing the SlamScanPtr
      * @param last number of the last considered scan
      * @param graph Outputs the created graph
+     * @param trees Cache for the KDTrees of the Scans
      * */
-    void createGraph(const std::vector<SLAMScanPtr>& scans, size_t last, Graph& graph) const;
+    void createGraph(const std::vector<SLAMScanPtr>& scans, size_t last, Graph& graph, KDTreeCache& trees) const;
 
     /**
      * @brief A function to fill the linear system mat * x = vec.
@@ -94,10 +145,19 @@ protected:
      * @param graph the graph created in the createGraph function
      * @param mat Outputs the GraphMatrix
      * @param vec Outputs the GraphVector
+     * @param trees Cache for the KDTrees of the Scans
      * */
-    void fillEquation(const std::vector<SLAMScanPtr>& scans, const Graph& graph, GraphMatrix& mat, GraphVector& vec) const;
+    void fillEquation(const std::vector<SLAMScanPtr>& scans, const Graph& graph, GraphMatrix& mat, GraphVector& vec, KDTreeCache& trees) const;
     
-    void eulerCovariance(KDTreePtr tree, SLAMScanPtr scan, Matrix6d& outMat, Vector6d& outVec) const;
+    /**
+     * @brief Calculates the covariance of the point pairs between two Scans
+     * @param tree      The KDTree of 'treeScan' in local coordinates
+     * @param treeScan  The Scan of 'tree'
+     * @param scan      The Scan whose points are searched in the tree
+     * @param outMat    Outputs the covariance matrix
+     * @param outVec    Outputs the covariance vector
+     * */
+    void eulerCovariance(KDTreePtr tree, SLAMScanPtr treeScan, SLAMScanPtr scan, Matrix6d& outMat, Vector6d& outVec) const;
 
     const SLAMOptions*     m_options;
 };
@@ -35,10 +35,13 @@
 #define ICPPOINTALIGN_HPP_
 
 #include "KDTree.hpp"
+#include "SLAMOptions.hpp"
 #include "SLAMScanWrapper.hpp"
 
 #include "lvr2/types/MatrixTypes.hpp"
 
+#include <ostream>
+
 namespace lvr2
 {
 
@@ -60,6 +63,9 @@ public:
     /**
      * @brief Executes the ICPAlign
      * 
+     * If the data Scan has a pyramid (see SLAMScanWrapper::createPyramid), the reduced
+     * levels are aligned first, from coarse to fine, before the Scan itself.
+     * 
      * @return Transformd The delta transformation caused by this Method
      */
     Transformd match();
@@ -71,15 +77,54 @@ public:
     void    setMaxLeafSize(int maxLeafSize);
     void    setEpsilon(double epsilon);
     void    setVerbose(bool verbose);
+    void    setMethod(ICPMethod method);
+    void    setNormalNeighbors(int k);
+
+    /// Sets the stream for all output of match(). Defaults to std::cout
+    void    setOutput(std::ostream& out);
 
     double  getMaxMatchDistance() const;
     int     getMaxIterations() const;
     int     getMaxLeafSize() const;
     double  getEpsilon() const;
     bool    getVerbose() const;
+    ICPMethod getMethod() const;
+    int     getNormalNeighbors() const;
+
+    /// Returns the number of iterations used by the last call of match()
+    int     getIterations() const;
+
+    /// Returns the duration of the last call of match() in seconds
+    double  getDuration() const;
 
 protected:
 
+    /**
+     * @brief Runs ICP iterations on 'data' until convergence or the maximum number of iterations
+     *
+     * @param data          The data Scan, transformed in place
+     * @param neighbors     Buffer for the neighbors of at least data->numPoints() entries
+     * @param error         Is set to the error of the last iteration
+     * @param iterations    Is set to the number of iterations
+     * @return bool         true if ICP converged
+     */
+    bool iterate(SLAMScanPtr data, KDTree::Neighbor* neighbors, double& error, int& iterations);
+
+    /**
+     * @brief Calculates one Gauss-Newton step that minimizes the squared distances of the
+     *        data points to the tangent planes of their neighbors
+     *
+     * @param data      The data Scan
+     * @param neighbors The neighbors of the data points in the model tree (or nullptr)
+     * @param transform Is set to the resulting transformation
+     * @param pairs     Is set to the number of point pairs with a valid normal
+     * @return double   The RMS point-to-plane distance before the transformation
+     */
+    double alignPointToPlane(SLAMScanPtr data, KDTree::Neighbor* neighbors, Transformd& transform, size_t& pairs) const;
+
+    /// Returns the normal of a neighbor from the search tree that contains it
+    const KDTree::Point& neighborNormal(const KDTree::Neighbor& neighbor) const;
+
     double      m_epsilon;
     double      m_maxDistanceMatch;
     int         m_maxIterations;
@@ -87,10 +132,19 @@ protected:
 
     bool        m_verbose;
 
+    ICPMethod   m_method;
+    int         m_normalNeighbors;
+
+    int         m_iterations;
+    double      m_duration;
+
+    std::ostream* m_out;
+
     SLAMScanPtr m_modelCloud;
     SLAMScanPtr m_dataCloud;
 
-    KDTreePtr   m_searchTree;
+    /// The trees of the model Scan. Several trees for a Metascan, one otherwise
+    std::vector<KDTreePtr> m_searchTrees;
 };
 
 } /* namespace lvr2 */
@@ -40,6 +40,8 @@
 
 #include <memory>
 #include <limits>
+#include <vector>
+#include <cstdint>
 #include <boost/shared_array.hpp>
 
 namespace lvr2
@@ -47,6 +49,12 @@ namespace lvr2
 
 /**
  * @brief a kd-Tree Implementation for nearest Neighbor searches
+ *
+ * The tree is stored as a flat array of nodes in depth-first order. The lesser
+ * child of a node directly follows its parent, the greater child is referenced
+ * by index. The points are reordered during construction so that the points of
+ * every leaf are stored contiguously and leaves only keep a range within the
+ * point array.
  */
 class KDTree
 {
@@ -62,8 +70,21 @@ public:
      * @param points        The Point Cloud
      * @param n             The number of points in 'points'
      * @param maxLeafSize   The maximum number of points to use for a Leaf in the Tree
+     * @param local         Use the local coordinates of the Scan instead of the global ones.
+     *                      A local tree stays valid when the Scan is transformed and has to be
+     *                      queried with points in the local coordinate system of the Scan.
+     */
+    static std::shared_ptr<KDTree> create(SLAMScanPtr scan, int maxLeafSize = 20, bool local = false);
+
+    /**
+     * @brief Creates a new KDTree from the given Points. The tree takes ownership of the
+     *        array and reorders it.
+     *
+     * @param points        The Point Cloud
+     * @param n             The number of points in 'points'
+     * @param maxLeafSize   The maximum number of points to use for a Leaf in the Tree
      */
-    static std::shared_ptr<KDTree> create(SLAMScanPtr scan, int maxLeafSize = 20);
+    static std::shared_ptr<KDTree> create(boost::shared_array<Point> points, size_t n, int maxLeafSize = 20);
 
     /**
      * @brief Finds the nearest neighbor of 'point' that is within 'maxDistance' (defaults to infinity).
@@ -91,7 +112,66 @@ public:
         return neighbor != nullptr;
     }
 
-    virtual ~KDTree() = default;
+    /**
+     * @brief Finds the k nearest neighbors of 'point' that are within 'maxDistance'.
+     *
+     * @param point         The Point whose neighbors are searched
+     * @param k             The number of neighbors to search
+     * @param neighbors     An array of at least k entries. Is filled with the found neighbors,
+     *                      sorted by increasing distance
+     * @param maxDistance   The maximum distance allowed between neighbors
+     * @return int          The number of neighbors that were found
+     */
+    template<typename T>
+    int kNearestNeighbors(
+        const Vector3<T>& point,
+        int k,
+        Neighbor* neighbors,
+        double maxDistance = std::numeric_limits<double>::infinity()
+    ) const
+    {
+        return knnInternal(point.template cast<PointT>(), k, neighbors, maxDistance);
+    }
+
+    /**
+     * @brief Estimates the normal of every Point in the tree by a principal component analysis
+     *        of its k nearest neighbors. The normals are stored with the tree and can be
+     *        accessed with normal().
+     *
+     * @param k             The number of neighbors used for each normal
+     */
+    void estimateNormals(int k);
+
+    /// Returns true if estimateNormals() was called
+    bool hasNormals() const { return normals.get() != nullptr; }
+
+    /**
+     * @brief Returns the normal of a Point in the tree. Points without enough neighbors to
+     *        estimate a normal have a zero normal. Requires estimateNormals() to be called first.
+     *
+     * @param neighbor      A Point of this tree, as returned by the neighbor searches
+     */
+    const Point& normal(const Neighbor& neighbor) const
+    {
+        return normals[neighbor - points.get()];
+    }
+
+    /// Returns true if 'neighbor' is a Point of this tree
+    bool contains(const Neighbor& neighbor) const
+    {
+        return neighbor >= points.get() && neighbor < points.get() + pointCount;
+    }
+
+    ~KDTree() = default;
+
+    /// Returns the number of Points in the tree
+    size_t numPoints() const { return pointCount; }
+
+    /// Returns the number of nodes (inner nodes and leaves) in the tree
+    size_t numNodes() const { return nodes.size(); }
+
+    /// Returns the maximum depth of the tree
+    int depth() const { return maxDepth; }
 
     /**
      * @brief Finds the nearest neighbors of all points in a Scan using a pre-generated KDTree
@@ -121,15 +201,105 @@ public:
      */
     static size_t nearestNeighbors(KDTreePtr tree, SLAMScanPtr scan, KDTree::Neighbor* neighbors, double maxDistance);
 
-protected:
+    /**
+     * @brief Finds the nearest neighbors of all points in a Scan using a pre-generated KDTree
+     *        whose points are in a different coordinate system, e.g. a tree created with local = true
+     *
+     * @param tree          The KDTree to search in
+     * @param transform     Transformation from the local coordinates of 'scan' into the
+     *                      coordinate system of the tree
+     * @param scan          The Scan to search for
+     * @param neighbors     An array to store the results in. neighbors[i] is set to a Pointer to the
+     *                      neighbor of points[i] or nullptr if none was found. The neighbors are in
+     *                      the coordinate system of the tree.
+     * @param maxDistance   The maximum Distance for a Neighbor. Has to be the same in both coordinate
+     *                      systems, so 'transform' has to be rigid.
+     *
+     * @return size_t The number of neighbors that were found
+     */
+    static size_t nearestNeighbors(KDTreePtr tree, const Transformd& transform, SLAMScanPtr scan, KDTree::Neighbor* neighbors, double maxDistance);
+
+    /**
+     * @brief Finds the nearest neighbors of all points in a Scan in the union of several KDTrees
+     *
+     * @param trees         The KDTrees to search in
+     * @param scan          The Scan to search for
+     * @param neighbors     An array to store the results in. neighbors[i] is set to a Pointer to the
+     *                      closest neighbor of points[i] in any of the trees or nullptr if none was found
+     * @param maxDistance   The maximum Distance for a Neighbor
+     *
+     * @return size_t The number of neighbors that were found
+     */
+    static size_t nearestNeighbors(const std::vector<KDTreePtr>& trees, SLAMScanPtr scan, KDTree::Neighbor* neighbors, double maxDistance);
+
+    /**
+     * @brief Finds the nearest neighbors of all points in a Scan in the union of several KDTrees
+     *
+     * @param trees         The KDTrees to search in
+     * @param scan          The Scan to search for
+     * @param neighbors     An array to store the results in. neighbors[i] is set to a Pointer to the
+     *                      closest neighbor of points[i] in any of the trees or nullptr if none was found
+     * @param maxDistance   The maximum Distance for a Neighbor
+     * @param centroid_m    Will be set to the average of all Points in 'neighbors'
+     * @param centroid_d    Will be set to the average of all Points in 'points' that have neighbors
+     *
+     * @return size_t The number of neighbors that were found
+     */
+    static size_t nearestNeighbors(const std::vector<KDTreePtr>& trees, SLAMScanPtr scan, KDTree::Neighbor* neighbors, double maxDistance, Vector3d& centroid_m, Vector3d& centroid_d);
+
+private:
+    /// A node of the tree. Leaves are marked by an axis of -1.
+    struct Node
+    {
+        /// The split value of an inner node
+        float split;
+
+        /// The split axis of an inner node or -1 for leaves
+        int32_t axis;
+
+        /// Index of the greater child of an inner node or index of the first point of a leaf
+        uint32_t index;
+
+        /// Number of points in a leaf
+        uint32_t count;
+    };
+
     KDTree() = default;
     KDTree(const KDTree&&) = delete;
 
-    virtual void nnInternal(const Point& point, Neighbor& neighbor, double& maxDist) const = 0;
+    /// Calculates the centroids of the point pairs found by nearestNeighbors
+    static void calculateCentroids(SLAMScanPtr scan, const Neighbor* neighbors, size_t found, Vector3d& centroid_m, Vector3d& centroid_d);
 
-    friend class KDNode;
+    /**
+     * @brief Recursively creates the subtree for points[0, n) and appends it to 'tree'
+     *
+     * @param base          The start of the point array, used to calculate the leaf ranges
+     * @param points        The points of the subtree. Gets reordered.
+     * @param n             The number of points
+     * @param maxLeafSize   The maximum number of points in a leaf
+     * @param tree          The node array the subtree is appended to
+     * @param taskLevels    The number of levels below which omp tasks are used for the subtrees
+     * @return int          The depth of the subtree
+     */
+    static int createRecursive(Point* base, Point* points, int n, int maxLeafSize, std::vector<Node>& tree, int taskLevels);
+
+    void nnInternal(const Point& point, Neighbor& neighbor, double& maxDist) const;
+
+    int knnInternal(const Point& point, int k, Neighbor* neighbors, double maxDist) const;
 
     boost::shared_array<Point> points;
+
+    /// The number of Points in 'points'
+    size_t pointCount = 0;
+
+    /// The normals of the Points, in the same order as 'points'. Empty until estimateNormals() is called.
+    boost::shared_array<Point> normals;
+
+    /// The nodes in depth-first order. The root is nodes[0].
+    std::vector<Node> nodes;
+
+    /// The maximum depth of the tree
+    int maxDepth = 0;
 };
 
 using KDTreePtr = std::shared_ptr<KDTree>;
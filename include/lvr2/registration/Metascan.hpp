@@ -35,6 +35,9 @@
 #define METASCAN_HPP_
 
 #include "SLAMScanWrapper.hpp"
+#include "KDTree.hpp"
+
+#include <vector>
 
 namespace lvr2
 {
@@ -43,6 +46,11 @@ namespace lvr2
  * @brief Represents several Scans as part of a single Scan
  * 
  * Note that most methods of Scan don't make sense on a Metascan, like reductions or Pose getters.
+ *
+ * For nearest neighbor searches, the Metascan keeps an incremental index of several KDTrees
+ * (see searchTrees()). The Scans are split into consecutive groups whose number of points
+ * decreases geometrically, so new Scans only cause the trees of the smallest groups to be rebuilt
+ * and there are only logarithmically many trees.
  */
 class Metascan : public SLAMScanWrapper
 {
@@ -56,8 +64,51 @@ public:
 
     void addScan(SLAMScanPtr scan);
 
+    /**
+     * @brief Returns KDTrees that contain all Points of the Metascan in global coordinates.
+     *
+     * Only the trees of new groups and of groups with transformed Scans are built, all others
+     * are reused from previous calls. The trees may be modified (e.g. estimateNormals()) and
+     * are kept for following calls.
+     *
+     * @param maxLeafSize   The maximum number of points in a leaf of the trees
+     * @return The trees. Every Point is in exactly one of them
+     */
+    const std::vector<KDTreePtr>& searchTrees(int maxLeafSize);
+
 protected:
+    /// Consecutive Scans that share a KDTree
+    struct ScanGroup
+    {
+        /// Index of the first Scan in m_scans
+        size_t first;
+
+        /// Number of Scans in the group
+        size_t count;
+
+        /// Total number of points of the Scans
+        size_t numPoints;
+
+        /// The tree of the group, nullptr if it has to be (re)built
+        KDTreePtr tree;
+
+        /// The poses of the Scans when the tree was built
+        std::vector<Transformd> poses;
+    };
+
     std::vector<SLAMScanPtr> m_scans;
+
+    /// The index of the first point of each Scan
+    std::vector<size_t> m_offsets;
+
+    /// The groups, from the oldest and largest to the newest and smallest
+    std::vector<ScanGroup> m_groups;
+
+    /// The trees of all groups as returned by searchTrees()
+    std::vector<KDTreePtr> m_trees;
+
+    /// The leaf size of the current trees
+    int m_maxLeafSize = 0;
 };
 
 } /* namespace lvr2 */
@@ -145,6 +145,30 @@ protected:
     /// Applies all reductions to the Scan
     void reduceScan(const SLAMScanPtr& scan);
 
+    /**
+     * @brief Registers the data Scan of an edge of m_icp_graph to its model Scan with ICP
+     *
+     * @param edge          The index of the edge in m_icp_graph
+     * @param out           The stream for the output
+     * @param iterations    Is increased by the number of ICP iterations
+     * @param duration      Is increased by the duration of ICP in seconds
+     */
+    void alignPair(size_t edge, std::ostream& out, int& iterations, double& duration);
+
+    /**
+     * @brief Registers the given edges of m_icp_graph concurrently where possible
+     *
+     * The edges are grouped into waves of edges that do not depend on each other: An edge
+     * depends on all previous edges that move its model Scan or that use or move its data Scan.
+     * The waves are executed one after another, while the pairs of a wave are distributed
+     * among the threads. The remaining threads are used within the ICP of each pair.
+     *
+     * @param edges         The indices of the edges in m_icp_graph, in registration order
+     * @param iterations    Is increased by the number of ICP iterations
+     * @param duration      Is increased by the summed duration of ICP in seconds
+     */
+    void alignPairsParallel(const std::vector<size_t>& edges, int& iterations, double& duration);
+
     /// Applies the Transformation to the specified Scan and adds a frame to all other Scans
     void applyTransform(SLAMScanPtr scan, const Matrix4d& transform);
 
@@ -39,6 +39,19 @@
 namespace lvr2
 {
 
+/**
+ * @brief The error metric that is minimized by ICP
+ */
+enum class ICPMethod
+{
+    /// Minimize the distances between point pairs with a closed form SVD solution
+    PointToPoint,
+
+    /// Minimize the distances of the data points to the tangent planes of the model points
+    /// with Gauss-Newton steps. Converges in far fewer iterations on planar structures.
+    PointToPlane
+};
+
 /**
  * @brief A struct to configure SLAMAlign
  */
@@ -87,6 +100,19 @@ struct SLAMOptions
     /// The epsilon difference between ICP-errors for the stop criterion of ICP
     double  epsilon = 0.00001;
 
+    /// The error metric of ICP
+    ICPMethod icpMethod = ICPMethod::PointToPoint;
+
+    /// The number of neighbors used to estimate the normals of the model Scan for point-to-plane ICP
+    int     icpNormalNeighbors = 20;
+
+    /// The number of resolution levels for coarse-to-fine ICP. 1 disables the pyramid
+    int     icpPyramidLevels = 1;
+
+    /// The voxel size of the finest reduced pyramid level. Each coarser level doubles it.
+    /// -1 (default): twice the reduction voxel size
+    double  icpPyramidVoxelSize = -1;
+
     // ==================== SLAM Options =========================================================
 
     /// Use simple Loopclosing
@@ -117,6 +143,10 @@ struct SLAMOptions
     /// The epsilon difference of SLAM corrections for the stop criterion of SLAM
     double  slamEpsilon = 0.5;
 
+    /// The maximum total number of Points in the KDTrees that GraphSLAM keeps for all iterations.
+    /// Trees of further Scans are built again in every iteration
+    size_t  slamTreeCachePoints = 50000000;
+
     /// max difference of position (euclidean distance) new and old
     double diffPosition = 50;
 
@@ -132,6 +132,32 @@ public:
      */
     void trim();
 
+    /**
+     * @brief Creates reduced copies of the Scan for coarse-to-fine registration
+     * 
+     * Level 0 is the Scan itself, level i > 0 is reduced by Octree reduction with a voxel size of
+     * voxelSize * 2^(i - 1). The pyramid is discarded by the other reduction Methods.
+     * 
+     * @param levels The number of levels including the Scan itself
+     * @param voxelSize The voxel size of level 1
+     * @param maxLeafSize The maximum number of Points in a Leaf of the Octree
+     */
+    void createPyramid(int levels, double voxelSize, int maxLeafSize);
+
+    /**
+     * @brief Returns the number of pyramid levels including the Scan itself. 1 if there is no pyramid
+     */
+    size_t pyramidLevels() const;
+
+    /**
+     * @brief Returns a reduced copy of the Scan from the pyramid. The copy is set to the current pose
+     *        of this Scan, but transforming it does not change this Scan.
+     * 
+     * @param level The level in [1, pyramidLevels())
+     * @return SLAMScanPtr The reduced Scan
+     */
+    std::shared_ptr<SLAMScanWrapper> pyramidLevel(size_t level);
+
 
     /**
      * @brief Returns the Point at the specified index in global Coordinates
@@ -216,6 +242,9 @@ protected:
     Transformd            m_deltaPose;
 
     std::vector<std::pair<Transformd, FrameUse>> m_frames;
+
+    /// The reduced copies of the Scan, starting with level 1
+    std::vector<std::shared_ptr<SLAMScanWrapper>> m_pyramid;
 };
 
 using SLAMScanPtr = std::shared_ptr<SLAMScanWrapper>;
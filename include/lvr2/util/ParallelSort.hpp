@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2018, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ *  ParallelSort.hpp
+ *
+ */
+
+#ifndef LVR2_UTIL_PARALLELSORT_H_
+#define LVR2_UTIL_PARALLELSORT_H_
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include "lvr2/config/lvropenmp.hpp"
+
+namespace lvr2
+{
+
+/**
+ * @brief Sorts the range [first, last) with all available OpenMP threads.
+ *
+ * The range is split into one block per thread. Each block is sorted with
+ * std::sort and neighboring blocks are then merged pairwise until a single
+ * sorted run remains. Small inputs and builds without OpenMP simply fall back
+ * to std::sort. The result is the same as std::sort with the same comparator,
+ * i.e. the sort is not stable.
+ *
+ * @param first     Begin of the range
+ * @param last      End of the range
+ * @param comp      Strict weak ordering used for comparison
+ */
+template<typename RandomIt, typename Compare>
+void parallelSort(RandomIt first, RandomIt last, Compare comp)
+{
+    const long n = std::distance(first, last);
+    const long numThreads = OpenMPConfig::getNumThreads();
+
+    // Not worth the overhead for small ranges
+    if (numThreads < 2 || n < 1 << 16)
+    {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    // Block boundaries, one block per thread
+    std::vector<long> bounds(numThreads + 1);
+    for (long i = 0; i <= numThreads; i++)
+    {
+        bounds[i] = n * i / numThreads;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < numThreads; i++)
+    {
+        std::sort(first + bounds[i], first + bounds[i + 1], comp);
+    }
+
+    // Merge neighboring runs until only one is left
+    for (long width = 1; width < numThreads; width *= 2)
+    {
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (long i = 0; i < numThreads - width; i += 2 * width)
+        {
+            long mid = bounds[i + width];
+            long end = bounds[std::min(i + 2 * width, numThreads)];
+            std::inplace_merge(first + bounds[i], first + mid, first + end, comp);
+        }
+    }
+}
+
+/**
+ * @brief Sorts the range [first, last) in ascending order with all available
+ *        OpenMP threads. See parallelSort(first, last, comp).
+ */
+template<typename RandomIt>
+void parallelSort(RandomIt first, RandomIt last)
+{
+    using ValueT = typename std::iterator_traits<RandomIt>::value_type;
+    parallelSort(first, last, std::less<ValueT>());
+}
+
+} // namespace lvr2
+
+#endif /* LVR2_UTIL_PARALLELSORT_H_ */
@@ -36,6 +36,37 @@
 
 namespace lvr2
 {
+namespace
+{
+
+/**
+ * @brief visitor that estimates the number of bytes of the channel data of a chunk
+ */
+struct ChunkBytesVisitor : public boost::static_visitor<std::size_t>
+{
+    template <typename U>
+    std::size_t operator()(const Channel<U>& channel) const
+    {
+        return channel.numElements() * channel.width() * sizeof(U);
+    }
+
+    template <typename BufferPtr>
+    std::size_t operator()(const BufferPtr& buffer) const
+    {
+        std::size_t bytes = 0;
+        if (buffer)
+        {
+            for (const auto& channel : *buffer)
+            {
+                bytes += boost::apply_visitor(*this, channel.second);
+            }
+        }
+        return bytes;
+    }
+};
+
+} // namespace
+
 ChunkHashGrid::ChunkHashGrid(std::string hdf5Path, size_t cacheSize, float chunkSize)
     : m_cacheSize(cacheSize)
 {
@@ -63,18 +94,41 @@ ChunkHashGrid::ChunkHashGrid(std::string hdf5Path,
     setBoundingBox(boundingBox);
 }
 
-bool ChunkHashGrid::isChunkLoaded(std::string layer, std::size_t hashValue)
+std::size_t ChunkHashGrid::layerId(const std::string& layer)
+{
+    auto layerIt = m_layerIds.find(layer);
+    if (layerIt != m_layerIds.end())
+    {
+        return layerIt->second;
+    }
+
+    std::size_t id = m_layerNames.size();
+    m_layerIds.emplace(layer, id);
+    m_layerNames.push_back(layer);
+    m_hashGrid.emplace_back();
+    return id;
+}
+
+ChunkHashGrid::CacheEntry* ChunkHashGrid::findEntry(const std::string& layer,
+                                                    std::size_t hashValue)
 {
-    auto layerIt = m_hashGrid.find(layer);
-    if (layerIt != m_hashGrid.end())
+    auto layerIt = m_layerIds.find(layer);
+    if (layerIt != m_layerIds.end())
     {
-        auto chunkIt = layerIt->second.find(hashValue);
-        if (chunkIt != layerIt->second.end())
+        auto& chunks = m_hashGrid[layerIt->second];
+        auto chunkIt = chunks.find(hashValue);
+        if (chunkIt != chunks.end())
         {
-            return true;
+            return &chunkIt->second;
         }
     }
-    return false;
+    return nullptr;
+}
+
+bool ChunkHashGrid::isChunkLoaded(std::string layer, std::size_t hashValue)
+{
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    return findEntry(layer, hashValue) != nullptr;
 }
 
 bool ChunkHashGrid::isChunkLoaded(std::string layer, int x, int y, int z)
@@ -82,49 +136,46 @@ bool ChunkHashGrid::isChunkLoaded(std::string layer, int x, int y, int z)
     return isChunkLoaded(layer, hashValue(x, y, z));
 }
 
+ChunkHashGrid::val_type* ChunkHashGrid::touchChunk(const std::string& layer,
+                                                   std::size_t hashValue,
+                                                   bool request)
+{
+    CacheEntry* entry = findEntry(layer, hashValue);
+    if (entry == nullptr)
+    {
+        return nullptr;
+    }
+
+    if (request && entry->prefetched)
+    {
+        entry->prefetched = false;
+        m_prefetchHits++;
+    }
+
+    // move chunk to the front of the cache queue without invalidating the iterator
+    m_items.splice(m_items.begin(), m_items, entry->lruIt);
+    return &entry->data;
+}
+
 void ChunkHashGrid::rehashCache(const BaseVector<std::size_t>& oldChunkAmount,
                                 const BaseVector<std::size_t>& oldChunkIndexOffset)
 {
-    std::unordered_map<std::string, std::unordered_map<std::size_t, val_type>> tmpCache;
-    for (std::pair<std::string, std::size_t>& elem : m_items)
+    // every cached chunk is moved to its new hash, so the maps are rebuilt instead of
+    // being updated in place (a new hash may collide with an old one that is not moved yet)
+    std::vector<std::unordered_map<std::size_t, CacheEntry>> newGrid(m_hashGrid.size());
+    for (lru_key& elem : m_items)
     {
         // undo old hash function
         int k = elem.second % oldChunkAmount.z - oldChunkIndexOffset.z;
         int j = (elem.second / oldChunkAmount.z) % oldChunkAmount.y - oldChunkIndexOffset.y;
         int i = elem.second / (oldChunkAmount.y * oldChunkAmount.z) - oldChunkIndexOffset.x;
 
-        val_type chunk;
-
-        auto layerIt = tmpCache.find(elem.first);
-        if (layerIt != tmpCache.end())
-        {
-            auto chunkIt = tmpCache[elem.first].find(elem.second);
-            if (chunkIt != tmpCache[elem.first].end())
-            {
-                chunk = tmpCache[elem.first][elem.second];
-            }
-            else
-            {
-                chunk = m_hashGrid[elem.first][elem.second];
-            }
-        }
-        else
-        {
-            chunk = m_hashGrid[elem.first][elem.second];
-        }
-
         std::size_t newHash = hashValue(i, j, k);
 
-        auto chunkIt = m_hashGrid[elem.first].find(newHash);
-        if (chunkIt != m_hashGrid[elem.first].end())
-        {
-            tmpCache[elem.first][newHash] = m_hashGrid[elem.first][newHash];
-        }
-        m_hashGrid[elem.first][newHash] = chunk;
-        m_hashGrid[elem.first].erase(elem.second);
-
+        newGrid[elem.first].emplace(newHash, std::move(m_hashGrid[elem.first][elem.second]));
         elem.second = newHash;
     }
+    m_hashGrid = std::move(newGrid);
 }
 
 void ChunkHashGrid::expandBoundingBox(const val_type& data)
@@ -142,31 +193,71 @@ void ChunkHashGrid::expandBoundingBox(const val_type& data)
     }
 }
 
-void ChunkHashGrid::loadChunk(std::string layer, int x, int y, int z, const val_type& data)
+void ChunkHashGrid::loadChunk(
+    std::string layer, int x, int y, int z, const val_type& data, bool prefetched)
 {
     std::size_t chunkHash = hashValue(x, y, z);
+    std::size_t bytes     = chunkBytes(data);
 
-    if (isChunkLoaded(layer, chunkHash))
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    if (CacheEntry* entry = findEntry(layer, chunkHash))
+    {
+        // chunk exists for layer in grid, replace data and move it to the front of the lru cache
+        m_cachedBytes     = m_cachedBytes - entry->bytes + bytes;
+        entry->data       = data;
+        entry->bytes      = bytes;
+        entry->prefetched = entry->prefetched && prefetched;
+        m_items.splice(m_items.begin(), m_items, entry->lruIt);
+    }
+    else
     {
-        // chunk exists for layer in grid
-        // remove chunk from cache to put the chunk to front of lru cache later
-        m_items.remove({layer, chunkHash});
+        // add new chunk to cache
+        std::size_t id = layerId(layer);
+        m_items.push_front({id, chunkHash});
+        m_hashGrid[id].emplace(chunkHash, CacheEntry{data, bytes, m_items.begin(), prefetched});
+        m_cachedBytes += bytes;
+        if (prefetched)
+        {
+            m_prefetchedChunks++;
+        }
     }
 
-    // add new chunk to cache
-    m_items.push_front({layer, chunkHash});
+    evictChunks();
+}
 
-    // check if cache is full
-    if (m_items.size() > m_cacheSize)
+void ChunkHashGrid::setCacheBytes(std::size_t cacheBytes)
+{
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    m_cacheBytes = cacheBytes;
+    evictChunks();
+}
+
+void ChunkHashGrid::evictChunks()
+{
+    // keep the most recently used chunk even if it exceeds the byte limit on its own
+    while (m_items.size() > 1
+           && (m_items.size() > m_cacheSize || (m_cacheBytes && m_cachedBytes > m_cacheBytes)))
     {
         // remove chunk from grid keep the grid for the current layer even if it holds no elements
-        m_hashGrid[m_items.back().first].erase(m_items.back().second);
+        const lru_key& last = m_items.back();
+        auto& chunks        = m_hashGrid[last.first];
+        auto chunkIt        = chunks.find(last.second);
+        m_cachedBytes -= chunkIt->second.bytes;
+        if (chunkIt->second.prefetched)
+        {
+            m_prefetchWasted++;
+        }
+        chunks.erase(chunkIt);
 
         // remove erased element from cache
         m_items.pop_back();
+        m_cacheEvictions++;
     }
+}
 
-    m_hashGrid[layer][chunkHash] = data;
+std::size_t ChunkHashGrid::chunkBytes(const val_type& data)
+{
+    return boost::apply_visitor(ChunkBytesVisitor(), data);
 }
 
 void ChunkHashGrid::setBoundingBox(const BoundingBox<BaseVector<float>> boundingBox)
@@ -207,6 +298,7 @@ void ChunkHashGrid::setChunkAmountAndOffset(const BaseVector<std::size_t>& chunk
         BaseVector<std::size_t> oldChunkAmount      = m_chunkAmount;
         BaseVector<std::size_t> oldChunkIndexOffset = m_chunkIndexOffset;
 
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
         m_chunkAmount      = chunkAmount;
         m_chunkIndexOffset = chunkIndexOffset;
 
@@ -41,6 +41,7 @@
 #include <algorithm>
 #include <boost/filesystem.hpp>
 #include <cmath>
+#include <highfive/H5Exception.hpp>
 
 namespace
 {
@@ -112,6 +113,135 @@ ChunkManager::ChunkManager(std::string hdf5Path, size_t cacheSize, float chunkSi
 {
 }
 
+ChunkManager::~ChunkManager()
+{
+    if (m_prefetchPool)
+    {
+        // discard queued prefetches and wait for the running ones
+        m_prefetchPool->stop(false);
+    }
+}
+
+void ChunkManager::prefetchArea(const BoundingBox<BaseVector<float>>& area,
+                                float margin,
+                                std::string layer)
+{
+    BaseVector<float> offset(margin, margin, margin);
+    BoundingBox<BaseVector<float>> expandedArea(area.getMin() - offset, area.getMax() + offset);
+
+    for (const BaseVector<int>& cellCoord : getAreaChunkCoordinates(expandedArea))
+    {
+        prefetchChunk(layer, cellCoord);
+    }
+}
+
+void ChunkManager::prefetchTrajectory(const std::vector<BaseVector<float>>& trajectory,
+                                      float radius,
+                                      float lookAhead,
+                                      std::string layer)
+{
+    if (trajectory.empty())
+    {
+        return;
+    }
+
+    BaseVector<float> offset(radius, radius, radius);
+    for (const BaseVector<float>& position : trajectory)
+    {
+        BoundingBox<BaseVector<float>> area(position - offset, position + offset);
+        prefetchArea(area, 0.0f, layer);
+    }
+
+    // predict the next position by linear extrapolation of the last step
+    if (trajectory.size() > 1 && lookAhead > 0.0f)
+    {
+        const BaseVector<float>& last = trajectory[trajectory.size() - 1];
+        const BaseVector<float>& prev = trajectory[trajectory.size() - 2];
+        BaseVector<float> next        = last + (last - prev) * lookAhead;
+
+        // cover the path between the last and the predicted position
+        BoundingBox<BaseVector<float>> path(last - offset, last + offset);
+        path.expand(next - offset);
+        path.expand(next + offset);
+        prefetchArea(path, 0.0f, layer);
+    }
+}
+
+void ChunkManager::waitForPrefetch()
+{
+    std::unique_lock<std::mutex> lock(m_prefetchMutex);
+    m_prefetchFinished.wait(lock, [this]() { return m_pendingPrefetches.empty(); });
+}
+
+size_t ChunkManager::getNumPendingPrefetches()
+{
+    std::lock_guard<std::mutex> lock(m_prefetchMutex);
+    return m_pendingPrefetches.size();
+}
+
+void ChunkManager::setPrefetchThreads(int numThreads)
+{
+    std::lock_guard<std::mutex> lock(m_prefetchMutex);
+    m_prefetchThreads = std::max(numThreads, 1);
+    if (m_prefetchPool)
+    {
+        m_prefetchPool->resize(m_prefetchThreads);
+    }
+}
+
+void ChunkManager::prefetchChunk(const std::string& layer, const BaseVector<int>& cellCoord)
+{
+    if (isChunkLoaded(layer, cellCoord.x, cellCoord.y, cellCoord.z))
+    {
+        return;
+    }
+
+    std::tuple<std::string, int, int, int> key(layer, cellCoord.x, cellCoord.y, cellCoord.z);
+
+    std::lock_guard<std::mutex> lock(m_prefetchMutex);
+    if (!m_pendingPrefetches.insert(key).second)
+    {
+        // already queued
+        return;
+    }
+
+    if (!m_prefetchPool)
+    {
+        m_prefetchPool.reset(new ctpl::thread_pool(m_prefetchThreads));
+    }
+
+    m_prefetchPool->push([this, key](int) {
+        // a failed prefetch only leaves the chunk uncached, it is loaded again on request
+        try
+        {
+            loadChunk<MeshBufferPtr>(
+                std::get<0>(key), std::get<1>(key), std::get<2>(key), std::get<3>(key), true);
+        }
+        catch (HighFive::Exception& e)
+        {
+            std::cerr << lvr2::timestamp << "Prefetching chunk (" << std::get<1>(key) << ", "
+                      << std::get<2>(key) << ", " << std::get<3>(key) << ") of layer "
+                      << std::get<0>(key) << " failed with HDF5 error: " << e.what() << std::endl;
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << lvr2::timestamp << "Prefetching chunk (" << std::get<1>(key) << ", "
+                      << std::get<2>(key) << ", " << std::get<3>(key) << ") of layer "
+                      << std::get<0>(key) << " failed: " << e.what() << std::endl;
+        }
+        catch (...)
+        {
+            // report unknown errors in the foreground by the next getChunk
+            std::lock_guard<std::mutex> lock(m_cacheMutex);
+            m_prefetchError = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(m_prefetchMutex);
+        m_pendingPrefetches.erase(key);
+        m_prefetchFinished.notify_all();
+    });
+}
+
 std::vector<std::string> ChunkManager::getChannelsFromMesh(std::string layer)
 {
     std::vector<std::string> attributeList;
@@ -151,48 +281,26 @@ void ChunkManager::extractArea(const BoundingBox<BaseVector<float>>& area,
                                std::unordered_map<std::size_t, MeshBufferPtr>& chunks,
                                std::string layer)
 {
-    // adjust area to our maximum boundingBox
-    BaseVector<float> adjustedAreaMin, adjustedAreaMax;
-    adjustedAreaMax[0] = std::min(area.getMax()[0], getBoundingBox().getMax()[0]);
-    adjustedAreaMax[1] = std::min(area.getMax()[1], getBoundingBox().getMax()[1]);
-    adjustedAreaMax[2] = std::min(area.getMax()[2], getBoundingBox().getMax()[2]);
-    adjustedAreaMin[0] = std::max(area.getMin()[0], getBoundingBox().getMin()[0]);
-    adjustedAreaMin[1] = std::max(area.getMin()[1], getBoundingBox().getMin()[1]);
-    adjustedAreaMin[2] = std::max(area.getMin()[2], getBoundingBox().getMin()[2]);
-    BoundingBox<BaseVector<float>> adjustedArea
-        = BoundingBox<BaseVector<float>>(adjustedAreaMin, adjustedAreaMax);
-
     // find all required chunks
-    // TODO: check if we need + 1
-    const BaseVector<float> maxSteps
-        = (adjustedArea.getMax() - adjustedArea.getMin()) / getChunkSize();
-    for (std::size_t i = 0; i < maxSteps.x; ++i)
+    for (const BaseVector<int>& cellCoord : getAreaChunkCoordinates(area))
     {
-        for (std::size_t j = 0; j < maxSteps.y; ++j)
-        {
-            for (std::size_t k = 0; k < maxSteps.z; ++k)
-            {
-                BaseVector<int> cellCoord = getCellCoordinates(
-                    adjustedArea.getMin() + BaseVector<float>(i, j, k) * getChunkSize());
-                size_t cellIndex = hashValue(cellCoord.x, cellCoord.y, cellCoord.z);
+        size_t cellIndex = hashValue(cellCoord.x, cellCoord.y, cellCoord.z);
 
-                // if element is already loaded.
-                // if(chunks.find(cellIndex) != chunks.end())
-                //{
-                //    continue;
-                //}
+        // if element is already loaded.
+        // if(chunks.find(cellIndex) != chunks.end())
+        //{
+        //    continue;
+        //}
 
-                boost::optional<MeshBufferPtr> loadedChunk
-                    = getChunk<MeshBufferPtr>(layer, cellCoord.x, cellCoord.y, cellCoord.z);
+        boost::optional<MeshBufferPtr> loadedChunk
+            = getChunk<MeshBufferPtr>(layer, cellCoord.x, cellCoord.y, cellCoord.z);
 
-                if (loadedChunk)
-                {
-                    // TODO: remove saving tmp chunks later
-                    // ModelFactory::saveModel(lvr2::ModelPtr(new lvr2::Model(loadedChunk)),
-                    //                        "area/" + std::to_string(cellIndex) + ".ply");
-                    chunks.insert({cellIndex, *loadedChunk});
-                }
-            }
+        if (loadedChunk)
+        {
+            // TODO: remove saving tmp chunks later
+            // ModelFactory::saveModel(lvr2::ModelPtr(new lvr2::Model(loadedChunk)),
+            //                        "area/" + std::to_string(cellIndex) + ".ply");
+            chunks.insert({cellIndex, *loadedChunk});
         }
     }
     //    std::cout << "Num chunks " << chunks.size() << std::endl;
@@ -203,41 +311,19 @@ MeshBufferPtr ChunkManager::extractArea(const BoundingBox<BaseVector<float>>& ar
 {
     std::unordered_map<std::size_t, MeshBufferPtr> chunks;
 
-    // adjust area to our maximum boundingBox
-    BaseVector<float> adjustedAreaMin, adjustedAreaMax;
-    adjustedAreaMax[0] = std::min(area.getMax()[0], getBoundingBox().getMax()[0]);
-    adjustedAreaMax[1] = std::min(area.getMax()[1], getBoundingBox().getMax()[1]);
-    adjustedAreaMax[2] = std::min(area.getMax()[2], getBoundingBox().getMax()[2]);
-    adjustedAreaMin[0] = std::max(area.getMin()[0], getBoundingBox().getMin()[0]);
-    adjustedAreaMin[1] = std::max(area.getMin()[1], getBoundingBox().getMin()[1]);
-    adjustedAreaMin[2] = std::max(area.getMin()[2], getBoundingBox().getMin()[2]);
-    BoundingBox<BaseVector<float>> adjustedArea
-        = BoundingBox<BaseVector<float>>(adjustedAreaMin, adjustedAreaMax);
-
     // find all required chunks
-    // TODO: check if we need + 1
-    const BaseVector<float> maxSteps
-        = (adjustedArea.getMax() - adjustedArea.getMin()) / getChunkSize();
-    for (std::size_t i = 0; i < maxSteps.x; ++i)
+    for (const BaseVector<int>& cellCoord : getAreaChunkCoordinates(area))
     {
-        for (std::size_t j = 0; j < maxSteps.y; ++j)
-        {
-            for (std::size_t k = 0; k < maxSteps.z; ++k)
-            {
-                BaseVector<int> cellCoord = getCellCoordinates(
-                    adjustedArea.getMin() + BaseVector<float>(i, j, k) * getChunkSize());
-                size_t cellIndex = hashValue(cellCoord.x, cellCoord.y, cellCoord.z);
+        size_t cellIndex = hashValue(cellCoord.x, cellCoord.y, cellCoord.z);
 
-                boost::optional<MeshBufferPtr> loadedChunk
-                    = getChunk<MeshBufferPtr>(layer, cellCoord.x, cellCoord.y, cellCoord.z);
-                if (loadedChunk)
-                {
-                    // TODO: remove saving tmp chunks later
-                    ModelFactory::saveModel(lvr2::ModelPtr(new lvr2::Model(*loadedChunk)),
-                                            "area/" + std::to_string(cellIndex) + ".ply");
-                    chunks.insert({cellIndex, *loadedChunk});
-                }
-            }
+        boost::optional<MeshBufferPtr> loadedChunk
+            = getChunk<MeshBufferPtr>(layer, cellCoord.x, cellCoord.y, cellCoord.z);
+        if (loadedChunk)
+        {
+            // TODO: remove saving tmp chunks later
+            ModelFactory::saveModel(lvr2::ModelPtr(new lvr2::Model(*loadedChunk)),
+                                    "area/" + std::to_string(cellIndex) + ".ply");
+            chunks.insert({cellIndex, *loadedChunk});
         }
     }
     std::cout << "Extracted " << chunks.size() << " Chunks" << std::endl;
@@ -748,6 +834,39 @@ BaseVector<int> ChunkManager::getCellCoordinates(const BaseVector<float>& vec) c
     return ret;
 }
 
+std::vector<BaseVector<int>> ChunkManager::getAreaChunkCoordinates(
+    const BoundingBox<BaseVector<float>>& area) const
+{
+    // adjust area to our maximum boundingBox
+    BaseVector<float> adjustedAreaMin, adjustedAreaMax;
+    adjustedAreaMax[0] = std::min(area.getMax()[0], getBoundingBox().getMax()[0]);
+    adjustedAreaMax[1] = std::min(area.getMax()[1], getBoundingBox().getMax()[1]);
+    adjustedAreaMax[2] = std::min(area.getMax()[2], getBoundingBox().getMax()[2]);
+    adjustedAreaMin[0] = std::max(area.getMin()[0], getBoundingBox().getMin()[0]);
+    adjustedAreaMin[1] = std::max(area.getMin()[1], getBoundingBox().getMin()[1]);
+    adjustedAreaMin[2] = std::max(area.getMin()[2], getBoundingBox().getMin()[2]);
+    BoundingBox<BaseVector<float>> adjustedArea
+        = BoundingBox<BaseVector<float>>(adjustedAreaMin, adjustedAreaMax);
+
+    // find all required chunks
+    // TODO: check if we need + 1
+    std::vector<BaseVector<int>> cellCoords;
+    const BaseVector<float> maxSteps
+        = (adjustedArea.getMax() - adjustedArea.getMin()) / getChunkSize();
+    for (std::size_t i = 0; i < maxSteps.x; ++i)
+    {
+        for (std::size_t j = 0; j < maxSteps.y; ++j)
+        {
+            for (std::size_t k = 0; k < maxSteps.z; ++k)
+            {
+                cellCoords.push_back(getCellCoordinates(
+                    adjustedArea.getMin() + BaseVector<float>(i, j, k) * getChunkSize()));
+            }
+        }
+    }
+    return cellCoords;
+}
+
 // std::string ChunkManager::getCellName(const BaseVector<float>& vec) const
 //{
 //    BaseVector<float> tmpVec = (vec - getBoundingBox().getMin()) / getChunkSize();
@@ -67,6 +67,22 @@ void OpenMPConfig::setMaxNumThreads()
 #endif
 }
 
+int OpenMPConfig::getMaxActiveLevels()
+{
+#ifdef LVR2_USE_OPEN_MP
+	return omp_get_max_active_levels();
+#else
+	return 1;
+#endif
+}
+
+void OpenMPConfig::setMaxActiveLevels(int levels)
+{
+#ifdef LVR2_USE_OPEN_MP
+	omp_set_max_active_levels(levels);
+#endif
+}
+
 int OpenMPConfig::getNumThreads()
 {
 #ifdef LVR2_USE_OPEN_MP
@@ -39,8 +39,10 @@
 using std::ifstream;
 
 #include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 
 #include "lvr2/io/AsciiIO.hpp"
+#include "lvr2/io/AsciiParser.hpp"
 #include "lvr2/io/Progress.hpp"
 #include "lvr2/io/Timestamp.hpp"
 
@@ -62,43 +64,40 @@ ModelPtr AsciiIO::read(
         cout << "»" << extension << "« is not a valid file extension." << endl;
         return ModelPtr();
     }
-    // Count lines in file to estimate the number of present points
-    size_t lines_in_file = countLines(filename);
-
-    if ( lines_in_file < 2 )
+    // Map file into memory
+    boost::iostreams::mapped_file_source mmfs;
+    try
     {
-        cout << timestamp << "AsciiIO: Too few lines in file (has to be > 2)." << endl;
+        mmfs.open(filename);
+    }
+    catch (std::exception& e)
+    {
+        cout << timestamp << "AsciiIO: Unable to map file " << filename << ": " << e.what() << endl;
         return ModelPtr();
     }
 
-    // Open file
-    ifstream in;
-    in.open(filename.c_str());
+    // Skip first line (may contain meta data in some formats)
+    const char* first = AsciiParser::nextLine(mmfs.data(), mmfs.data() + mmfs.size());
+    const char* last = mmfs.data() + mmfs.size();
 
-    // Read first two lines, ignore the first one
-    char buffer[2048];
-    in.getline(buffer, 2048);
-    in.getline(buffer, 2048);
+    if ( first == last )
+    {
+        cout << timestamp << "AsciiIO: Too few lines in file (has to be > 2)." << endl;
+        return ModelPtr();
+    }
 
     // Get number of entries in test line and analize
     int num_columns  = AsciiIO::getEntriesInLine(filename);
 
-    // Reopen file and read data
-    in.close();
-    in.open(filename.c_str());
-
-    // Again skip first line
-    in.getline(buffer, 2048);
-
-    // Buffer related variables
-    size_t numPoints = 0;
+    // Count point lines in parallel
+    AsciiParser parser(first, last);
+    size_t numPoints = parser.numLines();
 
     floatArr points;
     ucharArr pointColors;
     floatArr pointIntensities;
 
     // Alloc memory for points
-    numPoints = lines_in_file - 1;
     points = floatArr( new float[ numPoints * 3 ] );
     ModelPtr model(new Model);
     model->m_pointCloud = PointBufferPtr( new PointBuffer);
@@ -126,76 +125,34 @@ ModelPtr AsciiIO::read(
         pointIntensities = floatArr( new float[ numPoints ] );
     }
 
-    // Read data form file
-    size_t c = 0;
-    while (in.good() && c < numPoints)
-    {
-        float x, y, z, intensity, dummy;
-        unsigned int r, g, b;
-
-        for(int i = 0; i < num_columns; i++)
-        {
-            if(i == xPos)
-            {
-                in >> x;
-            }
-            else if(i == yPos)
-            {
-                in >> y;
-            }
-            else if(i == zPos)
-            {
-                in >> z;
-            }
-            else if(i == rPos)
-            {
-                in >> r;
-            }
-            else if(i == gPos)
-            {
-                in >> g;
-            }
-            else if(i == bPos)
-            {
-                in >> b;
-            }
-            else if(i == iPos)
-            {
-                in >> intensity;
-            }
-            else
-            {
-                in >> dummy;
-            }
-
-        }
+    // Parse data and write it directly into the buffers
+    size_t num_values = std::max({xPos, yPos, zPos, rPos, gPos, bPos, iPos}) + 1;
 
+    size_t incomplete = parser.parse(num_values, [&](size_t c, const float* values, size_t n)
+    {
         // Read according to determined format
         if(has_color)
         {
-            pointColors[ c * 3     ] = (unsigned char) r;
-            pointColors[ c * 3 + 1 ] = (unsigned char) g;
-            pointColors[ c * 3 + 2 ] = (unsigned char) b;
-
+            pointColors[ c * 3     ] = (unsigned char) (unsigned int) values[rPos];
+            pointColors[ c * 3 + 1 ] = (unsigned char) (unsigned int) values[gPos];
+            pointColors[ c * 3 + 2 ] = (unsigned char) (unsigned int) values[bPos];
         }
 
         if (has_intensity)
         {
-            pointIntensities[c] = intensity;
-
+            pointIntensities[c] = values[iPos];
         }
 
-        points[ c * 3     ] = x;
-        points[ c * 3 + 1 ] = y;
-        points[ c * 3 + 2 ] = z;
-        c++;
-    }
+        points[ c * 3     ] = values[xPos];
+        points[ c * 3 + 1 ] = values[yPos];
+        points[ c * 3 + 2 ] = values[zPos];
+    });
 
     // Sanity check
-    if(c != numPoints)
+    if(incomplete > 0)
     {
-        cout << timestamp << "Warning: Point count / line count mismatch: "
-             << numPoints << " / " << c << endl;
+        cout << timestamp << "Warning: " << incomplete << " of "
+             << numPoints << " lines contain less than " << num_values << " values" << endl;
     }
 
     // Assign buffers
@@ -0,0 +1,210 @@
+/**
+ * Copyright (c) 2018, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * AsciiParser.cpp
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+
+#include "lvr2/io/AsciiParser.hpp"
+#include "lvr2/config/lvropenmp.hpp"
+
+namespace lvr2
+{
+
+namespace
+{
+
+/// Minimal size of the blocks that are processed by a single thread
+constexpr size_t MinBlockSize = 1 << 20;
+
+/// Number of blocks per thread to balance lines of varying length
+constexpr size_t BlocksPerThread = 8;
+
+inline bool isSeparator(char c)
+{
+    return c == ' ' || c == '\t' || c == ',' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/// Converts the token at first with strtof on a null terminated copy
+const char* parseFloatFallback(const char* first, const char* last, float& value)
+{
+    char buffer[64];
+    size_t length = 0;
+    while (first + length < last && length < sizeof(buffer) - 1
+           && !isSeparator(first[length]) && first[length] != '\n')
+    {
+        buffer[length] = first[length];
+        length++;
+    }
+    buffer[length] = '\0';
+
+    char* end;
+    value = std::strtof(buffer, &end);
+    return end == buffer ? nullptr : first + (end - buffer);
+}
+
+} // namespace
+
+AsciiParser::AsciiParser(const char* first, const char* last, size_t maxLines)
+{
+    const size_t size = last > first ? last - first : 0;
+    const size_t maxBlocks = static_cast<size_t>(OpenMPConfig::getNumThreads()) * BlocksPerThread;
+    const size_t numBlocks = std::max<size_t>(1, std::min(size / MinBlockSize, maxBlocks));
+
+    // Split data into blocks that start directly after a line break
+    m_blocks.reserve(numBlocks + 1);
+    m_blocks.push_back(first);
+    for (size_t i = 1; i < numBlocks; i++)
+    {
+        const char* boundary = nextLine(first + size / numBlocks * i - 1, first + size);
+        m_blocks.push_back(std::max(boundary, m_blocks.back()));
+    }
+    m_blocks.push_back(first + size);
+
+    // Count non blank lines per block
+    m_lineOffsets.assign(numBlocks + 1, 0);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long b = 0; b < static_cast<long>(numBlocks); b++)
+    {
+        size_t count = 0;
+        const char* pos = m_blocks[b];
+        while (pos < m_blocks[b + 1])
+        {
+            const char* lineEnd = nextLine(pos, m_blocks[b + 1]);
+            if (!isBlank(pos, lineEnd))
+            {
+                count++;
+            }
+            pos = lineEnd;
+        }
+        m_lineOffsets[b + 1] = count;
+    }
+
+    for (size_t b = 0; b < numBlocks; b++)
+    {
+        m_lineOffsets[b + 1] += m_lineOffsets[b];
+    }
+
+    // Cut off all lines behind the requested maximum
+    if (maxLines > 0 && numLines() > maxLines)
+    {
+        size_t b = 0;
+        while (m_lineOffsets[b + 1] < maxLines)
+        {
+            b++;
+        }
+
+        size_t count = m_lineOffsets[b];
+        const char* pos = m_blocks[b];
+        while (count < maxLines)
+        {
+            const char* lineEnd = nextLine(pos, m_blocks[b + 1]);
+            if (!isBlank(pos, lineEnd))
+            {
+                count++;
+            }
+            pos = lineEnd;
+        }
+
+        m_blocks.resize(b + 2);
+        m_blocks[b + 1] = pos;
+        m_lineOffsets.resize(b + 2);
+        m_lineOffsets[b + 1] = maxLines;
+    }
+}
+
+const char* AsciiParser::parseFloat(const char* first, const char* last, float& value)
+{
+    while (first < last && isSeparator(*first))
+    {
+        first++;
+    }
+
+    // std::from_chars does not accept an explicit plus sign
+    if (first < last && *first == '+')
+    {
+        first++;
+    }
+
+    if (first == last)
+    {
+        return nullptr;
+    }
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    std::from_chars_result result = std::from_chars(first, last, value);
+    if (result.ec == std::errc())
+    {
+        return result.ptr;
+    }
+    else if (result.ec == std::errc::invalid_argument)
+    {
+        return nullptr;
+    }
+#endif
+
+    // Values that are out of range (and compilers without floating
+    // point support in from_chars) are handled like strtof does
+    return parseFloatFallback(first, last, value);
+}
+
+size_t AsciiParser::parseLine(const char* first, const char* last, float* values, size_t maxValues)
+{
+    size_t n = 0;
+    while (n < maxValues)
+    {
+        const char* next = parseFloat(first, last, values[n]);
+        if (!next)
+        {
+            break;
+        }
+        first = next;
+        n++;
+    }
+    std::fill(values + n, values + maxValues, 0.0f);
+    return n;
+}
+
+const char* AsciiParser::nextLine(const char* first, const char* last)
+{
+    const void* lineBreak = first < last ? std::memchr(first, '\n', last - first) : nullptr;
+    return lineBreak ? static_cast<const char*>(lineBreak) + 1 : last;
+}
+
+bool AsciiParser::isBlank(const char* first, const char* last)
+{
+    return std::all_of(first, last, [](char c) { return c == '\n' || isSeparator(c); });
+}
+
+} // namespace lvr2
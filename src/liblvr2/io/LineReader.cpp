@@ -33,6 +33,8 @@
  */
 
 #include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <cerrno>
 #include <exception>
 #include <fstream>
@@ -41,6 +43,7 @@
 #include <sstream>
 #include <stdio.h>
 
+#include "lvr2/io/AsciiParser.hpp"
 #include "lvr2/io/LineReader.hpp"
 
 namespace lvr2
@@ -271,6 +274,11 @@ boost::shared_ptr<void> LineReader::getNextPoints(size_t& return_amount, size_t
         }
     }
 
+    if (!m_fileAttributes[m_currentReadFile].m_ply || !m_fileAttributes[m_currentReadFile].m_binary)
+    {
+        return getNextAsciiPoints(return_amount, amount);
+    }
+
     std::string filePath = m_fileAttributes[m_currentReadFile].m_filePath;
 
     FILE* pFile;
@@ -310,185 +318,6 @@ boost::shared_ptr<void> LineReader::getNextPoints(size_t& return_amount, size_t
                 m_openNextFile = true;
             return pArray;
         }
-        else
-        {
-            fseek(pFile, m_fileAttributes[m_currentReadFile].m_filePos, SEEK_SET);
-            size_t readCount = 0;
-            if (m_fileAttributes[m_currentReadFile].m_fileType == XYZ &&
-                m_fileAttributes[m_currentReadFile].m_line_element_amount != 3)
-            {
-
-                std::vector<float> input;
-                input.reserve(amount * 3);
-                boost::shared_ptr<void> pArray(
-                    new char[amount * m_fileAttributes[m_currentReadFile].m_PointBlockSize],
-                    std::default_delete<char[]>());
-                float ax, ay, az;
-                char lineBuffer[1024];
-                while ((fgets(lineBuffer, 1024, pFile) != NULL) && readCount < amount)
-                {
-                    sscanf(lineBuffer, "%f %f %f", &ax, &ay, &az);
-                    readCount++;
-                    input.push_back(ax);
-                    input.push_back(ay);
-                    input.push_back(az);
-                }
-
-                memcpy(pArray.get(),
-                       input.data(),
-                       m_fileAttributes[m_currentReadFile].m_PointBlockSize * readCount);
-                return_amount = readCount;
-                if (return_amount < amount)
-                    m_openNextFile = true;
-                m_fileAttributes[m_currentReadFile].m_filePos = ftell(pFile);
-                fclose(pFile);
-                return pArray;
-            }
-            if (m_fileAttributes[m_currentReadFile].m_fileType == XYZ)
-            {
-                std::vector<float> input;
-                input.reserve(amount * 3);
-                boost::shared_ptr<void> pArray(
-                    new char[amount * m_fileAttributes[m_currentReadFile].m_PointBlockSize],
-                    std::default_delete<char[]>());
-                float ax, ay, az;
-                while ((fscanf(pFile, "%f %f %f", &ax, &ay, &az) != EOF) && readCount < amount)
-                {
-                    readCount++;
-                    input.push_back(ax);
-                    input.push_back(ay);
-                    input.push_back(az);
-                }
-
-                memcpy(pArray.get(),
-                       input.data(),
-                       m_fileAttributes[m_currentReadFile].m_PointBlockSize * readCount);
-                return_amount = readCount;
-                if (return_amount < amount)
-                {
-                    m_openNextFile = true;
-                }
-                else
-                {
-                    m_openNextFile = false;
-                }
-                m_fileAttributes[m_currentReadFile].m_filePos = ftell(pFile);
-                fclose(pFile);
-                return pArray;
-            }
-            else if (m_fileAttributes[m_currentReadFile].m_fileType == XYZN)
-            {
-                std::vector<float> input;
-                input.reserve(amount * 6);
-                boost::shared_ptr<void> pArray(
-                    new char[amount * m_fileAttributes[m_currentReadFile].m_PointBlockSize],
-                    std::default_delete<char[]>());
-                float ax, ay, az, nx, ny, nz;
-                while ((fscanf(pFile, "%f %f %f %f %f %f", &ax, &ay, &az, &nx, &ny, &nz) != EOF) &&
-                       readCount < amount)
-                {
-                    readCount++;
-                    input.push_back(ax);
-                    input.push_back(ay);
-                    input.push_back(az);
-                }
-                memcpy(pArray.get(),
-                       input.data(),
-                       m_fileAttributes[m_currentReadFile].m_PointBlockSize * readCount);
-                return_amount = readCount;
-                if (return_amount < amount)
-                    m_openNextFile = true;
-                m_fileAttributes[m_currentReadFile].m_filePos = ftell(pFile);
-                fclose(pFile);
-                return pArray;
-            }
-            else if (m_fileAttributes[m_currentReadFile].m_fileType == XYZRGB)
-            {
-                std::vector<xyzc> input;
-                input.reserve(amount * 6);
-                boost::shared_ptr<void> pArray(
-                    new char[amount * m_fileAttributes[m_currentReadFile].m_PointBlockSize],
-                    std::default_delete<char[]>());
-                xyzc pc;
-                float tmp_x, tmp_y, tmp_z;
-                unsigned char tmp_r, tmp_g, tmp_b;
-                while ((fscanf(pFile,
-                               "%f %f %f %hhu %hhu %hhu",  // don't read directly in to struct!
-                               &tmp_x,
-                               &tmp_y,
-                               &tmp_z,
-                               &tmp_r,
-                               &tmp_g,
-                               &tmp_b) != EOF) &&
-                       readCount < amount)
-                {
-                    pc.point.x = tmp_x;
-                    pc.point.y = tmp_y;
-                    pc.point.z = tmp_z;
-                    pc.color.r = tmp_r;
-                    pc.color.g = tmp_g;
-                    pc.color.b = tmp_b;
-                    readCount++;
-                    input.push_back(pc);
-                }
-                memcpy(pArray.get(),
-                       input.data(),
-                       m_fileAttributes[m_currentReadFile].m_PointBlockSize * readCount);
-                return_amount = readCount;
-                if (return_amount < amount)
-                    m_openNextFile = true;
-                m_fileAttributes[m_currentReadFile].m_filePos = ftell(pFile);
-                fclose(pFile);
-                return pArray;
-            }
-            else if (m_fileAttributes[m_currentReadFile].m_fileType == XYZNRGB)
-            {
-                std::vector<xyznc> input;
-                input.reserve(amount * 6);
-                boost::shared_ptr<void> pArray(
-                    new char[amount * m_fileAttributes[m_currentReadFile].m_PointBlockSize],
-                    std::default_delete<char[]>());
-                xyznc pc;
-                float tmp_x, tmp_y, tmp_z, tmp_nx, tmp_ny, tmp_nz;
-                unsigned char tmp_r, tmp_g, tmp_b;
-                while ((fscanf(pFile,
-                               "%f %f %f %hhu %hhu %hhu %f %f %f",
-                               &tmp_x,
-                               &tmp_y,
-                               &tmp_z,
-                               &tmp_r,
-                               &tmp_g,
-                               &tmp_b,
-                               &tmp_nx,
-                               &tmp_ny,
-                               &tmp_nz) != EOF) &&
-                       readCount < amount)
-                {
-                    pc.point.x = tmp_x;
-                    pc.point.y = tmp_y;
-                    pc.point.z = tmp_z;
-                    pc.color.r = tmp_r;
-                    pc.color.g = tmp_g;
-                    pc.color.b = tmp_b;
-                    pc.normal.x = tmp_nx;
-                    pc.normal.y = tmp_ny;
-                    pc.normal.z = tmp_nz;
-                    readCount++;
-                    input.push_back(pc);
-                }
-                memcpy(pArray.get(),
-                       input.data(),
-                       m_fileAttributes[m_currentReadFile].m_PointBlockSize * readCount);
-                return_amount = readCount;
-                m_fileAttributes[m_currentReadFile].m_filePos = ftell(pFile);
-                if (return_amount < amount)
-                {
-                    m_openNextFile = true;
-                }
-                fclose(pFile);
-                return pArray;
-            }
-        }
         fclose(pFile);
     }
     else
@@ -501,6 +330,108 @@ boost::shared_ptr<void> LineReader::getNextPoints(size_t& return_amount, size_t
     return tmp;
 }
 
+boost::shared_ptr<void> LineReader::getNextAsciiPoints(size_t& return_amount, size_t amount)
+{
+    fileAttribut& attr = m_fileAttributes[m_currentReadFile];
+
+    size_t fileSize = boost::filesystem::file_size(attr.m_filePath);
+    if (attr.m_filePos >= fileSize)
+    {
+        m_openNextFile = true;
+        return boost::shared_ptr<void>();
+    }
+
+    boost::iostreams::mapped_file_source mmfs(attr.m_filePath);
+    const char* first = mmfs.data() + attr.m_filePos;
+    const char* last = mmfs.data() + mmfs.size();
+
+    // Estimate the range that contains the requested number of lines from
+    // the average length of the next few lines
+    size_t sampleLines = 0;
+    const char* sampleEnd = first;
+    while (sampleEnd < last && sampleLines < 1024)
+    {
+        sampleEnd = AsciiParser::nextLine(sampleEnd, last);
+        sampleLines++;
+    }
+    size_t rangeSize = (sampleEnd - first) / sampleLines * 5 / 4 * amount + 1;
+
+    // Count the lines in the range in parallel and enlarge it if it
+    // contains too few lines
+    AsciiParser parser(first, first, amount);
+    while (true)
+    {
+        const char* rangeEnd = last;
+        if (rangeSize < static_cast<size_t>(last - first))
+        {
+            rangeEnd = AsciiParser::nextLine(first + rangeSize - 1, last);
+        }
+
+        parser = AsciiParser(first, rangeEnd, amount);
+        if (parser.numLines() == amount || rangeEnd == last)
+        {
+            break;
+        }
+        rangeSize *= 2;
+    }
+
+    // Parse lines directly into the returned point array. The expected column
+    // order is x y z [nx ny nz] for XYZ(N) and x y z r g b [nx ny nz] for XYZ(N)RGB.
+    const fileType type = attr.m_fileType;
+    const size_t blockSize = attr.m_PointBlockSize;
+    size_t numValues = 3;
+    switch (type)
+    {
+        case XYZ: numValues = 3; break;
+        case XYZN:
+        case XYZRGB: numValues = 6; break;
+        case XYZNRGB: numValues = 9; break;
+    }
+
+    boost::shared_ptr<void> pArray(new char[parser.numLines() * blockSize],
+                                   std::default_delete<char[]>());
+    char* data = static_cast<char*>(pArray.get());
+
+    parser.parse(numValues, [&](size_t i, const float* values, size_t n) {
+        xyz* p = reinterpret_cast<xyz*>(data + i * blockSize);
+        p->point.x = values[0];
+        p->point.y = values[1];
+        p->point.z = values[2];
+        if (type == XYZN)
+        {
+            xyzn* pn = static_cast<xyzn*>(p);
+            pn->normal.x = values[3];
+            pn->normal.y = values[4];
+            pn->normal.z = values[5];
+        }
+        else if (type == XYZRGB)
+        {
+            xyzc* pc = static_cast<xyzc*>(p);
+            pc->color.r = static_cast<unsigned char>(static_cast<unsigned int>(values[3]));
+            pc->color.g = static_cast<unsigned char>(static_cast<unsigned int>(values[4]));
+            pc->color.b = static_cast<unsigned char>(static_cast<unsigned int>(values[5]));
+        }
+        else if (type == XYZNRGB)
+        {
+            xyznc* pnc = static_cast<xyznc*>(p);
+            pnc->color.r = static_cast<unsigned char>(static_cast<unsigned int>(values[3]));
+            pnc->color.g = static_cast<unsigned char>(static_cast<unsigned int>(values[4]));
+            pnc->color.b = static_cast<unsigned char>(static_cast<unsigned int>(values[5]));
+            pnc->normal.x = values[6];
+            pnc->normal.y = values[7];
+            pnc->normal.z = values[8];
+        }
+    });
+
+    attr.m_filePos = parser.end() - mmfs.data();
+    return_amount = parser.numLines();
+    if (return_amount < amount)
+    {
+        m_openNextFile = true;
+    }
+    return pArray;
+}
+
 void LineReader::rewind()
 {
     std::vector<std::string> tmp;
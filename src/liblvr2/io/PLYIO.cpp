@@ -42,18 +42,642 @@
 #include "lvr2/io/PLYIO.hpp"
 #include "lvr2/io/Timestamp.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <ctime>
 #include <sstream>
 #include <fstream>
+#include <memory>
 
 #include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <opencv2/opencv.hpp>
 
 namespace lvr2
 {
 
 
+namespace
+{
+
+/* Scalar types of the ply format */
+enum class PlyScalar
+{
+    Char, UChar, Short, UShort, Int, UInt, Float, Double, Invalid
+};
+
+size_t plyScalarSize( PlyScalar type )
+{
+    switch ( type )
+    {
+        case PlyScalar::Char:
+        case PlyScalar::UChar:
+            return 1;
+        case PlyScalar::Short:
+        case PlyScalar::UShort:
+            return 2;
+        case PlyScalar::Int:
+        case PlyScalar::UInt:
+        case PlyScalar::Float:
+            return 4;
+        case PlyScalar::Double:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+PlyScalar parsePlyScalar( const string& name )
+{
+    if ( name == "char"   || name == "int8" )    return PlyScalar::Char;
+    if ( name == "uchar"  || name == "uint8" )   return PlyScalar::UChar;
+    if ( name == "short"  || name == "int16" )   return PlyScalar::Short;
+    if ( name == "ushort" || name == "uint16" )  return PlyScalar::UShort;
+    if ( name == "int"    || name == "int32" )   return PlyScalar::Int;
+    if ( name == "uint"   || name == "uint32" )  return PlyScalar::UInt;
+    if ( name == "float"  || name == "float32" ) return PlyScalar::Float;
+    if ( name == "double" || name == "float64" ) return PlyScalar::Double;
+    return PlyScalar::Invalid;
+}
+
+/* A property of an element in the header of a ply file */
+struct PlyHeaderProperty
+{
+    string      name;
+    PlyScalar   type;       // type of the values
+    PlyScalar   countType;  // type of the list length, Invalid for scalar properties
+    size_t      offset;     // byte offset within a record of a scalar element
+};
+
+/* An element in the header of a ply file and the location of its data */
+struct PlyHeaderElement
+{
+    string                          name;
+    size_t                          count;
+    std::vector<PlyHeaderProperty>  properties;
+    size_t                          stride;     // record size, 0 if the element has list properties
+    const char*                     data;       // first record
+
+    const PlyHeaderProperty* find( const char* propertyName ) const
+    {
+        for ( const PlyHeaderProperty& property : properties )
+        {
+            if ( property.name == propertyName )
+            {
+                return &property;
+            }
+        }
+        return nullptr;
+    }
+};
+
+bool isLittleEndianHost()
+{
+    const uint16_t one = 1;
+    return *reinterpret_cast<const uint8_t*>( &one ) == 1;
+}
+
+/**
+ * Parses the header of a binary little endian ply file. Returns false for
+ * all other files and headers that can't be handled. On success, data points
+ * to the first byte after the header.
+ */
+bool parseBinaryHeader( const char* begin, const char* end,
+        std::vector<PlyHeaderElement>& elements, const char*& data )
+{
+    const char* pos = begin;
+    bool first = true;
+    while ( pos < end )
+    {
+        const char* eol = static_cast<const char*>( memchr( pos, '\n', end - pos ) );
+        if ( !eol )
+        {
+            return false;
+        }
+        string line( pos, eol );
+        pos = eol + 1;
+        if ( !line.empty() && line.back() == '\r' )
+        {
+            line.pop_back();
+        }
+
+        std::istringstream tokens( line );
+        string keyword;
+        tokens >> keyword;
+
+        if ( first )
+        {
+            if ( keyword != "ply" )
+            {
+                return false;
+            }
+            first = false;
+        }
+        else if ( keyword == "format" )
+        {
+            string format, version;
+            tokens >> format >> version;
+            if ( format != "binary_little_endian" || version != "1.0" )
+            {
+                return false;
+            }
+        }
+        else if ( keyword == "comment" || keyword == "obj_info" )
+        {
+            continue;
+        }
+        else if ( keyword == "element" )
+        {
+            PlyHeaderElement element;
+            if ( !( tokens >> element.name >> element.count ) )
+            {
+                return false;
+            }
+            element.stride = 0;
+            element.data = nullptr;
+            elements.push_back( element );
+        }
+        else if ( keyword == "property" )
+        {
+            if ( elements.empty() )
+            {
+                return false;
+            }
+            PlyHeaderProperty property;
+            string type;
+            tokens >> type;
+            property.countType = PlyScalar::Invalid;
+            if ( type == "list" )
+            {
+                string countType;
+                tokens >> countType >> type;
+                property.countType = parsePlyScalar( countType );
+                if ( property.countType == PlyScalar::Invalid )
+                {
+                    return false;
+                }
+            }
+            property.type = parsePlyScalar( type );
+            if ( property.type == PlyScalar::Invalid || !( tokens >> property.name ) )
+            {
+                return false;
+            }
+            property.offset = 0;
+            elements.back().properties.push_back( property );
+        }
+        else if ( keyword == "end_header" )
+        {
+            // Records of elements without list properties have a fixed size
+            for ( PlyHeaderElement& element : elements )
+            {
+                size_t stride = 0;
+                for ( PlyHeaderProperty& property : element.properties )
+                {
+                    if ( property.countType != PlyScalar::Invalid )
+                    {
+                        stride = 0;
+                        break;
+                    }
+                    property.offset = stride;
+                    stride += plyScalarSize( property.type );
+                }
+                element.stride = stride;
+            }
+            data = pos;
+            return !first;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+/* Reads a list length or index of the given type */
+template<typename T>
+bool readPlyInteger( const char* pos, PlyScalar type, T& value )
+{
+    switch ( type )
+    {
+        case PlyScalar::Char:   { int8_t v;   memcpy( &v, pos, 1 ); value = v; return v >= 0; }
+        case PlyScalar::UChar:  { uint8_t v;  memcpy( &v, pos, 1 ); value = v; return true; }
+        case PlyScalar::Short:  { int16_t v;  memcpy( &v, pos, 2 ); value = v; return v >= 0; }
+        case PlyScalar::UShort: { uint16_t v; memcpy( &v, pos, 2 ); value = v; return true; }
+        case PlyScalar::Int:    { int32_t v;  memcpy( &v, pos, 4 ); value = v; return v >= 0; }
+        case PlyScalar::UInt:   { uint32_t v; memcpy( &v, pos, 4 ); value = v; return true; }
+        default:                return false;
+    }
+}
+
+/* Skips the records of an element with list properties. Returns false if the data is truncated. */
+bool skipListElement( const PlyHeaderElement& element, const char*& pos, const char* end )
+{
+    for ( size_t i = 0; i < element.count; i++ )
+    {
+        for ( const PlyHeaderProperty& property : element.properties )
+        {
+            size_t length = 1;
+            if ( property.countType != PlyScalar::Invalid )
+            {
+                size_t countSize = plyScalarSize( property.countType );
+                if ( static_cast<size_t>( end - pos ) < countSize
+                    || !readPlyInteger( pos, property.countType, length ) )
+                {
+                    return false;
+                }
+                pos += countSize;
+            }
+            size_t size = length * plyScalarSize( property.type );
+            if ( static_cast<size_t>( end - pos ) < size )
+            {
+                return false;
+            }
+            pos += size;
+        }
+    }
+    return true;
+}
+
+/* Returns true, if the element is a list of triangles stored as uchar count and 32 bit indices */
+bool isTriangleListElement( const PlyHeaderElement& element )
+{
+    if ( element.properties.size() != 1 )
+    {
+        return false;
+    }
+    const PlyHeaderProperty& property = element.properties[0];
+    return ( property.name == "vertex_indices" || property.name == "vertex_index" )
+        && plyScalarSize( property.countType ) == 1
+        && ( property.type == PlyScalar::Int || property.type == PlyScalar::UInt );
+}
+
+/* Converts width values of the same type per record into an interleaved array */
+template<typename Src, typename Dst>
+void convertPlyValues( const char* data, size_t stride, size_t count,
+        const size_t* offsets, size_t width, Dst* dst )
+{
+    #pragma omp parallel for schedule(static)
+    for ( size_t i = 0; i < count; i++ )
+    {
+        const char* record = data + i * stride;
+        for ( size_t j = 0; j < width; j++ )
+        {
+            Src value;
+            memcpy( &value, record + offsets[j], sizeof( Src ) );
+            dst[ i * width + j ] = static_cast<Dst>( value );
+        }
+    }
+}
+
+template<typename Dst>
+void copyPlyValues( PlyScalar type, const char* data, size_t stride, size_t count,
+        const size_t* offsets, size_t width, Dst* dst )
+{
+    switch ( type )
+    {
+        case PlyScalar::Char:   convertPlyValues<int8_t>( data, stride, count, offsets, width, dst ); break;
+        case PlyScalar::UChar:  convertPlyValues<uint8_t>( data, stride, count, offsets, width, dst ); break;
+        case PlyScalar::Short:  convertPlyValues<int16_t>( data, stride, count, offsets, width, dst ); break;
+        case PlyScalar::UShort: convertPlyValues<uint16_t>( data, stride, count, offsets, width, dst ); break;
+        case PlyScalar::Int:    convertPlyValues<int32_t>( data, stride, count, offsets, width, dst ); break;
+        case PlyScalar::UInt:   convertPlyValues<uint32_t>( data, stride, count, offsets, width, dst ); break;
+        case PlyScalar::Float:  convertPlyValues<float>( data, stride, count, offsets, width, dst ); break;
+        case PlyScalar::Double: convertPlyValues<double>( data, stride, count, offsets, width, dst ); break;
+        default: break;
+    }
+}
+
+/**
+ * Copies the given properties of a fixed size element interleaved into a new
+ * array. Returns false if one of the properties is missing.
+ */
+template<typename T>
+bool readPlyProperties( const PlyHeaderElement& element,
+        std::initializer_list<const char*> names, boost::shared_array<T>& array )
+{
+    std::vector<const PlyHeaderProperty*> properties;
+    for ( const char* name : names )
+    {
+        const PlyHeaderProperty* property = element.find( name );
+        if ( !property )
+        {
+            return false;
+        }
+        properties.push_back( property );
+    }
+
+    size_t width = properties.size();
+    array = boost::shared_array<T>( new T[ element.count * width ] );
+
+    // Convert all properties in one pass if they share a type
+    bool sameType = true;
+    std::vector<size_t> offsets;
+    for ( const PlyHeaderProperty* property : properties )
+    {
+        sameType = sameType && property->type == properties[0]->type;
+        offsets.push_back( property->offset );
+    }
+
+    if ( sameType )
+    {
+        copyPlyValues( properties[0]->type, element.data, element.stride,
+                element.count, offsets.data(), width, array.get() );
+    }
+    else
+    {
+        // Strided single values, written to every width-th entry
+        for ( size_t j = 0; j < width; j++ )
+        {
+            std::vector<T> values( element.count );
+            copyPlyValues( properties[j]->type, element.data, element.stride,
+                    element.count, &offsets[j], 1, values.data() );
+            T* dst = array.get();
+            #pragma omp parallel for schedule(static)
+            for ( size_t i = 0; i < element.count; i++ )
+            {
+                dst[ i * width + j ] = values[i];
+            }
+        }
+    }
+    return true;
+}
+
+/* The buffers read from a vertex or point element */
+struct PlyVertexData
+{
+    size_t      count = 0;
+    floatArr    coords;
+    ucharArr    colors;
+    floatArr    intensities;
+    floatArr    confidences;
+    floatArr    normals;
+};
+
+/**
+ * Reads a vertex or point element. The coordinates point into the mapped
+ * file if they are stored as the only properties of the element. Returns
+ * false if the element can't be read in bulk.
+ */
+bool readPlyVertexElement( const PlyHeaderElement& element,
+        const std::shared_ptr<boost::iostreams::mapped_file>& file,
+        bool readColor, bool readConfidence, bool readIntensity, bool readNormals,
+        PlyVertexData& out )
+{
+    out.count = element.count;
+    if ( !element.count )
+    {
+        return true;
+    }
+    if ( !element.stride )
+    {
+        return false;
+    }
+
+    const PlyHeaderProperty* x = element.find( "x" );
+    const PlyHeaderProperty* y = element.find( "y" );
+    const PlyHeaderProperty* z = element.find( "z" );
+    if ( x && y && z
+        && element.stride == 3 * sizeof( float )
+        && x->type == PlyScalar::Float && x->offset == 0
+        && y->type == PlyScalar::Float && y->offset == sizeof( float )
+        && z->type == PlyScalar::Float && z->offset == 2 * sizeof( float )
+        && reinterpret_cast<uintptr_t>( element.data ) % alignof( float ) == 0 )
+    {
+        // Zero copy: The file is mapped copy-on-write and stays mapped as long as the array exists
+        float* coords = reinterpret_cast<float*>( const_cast<char*>( element.data ) );
+        out.coords = floatArr( coords, [file]( float* ) {} );
+    }
+    else if ( !readPlyProperties( element, { "x", "y", "z" }, out.coords ) )
+    {
+        return false;
+    }
+
+    if ( readColor && element.find( "red" )
+        && !readPlyProperties( element, { "red", "green", "blue" }, out.colors ) )
+    {
+        return false;
+    }
+    if ( readIntensity && element.find( "intensity" )
+        && !readPlyProperties( element, { "intensity" }, out.intensities ) )
+    {
+        return false;
+    }
+    if ( readConfidence && element.find( "confidence" )
+        && !readPlyProperties( element, { "confidence" }, out.confidences ) )
+    {
+        return false;
+    }
+    if ( readNormals && element.find( "nx" )
+        && !readPlyProperties( element, { "nx", "ny", "nz" }, out.normals ) )
+    {
+        return false;
+    }
+    return true;
+}
+
+/* Reads a triangle list element. Returns false if it contains other polygons. */
+bool readPlyFaceElement( const PlyHeaderElement& element, indexArray& faces )
+{
+    const size_t stride = 1 + 3 * sizeof( uint32_t );
+    faces = indexArray( new unsigned int[ element.count * 3 ] );
+    unsigned int* dst = faces.get();
+
+    int polygons = 0;
+    #pragma omp parallel for schedule(static) reduction(|:polygons)
+    for ( size_t i = 0; i < element.count; i++ )
+    {
+        const char* record = element.data + i * stride;
+        polygons |= static_cast<uint8_t>( record[0] ) != 3;
+        memcpy( dst + i * 3, record + 1, 3 * sizeof( uint32_t ) );
+    }
+    return !polygons;
+}
+
+/* A property to write and the location of its values */
+struct PlyOutputProperty
+{
+    const char* name;
+    e_ply_type  type;       // PLY_FLOAT, PLY_UCHAR or PLY_INT
+    const void* data;       // values of the first element
+    size_t      stride;     // number of values between two elements
+    size_t      listLength; // number of values in a list property, 0 for scalar properties
+};
+
+/* An element to write */
+struct PlyOutputElement
+{
+    const char*                     name;
+    size_t                          count;
+    std::vector<PlyOutputProperty>  properties;
+};
+
+size_t plyOutputSize( e_ply_type type )
+{
+    return type == PLY_UCHAR ? 1 : 4;
+}
+
+const char* plyOutputTypeName( e_ply_type type )
+{
+    switch ( type )
+    {
+        case PLY_UCHAR: return "uchar";
+        case PLY_INT:   return "int";
+        default:        return "float";
+    }
+}
+
+/**
+ * Writes the elements as binary little endian ply file. The records are
+ * interleaved in blocks and written with one call per block.
+ */
+bool writeBinaryPly( const string& filename, const std::vector<PlyOutputElement>& elements )
+{
+    std::ofstream out( filename, std::ios::binary );
+    if ( !out.good() )
+    {
+        std::cerr << timestamp << "Could not create »" << filename << "«" << std::endl;
+        return false;
+    }
+
+    out << "ply\nformat binary_little_endian 1.0\n";
+    for ( const PlyOutputElement& element : elements )
+    {
+        out << "element " << element.name << " " << element.count << "\n";
+        for ( const PlyOutputProperty& property : element.properties )
+        {
+            out << "property ";
+            if ( property.listLength )
+            {
+                out << "list uchar ";
+            }
+            out << plyOutputTypeName( property.type ) << " " << property.name << "\n";
+        }
+    }
+    out << "end_header\n";
+
+    const size_t blockSize = 1 << 16;
+    std::vector<char> block;
+    for ( const PlyOutputElement& element : elements )
+    {
+        size_t recordSize = 0;
+        for ( const PlyOutputProperty& property : element.properties )
+        {
+            size_t size = plyOutputSize( property.type );
+            recordSize += property.listLength ? 1 + property.listLength * size : size;
+        }
+        block.resize( blockSize * recordSize );
+
+        for ( size_t first = 0; first < element.count; first += blockSize )
+        {
+            size_t n = std::min( blockSize, element.count - first );
+
+            #pragma omp parallel for schedule(static)
+            for ( size_t i = 0; i < n; i++ )
+            {
+                char* record = block.data() + i * recordSize;
+                for ( const PlyOutputProperty& property : element.properties )
+                {
+                    size_t size = plyOutputSize( property.type );
+                    size_t length = property.listLength ? property.listLength : 1;
+                    const char* src = static_cast<const char*>( property.data )
+                        + ( first + i ) * property.stride * size;
+                    if ( property.listLength )
+                    {
+                        *record++ = static_cast<char>( property.listLength );
+                    }
+                    memcpy( record, src, length * size );
+                    record += length * size;
+                }
+            }
+            out.write( block.data(), n * recordSize );
+        }
+    }
+
+    if ( !out.good() )
+    {
+        std::cerr << timestamp << "Could not write »" << filename << "«" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/* Writes the elements with RPly, e.g. on big endian hosts */
+bool writeRplyPly( const string& filename, const std::vector<PlyOutputElement>& elements )
+{
+    p_ply oply = ply_create( filename.c_str(), PLY_LITTLE_ENDIAN, NULL, 0, NULL );
+    if ( !oply )
+    {
+        std::cerr << timestamp << "Could not create »" << filename << "«" << std::endl;
+        return false;
+    }
+
+    for ( const PlyOutputElement& element : elements )
+    {
+        ply_add_element( oply, element.name, element.count );
+        for ( const PlyOutputProperty& property : element.properties )
+        {
+            if ( property.listLength )
+            {
+                ply_add_list_property( oply, property.name, PLY_UCHAR, property.type );
+            }
+            else
+            {
+                ply_add_scalar_property( oply, property.name, property.type );
+            }
+        }
+    }
+
+    if ( !ply_write_header( oply ) )
+    {
+        std::cerr << timestamp << "Could not write header." << std::endl;
+        ply_close( oply );
+        return false;
+    }
+
+    for ( const PlyOutputElement& element : elements )
+    {
+        for ( size_t i = 0; i < element.count; i++ )
+        {
+            for ( const PlyOutputProperty& property : element.properties )
+            {
+                size_t length = property.listLength ? property.listLength : 1;
+                if ( property.listLength )
+                {
+                    ply_write( oply, property.listLength );
+                }
+                for ( size_t j = 0; j < length; j++ )
+                {
+                    size_t index = i * property.stride + j;
+                    switch ( property.type )
+                    {
+                        case PLY_UCHAR:
+                            ply_write( oply, static_cast<const unsigned char*>( property.data )[index] );
+                            break;
+                        case PLY_INT:
+                            ply_write( oply, static_cast<const unsigned int*>( property.data )[index] );
+                            break;
+                        default:
+                            ply_write( oply, static_cast<const float*>( property.data )[index] );
+                            break;
+                    }
+                }
+            }
+        }
+    }
+
+    if ( !ply_close( oply ) )
+    {
+        std::cerr << timestamp << "Could not close file." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+
+
 void PLYIO::save( string filename )
 {
     if ( !m_model )
@@ -62,9 +686,6 @@ void PLYIO::save( string filename )
         return;
     }
 
-    /* Handle options. */
-    e_ply_storage_mode mode( PLY_LITTLE_ENDIAN );
-
     // Local buffer shortcuts
     floatArr m_vertices;
     floatArr m_vertexConfidence;
@@ -128,45 +749,25 @@ void PLYIO::save( string filename )
     }
 
 
-    p_ply oply = ply_create( filename.c_str(), mode, NULL, 0, NULL );
-    if ( !oply )
-    {
-        std::cerr << timestamp << "Could not create »" << filename << "«" << std::endl;
-        return;
-    }
-
     /* Check if we have vertex information. */
     if ( !( m_vertices || m_points ) )
     {
         std::cout << timestamp << "Neither vertices nor points to write." << std::endl;
-        if ( !ply_close( oply ) )
-        {
-            std::cerr << timestamp << "Could not close file." << std::endl;
-        }
         return;
     }
 
-    /* First: Write Header information according to data. */
-
-    bool vertex_color      = false;
-    bool vertex_intensity  = false;
-    bool vertex_confidence = false;
-    bool vertex_normal     = false;
-    bool point_color       = false;
-    bool point_intensity   = false;
-    bool point_confidence  = false;
-    bool point_normal      = false;
-
+    /* First: Collect the layout of all elements according to data. */
+    std::vector<PlyOutputElement> elements;
 
     /* Add vertex element. */
     if ( m_vertices )
     {
-        ply_add_element( oply, "vertex", m_numVertices );
+        PlyOutputElement vertex{ "vertex", m_numVertices, {} };
 
         /* Add vertex properties: x, y, z, (r, g, b) */
-        ply_add_scalar_property( oply, "x", PLY_FLOAT );
-        ply_add_scalar_property( oply, "y", PLY_FLOAT );
-        ply_add_scalar_property( oply, "z", PLY_FLOAT );
+        vertex.properties.push_back( { "x", PLY_FLOAT, m_vertices.get(),     3, 0 } );
+        vertex.properties.push_back( { "y", PLY_FLOAT, m_vertices.get() + 1, 3, 0 } );
+        vertex.properties.push_back( { "z", PLY_FLOAT, m_vertices.get() + 2, 3, 0 } );
 
         /* Add color information if there is any. */
         if ( m_vertexColors )
@@ -178,10 +779,9 @@ void PLYIO::save( string filename )
             }
             else
             {
-                ply_add_scalar_property( oply, "red",   PLY_UCHAR );
-                ply_add_scalar_property( oply, "green", PLY_UCHAR );
-                ply_add_scalar_property( oply, "blue",  PLY_UCHAR );
-                vertex_color = true;
+                vertex.properties.push_back( { "red",   PLY_UCHAR, m_vertexColors.get(),     w_vertex_color, 0 } );
+                vertex.properties.push_back( { "green", PLY_UCHAR, m_vertexColors.get() + 1, w_vertex_color, 0 } );
+                vertex.properties.push_back( { "blue",  PLY_UCHAR, m_vertexColors.get() + 2, w_vertex_color, 0 } );
             }
         }
 
@@ -196,8 +796,7 @@ void PLYIO::save( string filename )
             }
             else
             {
-                ply_add_scalar_property( oply, "intensity",  PLY_FLOAT );
-                vertex_intensity = true;
+                vertex.properties.push_back( { "intensity", PLY_FLOAT, m_vertexIntensity.get(), 1, 0 } );
             }
         }
 
@@ -212,8 +811,7 @@ void PLYIO::save( string filename )
             }
             else
             {
-                ply_add_scalar_property( oply, "confidence",  PLY_FLOAT );
-                vertex_confidence = true;
+                vertex.properties.push_back( { "confidence", PLY_FLOAT, m_vertexConfidence.get(), 1, 0 } );
             }
         }
 
@@ -227,30 +825,31 @@ void PLYIO::save( string filename )
             }
             else
             {
-                ply_add_scalar_property( oply, "nx", PLY_FLOAT );
-                ply_add_scalar_property( oply, "ny", PLY_FLOAT );
-                ply_add_scalar_property( oply, "nz", PLY_FLOAT );
-                vertex_normal = true;
+                vertex.properties.push_back( { "nx", PLY_FLOAT, m_vertexNormals.get(),     3, 0 } );
+                vertex.properties.push_back( { "ny", PLY_FLOAT, m_vertexNormals.get() + 1, 3, 0 } );
+                vertex.properties.push_back( { "nz", PLY_FLOAT, m_vertexNormals.get() + 2, 3, 0 } );
             }
         }
+        elements.push_back( vertex );
 
         /* Add faces. */
         if ( m_faceIndices )
         {
-            ply_add_element( oply, "face", m_numFaces );
-            ply_add_list_property( oply, "vertex_indices", PLY_UCHAR, PLY_INT );
+            PlyOutputElement face{ "face", m_numFaces, {} };
+            face.properties.push_back( { "vertex_indices", PLY_INT, m_faceIndices.get(), 3, 3 } );
+            elements.push_back( face );
         }
     }
 
     /* Add point element */
     if ( m_points )
     {
-        ply_add_element( oply, "point", m_numPoints );
+        PlyOutputElement point{ "point", m_numPoints, {} };
 
         /* Add point properties: x, y, z, (r, g, b) */
-        ply_add_scalar_property( oply, "x", PLY_FLOAT );
-        ply_add_scalar_property( oply, "y", PLY_FLOAT );
-        ply_add_scalar_property( oply, "z", PLY_FLOAT );
+        point.properties.push_back( { "x", PLY_FLOAT, m_points.get(),     3, 0 } );
+        point.properties.push_back( { "y", PLY_FLOAT, m_points.get() + 1, 3, 0 } );
+        point.properties.push_back( { "z", PLY_FLOAT, m_points.get() + 2, 3, 0 } );
 
         /* Add color information if there is any. */
         if ( m_pointColors )
@@ -262,10 +861,9 @@ void PLYIO::save( string filename )
             }
             else
             {
-                ply_add_scalar_property( oply, "red",   PLY_UCHAR );
-                ply_add_scalar_property( oply, "green", PLY_UCHAR );
-                ply_add_scalar_property( oply, "blue",  PLY_UCHAR );
-                point_color = true;
+                point.properties.push_back( { "red",   PLY_UCHAR, m_pointColors.get(),     w_point_color, 0 } );
+                point.properties.push_back( { "green", PLY_UCHAR, m_pointColors.get() + 1, w_point_color, 0 } );
+                point.properties.push_back( { "blue",  PLY_UCHAR, m_pointColors.get() + 2, w_point_color, 0 } );
             }
         }
 
@@ -280,8 +878,7 @@ void PLYIO::save( string filename )
             }
             else
             {
-                ply_add_scalar_property( oply, "intensity",  PLY_FLOAT );
-                point_intensity = true;
+                point.properties.push_back( { "intensity", PLY_FLOAT, m_pointIntensities.get(), 1, 0 } );
             }
         }
 
@@ -296,8 +893,7 @@ void PLYIO::save( string filename )
             }
             else
             {
-                ply_add_scalar_property( oply, "confidence",  PLY_FLOAT );
-                point_confidence = true;
+                point.properties.push_back( { "confidence", PLY_FLOAT, m_pointConfidences.get(), 1, 0 } );
             }
         }
 
@@ -311,115 +907,237 @@ void PLYIO::save( string filename )
             }
             else
             {
-                ply_add_scalar_property( oply, "nx", PLY_FLOAT );
-                ply_add_scalar_property( oply, "ny", PLY_FLOAT );
-                ply_add_scalar_property( oply, "nz", PLY_FLOAT );
-                point_normal = true;
+                point.properties.push_back( { "nx", PLY_FLOAT, m_pointNormals.get(),     3, 0 } );
+                point.properties.push_back( { "ny", PLY_FLOAT, m_pointNormals.get() + 1, 3, 0 } );
+                point.properties.push_back( { "nz", PLY_FLOAT, m_pointNormals.get() + 2, 3, 0 } );
             }
         }
+        elements.push_back( point );
     }
 
-    /* Write header to file. */
-    if ( !ply_write_header( oply ) )
+    /* Second: Write header and data. */
+    if ( isLittleEndianHost() )
     {
-        std::cerr << timestamp << "Could not write header." << std::endl;
-        return;
+        writeBinaryPly( filename, elements );
     }
+    else
+    {
+        writeRplyPly( filename, elements );
+    }
+}
 
-    /* Second: Write data. */
 
-    for (size_t i = 0; i < m_numVertices; i++ )
+ModelPtr PLYIO::read( string filename )
+{
+   return read( filename, true );
+}
+
+/**
+ * swaps n elements from index i1 in arr with n elements from index i2 in arr
+ */
+template <typename T>
+void swap(T*& arr, size_t i1, size_t i2, size_t n)
+{
+    std::swap_ranges(arr + i1, arr + i1 + n, arr + i2);
+}
+
+ModelPtr PLYIO::readBinary( string filename, bool readColor, bool readConfidence,
+        bool readIntensity, bool readNormals, bool readFaces, bool readPanoramaCoords )
+{
+    if ( !isLittleEndianHost() )
+    {
+        return ModelPtr();
+    }
+
+    /* Map the file copy-on-write, so that buffers may point into it. */
+    auto file = std::make_shared<boost::iostreams::mapped_file>();
+    try
+    {
+        boost::iostreams::mapped_file_params params( filename );
+        params.flags = boost::iostreams::mapped_file::priv;
+        file->open( params );
+    }
+    catch ( std::exception& )
+    {
+        return ModelPtr();
+    }
+    if ( !file->is_open() )
     {
-        ply_write( oply, (double) m_vertices[ i * 3     ] ); /* x */
-        ply_write( oply, (double) m_vertices[ i * 3 + 1 ] ); /* y */
-        ply_write( oply, (double) m_vertices[ i * 3 + 2 ] ); /* z */
-        if ( vertex_color )
+        return ModelPtr();
+    }
+
+    const char* begin = file->const_data();
+    const char* end   = begin + file->size();
+
+    std::vector<PlyHeaderElement> elements;
+    const char* pos = nullptr;
+    if ( !parseBinaryHeader( begin, end, elements, pos ) )
+    {
+        return ModelPtr();
+    }
+
+    /* Locate the data of all elements. */
+    PlyHeaderElement* vertexElement = nullptr;
+    PlyHeaderElement* pointElement  = nullptr;
+    PlyHeaderElement* faceElement   = nullptr;
+    for ( PlyHeaderElement& element : elements )
+    {
+        element.data = pos;
+        if ( element.name == "vertex" )
         {
-            ply_write( oply, m_vertexColors[ i * w_vertex_color     ] ); /* red */
-            ply_write( oply, m_vertexColors[ i * w_vertex_color + 1 ] ); /* green */
-            ply_write( oply, m_vertexColors[ i * w_vertex_color + 2 ] ); /* blue */
+            vertexElement = &element;
         }
-        if ( vertex_intensity )
+        else if ( element.name == "point" )
         {
-            ply_write( oply, m_vertexIntensity[ i ] );
+            pointElement = &element;
         }
-        if ( vertex_confidence )
+        else if ( element.name == "face" && readFaces && element.count )
         {
-            ply_write( oply, m_vertexConfidence[ i ] );
+            /* Only triangle lists are read in bulk, the lengths are checked while copying. */
+            if ( !isTriangleListElement( element ) )
+            {
+                return ModelPtr();
+            }
+            faceElement = &element;
+            element.stride = 1 + 3 * sizeof( uint32_t );
         }
-        if ( vertex_normal )
+
+        if ( element.stride )
+        {
+            if ( static_cast<size_t>( end - pos ) / element.stride < element.count )
+            {
+                return ModelPtr();
+            }
+            pos += element.count * element.stride;
+        }
+        else if ( !skipListElement( element, pos, end ) )
         {
-            ply_write( oply, (double) m_vertexNormals[ i * 3     ] ); /* nx */
-            ply_write( oply, (double) m_vertexNormals[ i * 3 + 1 ] ); /* ny */
-            ply_write( oply, (double) m_vertexNormals[ i * 3 + 2 ] ); /* nz */
+            return ModelPtr();
         }
     }
 
-    /* Write faces (Only if we also have vertices). */
-    if ( m_vertices )
+    /* Panorama coordinates need the spectral images of the RPly reader. */
+    if ( readPanoramaCoords
+        && ( ( vertexElement && vertexElement->find( "x_coords" ) )
+            || ( pointElement && pointElement->find( "x_coords" ) ) ) )
+    {
+        return ModelPtr();
+    }
+
+    PlyVertexData vertices;
+    PlyVertexData points;
+    indexArray faceIndices;
+    size_t numFaces = 0;
+
+    if ( vertexElement && !readPlyVertexElement( *vertexElement, file, readColor,
+            readConfidence, readIntensity, readNormals, vertices ) )
     {
-        for ( size_t i = 0; i < m_numFaces; i++ )
+        return ModelPtr();
+    }
+    if ( pointElement && !readPlyVertexElement( *pointElement, file, readColor,
+            readConfidence, readIntensity, readNormals, points ) )
+    {
+        return ModelPtr();
+    }
+    if ( faceElement )
+    {
+        if ( !readPlyFaceElement( *faceElement, faceIndices ) )
         {
-            ply_write( oply, 3.0 ); /* Indices per face. */
-            ply_write( oply, (double) m_faceIndices[ i * 3     ] );
-            ply_write( oply, (double) m_faceIndices[ i * 3 + 1 ] );
-            ply_write( oply, (double) m_faceIndices[ i * 3 + 2 ] );
+            return ModelPtr();
         }
+        numFaces = faceElement->count;
+    }
+
+    if ( !( vertices.coords || points.coords ) )
+    {
+        return ModelPtr();
+    }
+
+    /* Check if we got only vertices and neither points nor faces. If that is
+     * the case then use the vertices as points. */
+    if ( vertices.coords && !points.coords && !faceIndices )
+    {
+        std::cout << timestamp << "PLY contains neither faces nor points. "
+            << "Assuming that vertices are meant to be points." << std::endl;
+        std::swap( vertices, points );
     }
 
-    for ( size_t i = 0; i < m_numPoints; i++ )
+    // Save buffers in model
+    PointBufferPtr pc;
+    MeshBufferPtr mesh;
+    if ( points.coords )
     {
-        ply_write( oply, (double) m_points[ i * 3     ] ); /* x */
-        ply_write( oply, (double) m_points[ i * 3 + 1 ] ); /* y */
-        ply_write( oply, (double) m_points[ i * 3 + 2 ] ); /* z */
-        if ( point_color )
+        pc = PointBufferPtr( new PointBuffer );
+        pc->setPointArray( points.coords, points.count );
+
+        if ( points.colors )
         {
-            ply_write( oply, m_pointColors[ i * w_point_color     ] ); /* red */
-            ply_write( oply, m_pointColors[ i * w_point_color + 1 ] ); /* green */
-            ply_write( oply, m_pointColors[ i * w_point_color + 2 ] ); /* blue */
+            pc->setColorArray( points.colors, points.count );
         }
-        if ( point_intensity )
+
+        if ( points.intensities )
         {
-            ply_write( oply, m_pointIntensities[ i ] );
+            pc->addFloatChannel( points.intensities, "intensities", points.count, 1 );
         }
-        if ( point_confidence )
+
+        if ( points.confidences )
         {
-            ply_write( oply, m_pointConfidences[ i ] );
+            pc->addFloatChannel( points.confidences, "confidences", points.count, 1 );
         }
-        if ( point_normal )
+
+        if ( points.normals )
         {
-            ply_write( oply, (double) m_pointNormals[ i * 3     ] ); /* nx */
-            ply_write( oply, (double) m_pointNormals[ i * 3 + 1 ] ); /* ny */
-            ply_write( oply, (double) m_pointNormals[ i * 3 + 2 ] ); /* nz */
+            pc->setNormalArray( points.normals, points.count );
         }
     }
 
-    if ( !ply_close( oply ) )
+    if ( vertices.coords )
     {
-       std::cerr << timestamp << "Could not close file." << std::endl;
-    }
+        mesh = MeshBufferPtr( new MeshBuffer );
+        mesh->setVertices( vertices.coords, vertices.count );
 
-}
+        if ( faceIndices )
+        {
+            mesh->setFaceIndices( faceIndices, numFaces );
+        }
 
+        if ( vertices.normals )
+        {
+            mesh->setVertexNormals( vertices.normals );
+        }
 
-ModelPtr PLYIO::read( string filename )
-{
-   return read( filename, true );
-}
+        if ( vertices.colors )
+        {
+            mesh->setVertexColors( vertices.colors );
+        }
 
-/**
- * swaps n elements from index i1 in arr with n elements from index i2 in arr
- */
-template <typename T>
-void swap(T*& arr, size_t i1, size_t i2, size_t n)
-{
-    std::swap_ranges(arr + i1, arr + i1 + n, arr + i2);
+        if ( vertices.intensities )
+        {
+            mesh->addFloatChannel( vertices.intensities, "vertex_intensities", vertices.count, 1 );
+        }
+
+        if ( vertices.confidences )
+        {
+            mesh->addFloatChannel( vertices.confidences, "vertex_confidences", vertices.count, 1 );
+        }
+    }
+
+    return ModelPtr( new Model( mesh, pc ) );
 }
 
 ModelPtr PLYIO::read( string filename, bool readColor, bool readConfidence,
         bool readIntensity, bool readNormals, bool readFaces, bool readPanoramaCoords )
 {
 
+    /* Read binary little endian files in bulk if possible. */
+    ModelPtr model = readBinary( filename, readColor, readConfidence, readIntensity,
+            readNormals, readFaces, readPanoramaCoords );
+    if ( model )
+    {
+        m_model = model;
+        return model;
+    }
+
     /* Start reading new PLY */
     p_ply ply = ply_open( filename.c_str(), NULL, 0, NULL );
 
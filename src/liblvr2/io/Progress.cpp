@@ -49,12 +49,16 @@ namespace lvr2
 ProgressCallbackPtr ProgressBar::m_progressCallback = 0;
 ProgressTitleCallbackPtr ProgressBar::m_titleCallback = 0;
 
-ProgressBar::ProgressBar(size_t max_val, string prefix)
+ProgressBar::ProgressBar(size_t max_val, string prefix, bool quiet)
+    : m_currentVal(0), m_nextVal(0)
 {
 	m_prefix = prefix;
 	m_maxVal = max_val;
-    m_currentVal = 0;
 	m_percent = 0;
+	m_quiet = quiet;
+
+	// Counter value for the first percent
+	m_nextVal = m_maxVal ? (m_maxVal + 99) / 100 : std::numeric_limits<size_t>::max();
 
 	if(m_titleCallback)
 	{
@@ -80,47 +84,20 @@ void ProgressBar::setProgressTitleCallback(ProgressTitleCallbackPtr ptr)
 	m_titleCallback = ptr;
 }
 
-void ProgressBar::operator++()
+void ProgressBar::update()
 {
     boost::mutex::scoped_lock lock(m_mutex);
 
-    m_currentVal++;
-    short difference = (short)((float)m_currentVal/m_maxVal * 100 - m_percent);
-    if (difference < 1)
-    {
-        return;
-    }
-
-    while (difference >= 1)
+    // Another thread may have printed the current percentage already
+    size_t current = m_currentVal.load();
+    int percent = (int)(current * 100 / m_maxVal);
+    while (m_percent < percent)
     {
         m_percent++;
-        difference--;
-        print_bar();
-
-        if(m_progressCallback)
+        if(!m_quiet)
         {
-        	m_progressCallback(m_percent);
+            print_bar();
         }
-    }
-
-}
-
-void ProgressBar::operator+=(size_t n)
-{
-    boost::mutex::scoped_lock lock(m_mutex);
-
-    m_currentVal+= n;
-    short difference = (short)((float)m_currentVal/m_maxVal * 100 - m_percent);
-    if (difference < 1)
-    {
-        return;
-    }
-
-    while (difference >= 1)
-    {
-        m_percent++;
-        difference--;
-        print_bar();
 
         if(m_progressCallback)
         {
@@ -128,6 +105,8 @@ void ProgressBar::operator+=(size_t n)
         }
     }
 
+    // Counter value at which the next percentage is reached
+    m_nextVal = ((size_t)(m_percent + 1) * m_maxVal + 99) / 100;
 }
 
 void ProgressBar::print_bar()
@@ -144,10 +123,10 @@ ProgressCounter::ProgressCounter(int stepVal, string prefix)
 
 void ProgressCounter::operator++()
 {
-	boost::mutex::scoped_lock lock(m_mutex);
-	m_currentVal++;
-	if(m_currentVal % m_stepVal == 0)
+	size_t val = ++m_currentVal;
+	if(val % m_stepVal == 0)
 	{
+		boost::mutex::scoped_lock lock(m_mutex);
 		print_progress();
 	}
 }
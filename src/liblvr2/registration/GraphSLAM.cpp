@@ -34,8 +34,13 @@
 #include "lvr2/registration/GraphSLAM.hpp"
 
 #include <Eigen/SparseCholesky>
+#ifdef LVR2_USE_CHOLMOD
+#include <Eigen/CholmodSupport>
+#endif
 
 #include <math.h>
+#include <algorithm>
+#include <chrono>
 
 using namespace std;
 using namespace Eigen;
@@ -43,6 +48,26 @@ using namespace Eigen;
 namespace lvr2
 {
 
+namespace
+{
+
+#ifdef LVR2_USE_CHOLMOD
+/// Supernodal Cholesky factorization. Uses multithreaded BLAS if available
+using GraphSolver = CholmodSupernodalLLT<GraphSLAM::GraphMatrix>;
+#else
+using GraphSolver = SimplicialCholesky<GraphSLAM::GraphMatrix>;
+#endif
+
+/// Checks if two compressed sparse matrices have the same sparsity pattern
+bool samePattern(const GraphSLAM::GraphMatrix& a, const GraphSLAM::GraphMatrix& b)
+{
+    return a.rows() == b.rows() && a.cols() == b.cols() && a.nonZeros() == b.nonZeros()
+           && equal(a.outerIndexPtr(), a.outerIndexPtr() + a.outerSize() + 1, b.outerIndexPtr())
+           && equal(a.innerIndexPtr(), a.innerIndexPtr() + a.nonZeros(), b.innerIndexPtr());
+}
+
+} // namespace
+
 /**
  * @brief Lists all numbers of scans near to the scan 
  * @param scans reference to a vector containing the SlamScanPtr
@@ -50,7 +75,7 @@ namespace lvr2
  * @param options SlamOptions struct with all params
  * @param output Returns vector of the scan-numbers which ar defined as "close" 
  * */
-bool findCloseScans(const vector<SLAMScanPtr>& scans, size_t scan, const SLAMOptions& options, vector<size_t>& output)
+bool findCloseScans(const vector<SLAMScanPtr>& scans, size_t scan, const SLAMOptions& options, vector<size_t>& output, KDTreePtr tree)
 {
     if (scan < options.loopSize)
     {
@@ -75,7 +100,11 @@ bool findCloseScans(const vector<SLAMScanPtr>& scans, size_t scan, const SLAMOpt
     else
     {
         // convert current Scan to KDTree for Pair search
-        auto tree = KDTree::create(cur, options.maxLeafSize);
+        if (!tree)
+        {
+            tree = KDTree::create(cur, options.maxLeafSize, true);
+        }
+        Transformd toTree = cur->pose().inverse();
 
         size_t maxLen = 0;
         for (size_t other = 0; other < scan - options.loopSize; other++)
@@ -86,7 +115,7 @@ bool findCloseScans(const vector<SLAMScanPtr>& scans, size_t scan, const SLAMOpt
 
         for (size_t other = 0; other < scan - options.loopSize; other++)
         {
-            size_t count = KDTree::nearestNeighbors(tree, scans[other], neighbors, options.slamMaxDistance);
+            size_t count = KDTree::nearestNeighbors(tree, toTree * scans[other]->pose(), scans[other], neighbors, options.slamMaxDistance);
             if (count >= options.closeLoopPairs)
             {
                 output.push_back(other);
@@ -114,6 +143,58 @@ void EulerToMatrix4(const Vector3d& pos, const Vector3d& theta, Matrix4d& mat);
  * */
 void Matrix4ToEuler(const Matrix4d mat, Vector3d& rPosTheta, Vector3d& rPos);
 
+KDTreeCache::KDTreeCache(int maxLeafSize, size_t maxPoints)
+    : m_maxLeafSize(maxLeafSize), m_maxPoints(maxPoints)
+{
+}
+
+void KDTreeCache::getTrees(const vector<SLAMScanPtr>& scans, const vector<size_t>& indices, map<size_t, KDTreePtr>& output)
+{
+    vector<size_t> missing;
+    for (size_t index : indices)
+    {
+        if (output.find(index) != output.end())
+        {
+            continue;
+        }
+        auto found = m_trees.find(index);
+        if (found != m_trees.end())
+        {
+            output.insert(*found);
+        }
+        else
+        {
+            output.insert(make_pair(index, nullptr));
+            missing.push_back(index);
+        }
+    }
+
+    vector<KDTreePtr> built(missing.size());
+
+    // one tree per thread, which scales better than building the trees one after another
+    // with parallel construction
+    #pragma omp parallel for schedule(dynamic) if(missing.size() > 1)
+    for (size_t i = 0; i < missing.size(); i++)
+    {
+        built[i] = KDTree::create(scans[missing[i]], m_maxLeafSize, true);
+    }
+
+    for (size_t i = 0; i < missing.size(); i++)
+    {
+        size_t index = missing[i];
+        output[index] = built[i];
+
+        size_t points = built[i]->numPoints();
+        if (m_numPoints + points <= m_maxPoints)
+        {
+            m_trees.insert(make_pair(index, built[i]));
+            m_numPoints += points;
+        }
+    }
+
+    m_built += missing.size();
+}
+
 GraphSLAM::GraphSLAM(const SLAMOptions* options)
     : m_options(options)
 {
@@ -131,20 +212,55 @@ void GraphSLAM::doGraphSLAM(const vector<SLAMScanPtr>& scans, size_t last, const
     GraphVector B(6 * n);
     GraphVector X(6 * n);
 
+    // The trees are in local coordinates and stay valid for all iterations
+    KDTreeCache trees(m_options->maxLeafSize, m_options->slamTreeCachePoints);
+
+    // The symbolic factorization only depends on the sparsity pattern of A, which only
+    // changes if the graph changes
+    GraphSolver solver;
+    GraphMatrix pattern;
+    size_t analyzed = 0;
+
+    double graphDuration = 0.0;
+    double solveDuration = 0.0;
+    size_t iterations = 0;
+
     for (size_t iteration = 0;
             iteration < m_options->slamIterations;
             iteration++)
     {
         cout << "GraphSLAM Iteration " << iteration << " of " << m_options->slamIterations << endl;
 
-        createGraph(scans, last, graph);
+        auto start_time = chrono::steady_clock::now();
+
+        createGraph(scans, last, graph, trees);
 
         // Construct the linear equation system A * X = B..
-        fillEquation(scans, graph, A, B);
+        fillEquation(scans, graph, A, B, trees);
 
         graph.clear();
 
-        X = SimplicialCholesky<GraphMatrix>().compute(A).solve(B);
+        auto graph_time = chrono::steady_clock::now();
+
+        if (analyzed == 0 || !samePattern(A, pattern))
+        {
+            solver.analyzePattern(A);
+            pattern = A;
+            analyzed++;
+        }
+        solver.factorize(A);
+        X = solver.solve(B);
+
+        auto solve_time = chrono::steady_clock::now();
+        graphDuration += chrono::duration<double>(graph_time - start_time).count();
+        solveDuration += chrono::duration<double>(solve_time - graph_time).count();
+        iterations++;
+
+        if (m_options->verbose)
+        {
+            cout << "Graph: " << (int)(chrono::duration<double>(graph_time - start_time).count() * 1000) << " ms, "
+                 << "Solve: " << (int)(chrono::duration<double>(solve_time - graph_time).count() * 1000) << " ms" << endl;
+        }
 
         double sum_position_diff = 0.0;
 
@@ -238,9 +354,22 @@ void GraphSLAM::doGraphSLAM(const vector<SLAMScanPtr>& scans, size_t last, const
             break;
         }
     }
+
+    if (iterations > 0)
+    {
+        cout << "GraphSLAM: " << iterations << " iterations, "
+             << (int)(graphDuration * 1000) << " ms graph construction, "
+             << (int)(solveDuration * 1000) << " ms solving, "
+             << analyzed << " symbolic factorizations" << endl;
+    }
+
+    if (m_options->verbose)
+    {
+        cout << "GraphSLAM built " << trees.numBuilt() << " KDTrees" << endl;
+    }
 }
 
-void GraphSLAM::createGraph(const vector<SLAMScanPtr>& scans, size_t last, Graph& graph) const
+void GraphSLAM::createGraph(const vector<SLAMScanPtr>& scans, size_t last, Graph& graph, KDTreeCache& trees) const
 {
     graph.clear();
 
@@ -249,10 +378,22 @@ void GraphSLAM::createGraph(const vector<SLAMScanPtr>& scans, size_t last, Graph
         graph.push_back(make_pair(i - 1, i));
     }
 
+    // the pair search needs a tree of every Scan that is checked
+    map<size_t, KDTreePtr> scanTrees;
+    if (m_options->closeLoopPairs >= 0)
+    {
+        vector<size_t> indices;
+        for (size_t i = m_options->loopSize; i <= last; i++)
+        {
+            indices.push_back(i);
+        }
+        trees.getTrees(scans, indices, scanTrees);
+    }
+
     vector<size_t> others;
     for (size_t i = m_options->loopSize; i <= last; i++)
     {
-        findCloseScans(scans, i, *m_options, others);
+        findCloseScans(scans, i, *m_options, others, scanTrees.empty() ? nullptr : scanTrees[i]);
 
         for (size_t other : others)
         {
@@ -263,19 +404,16 @@ void GraphSLAM::createGraph(const vector<SLAMScanPtr>& scans, size_t last, Graph
     }
 }
 
-void GraphSLAM::fillEquation(const vector<SLAMScanPtr>& scans, const Graph& graph, GraphMatrix& mat, GraphVector& vec) const
+void GraphSLAM::fillEquation(const vector<SLAMScanPtr>& scans, const Graph& graph, GraphMatrix& mat, GraphVector& vec, KDTreeCache& treeCache) const
 {
-    // Cache all KDTrees
-    map<size_t, KDTreePtr> trees;
+    // Collect the KDTrees of all sources
+    vector<size_t> sources(graph.size());
     for (size_t i = 0; i < graph.size(); i++)
     {
-        size_t a = graph[i].first;
-        if (trees.find(a) == trees.end())
-        {
-            auto tree = KDTree::create(scans[a], m_options->maxLeafSize);
-            trees.insert(make_pair(a, tree));
-        }
+        sources[i] = graph[i].first;
     }
+    map<size_t, KDTreePtr> trees;
+    treeCache.getTrees(scans, sources, trees);
 
     vector<pair<Matrix6d, Vector6d>> coeff(graph.size());
 
@@ -285,12 +423,12 @@ void GraphSLAM::fillEquation(const vector<SLAMScanPtr>& scans, const Graph& grap
         int a, b;
         std::tie(a, b) = graph[i];
 
-        KDTreePtr tree  = trees[a];
+        KDTreePtr tree  = trees.at(a);
         SLAMScanPtr scan = scans[b];
 
         Matrix6d coeffMat;
         Vector6d coeffVec;
-        eulerCovariance(tree, scan, coeffMat, coeffVec);
+        eulerCovariance(tree, scans[a], scan, coeffMat, coeffVec);
 
         coeff[i] = make_pair(coeffMat, coeffVec);
     }
@@ -389,13 +527,18 @@ void GraphSLAM::fillEquation(const vector<SLAMScanPtr>& scans, const Graph& grap
     mat.setFromTriplets(triplets.begin(), triplets.end());
 }
 
-void GraphSLAM::eulerCovariance(KDTreePtr tree, SLAMScanPtr scan, Matrix6d& outMat, Vector6d& outVec) const
+void GraphSLAM::eulerCovariance(KDTreePtr tree, SLAMScanPtr treeScan, SLAMScanPtr scan, Matrix6d& outMat, Vector6d& outVec) const
 {
     size_t n = scan->numPoints();
 
     KDTree::Neighbor* results = new KDTree::Neighbor[n];
 
-    size_t pairs = KDTree::nearestNeighbors(tree, scan, results, m_options->slamMaxDistance);
+    // the tree is in local coordinates of treeScan
+    const Transformd& treePose = treeScan->pose();
+    Matrix3d rotation = treePose.block<3, 3>(0, 0);
+    Vector3d translation = treePose.block<3, 1>(0, 3);
+
+    size_t pairs = KDTree::nearestNeighbors(tree, treePose.inverse() * scan->pose(), scan, results, m_options->slamMaxDistance);
 
     Vector6d mz = Vector6d::Zero();
     Vector3d sum = Vector3d::Zero();
@@ -410,7 +553,7 @@ void GraphSLAM::eulerCovariance(KDTreePtr tree, SLAMScanPtr scan, Matrix6d& outM
         }
 
         Vector3d p = scan->point(i).cast<double>();
-        Vector3d r = results[i]->cast<double>();
+        Vector3d r = rotation * results[i]->cast<double>() + translation;
 
         Vector3d mid = (p + r) / 2.0;
         Vector3d d = r - p;
@@ -463,7 +606,7 @@ void GraphSLAM::eulerCovariance(KDTreePtr tree, SLAMScanPtr scan, Matrix6d& outM
         }
 
         Vector3d p = scan->point(i).cast<double>();
-        Vector3d r = results[i]->cast<double>();
+        Vector3d r = rotation * results[i]->cast<double>() + translation;
 
         Vector3d mid = (p + r) / 2.0;
         Vector3d delta = r - p;
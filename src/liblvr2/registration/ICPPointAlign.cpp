@@ -33,6 +33,7 @@
  */
 #include "lvr2/registration/ICPPointAlign.hpp"
 #include "lvr2/registration/EigenSVDPointAlign.hpp"
+#include "lvr2/registration/Metascan.hpp"
 #include "lvr2/io/Timestamp.hpp"
 
 #include <iomanip>
@@ -49,10 +50,14 @@ ICPPointAlign::ICPPointAlign(SLAMScanPtr model, SLAMScanPtr data) :
     // Init default values
     m_maxDistanceMatch  = 25;
     m_maxIterations     = 50;
+    m_maxLeafSize       = 20;
     m_epsilon           = 0.00001;
     m_verbose           = false;
-
-    m_searchTree = KDTree::create(model, m_maxLeafSize);
+    m_method            = ICPMethod::PointToPoint;
+    m_normalNeighbors   = 20;
+    m_iterations        = 0;
+    m_duration          = 0.0;
+    m_out               = &cout;
 }
 
 Transformd ICPPointAlign::match()
@@ -64,64 +69,250 @@ Transformd ICPPointAlign::match()
 
     auto start_time = chrono::steady_clock::now();
 
+    // the tree is created here to respect setMaxLeafSize()
+    if (m_searchTrees.empty())
+    {
+        // a Metascan keeps its trees between matches and only builds the ones of new Scans
+        Metascan* meta = dynamic_cast<Metascan*>(m_modelCloud.get());
+        if (meta)
+        {
+            m_searchTrees = meta->searchTrees(m_maxLeafSize);
+        }
+        else
+        {
+            m_searchTrees.push_back(KDTree::create(m_modelCloud, m_maxLeafSize));
+        }
+    }
+    for (const KDTreePtr& tree : m_searchTrees)
+    {
+        if (m_method == ICPMethod::PointToPlane && !tree->hasNormals())
+        {
+            tree->estimateNormals(m_normalNeighbors);
+        }
+    }
+
+    Transformd delta = Matrix4d::Identity();
+    double ret = 0.0;
+    bool converged = true;
+    string levelIterations;
+    m_iterations = 0;
+
+    KDTree::Neighbor* neighbors = new KDTree::Neighbor[m_dataCloud->numPoints()];
+
+    // Coarse-to-fine: align the reduced levels of the data Scan first. All levels are
+    // matched against the same model tree, so the tree and its normals are reused.
+    for (size_t level = m_dataCloud->pyramidLevels() - 1; level > 0; level--)
+    {
+        SLAMScanPtr data = m_dataCloud->pyramidLevel(level);
+        Transformd before = data->pose();
+
+        if (m_verbose)
+        {
+            *m_out << timestamp << "ICP level " << level << " using " << data->numPoints() << " points." << endl;
+        }
+
+        int iterations;
+        converged = iterate(data, neighbors, ret, iterations);
+        m_iterations += iterations;
+        levelIterations += to_string(iterations) + "+";
+
+        // Apply the pose change of the level to the full Scan
+        Transformd transform = data->pose() * before.inverse();
+        m_dataCloud->transform(transform, false);
+        delta = delta * transform;
+    }
+
+    Transformd before = m_dataCloud->pose();
+
+    int iterations;
+    converged = iterate(m_dataCloud, neighbors, ret, iterations);
+    m_iterations += iterations;
+
+    delta = delta * (m_dataCloud->pose() * before.inverse());
+
+    delete[] neighbors;
+
+    m_duration = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+    *m_out << setw(6) << (int)(m_duration * 1000) << " ms, ";
+    *m_out << "Error: " << fixed << setprecision(3) << setw(7) << ret;
+    *m_out << " after " << m_iterations << " Iterations";
+    if (!levelIterations.empty())
+    {
+        *m_out << " (" << levelIterations << iterations << ")";
+    }
+    if (!converged)
+    {
+        *m_out << " (not converged)";
+    }
+    *m_out << endl;
+    if (m_verbose)
+    {
+        *m_out << "Result: " << endl << m_dataCloud->deltaPose() << endl;
+    }
+
+    return delta;
+}
+
+bool ICPPointAlign::iterate(SLAMScanPtr data, KDTree::Neighbor* neighbors, double& error, int& iterations)
+{
     double ret = 0.0, prev_ret = 0.0, prev_prev_ret = 0.0;
     EigenSVDPointAlign<double> align;
-    int iteration = 0;
 
     Vector3d centroid_m = Vector3d::Zero();
     Vector3d centroid_d = Vector3d::Zero();
     Transformd transform = Matrix4d::Identity();
-    Transformd delta = Matrix4d::Identity();
-
-    size_t numPoints = m_dataCloud->numPoints();
 
-    KDTree::Neighbor* neighbors = new KDTree::Neighbor[numPoints];
-
-    for (iteration = 0; iteration < m_maxIterations; iteration++)
+    for (iterations = 1; iterations <= m_maxIterations; iterations++)
     {
         // Update break variables
         prev_prev_ret = prev_ret;
         prev_ret = ret;
 
-        // Get point pairs
-        size_t pairs = KDTree::nearestNeighbors(m_searchTree, m_dataCloud, neighbors, m_maxDistanceMatch, centroid_m, centroid_d);
-
-        // Get transformation
+        // Get point pairs and transformation
+        size_t pairs;
         transform = Transformd::Identity();
-        ret = align.alignPoints(m_dataCloud, neighbors, centroid_m, centroid_d, transform);
+
+        if (m_method == ICPMethod::PointToPlane)
+        {
+            KDTree::nearestNeighbors(m_searchTrees, data, neighbors, m_maxDistanceMatch);
+            ret = alignPointToPlane(data, neighbors, transform, pairs);
+        }
+        else
+        {
+            pairs = KDTree::nearestNeighbors(m_searchTrees, data, neighbors, m_maxDistanceMatch, centroid_m, centroid_d);
+            ret = align.alignPoints(data, neighbors, centroid_m, centroid_d, transform);
+        }
 
         // Apply transformation
-        m_dataCloud->transform(transform, false);
-        delta = delta * transform;
+        data->transform(transform, false);
 
         if (m_verbose)
         {
-            cout << timestamp << "ICP Error is " << ret << " in iteration " << iteration << " / " << m_maxIterations << " using " << pairs << " points." << endl;
+            *m_out << timestamp << "ICP Error is " << ret << " in iteration " << iterations << " / " << m_maxIterations << " using " << pairs << " points." << endl;
         }
 
         // Check minimum distance
         if ((fabs(ret - prev_ret) < m_epsilon) && (fabs(ret - prev_prev_ret) < m_epsilon))
         {
-            break;
+            error = ret;
+            return true;
         }
     }
 
-    delete[] neighbors;
+    iterations = m_maxIterations;
+    error = ret;
+    return false;
+}
 
-    auto duration = chrono::steady_clock::now() - start_time;
-    cout << setw(6) << (int)(duration.count() / 1e6) << " ms, ";
-    cout << "Error: " << fixed << setprecision(3) << setw(7) << ret;
-    if (iteration < m_maxIterations)
+double ICPPointAlign::alignPointToPlane(SLAMScanPtr data, KDTree::Neighbor* neighbors, Transformd& transform, size_t& pairs) const
+{
+    size_t n = data->numPoints();
+
+    // The rotation is linearized around the centroid of the data points for numerical stability
+    Vector3d centroid = Vector3d::Zero();
+    pairs = 0;
+
+    #pragma omp parallel
     {
-        cout << " after " << iteration << " Iterations";
+        Vector3d localCentroid = Vector3d::Zero();
+        size_t localPairs = 0;
+
+        #pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < n; i++)
+        {
+            if (neighbors[i] != nullptr && !neighborNormal(neighbors[i]).isZero())
+            {
+                localCentroid += data->point(i);
+                localPairs++;
+            }
+        }
+
+        #pragma omp critical
+        {
+            centroid += localCentroid;
+            pairs += localPairs;
+        }
     }
-    cout << endl;
-    if (m_verbose)
+
+    transform = Transformd::Identity();
+    if (pairs < 6)
     {
-        cout << "Result: " << endl << m_dataCloud->deltaPose() << endl;
+        return 0.0;
     }
+    centroid /= pairs;
 
-    return delta;
+    // Accumulate the normal equations of the linearized residuals
+    // r = n * (R * (d - c) + c + t - m) with R = I + [w]x
+    Matrix6d A = Matrix6d::Zero();
+    Vector6d b = Vector6d::Zero();
+    double error = 0.0;
+
+    #pragma omp parallel
+    {
+        Matrix6d localA = Matrix6d::Zero();
+        Vector6d localB = Vector6d::Zero();
+        double localError = 0.0;
+
+        #pragma omp for schedule(static) nowait
+        for (size_t i = 0; i < n; i++)
+        {
+            if (neighbors[i] == nullptr)
+            {
+                continue;
+            }
+            Vector3d normal = neighborNormal(neighbors[i]).cast<double>();
+            if (normal.isZero())
+            {
+                continue;
+            }
+
+            Vector3d d = data->point(i);
+            double r = normal.dot(d - neighbors[i]->cast<double>());
+
+            Vector6d J;
+            J.head<3>() = (d - centroid).cross(normal);
+            J.tail<3>() = normal;
+
+            localA.selfadjointView<Eigen::Upper>().rankUpdate(J);
+            localB -= J * r;
+            localError += r * r;
+        }
+
+        #pragma omp critical
+        {
+            A += localA;
+            b += localB;
+            error += localError;
+        }
+    }
+
+    Vector6d x = A.selfadjointView<Eigen::Upper>().ldlt().solve(b);
+
+    Vector3d w = x.head<3>();
+    Matrix3d R = Matrix3d::Identity();
+    double angle = w.norm();
+    if (angle > 0.0)
+    {
+        R = Eigen::AngleAxisd(angle, w / angle).toRotationMatrix();
+    }
+
+    transform.block<3, 3>(0, 0) = R;
+    transform.block<3, 1>(0, 3) = centroid + x.tail<3>() - R * centroid;
+
+    return sqrt(error / pairs);
+}
+
+const KDTree::Point& ICPPointAlign::neighborNormal(const KDTree::Neighbor& neighbor) const
+{
+    for (size_t i = 0; i + 1 < m_searchTrees.size(); i++)
+    {
+        if (m_searchTrees[i]->contains(neighbor))
+        {
+            return m_searchTrees[i]->normal(neighbor);
+        }
+    }
+    return m_searchTrees.back()->normal(neighbor);
 }
 
 void ICPPointAlign::setMaxMatchDistance(double d)
@@ -148,6 +339,21 @@ void ICPPointAlign::setVerbose(bool verbose)
     m_verbose = verbose;
 }
 
+void ICPPointAlign::setMethod(ICPMethod method)
+{
+    m_method = method;
+}
+
+void ICPPointAlign::setNormalNeighbors(int k)
+{
+    m_normalNeighbors = k;
+}
+
+void ICPPointAlign::setOutput(std::ostream& out)
+{
+    m_out = &out;
+}
+
 double ICPPointAlign::getMaxMatchDistance() const
 {
     return m_maxDistanceMatch;
@@ -173,4 +379,24 @@ bool ICPPointAlign::getVerbose() const
     return m_verbose;
 }
 
+ICPMethod ICPPointAlign::getMethod() const
+{
+    return m_method;
+}
+
+int ICPPointAlign::getNormalNeighbors() const
+{
+    return m_normalNeighbors;
+}
+
+int ICPPointAlign::getIterations() const
+{
+    return m_iterations;
+}
+
+double ICPPointAlign::getDuration() const
+{
+    return m_duration;
+}
+
 } /* namespace lvr2 */
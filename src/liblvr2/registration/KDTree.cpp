@@ -33,64 +33,162 @@
  */
 #include "lvr2/registration/KDTree.hpp"
 #include "lvr2/registration/AABB.hpp"
+#include "lvr2/config/lvropenmp.hpp"
+#include "lvr2/reconstruction/CovariancePCA.hpp"
+
+#include <algorithm>
+#include <cmath>
 
 namespace lvr2
 {
 
-class KDNode : public KDTree
+namespace
+{
+
+/// Size of the traversal stack that is allocated on the stack
+constexpr int LocalStackSize = 64;
+
+/// A subtree that still has to be checked, and the distance of the query point to its split plane
+struct StackEntry
+{
+    uint32_t node;
+    double planeDist;
+};
+
+} // namespace
+
+int KDTree::createRecursive(Point* base, Point* points, int n, int maxLeafSize, std::vector<Node>& tree, int taskLevels)
 {
-public:
-    KDNode(int axis, double split, KDTreePtr& lesser, KDTreePtr& greater)
-        : axis(axis), split(split), lesser(move(lesser)), greater(move(greater))
-    { }
+    if (n <= maxLeafSize)
+    {
+        tree.push_back({ 0.0f, -1, static_cast<uint32_t>(points - base), static_cast<uint32_t>(n) });
+        return 1;
+    }
+
+    AABB<float> boundingBox(points, n);
+
+    int splitAxis = boundingBox.longestAxis();
+    float splitValue = boundingBox.avg()(splitAxis);
+
+    if (boundingBox.difference(splitAxis) == 0.0) // all points are exactly the same
+    {
+        // this case is rare, but would lead to an infinite recursion loop if not handled,
+        // since all Points would end up in the "lesser" branch every time
 
-protected:
-    virtual void nnInternal(const Point& point, Neighbor& neighbor, double& maxDist) const override
+        // there is no need to check all of them later on, so just pretend like there is only one
+        tree.push_back({ 0.0f, -1, static_cast<uint32_t>(points - base), 1 });
+        return 1;
+    }
+
+    int l = splitPoints(points, n, splitAxis, splitValue);
+
+    if (l == 0 || l == n)
+    {
+        // the average may be rounded onto the bounding box for nearly identical points
+        tree.push_back({ 0.0f, -1, static_cast<uint32_t>(points - base), static_cast<uint32_t>(n) });
+        return 1;
+    }
+
+    size_t index = tree.size();
+    tree.push_back({ splitValue, splitAxis, 0, 0 });
+
+    int depthLesser, depthGreater;
+
+    // Subtrees of tasks are created in separate arrays that have to be copied afterwards,
+    // so tasks are only used for the upper levels of the tree
+    if (taskLevels > 0 && n > 8 * maxLeafSize)
     {
-        double val = point(this->axis);
-        if (val < this->split)
+        std::vector<Node> lesser, greater;
+
+        #pragma omp task shared(lesser, depthLesser)
+        depthLesser  = createRecursive(base, points    , l    , maxLeafSize, lesser, taskLevels - 1);
+
+        #pragma omp task shared(greater, depthGreater)
+        depthGreater = createRecursive(base, points + l, n - l, maxLeafSize, greater, taskLevels - 1);
+
+        #pragma omp taskwait
+
+        // append the subtrees and shift their child indices accordingly
+        for (const std::vector<Node>* subtree : { &lesser, &greater })
         {
-            this->lesser->nnInternal(point, neighbor, maxDist);
-            if (val + maxDist >= this->split)
+            uint32_t offset = tree.size();
+            if (subtree == &greater)
             {
-                this->greater->nnInternal(point, neighbor, maxDist);
+                tree[index].index = offset;
             }
-        }
-        else
-        {
-            this->greater->nnInternal(point, neighbor, maxDist);
-            if (val - maxDist <= this->split)
+            for (Node node : *subtree)
             {
-                this->lesser->nnInternal(point, neighbor, maxDist);
+                if (node.axis >= 0)
+                {
+                    node.index += offset;
+                }
+                tree.push_back(node);
             }
         }
     }
+    else
+    {
+        depthLesser = createRecursive(base, points, l, maxLeafSize, tree, 0);
+        tree[index].index = tree.size();
+        depthGreater = createRecursive(base, points + l, n - l, maxLeafSize, tree, 0);
+    }
 
-private:
-    int axis;
-    double split;
-    KDTreePtr lesser;
-    KDTreePtr greater;
-};
+    return std::max(depthLesser, depthGreater) + 1;
+}
 
-class KDLeaf : public KDTree
+void KDTree::nnInternal(const Point& point, Neighbor& neighbor, double& maxDist) const
 {
-public:
-    KDLeaf(Point* points, int count)
-        : points(points), count(count)
-    { }
+    // Depth first traversal that visits the closer child first. The farther child
+    // is pushed together with the distance to the split plane and skipped later on
+    // if no closer point can be found there anymore.
+    StackEntry localStack[LocalStackSize];
+    std::vector<StackEntry> heapStack;
+    StackEntry* stack = localStack;
+    if (maxDepth > LocalStackSize)
+    {
+        heapStack.resize(maxDepth);
+        stack = heapStack.data();
+    }
+
+    int top = 0;
+    stack[top++] = { 0, 0.0 };
 
-protected:
-    virtual void nnInternal(const Point& point, Neighbor& neighbor, double& maxDist) const override
+    while (top > 0)
     {
+        StackEntry entry = stack[--top];
+        if (entry.planeDist > maxDist)
+        {
+            continue;
+        }
+
+        const Node* node = &nodes[entry.node];
+        uint32_t current = entry.node;
+
+        while (node->axis >= 0)
+        {
+            double val = point(node->axis);
+            if (val < node->split)
+            {
+                stack[top++] = { node->index, node->split - val };
+                current++;
+            }
+            else
+            {
+                stack[top++] = { current + 1, val - node->split };
+                current = node->index;
+            }
+            node = &nodes[current];
+        }
+
         double maxDistSq = maxDist * maxDist;
         bool changed = false;
-        for (int i = 0; i < this->count; i++)
+        Point* leafPoints = this->points.get() + node->index;
+        for (uint32_t i = 0; i < node->count; i++)
         {
-            double dist = (point - this->points[i]).squaredNorm();
+            double dist = (point - leafPoints[i]).squaredNorm();
             if (dist < maxDistSq)
             {
-                neighbor = &this->points[i];
+                neighbor = &leafPoints[i];
                 maxDistSq = dist;
                 changed = true;
             }
@@ -100,83 +198,156 @@ protected:
             maxDist = sqrt(maxDistSq);
         }
     }
+}
 
-private:
-    Point* points;
-    int count;
-};
-
-KDTreePtr create_recursive(KDTree::Point* points, int n, int maxLeafSize)
+int KDTree::knnInternal(const Point& point, int k, Neighbor* neighbors, double maxDist) const
 {
-    if (n <= maxLeafSize)
+    // neighbors[0, found) is kept sorted by distance. The search radius shrinks
+    // to the distance of the k-th neighbor as soon as k neighbors are found.
+    std::vector<double> distances(k);
+    int found = 0;
+    double maxDistSq = maxDist * maxDist;
+
+    StackEntry localStack[LocalStackSize];
+    std::vector<StackEntry> heapStack;
+    StackEntry* stack = localStack;
+    if (maxDepth > LocalStackSize)
     {
-        return KDTreePtr(new KDLeaf(points, n));
+        heapStack.resize(maxDepth);
+        stack = heapStack.data();
     }
 
-    AABB<float> boundingBox(points, n);
-
-    int splitAxis = boundingBox.longestAxis();
-    double splitValue = boundingBox.avg()(splitAxis);
+    int top = 0;
+    stack[top++] = { 0, 0.0 };
 
-    if (boundingBox.difference(splitAxis) == 0.0) // all points are exactly the same
+    while (top > 0 && k > 0)
     {
-        // this case is rare, but would lead to an infinite recursion loop if not handled,
-        // since all Points would end up in the "lesser" branch every time
+        StackEntry entry = stack[--top];
+        if (entry.planeDist * entry.planeDist > maxDistSq)
+        {
+            continue;
+        }
 
-        // there is no need to check all of them later on, so just pretend like there is only one
-        return KDTreePtr(new KDLeaf(points, 1));
+        const Node* node = &nodes[entry.node];
+        uint32_t current = entry.node;
+
+        while (node->axis >= 0)
+        {
+            double val = point(node->axis);
+            if (val < node->split)
+            {
+                stack[top++] = { node->index, node->split - val };
+                current++;
+            }
+            else
+            {
+                stack[top++] = { current + 1, val - node->split };
+                current = node->index;
+            }
+            node = &nodes[current];
+        }
+
+        Point* leafPoints = this->points.get() + node->index;
+        for (uint32_t i = 0; i < node->count; i++)
+        {
+            double dist = (point - leafPoints[i]).squaredNorm();
+            if (dist >= maxDistSq)
+            {
+                continue;
+            }
+
+            // insert into the sorted list, dropping the farthest neighbor if it is full
+            int pos = found < k ? found++ : k - 1;
+            while (pos > 0 && distances[pos - 1] > dist)
+            {
+                distances[pos] = distances[pos - 1];
+                neighbors[pos] = neighbors[pos - 1];
+                pos--;
+            }
+            distances[pos] = dist;
+            neighbors[pos] = &leafPoints[i];
+
+            if (found == k)
+            {
+                maxDistSq = distances[k - 1];
+            }
+        }
     }
 
-    int l = splitPoints(points, n, splitAxis, splitValue);
+    return found;
+}
 
-    KDTreePtr lesser, greater;
+void KDTree::estimateNormals(int k)
+{
+    normals = boost::shared_array<Point>(new Point[pointCount]);
+    const float* coordinates = reinterpret_cast<const float*>(points.get());
 
-    if (n > 8 * maxLeafSize) // stop the omp task subdivision early to avoid spamming tasks
+    #pragma omp parallel
     {
-        #pragma omp task shared(lesser)
-        lesser  = create_recursive(points    , l    , maxLeafSize);
+        std::vector<Neighbor> neighbors(k);
+        std::vector<size_t> ids(k);
 
-        #pragma omp task shared(greater)
-        greater = create_recursive(points + l, n - l, maxLeafSize);
+        #pragma omp for schedule(dynamic, 256)
+        for (size_t i = 0; i < pointCount; i++)
+        {
+            int found = knnInternal(points[i], k, neighbors.data(), std::numeric_limits<double>::infinity());
 
-        #pragma omp taskwait
-    }
-    else
-    {
-        lesser  = create_recursive(points    , l    , maxLeafSize);
-        greater = create_recursive(points + l, n - l, maxLeafSize);
-    }
+            // at least three points are needed to define a plane
+            if (found < 3)
+            {
+                normals[i] = Point::Zero();
+                continue;
+            }
+
+            for (int j = 0; j < found; j++)
+            {
+                ids[j] = neighbors[j] - points.get();
+            }
 
-    return KDTreePtr(new KDNode(splitAxis, splitValue, lesser, greater));
+            float centroid[3], cov[6];
+            calcCovariance(coordinates, ids.data(), found, centroid, cov);
+            smallestEigenvector(cov, normals[i].data());
+        }
+    }
 }
 
-KDTreePtr KDTree::create(SLAMScanPtr scan, int maxLeafSize)
+KDTreePtr KDTree::create(SLAMScanPtr scan, int maxLeafSize, bool local)
 {
-    KDTreePtr ret;
-
     size_t n = scan->numPoints();
     auto points = boost::shared_array<Point>(new Point[n]);
 
     #pragma omp parallel for schedule(static)
     for (size_t i = 0; i < n; i++)
     {
-        points[i] = scan->point(i).cast<PointT>();
+        points[i] = local ? scan->rawPoint(i) : scan->point(i).cast<PointT>();
     }
 
+    return create(points, n, maxLeafSize);
+}
+
+KDTreePtr KDTree::create(boost::shared_array<Point> points, size_t n, int maxLeafSize)
+{
+    KDTreePtr ret(new KDTree());
+
+    ret->nodes.reserve(2 * n / std::max(maxLeafSize, 1) + 1);
+
+    // about four tasks per thread
+    int threads = OpenMPConfig::getNumThreads();
+    int taskLevels = threads > 1 ? static_cast<int>(std::ceil(std::log2(threads))) + 2 : 0;
+
     #pragma omp parallel // allows "pragma omp task"
     #pragma omp single // only execute every task once
-    ret = create_recursive(points.get(), n, maxLeafSize);
+    ret->maxDepth = createRecursive(points.get(), points.get(), n, maxLeafSize, ret->nodes, taskLevels);
 
     ret->points = points;
+    ret->pointCount = n;
 
     return ret;
 }
 
 
-size_t KDTree::nearestNeighbors(KDTreePtr tree, SLAMScanPtr scan, KDTree::Neighbor* neighbors, double maxDistance, Vector3d& centroid_m, Vector3d& centroid_d)
+void KDTree::calculateCentroids(SLAMScanPtr scan, const Neighbor* neighbors, size_t found, Vector3d& centroid_m, Vector3d& centroid_d)
 {
-    size_t found = KDTree::nearestNeighbors(tree, scan, neighbors, maxDistance);
-
     centroid_m = Vector3d::Zero();
     centroid_d = Vector3d::Zero();
 
@@ -191,7 +362,12 @@ size_t KDTree::nearestNeighbors(KDTreePtr tree, SLAMScanPtr scan, KDTree::Neighb
 
     centroid_m /= found;
     centroid_d /= found;
+}
 
+size_t KDTree::nearestNeighbors(KDTreePtr tree, SLAMScanPtr scan, KDTree::Neighbor* neighbors, double maxDistance, Vector3d& centroid_m, Vector3d& centroid_d)
+{
+    size_t found = KDTree::nearestNeighbors(tree, scan, neighbors, maxDistance);
+    calculateCentroids(scan, neighbors, found, centroid_m, centroid_d);
     return found;
 }
 
@@ -212,4 +388,68 @@ size_t KDTree::nearestNeighbors(KDTreePtr tree, SLAMScanPtr scan, KDTree::Neighb
     return found;
 }
 
+size_t KDTree::nearestNeighbors(KDTreePtr tree, const Transformd& transform, SLAMScanPtr scan, KDTree::Neighbor* neighbors, double maxDistance)
+{
+    size_t found = 0;
+    double distance = 0.0;
+
+    Eigen::Matrix3d rotation = transform.block<3, 3>(0, 0);
+    Vector3d translation = transform.block<3, 1>(0, 3);
+
+    #pragma omp parallel for firstprivate(distance) reduction(+:found) schedule(dynamic,8)
+    for (size_t i = 0; i < scan->numPoints(); i++)
+    {
+        Vector3d point = rotation * scan->rawPoint(i).cast<double>() + translation;
+        if (tree->nearestNeighbor(point, neighbors[i], distance, maxDistance))
+        {
+            found++;
+        }
+    }
+
+    return found;
+}
+
+size_t KDTree::nearestNeighbors(const std::vector<KDTreePtr>& trees, SLAMScanPtr scan, KDTree::Neighbor* neighbors, double maxDistance)
+{
+    if (trees.size() == 1)
+    {
+        return nearestNeighbors(trees[0], scan, neighbors, maxDistance);
+    }
+
+    size_t found = 0;
+
+    #pragma omp parallel for reduction(+:found) schedule(dynamic,8)
+    for (size_t i = 0; i < scan->numPoints(); i++)
+    {
+        Vector3d point = scan->point(i);
+
+        // every tree only has to find neighbors closer than the best one so far
+        neighbors[i] = nullptr;
+        double bestDistance = maxDistance;
+        for (const KDTreePtr& tree : trees)
+        {
+            Neighbor neighbor;
+            double distance;
+            if (tree->nearestNeighbor(point, neighbor, distance, bestDistance))
+            {
+                neighbors[i] = neighbor;
+                bestDistance = distance;
+            }
+        }
+        if (neighbors[i] != nullptr)
+        {
+            found++;
+        }
+    }
+
+    return found;
+}
+
+size_t KDTree::nearestNeighbors(const std::vector<KDTreePtr>& trees, SLAMScanPtr scan, KDTree::Neighbor* neighbors, double maxDistance, Vector3d& centroid_m, Vector3d& centroid_d)
+{
+    size_t found = KDTree::nearestNeighbors(trees, scan, neighbors, maxDistance);
+    calculateCentroids(scan, neighbors, found, centroid_m, centroid_d);
+    return found;
+}
+
 }
@@ -33,6 +33,8 @@
  */
 #include "lvr2/registration/Metascan.hpp"
 
+#include <algorithm>
+
 namespace lvr2
 {
 
@@ -58,22 +60,89 @@ void Metascan::transform(const Transformd& transform, bool writeFrame, FrameUse
 
 Vector3d Metascan::point(size_t index) const
 {
-    for (auto& scan : m_scans)
+    if (index >= m_numPoints)
     {
-        if (index < scan->numPoints())
-        {
-            return scan->point(index);
-        }
-        index -= scan->numPoints();
+        return Vector3d();
     }
-    return Vector3d();
+    // find the last Scan that starts at or before index
+    size_t scan = std::upper_bound(m_offsets.begin(), m_offsets.end(), index) - m_offsets.begin() - 1;
+    return m_scans[scan]->point(index - m_offsets[scan]);
 }
 
 void Metascan::addScan(SLAMScanPtr scan)
 {
+    m_offsets.push_back(m_numPoints);
     m_scans.push_back(scan);
     m_numPoints += scan->numPoints();
     m_deltaPose = scan->deltaPose();
+
+    m_groups.push_back({ m_scans.size() - 1, 1, scan->numPoints(), nullptr, {} });
+
+    // Merge the newest groups until every group has more than twice the points of the next one.
+    // This keeps the number of groups logarithmic and every point is only part of
+    // logarithmically many rebuilds.
+    while (m_groups.size() >= 2)
+    {
+        ScanGroup& last = m_groups[m_groups.size() - 1];
+        ScanGroup& prev = m_groups[m_groups.size() - 2];
+        if (prev.numPoints > 2 * last.numPoints)
+        {
+            break;
+        }
+        prev.count += last.count;
+        prev.numPoints += last.numPoints;
+        prev.tree = nullptr;
+        prev.poses.clear();
+        m_groups.pop_back();
+    }
+}
+
+const std::vector<KDTreePtr>& Metascan::searchTrees(int maxLeafSize)
+{
+    m_trees.clear();
+
+    for (ScanGroup& group : m_groups)
+    {
+        if (group.tree && maxLeafSize == m_maxLeafSize)
+        {
+            // the tree is in global coordinates, so it is only valid as long as no Scan was moved
+            bool moved = false;
+            for (size_t i = 0; i < group.count && !moved; i++)
+            {
+                moved = m_scans[group.first + i]->pose() != group.poses[i];
+            }
+            if (!moved)
+            {
+                m_trees.push_back(group.tree);
+                continue;
+            }
+        }
+
+        size_t offset = m_offsets[group.first];
+        auto points = boost::shared_array<KDTree::Point>(new KDTree::Point[group.numPoints]);
+
+        group.poses.clear();
+        for (size_t i = 0; i < group.count; i++)
+        {
+            const SLAMScanPtr& scan = m_scans[group.first + i];
+            KDTree::Point* target = points.get() + m_offsets[group.first + i] - offset;
+
+            #pragma omp parallel for schedule(static)
+            for (size_t j = 0; j < scan->numPoints(); j++)
+            {
+                target[j] = scan->point(j).cast<KDTree::PointT>();
+            }
+
+            group.poses.push_back(scan->pose());
+        }
+
+        group.tree = KDTree::create(points, group.numPoints, maxLeafSize);
+        m_trees.push_back(group.tree);
+    }
+
+    m_maxLeafSize = maxLeafSize;
+
+    return m_trees;
 }
 
 } /* namespace lvr2 */
@@ -36,8 +36,12 @@
 #include "lvr2/registration/SLAMAlign.hpp"
 #include "lvr2/registration/ICPPointAlign.hpp"
 #include "lvr2/registration/Metascan.hpp"
+#include "lvr2/config/lvropenmp.hpp"
 
 #include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
 
 using namespace std;
 
@@ -120,6 +124,19 @@ void SLAMAlign::reduceScan(const SLAMScanPtr& scan)
             cout << "Removed " << (prev - scan->numPoints()) << " / " << prev << " Points -> " << scan->numPoints() << " left" << endl;
         }
     }
+
+    if (m_options.icpPyramidLevels > 1)
+    {
+        double voxelSize = m_options.icpPyramidVoxelSize > 0 ? m_options.icpPyramidVoxelSize : 2 * m_options.reduction;
+        if (voxelSize > 0)
+        {
+            scan->createPyramid(m_options.icpPyramidLevels, voxelSize, m_options.maxLeafSize);
+        }
+        else
+        {
+            cout << "Warning: No voxel size for the ICP pyramid. Set a reduction or the pyramid voxel size." << endl;
+        }
+    }
 }
 
 void SLAMAlign::match()
@@ -139,53 +156,40 @@ void SLAMAlign::match()
         m_metascan = SLAMScanPtr(meta);
     }
 
-    string scan_number_string = to_string(m_scans.size() - 1);
+    size_t icpPairs = 0;
+    int icpIterations = 0;
+    double icpDuration = 0.0;
 
-    // only match everything after m_alreadyMatched
-    for (size_t i = 0; i < m_icp_graph.size(); i++)
+    // Pairs can only be registered concurrently if nothing besides ICP itself depends on the
+    // order: The Metascan grows with every Scan, frames are added to all Scans and
+    // loopclosing may move all previous Scans.
+    bool parallel = !m_options.metascan && !m_options.createFrames
+                    && !m_options.doLoopClosing && !m_options.doGraphSLAM
+                    && OpenMPConfig::getNumThreads() > 1;
+
+    if (parallel)
     {
-        if (m_new_scans.empty() || m_new_scans.at(m_icp_graph.at(i).second))
+        vector<size_t> edges;
+        for (size_t i = 0; i < m_icp_graph.size(); i++)
         {
-            cout << m_scans.size() << endl;
-            ;
-
-            if (m_options.verbose)
-            {
-                cout << "Iteration " << setw(scan_number_string.length()) << m_icp_graph.at(i).second << "/" << scan_number_string << ": " << endl;
-            }
-            else
-            {
-                cout << setw(scan_number_string.length()) << m_icp_graph.at(i).second << "/" << scan_number_string << ": " << flush;
-            }
-
-            SLAMScanPtr prev = m_options.metascan ? m_metascan : m_scans[m_icp_graph.at(i).first];
-            const SLAMScanPtr& cur = m_scans[m_icp_graph.at(i).second];
-
-            if (!m_options.trustPose && m_icp_graph.at(i).second != 1) // no deltaPose on first run
-            {
-                applyTransform(cur, prev->deltaPose());
-            }
-            else
+            if (m_new_scans.empty() || m_new_scans.at(m_icp_graph.at(i).second))
             {
-                if (m_options.createFrames)
-                {
-                    applyTransform(cur, Matrix4d::Identity());
-                }
+                edges.push_back(i);
             }
+        }
+        alignPairsParallel(edges, icpIterations, icpDuration);
+        icpPairs = edges.size();
+    }
 
-            ICPPointAlign icp(prev, cur);
-            icp.setMaxMatchDistance(m_options.icpMaxDistance);
-            icp.setMaxIterations(m_options.icpIterations);
-            icp.setMaxLeafSize(m_options.maxLeafSize);
-            icp.setEpsilon(m_options.epsilon);
-            icp.setVerbose(m_options.verbose);
-
-            icp.match();
+    // only match everything after m_alreadyMatched
+    for (size_t i = 0; i < m_icp_graph.size() && !parallel; i++)
+    {
+        if (m_new_scans.empty() || m_new_scans.at(m_icp_graph.at(i).second))
+        {
+            alignPair(i, cout, icpIterations, icpDuration);
+            icpPairs++;
 
-            if (m_options.createFrames)
-            {
-                applyTransform(cur, Matrix4d::Identity());
-            }
+            const SLAMScanPtr& cur = m_scans[m_icp_graph.at(i).second];
 
             if (m_options.metascan)
             {
@@ -202,6 +206,131 @@ void SLAMAlign::match()
             
         }
     }
+
+    if (icpPairs > 0)
+    {
+        cout << "ICP (" << (m_options.icpMethod == ICPMethod::PointToPlane ? "point-to-plane" : "point-to-point")
+             << "): " << icpPairs << " Scan pairs, " << fixed << setprecision(1)
+             << (double)icpIterations / icpPairs << " Iterations and "
+             << (int)(icpDuration * 1000 / icpPairs) << " ms per pair" << endl;
+    }
+}
+
+void SLAMAlign::alignPair(size_t edge, ostream& out, int& iterations, double& duration)
+{
+    string scan_number_string = to_string(m_scans.size() - 1);
+
+    if (m_options.verbose)
+    {
+        out << "Iteration " << setw(scan_number_string.length()) << m_icp_graph.at(edge).second << "/" << scan_number_string << ": " << endl;
+    }
+    else
+    {
+        out << setw(scan_number_string.length()) << m_icp_graph.at(edge).second << "/" << scan_number_string << ": " << flush;
+    }
+
+    SLAMScanPtr prev = m_options.metascan ? m_metascan : m_scans[m_icp_graph.at(edge).first];
+    const SLAMScanPtr& cur = m_scans[m_icp_graph.at(edge).second];
+
+    if (!m_options.trustPose && m_icp_graph.at(edge).second != 1) // no deltaPose on first run
+    {
+        applyTransform(cur, prev->deltaPose());
+    }
+    else
+    {
+        if (m_options.createFrames)
+        {
+            applyTransform(cur, Matrix4d::Identity());
+        }
+    }
+
+    ICPPointAlign icp(prev, cur);
+    icp.setMaxMatchDistance(m_options.icpMaxDistance);
+    icp.setMaxIterations(m_options.icpIterations);
+    icp.setMaxLeafSize(m_options.maxLeafSize);
+    icp.setEpsilon(m_options.epsilon);
+    icp.setVerbose(m_options.verbose);
+    icp.setMethod(m_options.icpMethod);
+    icp.setNormalNeighbors(m_options.icpNormalNeighbors);
+    icp.setOutput(out);
+
+    icp.match();
+
+    iterations += icp.getIterations();
+    duration += icp.getDuration();
+
+    if (m_options.createFrames)
+    {
+        applyTransform(cur, Matrix4d::Identity());
+    }
+}
+
+void SLAMAlign::alignPairsParallel(const vector<size_t>& edges, int& iterations, double& duration)
+{
+    // The wave of every edge: one after the last wave that moved its model Scan or
+    // that used or moved its data Scan
+    vector<int> lastRead(m_scans.size(), -1);
+    vector<int> lastWrite(m_scans.size(), -1);
+    vector<vector<size_t>> waves;
+
+    for (size_t edge : edges)
+    {
+        int model = m_icp_graph.at(edge).first;
+        int data = m_icp_graph.at(edge).second;
+
+        int wave = max({ lastWrite[model], lastWrite[data], lastRead[data] }) + 1;
+        lastRead[model] = max(lastRead[model], wave);
+        lastWrite[data] = wave;
+
+        if (wave >= (int)waves.size())
+        {
+            waves.resize(wave + 1);
+        }
+        waves[wave].push_back(edge);
+    }
+
+    int threads = OpenMPConfig::getNumThreads();
+    int maxLevels = OpenMPConfig::getMaxActiveLevels();
+    OpenMPConfig::setMaxActiveLevels(max(maxLevels, 2));
+
+    int waveIterations = 0;
+    double waveDuration = 0.0;
+
+    auto start_time = chrono::steady_clock::now();
+
+    for (const vector<size_t>& wave : waves)
+    {
+        int outerThreads = min((int)wave.size(), threads);
+        int innerThreads = max(threads / outerThreads, 1);
+
+        #pragma omp parallel for num_threads(outerThreads) schedule(dynamic, 1) reduction(+:waveIterations, waveDuration)
+        for (size_t i = 0; i < wave.size(); i++)
+        {
+            // only affects parallel regions created by this thread
+            OpenMPConfig::setNumThreads(innerThreads);
+
+            // collect the output to avoid mixing the lines of different pairs
+            ostringstream out;
+            alignPair(wave[i], out, waveIterations, waveDuration);
+
+            #pragma omp critical
+            cout << out.str() << flush;
+        }
+    }
+
+    double wallTime = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+    OpenMPConfig::setMaxActiveLevels(maxLevels);
+
+    iterations += waveIterations;
+    duration += waveDuration;
+
+    if (!edges.empty())
+    {
+        cout << "Parallel ICP: " << edges.size() << " Scan pairs in " << waves.size() << " waves, "
+             << fixed << setprecision(1) << (double)edges.size() / waves.size() << " pairs per wave, "
+             << "achieved concurrency " << (wallTime > 0.0 ? waveDuration / wallTime : 1.0) << endl;
+    }
 }
 
 void SLAMAlign::applyTransform(SLAMScanPtr scan, const Matrix4d& transform)
@@ -330,6 +459,8 @@ void SLAMAlign::loopClose(size_t first, size_t last)
     icp.setMaxLeafSize(m_options.maxLeafSize);
     icp.setEpsilon(m_options.slamEpsilon);
     icp.setVerbose(m_options.verbose);
+    icp.setMethod(m_options.icpMethod);
+    icp.setNormalNeighbors(m_options.icpNormalNeighbors);
 
     Matrix4d transform = icp.match();
 
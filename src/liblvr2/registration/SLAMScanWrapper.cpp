@@ -88,12 +88,14 @@ void SLAMScanWrapper::transform(const Transformd& transform, bool writeFrame, Fr
 
 void SLAMScanWrapper::reduce(double voxelSize, int maxLeafSize)
 {
+    m_pyramid.clear();
     m_numPoints = octreeReduce(m_points.data(), m_numPoints, voxelSize, maxLeafSize);
     m_points.resize(m_numPoints);
 }
 
 void SLAMScanWrapper::setMinDistance(double minDistance)
 {
+    m_pyramid.clear();
     double sqDist = minDistance * minDistance;
 
     size_t cur = 0;
@@ -114,6 +116,7 @@ void SLAMScanWrapper::setMinDistance(double minDistance)
 
 void SLAMScanWrapper::setMaxDistance(double maxDistance)
 {
+    m_pyramid.clear();
     double sqDist = maxDistance * maxDistance;
 
     size_t cur = 0;
@@ -138,6 +141,42 @@ void SLAMScanWrapper::trim()
     m_points.shrink_to_fit();
 }
 
+void SLAMScanWrapper::createPyramid(int levels, double voxelSize, int maxLeafSize)
+{
+    m_pyramid.clear();
+
+    const std::vector<Vector3f>* source = &m_points;
+    size_t sourceCount = m_numPoints;
+
+    for (int level = 1; level < levels; level++)
+    {
+        // every level is reduced from the next finer one
+        std::shared_ptr<SLAMScanWrapper> reduced(new SLAMScanWrapper(ScanPtr()));
+        reduced->m_scan = ScanPtr(new Scan());
+        reduced->m_points.assign(source->begin(), source->begin() + sourceCount);
+        reduced->m_numPoints = octreeReduce(reduced->m_points.data(), sourceCount, voxelSize, maxLeafSize);
+        reduced->trim();
+
+        m_pyramid.push_back(reduced);
+        source = &reduced->m_points;
+        sourceCount = reduced->m_numPoints;
+        voxelSize *= 2;
+    }
+}
+
+size_t SLAMScanWrapper::pyramidLevels() const
+{
+    return m_pyramid.size() + 1;
+}
+
+std::shared_ptr<SLAMScanWrapper> SLAMScanWrapper::pyramidLevel(size_t level)
+{
+    std::shared_ptr<SLAMScanWrapper>& reduced = m_pyramid[level - 1];
+    reduced->m_scan->registration = m_scan->registration;
+    reduced->m_deltaPose = m_deltaPose;
+    return reduced;
+}
+
 Vector3d SLAMScanWrapper::point(size_t index) const
 {
     const Vector3f& p = m_points[index];
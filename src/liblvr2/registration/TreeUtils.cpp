@@ -64,6 +64,12 @@ int splitPoints(Vector3f* points, int n, int axis, double splitValue)
         }
     }
 
+    // the loop stops at l == r without classifying that point
+    if (l < n && points[l](axis) < splitValue)
+    {
+        ++l;
+    }
+
     return l;
 }
 
@@ -0,0 +1,432 @@
+/**
+ * Copyright (c) 2018, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * Main.cpp
+ *
+ *  Micro-benchmark for the KDTree used by the registration. Compares the
+ *  flat KDTree with a pointer based tree that uses one heap allocated object
+ *  per node and virtual dispatch during the search.
+ */
+
+#include "lvr2/io/ModelFactory.hpp"
+#include "lvr2/registration/AABB.hpp"
+#include "lvr2/registration/KDTree.hpp"
+#include "lvr2/registration/TreeUtils.hpp"
+#include "lvr2/types/ScanTypes.hpp"
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace lvr2;
+using namespace std;
+
+namespace
+{
+
+/**
+ * @brief Reference kd-tree with separately allocated nodes, used as the baseline
+ */
+class PointerKDTree
+{
+public:
+    using Point = KDTree::Point;
+    using Neighbor = KDTree::Neighbor;
+    using Ptr = std::shared_ptr<PointerKDTree>;
+
+    static Ptr create(SLAMScanPtr scan, int maxLeafSize);
+
+    bool nearestNeighbor(const Vector3d& point, Neighbor& neighbor, double& distance, double maxDistance) const
+    {
+        neighbor = nullptr;
+        distance = maxDistance;
+        nnInternal(point.cast<float>(), neighbor, distance);
+        return neighbor != nullptr;
+    }
+
+    virtual ~PointerKDTree() = default;
+
+protected:
+    virtual void nnInternal(const Point& point, Neighbor& neighbor, double& maxDist) const = 0;
+
+    friend class PointerKDNode;
+
+    boost::shared_array<Point> points;
+};
+
+class PointerKDNode : public PointerKDTree
+{
+public:
+    PointerKDNode(int axis, double split, Ptr lesser, Ptr greater)
+        : axis(axis), split(split), lesser(move(lesser)), greater(move(greater))
+    { }
+
+protected:
+    virtual void nnInternal(const Point& point, Neighbor& neighbor, double& maxDist) const override
+    {
+        double val = point(axis);
+        if (val < split)
+        {
+            lesser->nnInternal(point, neighbor, maxDist);
+            if (val + maxDist >= split)
+            {
+                greater->nnInternal(point, neighbor, maxDist);
+            }
+        }
+        else
+        {
+            greater->nnInternal(point, neighbor, maxDist);
+            if (val - maxDist <= split)
+            {
+                lesser->nnInternal(point, neighbor, maxDist);
+            }
+        }
+    }
+
+private:
+    int axis;
+    double split;
+    Ptr lesser;
+    Ptr greater;
+};
+
+class PointerKDLeaf : public PointerKDTree
+{
+public:
+    PointerKDLeaf(Point* points, int count) : leafPoints(points), count(count) { }
+
+protected:
+    virtual void nnInternal(const Point& point, Neighbor& neighbor, double& maxDist) const override
+    {
+        double maxDistSq = maxDist * maxDist;
+        bool changed = false;
+        for (int i = 0; i < count; i++)
+        {
+            double dist = (point - leafPoints[i]).squaredNorm();
+            if (dist < maxDistSq)
+            {
+                neighbor = &leafPoints[i];
+                maxDistSq = dist;
+                changed = true;
+            }
+        }
+        if (changed)
+        {
+            maxDist = sqrt(maxDistSq);
+        }
+    }
+
+private:
+    Point* leafPoints;
+    int count;
+};
+
+PointerKDTree::Ptr createPointerTree(PointerKDTree::Point* points, int n, int maxLeafSize)
+{
+    if (n <= maxLeafSize)
+    {
+        return PointerKDTree::Ptr(new PointerKDLeaf(points, n));
+    }
+
+    AABB<float> boundingBox(points, n);
+    int splitAxis = boundingBox.longestAxis();
+    double splitValue = boundingBox.avg()(splitAxis);
+
+    if (boundingBox.difference(splitAxis) == 0.0)
+    {
+        return PointerKDTree::Ptr(new PointerKDLeaf(points, 1));
+    }
+
+    int l = splitPoints(points, n, splitAxis, splitValue);
+    if (l == 0 || l == n)
+    {
+        return PointerKDTree::Ptr(new PointerKDLeaf(points, n));
+    }
+
+    PointerKDTree::Ptr lesser, greater;
+    if (n > 8 * maxLeafSize)
+    {
+        #pragma omp task shared(lesser)
+        lesser  = createPointerTree(points    , l    , maxLeafSize);
+
+        #pragma omp task shared(greater)
+        greater = createPointerTree(points + l, n - l, maxLeafSize);
+
+        #pragma omp taskwait
+    }
+    else
+    {
+        lesser  = createPointerTree(points    , l    , maxLeafSize);
+        greater = createPointerTree(points + l, n - l, maxLeafSize);
+    }
+
+    return PointerKDTree::Ptr(new PointerKDNode(splitAxis, splitValue, lesser, greater));
+}
+
+PointerKDTree::Ptr PointerKDTree::create(SLAMScanPtr scan, int maxLeafSize)
+{
+    size_t n = scan->numPoints();
+    auto points = boost::shared_array<Point>(new Point[n]);
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++)
+    {
+        points[i] = scan->point(i).cast<float>();
+    }
+
+    Ptr ret;
+
+    #pragma omp parallel
+    #pragma omp single
+    ret = createPointerTree(points.get(), n, maxLeafSize);
+
+    ret->points = points;
+    return ret;
+}
+
+/**
+ * @brief Creates a synthetic indoor scan: The walls, floor and ceiling of a
+ *        room of the given size, sampled randomly with some sensor noise.
+ */
+PointBufferPtr createRoomScan(size_t n, const Vector3f& size, float noise, mt19937& rng)
+{
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    uniform_int_distribution<int> face(0, 5);
+    normal_distribution<float> gauss(0.0f, noise);
+
+    floatArr points(new float[n * 3]);
+    for (size_t i = 0; i < n; i++)
+    {
+        Vector3f p(unit(rng), unit(rng), unit(rng));
+        int f = face(rng);
+        p(f / 2) = f % 2;
+        p = (p - Vector3f::Constant(0.5f)).cwiseProduct(size);
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            points[i * 3 + axis] = p(axis) + gauss(rng);
+        }
+    }
+    return PointBufferPtr(new PointBuffer(points, n));
+}
+
+SLAMScanPtr createScan(PointBufferPtr points, const Transformd& pose)
+{
+    ScanPtr scan(new Scan);
+    scan->points = points;
+    scan->numPoints = points->numPoints();
+    scan->registration = pose;
+    scan->poseEstimation = pose;
+    return SLAMScanPtr(new SLAMScanWrapper(scan));
+}
+
+double secondsSince(const chrono::steady_clock::time_point& start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    string inputFile;
+    size_t numPoints = 1000000;
+    int maxLeafSize = 20;
+    double maxDistance = 0.25;
+    int runs = 5;
+    double noise = 0.005;
+    bool help = false;
+
+    try
+    {
+        using namespace boost::program_options;
+
+        options_description options("Options");
+        options.add_options()
+        ("input,i", value<string>(&inputFile),
+         "A point cloud to use as model scan. A synthetic room scan is created if not given.")
+
+        ("points,n", value<size_t>(&numPoints)->default_value(numPoints),
+         "The number of points of the synthetic scan.")
+
+        ("maxLeafSize,l", value<int>(&maxLeafSize)->default_value(maxLeafSize),
+         "The maximum number of Points in a Leaf of a KDTree.")
+
+        ("maxDistance,d", value<double>(&maxDistance)->default_value(maxDistance),
+         "The maximum distance between neighbors.")
+
+        ("runs,r", value<int>(&runs)->default_value(runs),
+         "The number of repetitions. The fastest run is reported.")
+
+        ("noise", value<double>(&noise)->default_value(noise),
+         "The standard deviation of the noise added to the synthetic scans.")
+
+        ("help,h", bool_switch(&help),
+         "Print this help.")
+        ;
+
+        variables_map variables;
+        store(parse_command_line(argc, argv, options), variables);
+        notify(variables);
+
+        if (help)
+        {
+            cout << "KDTree benchmark: Builds a flat and a pointer based kd-tree for a model" << endl;
+            cout << "scan and searches the nearest neighbors of a slightly transformed copy." << endl;
+            cout << "Usage: " << endl;
+            cout << "\tlvr2_kdtree_benchmark [OPTIONS]" << endl;
+            cout << endl;
+            options.print(cout);
+            return EXIT_SUCCESS;
+        }
+    }
+    catch (const boost::program_options::error& ex)
+    {
+        cerr << ex.what() << endl;
+        cerr << endl;
+        cerr << "Use '--help' to see the list of possible options" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // =============== create model and data scan ===============
+    mt19937 rng(42);
+    PointBufferPtr modelPoints;
+
+    if (inputFile.empty())
+    {
+        modelPoints = createRoomScan(numPoints, Vector3f(20.0f, 10.0f, 4.0f), noise, rng);
+    }
+    else
+    {
+        ModelPtr model = ModelFactory::readModel(inputFile);
+        if (!model || !model->m_pointCloud)
+        {
+            cerr << "Unable to read point cloud from " << inputFile << endl;
+            return EXIT_FAILURE;
+        }
+        modelPoints = model->m_pointCloud;
+    }
+
+    // The data scan is the model with a small pose error, as in a typical ICP iteration
+    Transformd pose = Transformd::Identity();
+    pose.block<3, 3>(0, 0) = Eigen::AngleAxisd(M_PI / 180.0, Vector3d::UnitZ()).toRotationMatrix();
+    pose.block<3, 1>(0, 3) = Vector3d(0.05, -0.03, 0.02);
+
+    SLAMScanPtr modelScan = createScan(modelPoints, Transformd::Identity());
+    SLAMScanPtr dataScan = createScan(modelPoints, pose);
+
+    size_t n = dataScan->numPoints();
+    cout << "Model points: " << modelScan->numPoints() << ", queries: " << n
+         << ", max leaf size: " << maxLeafSize << ", max distance: " << maxDistance << endl;
+
+    // =============== build ===============
+    double flatBuild = numeric_limits<double>::max();
+    double pointerBuild = numeric_limits<double>::max();
+    KDTreePtr flatTree;
+    PointerKDTree::Ptr pointerTree;
+
+    for (int run = 0; run < runs; run++)
+    {
+        flatTree.reset();
+        auto start = chrono::steady_clock::now();
+        flatTree = KDTree::create(modelScan, maxLeafSize);
+        flatBuild = min(flatBuild, secondsSince(start));
+
+        pointerTree.reset();
+        start = chrono::steady_clock::now();
+        pointerTree = PointerKDTree::create(modelScan, maxLeafSize);
+        pointerBuild = min(pointerBuild, secondsSince(start));
+    }
+
+    // =============== search ===============
+    vector<KDTree::Neighbor> flatNeighbors(n), pointerNeighbors(n);
+    double flatSearch = numeric_limits<double>::max();
+    double pointerSearch = numeric_limits<double>::max();
+    size_t flatFound = 0, pointerFound = 0;
+
+    for (int run = 0; run < runs; run++)
+    {
+        auto start = chrono::steady_clock::now();
+        flatFound = KDTree::nearestNeighbors(flatTree, dataScan, flatNeighbors.data(), maxDistance);
+        flatSearch = min(flatSearch, secondsSince(start));
+
+        start = chrono::steady_clock::now();
+        size_t found = 0;
+        double distance = 0.0;
+
+        #pragma omp parallel for firstprivate(distance) reduction(+:found) schedule(dynamic,8)
+        for (size_t i = 0; i < n; i++)
+        {
+            if (pointerTree->nearestNeighbor(dataScan->point(i), pointerNeighbors[i], distance, maxDistance))
+            {
+                found++;
+            }
+        }
+        pointerSearch = min(pointerSearch, secondsSince(start));
+        pointerFound = found;
+    }
+
+    // =============== validate ===============
+    size_t mismatches = 0;
+
+    #pragma omp parallel for reduction(+:mismatches)
+    for (size_t i = 0; i < n; i++)
+    {
+        KDTree::Point query = dataScan->point(i).cast<float>();
+        if ((flatNeighbors[i] == nullptr) != (pointerNeighbors[i] == nullptr))
+        {
+            mismatches++;
+        }
+        else if (flatNeighbors[i] && (query - *flatNeighbors[i]).squaredNorm() != (query - *pointerNeighbors[i]).squaredNorm())
+        {
+            mismatches++;
+        }
+    }
+
+    cout << fixed << setprecision(4);
+    cout << "                 build [s]   search [s]   found" << endl;
+    cout << "flat tree     " << setw(12) << flatBuild << setw(13) << flatSearch << setw(10) << flatFound << endl;
+    cout << "pointer tree  " << setw(12) << pointerBuild << setw(13) << pointerSearch << setw(10) << pointerFound << endl;
+    cout << setprecision(2);
+    cout << "speedup       " << setw(12) << pointerBuild / flatBuild << setw(13) << pointerSearch / flatSearch << endl;
+    cout << "flat tree nodes: " << flatTree->numNodes() << ", depth: " << flatTree->depth() << endl;
+
+    if (mismatches > 0)
+    {
+        cout << "Warning: " << mismatches << " queries have differing neighbor distances" << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
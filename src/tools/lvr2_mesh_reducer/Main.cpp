@@ -39,6 +39,7 @@
 using std::unique_ptr;
 using std::make_unique;
 
+#include "lvr2/config/lvropenmp.hpp"
 #include "lvr2/io/Progress.hpp"
 #include "lvr2/io/Model.hpp"
 #include "lvr2/geometry/HalfEdgeMesh.hpp"
@@ -63,6 +64,7 @@ int main(int argc, char** argv)
         return EXIT_SUCCESS;
     }
     std::cout << options << std::endl;
+    lvr2::OpenMPConfig::setNumThreads(options.getNumThreads());
     cout << "LOAD" << endl;
     lvr2::ModelPtr model = lvr2::ModelFactory::readModel(options.getInputFileName());
     cout << "MODEL" << endl;
@@ -90,7 +92,9 @@ int main(int argc, char** argv)
         // Each edge collapse removes two faces in the general case.
         // TODO: maybe we should calculate this differently...
         const auto count = static_cast<size_t>((mesh.numFaces() / 2) * reductionRatio);
-        auto collapsedCount = simpleMeshReduction(mesh, count, faceNormals);
+        auto collapsedCount = options.useParallelReduction()
+            ? simpleParallelMeshReduction(mesh, count, faceNormals)
+            : simpleMeshReduction(mesh, count, faceNormals);
     }
 
     // =======================================================================
@@ -53,7 +53,12 @@ Options::Options(int argc, char** argv) : BaseOption(argc, argv)
         "reductionRatio,r",
         value<float>(&m_edgeCollapseReductionRatio)->default_value(0.0),
         "Percentage of faces to remove via edge-collapse (0.0 means no reduction, 1.0 means to "
-        "remove all faces which can be removed)");
+        "remove all faces which can be removed)")(
+        "parallel",
+        "Collapse edges in parallel batches instead of strictly in order of their cost")(
+        "threads",
+        value<int>(&m_numThreads)->default_value(lvr2::OpenMPConfig::getNumThreads()),
+        "Number of threads");
     setup();
 }
 
@@ -67,6 +72,16 @@ float Options::getEdgeCollapseReductionRatio() const
     return (m_variables["reductionRatio"].as<float>());
 }
 
+bool Options::useParallelReduction() const
+{
+    return m_variables.count("parallel");
+}
+
+int Options::getNumThreads() const
+{
+    return m_variables["threads"].as<int>();
+}
+
 bool Options::printUsage() const
 {
     if (m_variables.count("help"))
@@ -76,10 +76,23 @@ class Options : public lvr2::BaseOption
      */
     float getEdgeCollapseReductionRatio() const;
 
+    /**
+     * @brief Whether edges are collapsed in parallel batches
+     */
+    bool useParallelReduction() const;
+
+    /**
+     * @brief Returns the number of used threads
+     */
+    int getNumThreads() const;
+
     bool printUsage() const;
 
   private:
     float m_edgeCollapseReductionRatio;
+
+    /// The number of used threads
+    int m_numThreads;
 };
 
 inline ostream& operator<<(ostream& os, const Options& o)
@@ -88,7 +101,10 @@ inline ostream& operator<<(ostream& os, const Options& o)
     {
         cout << "##### Edge collapse reduction ratio\t: " << o.getEdgeCollapseReductionRatio()
              << endl;
+        cout << "##### Parallel reduction\t\t: " << (o.useParallelReduction() ? "YES" : "NO")
+             << endl;
     }
+    cout << "##### Number of threads\t\t: " << o.getNumThreads() << endl;
 
     return os;
 }
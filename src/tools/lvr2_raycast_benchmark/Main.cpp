@@ -0,0 +1,372 @@
+/**
+ * Copyright (c) 2018, University Osnabrück
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University Osnabrück nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL University Osnabrück BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * Main.cpp
+ *
+ *  Micro-benchmark for the BVHRaycaster. Compares the packet traversal of
+ *  castRays over a BVH4 with casting every ray separately by castRay, and
+ *  occlusion queries with closest hit queries for the visibility of all
+ *  vertices from positions around the mesh.
+ */
+
+#include "lvr2/algorithm/raycasting/BVHRaycaster.hpp"
+#include "lvr2/io/ModelFactory.hpp"
+#include "lvr2/util/Synthetic.hpp"
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace lvr2;
+using namespace std;
+
+namespace
+{
+
+using BenchmarkInt = Intersection<intelem::Point, intelem::Distance, intelem::Face>;
+
+/**
+ * @brief Creates the ray directions of a scanner with the given resolution:
+ *        One row per horizontal angle, each covering the vertical opening angle.
+ */
+vector<vector<Vector3f>> createScannerDirections(int rows, int columns)
+{
+    const float minPhi = -M_PI / 3.0;
+    const float maxPhi = M_PI / 3.0;
+
+    vector<vector<Vector3f>> directions(rows);
+    for (int i = 0; i < rows; i++)
+    {
+        float theta = 2.0 * M_PI * i / rows;
+        directions[i].resize(columns);
+        for (int j = 0; j < columns; j++)
+        {
+            float phi = minPhi + (maxPhi - minPhi) * j / (columns - 1);
+            directions[i][j] = Vector3f(cos(phi) * cos(theta), cos(phi) * sin(theta), sin(phi));
+        }
+    }
+    return directions;
+}
+
+double secondsSince(const chrono::steady_clock::time_point& start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    string inputFile;
+    int resolution = 300;
+    int rows = 1000;
+    int columns = 500;
+    int numOrigins = 4;
+    int runs = 3;
+    unsigned int stackSize = 512;
+    bool help = false;
+
+    try
+    {
+        using namespace boost::program_options;
+
+        options_description options("Options");
+        options.add_options()
+        ("input,i", value<string>(&inputFile),
+         "A triangle mesh to cast the rays onto. A synthetic sphere is used if not given.")
+
+        ("resolution,s", value<int>(&resolution)->default_value(resolution),
+         "The number of longitude and latitude steps of the synthetic sphere.")
+
+        ("rows", value<int>(&rows)->default_value(rows),
+         "The number of horizontal steps of the simulated scanner.")
+
+        ("columns", value<int>(&columns)->default_value(columns),
+         "The number of vertical steps of the simulated scanner.")
+
+        ("origins,o", value<int>(&numOrigins)->default_value(numOrigins),
+         "The number of scan positions. They are placed randomly within the center of the mesh.")
+
+        ("runs,r", value<int>(&runs)->default_value(runs),
+         "The number of repetitions. The fastest run is reported.")
+
+        ("stackSize", value<unsigned int>(&stackSize)->default_value(stackSize),
+         "The traversal stack size of castRay.")
+
+        ("help,h", bool_switch(&help),
+         "Print this help.")
+        ;
+
+        variables_map variables;
+        store(parse_command_line(argc, argv, options), variables);
+        notify(variables);
+
+        if (help)
+        {
+            cout << "Raycast benchmark: Simulates scans of a mesh with the BVHRaycaster, once by" << endl;
+            cout << "casting single rays and once by casting packets of rays through a BVH4." << endl;
+            cout << "Usage: " << endl;
+            cout << "\tlvr2_raycast_benchmark [OPTIONS]" << endl;
+            cout << endl;
+            options.print(cout);
+            return EXIT_SUCCESS;
+        }
+    }
+    catch (const boost::program_options::error& ex)
+    {
+        cerr << ex.what() << endl;
+        cerr << endl;
+        cerr << "Use '--help' to see the list of possible options" << endl;
+        return EXIT_FAILURE;
+    }
+
+    if (rows < 1 || columns < 2 || numOrigins < 1)
+    {
+        cerr << "At least one scan position with one row of two columns is needed" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // =============== load mesh ===============
+    MeshBufferPtr mesh;
+
+    if (inputFile.empty())
+    {
+        mesh = synthetic::genSphere(resolution, resolution);
+    }
+    else
+    {
+        ModelPtr model = ModelFactory::readModel(inputFile);
+        if (!model || !model->m_mesh)
+        {
+            cerr << "Unable to read mesh from " << inputFile << endl;
+            return EXIT_FAILURE;
+        }
+        mesh = model->m_mesh;
+    }
+
+    // =============== create rays ===============
+    size_t numVertices = mesh->numVertices();
+    floatArr vertices = mesh->getVertices();
+
+    Vector3f minPoint = Vector3f::Constant(numeric_limits<float>::max());
+    Vector3f maxPoint = Vector3f::Constant(numeric_limits<float>::lowest());
+    for (size_t i = 0; i < numVertices; i++)
+    {
+        Vector3f p(vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2]);
+        minPoint = minPoint.cwiseMin(p);
+        maxPoint = maxPoint.cwiseMax(p);
+    }
+
+    mt19937 rng(42);
+    uniform_real_distribution<float> unit(-0.25f, 0.25f);
+
+    Vector3f center = (minPoint + maxPoint) / 2.0f;
+    Vector3f extent = maxPoint - minPoint;
+
+    vector<Vector3f> origins;
+    vector<vector<Vector3f>> directions;
+    vector<vector<Vector3f>> scannerDirections = createScannerDirections(rows, columns);
+
+    for (int i = 0; i < numOrigins; i++)
+    {
+        Vector3f origin = center + Vector3f(unit(rng), unit(rng), unit(rng)).cwiseProduct(extent);
+        for (auto& row : scannerDirections)
+        {
+            origins.push_back(origin);
+            directions.push_back(row);
+        }
+    }
+
+    size_t numRays = static_cast<size_t>(numOrigins) * rows * columns;
+    cout << "Faces: " << mesh->numFaces() << ", rays: " << numRays
+         << " from " << numOrigins << " positions" << endl;
+
+    // =============== build ===============
+    auto start = chrono::steady_clock::now();
+    BVHRaycaster<BenchmarkInt> raycaster(mesh, stackSize);
+    double binaryBuild = secondsSince(start);
+
+    // The BVH4 is collapsed on the first call of castRays
+    start = chrono::steady_clock::now();
+    {
+        vector<BenchmarkInt> intersections;
+        vector<uint8_t> hits;
+        raycaster.castRays(origins[0], vector<Vector3f>(1, directions[0][0]), intersections, hits);
+    }
+    double wideBuild = secondsSince(start);
+
+    // =============== cast ===============
+    vector<vector<BenchmarkInt>> singleIntersections(directions.size()), packetIntersections;
+    vector<vector<uint8_t>> singleHits(directions.size()), packetHits;
+    double singleTime = numeric_limits<double>::max();
+    double packetTime = numeric_limits<double>::max();
+
+    for (int run = 0; run < runs; run++)
+    {
+        start = chrono::steady_clock::now();
+
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < directions.size(); i++)
+        {
+            singleIntersections[i].resize(directions[i].size());
+            singleHits[i].resize(directions[i].size());
+            for (size_t j = 0; j < directions[i].size(); j++)
+            {
+                singleHits[i][j] = raycaster.castRay(origins[i], directions[i][j], singleIntersections[i][j]);
+            }
+        }
+        singleTime = min(singleTime, secondsSince(start));
+
+        start = chrono::steady_clock::now();
+        raycaster.castRays(origins, directions, packetIntersections, packetHits);
+        packetTime = min(packetTime, secondsSince(start));
+    }
+
+    // =============== visibility ===============
+    // Rays from positions outside of the bounding box to all vertices,
+    // stopping just before the vertex itself
+    vector<Vector3f> visibilityOrigins;
+    vector<Vector3f> visibilityDirections;
+    visibilityOrigins.reserve(numOrigins * numVertices);
+    visibilityDirections.reserve(numOrigins * numVertices);
+    for (int i = 0; i < numOrigins; i++)
+    {
+        Vector3f offset(unit(rng), unit(rng), unit(rng));
+        Vector3f origin = center + offset.normalized().cwiseProduct(extent);
+        for (size_t j = 0; j < numVertices; j++)
+        {
+            visibilityOrigins.push_back(origin);
+            visibilityDirections.push_back(Vector3f(vertices[j * 3], vertices[j * 3 + 1], vertices[j * 3 + 2]) - origin);
+        }
+    }
+
+    const float visibilityRange = 1.0f - 1e-3f;
+    size_t numVisibilityRays = visibilityDirections.size();
+    vector<uint8_t> closestOccluded(numVisibilityRays), singleOccluded(numVisibilityRays), packetOccluded;
+    double closestTime = numeric_limits<double>::max();
+    double occludedTime = numeric_limits<double>::max();
+    double packetOccludedTime = numeric_limits<double>::max();
+
+    for (int run = 0; run < runs; run++)
+    {
+        start = chrono::steady_clock::now();
+
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (size_t i = 0; i < numVisibilityRays; i++)
+        {
+            BenchmarkInt intersection;
+            closestOccluded[i] = raycaster.castRay(visibilityOrigins[i], visibilityDirections[i],
+                                                   0.0f, visibilityRange, intersection);
+        }
+        closestTime = min(closestTime, secondsSince(start));
+
+        start = chrono::steady_clock::now();
+
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (size_t i = 0; i < numVisibilityRays; i++)
+        {
+            singleOccluded[i] = raycaster.isOccluded(visibilityOrigins[i], visibilityDirections[i],
+                                                     0.0f, visibilityRange);
+        }
+        occludedTime = min(occludedTime, secondsSince(start));
+
+        start = chrono::steady_clock::now();
+        raycaster.isOccluded(visibilityOrigins, visibilityDirections, 0.0f, visibilityRange, packetOccluded);
+        packetOccludedTime = min(packetOccludedTime, secondsSince(start));
+    }
+
+    // =============== validate ===============
+    size_t hits = 0;
+    size_t mismatches = 0;
+
+    #pragma omp parallel for reduction(+:hits, mismatches)
+    for (size_t i = 0; i < directions.size(); i++)
+    {
+        for (size_t j = 0; j < directions[i].size(); j++)
+        {
+            const BenchmarkInt& a = singleIntersections[i][j];
+            const BenchmarkInt& b = packetIntersections[i][j];
+
+            // Rays through a shared edge may report either face, but never another distance
+            if (singleHits[i][j] != packetHits[i][j])
+            {
+                mismatches++;
+            }
+            else if (singleHits[i][j])
+            {
+                hits++;
+                if (abs(a.dist - b.dist) > 1e-5f * max(1.0f, a.dist))
+                {
+                    mismatches++;
+                }
+            }
+        }
+    }
+
+    cout << fixed << setprecision(4);
+    cout << "Build: binary BVH " << binaryBuild << " s, BVH4 " << wideBuild << " s" << endl;
+    cout << "                 cast [s]   Mrays/s" << endl;
+    cout << "single rays  " << setw(12) << singleTime << setw(10) << numRays / singleTime / 1e6 << endl;
+    cout << "ray packets  " << setw(12) << packetTime << setw(10) << numRays / packetTime / 1e6 << endl;
+    cout << setprecision(2);
+    cout << "speedup      " << setw(12) << singleTime / packetTime << endl;
+    cout << "Hits: " << hits << endl;
+
+    size_t occluded = 0;
+    for (size_t i = 0; i < numVisibilityRays; i++)
+    {
+        if (closestOccluded[i] != singleOccluded[i] || closestOccluded[i] != packetOccluded[i])
+        {
+            mismatches++;
+        }
+        occluded += closestOccluded[i];
+    }
+
+    cout << endl;
+    cout << "Visibility of " << numVertices << " vertices from " << numOrigins << " positions around the mesh" << endl;
+    cout << fixed << setprecision(4);
+    cout << "                  cast [s]   Mrays/s" << endl;
+    cout << "closest hit   " << setw(12) << closestTime << setw(10) << numVisibilityRays / closestTime / 1e6 << endl;
+    cout << "occlusion     " << setw(12) << occludedTime << setw(10) << numVisibilityRays / occludedTime / 1e6 << endl;
+    cout << "occl. packets " << setw(12) << packetOccludedTime << setw(10) << numVisibilityRays / packetOccludedTime / 1e6 << endl;
+    cout << "Occluded: " << occluded << endl;
+
+    if (mismatches > 0)
+    {
+        cout << "Warning: " << mismatches << " rays have differing intersections" << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
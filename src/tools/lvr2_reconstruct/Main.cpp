@@ -133,11 +133,16 @@ PointsetSurfacePtr<BaseVecT> loadPointCloud(const reconstruct::Options& options)
         {
             plane_fit_method = 1;
         }
+        else if(options.useFastNormals())
+        {
+            plane_fit_method = 3;
+        }
 
         // plane_fit_method
         // - 0: PCA
         // - 1: RANSAC
         // - 2: Iterative
+        // - 3: Covariance based PCA
 
         surface = make_shared<AdaptiveKSearchSurface<BaseVecT>>(
             buffer,
@@ -230,7 +235,8 @@ std::pair<shared_ptr<GridBase>, unique_ptr<FastReconstructionBase<Vec>>>
             surface,
             surface->getBoundingBox(),
             useVoxelsize,
-            options.extrude()
+            options.extrude(),
+            options.parallelGrid()
         );
         grid->calcDistanceValues();
         auto reconstruction = make_unique<FastReconstruction<Vec, FastBox<Vec>>>(grid);
@@ -244,7 +250,8 @@ std::pair<shared_ptr<GridBase>, unique_ptr<FastReconstructionBase<Vec>>>
             surface,
             surface->getBoundingBox(),
             useVoxelsize,
-            options.extrude()
+            options.extrude(),
+            options.parallelGrid()
         );
         grid->calcDistanceValues();
         auto reconstruction = make_unique<FastReconstruction<Vec, BilinearFastBox<Vec>>>(grid);
@@ -266,7 +273,8 @@ std::pair<shared_ptr<GridBase>, unique_ptr<FastReconstructionBase<Vec>>>
             surface,
             surface->getBoundingBox(),
             useVoxelsize,
-            options.extrude()
+            options.extrude(),
+            options.parallelGrid()
         );
         grid->calcDistanceValues();
         auto reconstruction = make_unique<FastReconstruction<Vec, TetraederBox<Vec>>>(grid);
@@ -280,7 +288,8 @@ std::pair<shared_ptr<GridBase>, unique_ptr<FastReconstructionBase<Vec>>>
             surface,
             surface->getBoundingBox(),
             useVoxelsize,
-            options.extrude()
+            options.extrude(),
+            options.parallelGrid()
         );
         grid->calcDistanceValues();
         auto reconstruction = make_unique<FastReconstruction<Vec, SharpBox<Vec>>>(grid);
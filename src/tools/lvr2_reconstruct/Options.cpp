@@ -67,6 +67,7 @@ Options::Options(int argc, char** argv)
         ("intersections,i", value<int>(&m_intersections)->default_value(-1), "Number of intersections used for reconstruction. If other than -1, voxelsize will calculated automatically.")
         ("pcm,p", value<string>(&m_pcm)->default_value("FLANN"), "Point cloud manager used for point handling and normal estimation. Choose from {STANN, PCL, NABO}.")
         ("ransac", "Set this flag for RANSAC based normal estimation.")
+        ("fastNormals", "Set this flag for covariance based (PCA) normal estimation using a vectorized closed-form eigen solver.")
         ("decomposition,d", value<string>(&m_pcm)->default_value("PMC"), "Defines the type of decomposition that is used for the voxels (Standard Marching Cubes (MC), Planar Marching Cubes (PMC), Standard Marching Cubes with sharp feature detection (SF), Dual Marching Cubes with an adaptive Octree (DMC) or Tetraeder (MT) decomposition. Choose from {MC, PMC, MT, SF}")
         ("optimizePlanes,o", "Shift all triangle vertices of a cluster onto their shared plane")
         ("clusterPlanes,c", "Cluster planar regions based on normal threshold, do not shift vertices into regression plane.")
@@ -111,6 +112,7 @@ Options::Options(int argc, char** argv)
         ("mtv", value<int>(&m_minimumTransformationVotes)->default_value(3), "Minimum number of votes to consider a texture transformation as correct")
         ("vcfp", "Use color information from pointcloud to paint vertices")
         ("useGPU", "GPU normal estimation")
+        ("parallelGrid", "Create the reconstruction grid with all available threads. The resulting grid is identical to the serially created one.")
         ("flipPoint", value< vector<float> >()->multitoken(), "Flippoint --flipPoint x y z" )
         ("texFromImages,q", "Foo Bar ............")
         ("projectDir,a", value<string>()->default_value(""), "Foo Bar ............")
@@ -283,6 +285,11 @@ bool Options::useRansac() const
     return (m_variables.count("ransac"));
 }
 
+bool Options::useFastNormals() const
+{
+    return (m_variables.count("fastNormals"));
+}
+
 bool Options::saveOriginalData() const
 {
     return (m_variables.count("saveOriginalData"));
@@ -443,6 +450,11 @@ bool Options::useGPU() const
     return m_variables.count("useGPU");
 }
 
+bool Options::parallelGrid() const
+{
+    return m_variables.count("parallelGrid");
+}
+
 vector<float> Options::getFlippoint() const
 {
     vector<float> dest;
@@ -138,6 +138,11 @@ public:
      */
     bool    useRansac() const;
 
+    /**
+     * @brief   If true, covariance based (PCA) normal estimation is used
+     */
+    bool    useFastNormals() const;
+
     /**
      * @brief   True if texture analysis is enabled
      */
@@ -324,6 +329,11 @@ public:
 
     bool useGPU() const;
 
+    /**
+     * @brief   Returns true if the grid should be built in parallel
+     */
+    bool parallelGrid() const;
+
     vector<float> getFlippoint() const;
 
     bool texturesFromImages() const;
@@ -479,6 +489,10 @@ inline ostream& operator<<(ostream& os, const Options &o)
     {
         cout << "##### Use RANSAC\t\t: NO" << endl;
     }
+    if(o.useFastNormals())
+    {
+        cout << "##### Use fast normals\t\t: YES" << endl;
+    }
 
     cout << "##### Voxel decomposition: \t: " << o.getDecomposition()   << endl;
     cout << "##### Classifier:\t\t: "         << o.getClassifier()      << endl;
@@ -103,6 +103,7 @@ int main(int argc, char** argv)
     string output_pose_format;
     bool no_frames = false;
     path output_dir;
+    string icp_method = "point";
 
     bool help;
 
@@ -187,6 +188,22 @@ int main(int argc, char** argv)
 
         ("epsilon", value<double>(&options.epsilon)->default_value(options.epsilon),
          "The epsilon difference between ICP-errors for the stop criterion of ICP.")
+
+        ("icpMethod", value<string>(&icp_method)->default_value(icp_method),
+         "The error metric of ICP.\n"
+         "point (default): point-to-point distances, solved with SVD.\n"
+         "plane: point-to-plane distances using normals of the model Scan. Converges in much fewer iterations on planar scenes.")
+
+        ("normalNeighbors", value<int>(&options.icpNormalNeighbors)->default_value(options.icpNormalNeighbors),
+         "The number of neighbors used to estimate normals for point-to-plane ICP.")
+
+        ("icpLevels", value<int>(&options.icpPyramidLevels)->default_value(options.icpPyramidLevels),
+         "The number of resolution levels for coarse-to-fine ICP.\n"
+         "1 (default): Run ICP only on the (reduced) Scans.")
+
+        ("icpLevelVoxelSize", value<double>(&options.icpPyramidVoxelSize)->default_value(options.icpPyramidVoxelSize),
+         "The voxel size of the finest reduced level for coarse-to-fine ICP. Each coarser level doubles it.\n"
+         "-1 (default): twice the voxel size of --reduction.")
         ;
 
         loopclosing_options.add_options()
@@ -221,6 +238,10 @@ int main(int argc, char** argv)
 
         ("slamEpsilon", value<double>(&options.slamEpsilon)->default_value(options.slamEpsilon),
          "The epsilon difference of SLAM corrections for the stop criterion of SLAM.")
+
+        ("slamTreeCache", value<size_t>(&options.slamTreeCachePoints)->default_value(options.slamTreeCachePoints),
+         "The maximum total number of Points in the KDTrees that GraphSLAM keeps between iterations.\n"
+         "Trees of further Scans are built again in every iteration.")
         ;
 
         options_description hidden_options("hidden_options");
@@ -290,6 +311,19 @@ int main(int argc, char** argv)
             }
         }
 
+        if (icp_method == "point")
+        {
+            options.icpMethod = ICPMethod::PointToPoint;
+        }
+        else if (icp_method == "plane")
+        {
+            options.icpMethod = ICPMethod::PointToPlane;
+        }
+        else
+        {
+            throw error("Unknown ICP method: " + icp_method);
+        }
+
         options.createFrames = !no_frames;
     }
     catch (const boost::program_options::error& ex)